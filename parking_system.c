@@ -4,10 +4,29 @@
 #include <math.h>
 #include <stdbool.h>
 #include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
 
 #define VACANT 0
 #define OCCUPIED 1
 
+#define PARKING_DB_FILE "sample_parking.csv"
+#define USER_DB_FILE "sample_user.csv"
+
 // B+ Tree Order and Limits
 #define ORDER 5
 #define MAXKEYS (ORDER - 1)
@@ -17,6 +36,8 @@
 typedef enum { FAILURE, SUCCESS } status_code;
 typedef enum { NOTPARKED, PARKED } parked; // for user
 
+#define PARKED_HEAPS 2 // Arrival heaps of a parked list: every parked vehicle, and those an overstay alarm is pending for
+
 
 typedef struct User_Node 
 {
@@ -34,6 +55,10 @@ typedef struct User_Node
     float parking_amt;
     float total_parking_amt;
     parked status;
+    int lot_id; // Facility of the current or last stay
+    struct User_Node* prev_parked; // Links in the facility's parked list while PARKED
+    struct User_Node* next_parked;
+    int heap_pos[PARKED_HEAPS]; // Positions in the parked list's arrival heaps, -1 when absent
 
 } User;
 
@@ -43,6 +68,7 @@ typedef struct Parking_Node
     int parking_space_status;
     float revenue;
     int occupancies;
+    User* occupant; // Vehicle parked here, NULL while vacant
 
 } Parking;
 
@@ -52,18 +78,12 @@ typedef struct GenericBPlusTreeNode
     struct GenericBPlusTreeNode* children[MAXCHILDREN]; // Internal: Pointers to children. Leaf: Not used (NULL).
     struct GenericBPlusTreeNode* parent;
     struct GenericBPlusTreeNode* next_leaf;
+    uint64_t version; // Optimistic lock word, see Concurrent B+ Tree below
     int num_keys;
     bool is_leaf;
 
 } GenericBPlusTreeNode;
 
-typedef struct ListNode 
-{
-    void* data;
-    struct ListNode* next;
-
-} ListNode;
-
 // Function Pointer Types
 typedef int (*CompareDataFunc)(const void* key1, const void* key2);
 typedef int (*CompareInternalKeyFunc)(const void* key1, const void* key2);
@@ -74,16 +94,371 @@ typedef void* (*GetKeyFromDataFunc)(const void* data);
 typedef void* (*CopyKeyFunc)(const void* key);
 typedef void (*FreeKeyFunc)(void* key);
 
-User* createUser(const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time, int parking_id) 
+
+// Metrics
+// Built only with -DPARKING_METRICS; otherwise every hook below expands to nothing.
+// Latencies go into HDR-style log-linear histograms (8 linear sub-buckets per power
+// of two of nanoseconds, so ~12% relative error at any scale) updated with relaxed
+// atomics. Metrics_Dump writes the Prometheus text exposition format; it runs on
+// request (menu, server METRICS command) or whenever the process receives SIGUSR1.
+#ifdef PARKING_METRICS
+
+typedef enum 
 {
-    User* nptr = (User*)malloc(sizeof(User));
+    METRIC_INSERT_UPDATE,
+    METRIC_EXIT_VEHICLE,
+    METRIC_GATE_BATCH,
+    METRIC_FIND_FREE_SLOT,
+    METRIC_SEARCH_BPLUS,
+    METRIC_SEARCH_BPLUS_OLC,
+    METRIC_INSERT_BPLUS,
+    METRIC_INSERT_BPLUS_OLC,
+    METRIC_READ_USERS,
+    METRIC_WRITE_USERS,
+    METRIC_READ_PARKING,
+    METRIC_WRITE_PARKING,
+    METRIC_OP_COUNT
+
+} metric_op;
+
+static const char* const metric_op_names[METRIC_OP_COUNT] = 
+{
+    "insert_update", "exit_vehicle", "gate_batch", "find_free_slot", "search_bplus", "search_bplus_olc",
+    "insert_bplus", "insert_bplus_olc", "read_users", "write_users", "read_parking", "write_parking"
+};
 
-    if (!nptr) 
+#define HIST_SUB_BITS 3
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB_BUCKETS)
+
+typedef struct LatencyHistogram 
+{
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+
+} LatencyHistogram;
+
+typedef struct Metrics 
+{
+    LatencyHistogram ops[METRIC_OP_COUNT];
+    uint64_t leaf_splits;
+    uint64_t internal_splits;
+    uint64_t root_splits;
+    uint64_t slot_searches;
+    uint64_t slot_leaves_scanned;
+
+} Metrics;
+
+static Metrics g_metrics;
+
+uint64_t metricsNow(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int histogramBucket(uint64_t value) 
+{
+    if (value < HIST_SUB_BUCKETS) return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HIST_SUB_BITS;
+
+    return ((msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS) + (int)((value >> shift) & (HIST_SUB_BUCKETS - 1));
+}
+
+// Smallest value that lands in bucket
+uint64_t histogramBucketLow(int bucket) 
+{
+    int major = bucket >> HIST_SUB_BITS;
+    uint64_t sub = bucket & (HIST_SUB_BUCKETS - 1);
+
+    if (major == 0) return sub;
+
+    return (HIST_SUB_BUCKETS + sub) << (major - 1);
+}
+
+void Metrics_Record(metric_op op, uint64_t nanos) 
+{
+    LatencyHistogram* hist = &g_metrics.ops[op];
+
+    __atomic_fetch_add(&hist->counts[histogramBucket(nanos)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum_ns, nanos, __ATOMIC_RELAXED);
+
+    uint64_t seen = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+    while (nanos > seen && !__atomic_compare_exchange_n(&hist->max_ns, &seen, nanos, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Value below which the given fraction of samples fall (bucket upper edge)
+uint64_t histogramQuantile(const LatencyHistogram* hist, double quantile) 
+{
+    uint64_t total = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+    if (total == 0) return 0;
+
+    uint64_t target = (uint64_t)ceil(quantile * total);
+    uint64_t seen = 0;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) 
     {
-        perror("Memory Allocation Failed for User");
-        exit(EXIT_FAILURE);
+        seen += __atomic_load_n(&hist->counts[i], __ATOMIC_RELAXED);
+        if (seen >= target) return histogramBucketLow(i + 1) - 1;
+    }
+
+    return hist->max_ns;
+}
+
+void Metrics_Dump(FILE* out) 
+{
+    fprintf(out, "# TYPE parking_op_latency_seconds histogram\n");
+
+    for (int op = 0; op < METRIC_OP_COUNT; op++) 
+    {
+        const LatencyHistogram* hist = &g_metrics.ops[op];
+        uint64_t total = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+        if (total == 0) continue;
+
+        // Only buckets that hold samples are emitted; cumulative counts stay exact
+        uint64_t cumulative = 0;
+        for (int i = 0; i < HIST_BUCKETS; i++) 
+        {
+            uint64_t n = __atomic_load_n(&hist->counts[i], __ATOMIC_RELAXED);
+            if (n == 0) continue;
+
+            cumulative += n;
+            fprintf(out, "parking_op_latency_seconds_bucket{op=\"%s\",le=\"%.9f\"} %llu\n", metric_op_names[op], histogramBucketLow(i + 1) / 1e9, (unsigned long long)cumulative);
+        }
+
+        fprintf(out, "parking_op_latency_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", metric_op_names[op], (unsigned long long)cumulative);
+        fprintf(out, "parking_op_latency_seconds_sum{op=\"%s\"} %.9f\n", metric_op_names[op], __atomic_load_n(&hist->sum_ns, __ATOMIC_RELAXED) / 1e9);
+        fprintf(out, "parking_op_latency_seconds_count{op=\"%s\"} %llu\n", metric_op_names[op], (unsigned long long)total);
+    }
+
+    fprintf(out, "# TYPE parking_op_latency_quantile_seconds gauge\n");
+
+    for (int op = 0; op < METRIC_OP_COUNT; op++) 
+    {
+        const LatencyHistogram* hist = &g_metrics.ops[op];
+        if (__atomic_load_n(&hist->count, __ATOMIC_RELAXED) == 0) continue;
+
+        fprintf(out, "parking_op_latency_quantile_seconds{op=\"%s\",quantile=\"0.5\"} %.9f\n", metric_op_names[op], histogramQuantile(hist, 0.5) / 1e9);
+        fprintf(out, "parking_op_latency_quantile_seconds{op=\"%s\",quantile=\"0.99\"} %.9f\n", metric_op_names[op], histogramQuantile(hist, 0.99) / 1e9);
+        fprintf(out, "parking_op_latency_quantile_seconds{op=\"%s\",quantile=\"0.999\"} %.9f\n", metric_op_names[op], histogramQuantile(hist, 0.999) / 1e9);
+        fprintf(out, "parking_op_latency_quantile_seconds{op=\"%s\",quantile=\"1\"} %.9f\n", metric_op_names[op], __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED) / 1e9);
+    }
+
+    fprintf(out, "# TYPE parking_node_splits_total counter\n");
+    fprintf(out, "parking_node_splits_total{kind=\"leaf\"} %llu\n", (unsigned long long)__atomic_load_n(&g_metrics.leaf_splits, __ATOMIC_RELAXED));
+    fprintf(out, "parking_node_splits_total{kind=\"internal\"} %llu\n", (unsigned long long)__atomic_load_n(&g_metrics.internal_splits, __ATOMIC_RELAXED));
+    fprintf(out, "parking_node_splits_total{kind=\"root\"} %llu\n", (unsigned long long)__atomic_load_n(&g_metrics.root_splits, __ATOMIC_RELAXED));
+    fprintf(out, "# TYPE parking_slot_searches_total counter\n");
+    fprintf(out, "parking_slot_searches_total %llu\n", (unsigned long long)__atomic_load_n(&g_metrics.slot_searches, __ATOMIC_RELAXED));
+    fprintf(out, "# TYPE parking_slot_leaves_scanned_total counter\n");
+    fprintf(out, "parking_slot_leaves_scanned_total %llu\n", (unsigned long long)__atomic_load_n(&g_metrics.slot_leaves_scanned, __ATOMIC_RELAXED));
+    fflush(out);
+}
+
+// SIGUSR1 is blocked in every thread and consumed here, so the dump runs in a normal thread context
+void* metricsSignalThread(void* arg) 
+{
+    sigset_t* set = (sigset_t*)arg;
+    int sig;
+
+    while (sigwait(set, &sig) == 0) 
+    {
+        Metrics_Dump(stderr);
+    }
+
+    return NULL;
+}
+
+// Call before any other thread starts so they all inherit the blocked mask
+void Metrics_InstallSignalDump(void) 
+{
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, metricsSignalThread, &set) == 0) 
+    {
+        pthread_detach(thread);
+    }
+}
+
+typedef struct MetricScope 
+{
+    metric_op op;
+    uint64_t start;
+
+} MetricScope;
+
+void metricScopeEnd(MetricScope* scope) 
+{
+    Metrics_Record(scope->op, metricsNow() - scope->start);
+}
+
+// Time the rest of the enclosing block, whichever way it returns
+#define METRIC_SCOPE(op) __attribute__((cleanup(metricScopeEnd))) MetricScope metric_scope_ = { (op), metricsNow() }
+#define METRIC_COUNT(counter, n) __atomic_fetch_add(&g_metrics.counter, (n), __ATOMIC_RELAXED)
+
+#else
+
+#define METRIC_SCOPE(op) do { } while (0)
+#define METRIC_COUNT(counter, n) do { } while (0)
+
+#endif
+
+// Tracked Allocator
+// Every heap allocation in this file goes through these wrappers so memory can be
+// accounted per category. Each block carries a small header in front of it with its
+// size, category and distance back to the real malloc'd base.
+typedef enum 
+{
+    MEM_USER,
+    MEM_PARKING,
+    MEM_TREE_NODE,
+    MEM_TREE_KEY,
+    MEM_USER_POOL,
+    MEM_SCRATCH,
+    MEM_SERVER,
+    MEM_PIPELINE,
+    MEM_EXPORT,
+    MEM_SESSION,
+    MEM_OCCUPANCY,
+    MEM_RESERVATION,
+    MEM_SLOT_INDEX,
+    MEM_PARKED,
+    MEM_PLATE_INDEX,
+    MEM_PAGE_CACHE,
+    MEM_CATEGORY_COUNT
+
+} mem_category;
+
+static const char* const mem_category_names[MEM_CATEGORY_COUNT] = 
+{
+    "user records", "parking records", "tree nodes", "tree keys",
+    "user pools", "scratch", "server", "pipeline", "export", "sessions", "occupancy", "reservations", "slot index", "parked index", "plate index", "page cache"
+};
+
+typedef struct MemCounters 
+{
+    uint64_t bytes;      // Live payload bytes
+    uint64_t peak_bytes;
+    uint64_t allocations;
+    uint64_t frees;
+
+} MemCounters;
+
+static MemCounters g_memory[MEM_CATEGORY_COUNT];
+
+typedef struct AllocHeader 
+{
+    size_t size;
+    uint32_t category;
+    uint32_t offset; // From the malloc'd base to the payload
+
+} AllocHeader;
+
+void memAccount(mem_category category, size_t size) 
+{
+    MemCounters* counters = &g_memory[category];
+    uint64_t now = __atomic_add_fetch(&counters->bytes, size, __ATOMIC_RELAXED) ;
+    __atomic_fetch_add(&counters->allocations, 1, __ATOMIC_RELAXED);
+
+    uint64_t peak = __atomic_load_n(&counters->peak_bytes, __ATOMIC_RELAXED);
+    while (now > peak && !__atomic_compare_exchange_n(&counters->peak_bytes, &peak, now, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void* trackedAlignedAlloc(size_t alignment, size_t size, mem_category category) 
+{
+    if (alignment < sizeof(AllocHeader)) alignment = sizeof(AllocHeader);
+
+    char* base = (char*)malloc(size + alignment);
+    if (!base) return NULL;
+
+    // Payload sits at the first aligned address with room for the header in front
+    uintptr_t payload = ((uintptr_t)base + sizeof(AllocHeader) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    AllocHeader* header = (AllocHeader*)payload - 1;
+    header->size = size;
+    header->category = category;
+    header->offset = (uint32_t)(payload - (uintptr_t)base);
+
+    memAccount(category, size);
+
+    return (void*)payload;
+}
+
+void* trackedMalloc(size_t size, mem_category category) 
+{
+    return trackedAlignedAlloc(sizeof(AllocHeader), size, category);
+}
+
+void* trackedCalloc(size_t count, size_t size, mem_category category) 
+{
+    void* ptr = trackedMalloc(count * size, category);
+    if (ptr) memset(ptr, 0, count * size);
+
+    return ptr;
+}
+
+void trackedFree(void* ptr) 
+{
+    if (!ptr) return;
+
+    AllocHeader* header = (AllocHeader*)ptr - 1;
+    MemCounters* counters = &g_memory[header->category];
+    __atomic_fetch_sub(&counters->bytes, header->size, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&counters->frees, 1, __ATOMIC_RELAXED);
+
+    free((char*)ptr - header->offset);
+}
+
+void* trackedRealloc(void* ptr, size_t size, mem_category category) 
+{
+    if (!ptr) return trackedMalloc(size, category);
+
+    // Only default-aligned blocks are ever grown
+    AllocHeader* header = (AllocHeader*)ptr - 1;
+    void* grown = trackedMalloc(size, (mem_category)header->category);
+    if (!grown) return NULL;
+
+    memcpy(grown, ptr, header->size < size ? header->size : size);
+    trackedFree(ptr);
+
+    return grown;
+}
+
+void Memory_Report(FILE* out) 
+{
+    uint64_t total = 0;
+
+    fprintf(out, "\n--- Memory by Category ---\n");
+    fprintf(out, "%-16s %14s %14s %12s %12s\n", "Category", "Live bytes", "Peak bytes", "Allocs", "Frees");
+
+    for (int i = 0; i < MEM_CATEGORY_COUNT; i++) 
+    {
+        const MemCounters* counters = &g_memory[i];
+        uint64_t bytes = __atomic_load_n(&counters->bytes, __ATOMIC_RELAXED);
+        total += bytes;
+
+        fprintf(out, "%-16s %14llu %14llu %12llu %12llu\n", mem_category_names[i], (unsigned long long)bytes,
+                (unsigned long long)__atomic_load_n(&counters->peak_bytes, __ATOMIC_RELAXED),
+                (unsigned long long)__atomic_load_n(&counters->allocations, __ATOMIC_RELAXED),
+                (unsigned long long)__atomic_load_n(&counters->frees, __ATOMIC_RELAXED));
     }
 
+    fprintf(out, "%-16s %14llu\n", "total", (unsigned long long)total);
+}
+
+// Fill a freshly allocated User record for a new arrival
+void initUser(User* nptr, const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time, int parking_id) 
+{
     strcpy(nptr->vehicle_num, vehicle_num);
     strcpy(nptr->owner_name, owner_name);
     strcpy(nptr->arrival_date, arrival_date);
@@ -98,13 +473,116 @@ User* createUser(const char* vehicle_num, const char* owner_name, const char* ar
     nptr->parking_amt = 0;
     nptr->total_parking_amt = 0;
     nptr->status = (parking_id > 0) ? PARKED : NOTPARKED; // Status depends if slot assigned
+    nptr->lot_id = 0;
+    nptr->prev_parked = NULL;
+    nptr->next_parked = NULL;
+    for (int h = 0; h < PARKED_HEAPS; h++) nptr->heap_pos[h] = -1;
+}
+
+User* createUser(const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time, int parking_id) 
+{
+    User* nptr = (User*)trackedMalloc(sizeof(User), MEM_USER);
+
+    if (!nptr) 
+    {
+        perror("Memory Allocation Failed for User");
+        exit(EXIT_FAILURE);
+    }
+
+    initUser(nptr, vehicle_num, owner_name, arrival_date, arrival_time, parking_id);
+
+    return nptr;
+}
+
+// Slab allocator for User records. Records are carved out of large slabs and only
+// returned to the system all at once, so a tree built from a pool must be destroyed
+// with a NULL freeData and the pool released afterwards. Alloc and Free take the pool's
+// lock, so gates that share a pool without an exclusive lock can register users.
+#define USER_POOL_SLAB 1024
+
+typedef struct UserSlab 
+{
+    struct UserSlab* next;
+    int used;
+    User records[USER_POOL_SLAB];
+
+} UserSlab;
+
+typedef struct UserPool 
+{
+    UserSlab* slabs;
+    User* free_list; // Returned records, linked through their first bytes
+    pthread_mutex_t lock;
+
+} UserPool;
+
+void UserPool_Init(UserPool* pool) 
+{
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+}
+
+User* UserPool_Alloc(UserPool* pool) 
+{
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->free_list) 
+    {
+        User* nptr = pool->free_list;
+        pool->free_list = *(User**)nptr;
+        pthread_mutex_unlock(&pool->lock);
+        return nptr;
+    }
+
+    if (pool->slabs == NULL || pool->slabs->used == USER_POOL_SLAB) 
+    {
+        UserSlab* slab = (UserSlab*)trackedMalloc(sizeof(UserSlab), MEM_USER_POOL);
+
+        if (!slab) 
+        {
+            perror("Memory Allocation Failed for User slab");
+            exit(EXIT_FAILURE);
+        }
+
+        slab->used = 0;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+    }
+
+    User* nptr = &pool->slabs->records[pool->slabs->used++];
+    pthread_mutex_unlock(&pool->lock);
 
     return nptr;
 }
 
+void UserPool_Free(UserPool* pool, User* user) 
+{
+    pthread_mutex_lock(&pool->lock);
+    *(User**)user = pool->free_list;
+    pool->free_list = user;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void UserPool_Destroy(UserPool* pool) 
+{
+    UserSlab* slab = pool->slabs;
+
+    while (slab) 
+    {
+        UserSlab* next = slab->next;
+        trackedFree(slab);
+        slab = next;
+    }
+
+    pool->slabs = NULL;
+    pool->free_list = NULL;
+    pthread_mutex_destroy(&pool->lock);
+}
+
 Parking* createParkingSlot(int i) 
 {
-    Parking* nptr = (Parking*)malloc(sizeof(Parking));
+    Parking* nptr = (Parking*)trackedMalloc(sizeof(Parking), MEM_PARKING);
 
     if (!nptr) 
     {
@@ -116,18 +594,19 @@ Parking* createParkingSlot(int i)
     nptr->occupancies = 0;
     nptr->parking_space_status = VACANT;
     nptr->revenue = 0;
+    nptr->occupant = NULL;
 
     return nptr;
 }
 
 void freeUser(void* data) 
 {
-    free(data);
+    trackedFree(data);
 }
 
 void freeParking(void* data) 
 {
-    free(data);
+    trackedFree(data);
 }
 
 
@@ -174,7 +653,7 @@ void* copyUserKey(const void* key)
 {
     const char* original_key = (const char*)key;
     size_t key_len = strlen(original_key);
-    char* new_key = (char*)malloc(key_len + 1);
+    char* new_key = (char*)trackedMalloc(key_len + 1, MEM_TREE_KEY);
 
     if (!new_key)
     {
@@ -190,7 +669,7 @@ void* copyUserKey(const void* key)
 // Create a copy of a Parking key
 void* copyParkingKey(const void* key) 
 {
-    int* new_key = (int*)malloc(sizeof(int));
+    int* new_key = (int*)trackedMalloc(sizeof(int), MEM_TREE_KEY);
 
     if (!new_key) 
     {
@@ -206,13 +685,13 @@ void* copyParkingKey(const void* key)
 // Free a copied User key
 void freeUserKey(void* key) 
 {
-    free(key);
+    trackedFree(key);
 }
 
 // Free a copied Parking key
 void freeParkingKey(void* key) 
 {
-    free(key);
+    trackedFree(key);
 }
 
 
@@ -235,14 +714,14 @@ void printUserInFile(const void* a, FILE* file)
 {
     const User* current = (const User*)a;
 
-    fprintf(file, "\n%s,%s,%s,%s,%s,%s,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%d",
+    fprintf(file, "\n%s,%s,%s,%s,%s,%s,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%d,%d",
             current->vehicle_num, current->owner_name,
             current->arrival_date, current->arrival_time,
             current->departure_date, current->departure_time,
             current->parking_space_id, current->number_of_parkings,
             current->membership, current->spent_time,
             current->total_spent_time, current->parking_amt,
-            current->total_parking_amt, (int)current->status);
+            current->total_parking_amt, (int)current->status, current->lot_id);
 }
 
 void printParkingInFile(const void* a, FILE* file) 
@@ -257,7 +736,7 @@ void printParkingInFile(const void* a, FILE* file)
 // B+ Tree Functions
 GenericBPlusTreeNode* createGenericBPlusTreeNode(bool is_leaf) 
 {
-    GenericBPlusTreeNode* node = (GenericBPlusTreeNode*)malloc(sizeof(GenericBPlusTreeNode));
+    GenericBPlusTreeNode* node = (GenericBPlusTreeNode*)trackedMalloc(sizeof(GenericBPlusTreeNode), MEM_TREE_NODE);
 
     if (!node) 
     {
@@ -269,6 +748,7 @@ GenericBPlusTreeNode* createGenericBPlusTreeNode(bool is_leaf)
     node->is_leaf = is_leaf;
     node->parent = NULL;
     node->next_leaf = NULL; // Important for B+ Tree leaves
+    node->version = 0;
     for (int i = 0; i < MAXKEYS; i++) node->keys[i] = NULL;
     for (int i = 0; i < MAXCHILDREN; i++) node->children[i] = NULL;
 
@@ -304,6 +784,8 @@ GenericBPlusTreeNode* findLeaf(GenericBPlusTreeNode* root, const void* key, Comp
 // Search for data associated with a key
 void* Search_BPlus(GenericBPlusTreeNode* root, const void* key, CompareDataFunc cmp_data, CompareInternalKeyFunc cmp_internal) 
 {
+    METRIC_SCOPE(METRIC_SEARCH_BPLUS);
+
     if (root == NULL)
     {
         return NULL;
@@ -361,13 +843,15 @@ status_code insertIntoParent(GenericBPlusTreeNode** rootRef, GenericBPlusTreeNod
         GenericBPlusTreeNode* new_root = createGenericBPlusTreeNode(false); // New root is internal
         if (!new_root) { freeKey(key_copy); return FAILURE; }
 
+        METRIC_COUNT(root_splits, 1);
+
         new_root->keys[0] = key_copy; // key_copy is owned by new_root now
         new_root->children[0] = left;
         new_root->children[1] = right;
         new_root->num_keys = 1;
         left->parent = new_root;
         right->parent = new_root;
-        *rootRef = new_root;
+        __atomic_store_n(rootRef, new_root, __ATOMIC_RELEASE); // Optimistic readers load the root concurrently
 
         return SUCCESS;
     }
@@ -401,6 +885,8 @@ status_code insertIntoParent(GenericBPlusTreeNode** rootRef, GenericBPlusTreeNod
             return FAILURE; 
         }
 
+        METRIC_COUNT(internal_splits, 1);
+
         // Temporary storage for keys and children
         void* temp_keys[MAXKEYS + 1];
         GenericBPlusTreeNode* temp_children[MAXCHILDREN + 1];
@@ -486,9 +972,78 @@ status_code insertIntoParent(GenericBPlusTreeNode** rootRef, GenericBPlusTreeNod
     }
 }
 
+// Helper to split a full leaf while inserting a new data pointer into it
+status_code splitLeafAndInsert(GenericBPlusTreeNode** rootRef, GenericBPlusTreeNode* leaf, void* dataPtr, CompareDataFunc cmp_data, CompareInternalKeyFunc cmp_internal, GetKeyFromDataFunc getKey, CopyKeyFunc copyKey, FreeKeyFunc freeKey)
+{
+    void* key = getKey(dataPtr);
+
+    GenericBPlusTreeNode* new_leaf = createGenericBPlusTreeNode(true);
+    if (!new_leaf) return FAILURE;
+
+    METRIC_COUNT(leaf_splits, 1);
+
+    // Temporary storage for keys + new key
+    void* temp_keys[MAXKEYS + 1];
+    int i = 0;
+
+    while (i < MAXKEYS && cmp_data(key, leaf->keys[i]) > 0) 
+    {
+        temp_keys[i] = leaf->keys[i];
+        i++;
+    }
+
+    temp_keys[i] = dataPtr; // Insert the new data pointer
+    while (i < MAXKEYS) 
+    {
+        temp_keys[i + 1] = leaf->keys[i];
+        i++;
+    }
+
+
+    // Distribute keys between old and new leaf
+    int split_point = (MAXKEYS + 1 + 1) / 2; // Ceil((MAXKEYS+1)/2)
+    leaf->num_keys = split_point;
+    new_leaf->num_keys = (MAXKEYS + 1) - split_point;
+
+    for (i = 0; i < leaf->num_keys; i++) 
+    {
+        leaf->keys[i] = temp_keys[i];
+    }
+     // Clear remaining pointers in old leaf (optional but good practice)
+    for (i = leaf->num_keys; i < MAXKEYS; i++) 
+    {
+        leaf->keys[i] = NULL;
+    }
+
+    for (i = 0; i < new_leaf->num_keys; i++) 
+    {
+        new_leaf->keys[i] = temp_keys[split_point + i];
+    }
+
+    // Clear remaining pointers in new leaf
+    for (i = new_leaf->num_keys; i < MAXKEYS; i++) 
+    {
+        new_leaf->keys[i] = NULL;
+    }
+
+    // Update parent pointers and leaf links
+    new_leaf->parent = leaf->parent;
+    new_leaf->next_leaf = leaf->next_leaf;
+    leaf->next_leaf = new_leaf;
+
+    // Get the key to copy up (first key of the new leaf)
+    void* key_to_copy_up = getKey(new_leaf->keys[0]);
+    void* key_copy = copyKey(key_to_copy_up); // Create a copy for the internal node
+
+    // Insert the copied key into the parent
+    return insertIntoParent(rootRef, leaf, key_copy, new_leaf, copyKey, freeKey, cmp_internal);
+}
+
 // Main Insertion Function
 status_code Insert_BPlus(GenericBPlusTreeNode** rootRef, void* dataPtr, CompareDataFunc cmp_data, CompareInternalKeyFunc cmp_internal, GetKeyFromDataFunc getKey, CopyKeyFunc copyKey, FreeKeyFunc freeKey)
 {
+    METRIC_SCOPE(METRIC_INSERT_BPLUS);
+
     status_code sc = SUCCESS;
 
     // Handle Empty Tree
@@ -527,1120 +1082,10988 @@ status_code Insert_BPlus(GenericBPlusTreeNode** rootRef, void* dataPtr, CompareD
             else 
             {
                 // Leaf is full - Split the leaf
-                GenericBPlusTreeNode* new_leaf = createGenericBPlusTreeNode(true);
-                if (!new_leaf) return FAILURE;
+                return splitLeafAndInsert(rootRef, leaf, dataPtr, cmp_data, cmp_internal, getKey, copyKey, freeKey);
+            }
+        }
+    }
 
-                // Temporary storage for keys + new key
-                void* temp_keys[MAXKEYS + 1];
-                int i = 0;
+    return sc;
+}
 
-                while (i < MAXKEYS && cmp_data(key, leaf->keys[i]) > 0) 
-                {
-                    temp_keys[i] = leaf->keys[i];
-                    i++;
-                }
 
-                temp_keys[i] = dataPtr; // Insert the new data pointer
-                while (i < MAXKEYS) 
-                {
-                    temp_keys[i + 1] = leaf->keys[i];
-                    i++;
-                }
+// Concurrent B+ Tree (Optimistic Lock Coupling)
+// Every node carries a version word: bit 0 is a write latch, and each write unlock
+// bumps the version. Readers never latch - they remember the version, read, and
+// restart from the root if it moved. Writers crab down latching each node and drop
+// all ancestors as soon as a child has room, so a split only holds the nodes it rewrites.
+// Internal keys and data records are never freed while the tree is live, which is what
+// makes it safe for a reader to look at a node that is being rewritten under it.
+typedef struct ConcurrentBPlusTree 
+{
+    GenericBPlusTreeNode* root; // Swapped only while root_latch is held
+    uint64_t root_latch;        // Same version protocol as the nodes
 
+} ConcurrentBPlusTree;
 
-                // Distribute keys between old and new leaf
-                int split_point = (MAXKEYS + 1 + 1) / 2; // Ceil((MAXKEYS+1)/2)
-                leaf->num_keys = split_point;
-                new_leaf->num_keys = (MAXKEYS + 1) - split_point;
+#define OLC_MAX_HEIGHT 64
 
-                for (i = 0; i < leaf->num_keys; i++) 
-                {
-                    leaf->keys[i] = temp_keys[i];
-                }
-                 // Clear remaining pointers in old leaf (optional but good practice)
-                for (i = leaf->num_keys; i < MAXKEYS; i++) 
-                {
-                    leaf->keys[i] = NULL;
-                }
+void versionWriteLock(uint64_t* version) 
+{
+    uint64_t expected = __atomic_load_n(version, __ATOMIC_RELAXED);
 
-                for (i = 0; i < new_leaf->num_keys; i++) 
-                {
-                    new_leaf->keys[i] = temp_keys[split_point + i];
-                }
+    while (true) 
+    {
+        if ((expected & 1) == 0 && __atomic_compare_exchange_n(version, &expected, expected | 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) 
+        {
+            return;
+        }
 
-                // Clear remaining pointers in new leaf
-                for (i = new_leaf->num_keys; i < MAXKEYS; i++) 
-                {
-                    new_leaf->keys[i] = NULL;
-                }
+        sched_yield();
+        expected = __atomic_load_n(version, __ATOMIC_RELAXED);
+    }
+}
 
-                // Update parent pointers and leaf links
-                new_leaf->parent = leaf->parent;
-                new_leaf->next_leaf = leaf->next_leaf;
-                leaf->next_leaf = new_leaf;
+void versionWriteUnlock(uint64_t* version) 
+{
+    __atomic_fetch_add(version, 1, __ATOMIC_RELEASE); // Odd -> even, and a new version
+}
 
-                // Get the key to copy up (first key of the new leaf)
-                void* key_to_copy_up = getKey(new_leaf->keys[0]);
-                void* key_copy = copyKey(key_to_copy_up); // Create a copy for the internal node
+// Returns false if the word is latched; the caller restarts
+bool versionReadLock(const uint64_t* version, uint64_t* seen) 
+{
+    *seen = __atomic_load_n(version, __ATOMIC_ACQUIRE);
+    return (*seen & 1) == 0;
+}
 
-                // Insert the copied key into the parent
-                return insertIntoParent(rootRef, leaf, key_copy, new_leaf, copyKey, freeKey, cmp_internal);
-            }
-        }
-    }
+bool versionValidate(const uint64_t* version, uint64_t seen) 
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(version, __ATOMIC_RELAXED) == seen;
+}
 
-    return sc;
+void Init_Concurrent_BPlus(ConcurrentBPlusTree* tree, GenericBPlusTreeNode* root) 
+{
+    tree->root = root;
+    tree->root_latch = 0;
 }
 
+// Optimistic descent: returns the leaf for key and the version it was read at, or NULL on an empty tree
+GenericBPlusTreeNode* findLeaf_OLC(ConcurrentBPlusTree* tree, const void* key, CompareInternalKeyFunc cmp_internal, uint64_t* leaf_version) 
+{
+restart:
+    ;
+    GenericBPlusTreeNode* node = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+    if (node == NULL) return NULL;
+
+    uint64_t version;
+    if (!versionReadLock(&node->version, &version)) goto restart;
 
+    // A split may have pushed a new root above the one we loaded
+    if (__atomic_load_n(&tree->root, __ATOMIC_ACQUIRE) != node) goto restart;
 
-// B+ Tree Traversal (Leaf Nodes)
-void traverseLeaves(GenericBPlusTreeNode* root, PrintFunc print) 
-{
-    if (!root) 
+    while (!node->is_leaf) 
     {
-        printf("Tree is empty.\n");
-        return;
-    }
+        int num_keys = __atomic_load_n(&node->num_keys, __ATOMIC_RELAXED);
+        if (num_keys > MAXKEYS) goto restart;
 
-    // Find the leftmost leaf node
-    GenericBPlusTreeNode* current = root;
-    while (current && !current->is_leaf) 
-    {
-        current = current->children[0];
-    }
+        int i = 0;
+        while (i < num_keys) 
+        {
+            void* separator = __atomic_load_n(&node->keys[i], __ATOMIC_RELAXED);
+            if (separator == NULL) goto restart; // Torn read of a node being split
 
-    if (!current) 
-    {
-        printf("No leaf nodes found (tree might be corrupted or empty internal).\n");
-        return;
-    }
+            if (cmp_internal(key, separator) < 0) break;
+            i++;
+        }
 
+        GenericBPlusTreeNode* child = __atomic_load_n(&node->children[i], __ATOMIC_ACQUIRE);
+        if (child == NULL) goto restart;
 
-    // Traverse the linked list of leaves
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->num_keys; i++) 
-        {
-            if (current->keys[i]) // Check if pointer is valid
-            { 
-                print(current->keys[i]);
-            } 
-            else 
-            {
-                printf("NULL data pointer found at index %d\n", i);
-            }
+        uint64_t child_version;
+        if (!versionReadLock(&child->version, &child_version)) goto restart;
 
-        }
-        printf("\n");
-        current = current->next_leaf;
+        // Parent must be unchanged, otherwise the child we picked may no longer cover key
+        if (!versionValidate(&node->version, version)) goto restart;
+
+        node = child;
+        version = child_version;
     }
 
-    printf("-- End of Leaf Traversal --\n");
+    *leaf_version = version;
+    return node;
 }
 
-
-void traverseLeavesForFile(GenericBPlusTreeNode* root, PrintFuncFile print, FILE* file) 
+void* Search_BPlus_OLC(ConcurrentBPlusTree* tree, const void* key, CompareDataFunc cmp_data, CompareInternalKeyFunc cmp_internal) 
 {
-    if (!root || !file) return;
-
-    GenericBPlusTreeNode* current = root;
+    METRIC_SCOPE(METRIC_SEARCH_BPLUS_OLC);
 
-    while (current && !current->is_leaf) 
+    while (true) 
     {
-        current = current->children[0];
-    }
-     
-    if (!current) return; // Empty tree or no leaves
+        uint64_t version;
+        GenericBPlusTreeNode* leaf = findLeaf_OLC(tree, key, cmp_internal, &version);
+        if (!leaf) return NULL;
 
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->num_keys; i++) 
+        void* found = NULL;
+        bool torn = false;
+        int num_keys = __atomic_load_n(&leaf->num_keys, __ATOMIC_RELAXED);
+        if (num_keys > MAXKEYS) continue;
+
+        for (int i = 0; i < num_keys; i++) 
         {
+            void* data = __atomic_load_n(&leaf->keys[i], __ATOMIC_RELAXED);
+            if (data == NULL) 
+            {
+                torn = true;
+                break;
+            }
 
-            if (current->keys[i]) 
+            if (cmp_data(key, data) == 0) 
             {
-                print(current->keys[i], file);
+                found = data;
+                break;
             }
         }
-        current = current->next_leaf;
-    }
-}
 
-
-// Search User
-User* SearchUser_BPlus(GenericBPlusTreeNode* userRoot, const char* vehicle_num) 
-{
-    return (User*)Search_BPlus(userRoot, vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal);
+        if (!torn && versionValidate(&leaf->version, version)) 
+        {
+            return found;
+        }
+    }
 }
 
-// Search Parking
-Parking* SearchParking_BPlus(GenericBPlusTreeNode* parkingRoot, int parking_id) 
+// Optimistic descent to the leftmost leaf, or NULL on an empty tree. Splits keep the left
+// half in place, so the leftmost leaf never moves once the tree has one.
+GenericBPlusTreeNode* firstLeaf_OLC(ConcurrentBPlusTree* tree) 
 {
-    return (Parking*)Search_BPlus(parkingRoot, &parking_id, compareParkingId, compareParkingIdInternal);
-}
+restart:
+    ;
+    GenericBPlusTreeNode* node = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+    if (node == NULL) return NULL;
 
+    uint64_t version;
+    if (!versionReadLock(&node->version, &version)) goto restart;
 
-Parking* Find_Free_Slot(GenericBPlusTreeNode* parkingRoot, int min_id, int max_id, CompareInternalKeyFunc cmp_internal) 
-{
-    if (parkingRoot == NULL)
+    while (!node->is_leaf) 
     {
-        return NULL;
-    }
+        GenericBPlusTreeNode* child = __atomic_load_n(&node->children[0], __ATOMIC_ACQUIRE);
+        if (child == NULL) goto restart;
 
-    // Find the leaf node where min_id would reside or start
-    GenericBPlusTreeNode* leaf = findLeaf(parkingRoot, &min_id, cmp_internal);
+        uint64_t child_version;
+        if (!versionReadLock(&child->version, &child_version)) goto restart;
+        if (!versionValidate(&node->version, version)) goto restart;
 
-    GenericBPlusTreeNode* current_leaf = leaf;
+        node = child;
+        version = child_version;
+    }
 
-    // Search starting from this leaf, potentially moving to next leaves
-    while (current_leaf) 
+    return node;
+}
+
+// Read a leaf's records (into records, room for MAXKEYS, unless it is NULL) and its
+// successor as one consistent snapshot, waiting out a writer that has the leaf latched.
+// Returns how many records the leaf held.
+int readLeaf_OLC(GenericBPlusTreeNode* leaf, void** records, GenericBPlusTreeNode** next) 
+{
+    while (true) 
     {
-        for (int i = 0; i < current_leaf->num_keys; i++) 
+        uint64_t version;
+        if (!versionReadLock(&leaf->version, &version)) 
         {
-            Parking* p = (Parking*)current_leaf->keys[i];
+            sched_yield();
+            continue;
+        }
 
-            if (p->parking_id >= min_id && p->parking_id <= max_id) 
-            {
-                if (p->parking_space_status == VACANT) 
-                {
-                    return p; // Found a suitable vacant slot
-                }
-            }
+        int num_keys = __atomic_load_n(&leaf->num_keys, __ATOMIC_RELAXED);
+        bool torn = num_keys > MAXKEYS;
+
+        for (int i = 0; records && !torn && i < num_keys; i++) 
+        {
+            records[i] = __atomic_load_n(&leaf->keys[i], __ATOMIC_RELAXED);
+            torn = records[i] == NULL;
         }
 
-        current_leaf = current_leaf->next_leaf;
-    }
+        *next = __atomic_load_n(&leaf->next_leaf, __ATOMIC_ACQUIRE);
 
-    return NULL; // No vacant slot found in the range
+        if (!torn && versionValidate(&leaf->version, version)) return num_keys;
+    }
 }
 
-bool Assign_Parking_ID(GenericBPlusTreeNode* parkingRoot, int min_id, int max_id, int* assigned_parking_id) 
+// Release every latch a writer is still holding on its way down
+void releaseWriteLatches(ConcurrentBPlusTree* tree, GenericBPlusTreeNode** held, int* num_held, bool* holds_root_latch) 
 {
-    bool status = true;
-
-    Parking* freeParkingSlot = Find_Free_Slot(parkingRoot, min_id, max_id, compareParkingIdInternal);
-
-    if (freeParkingSlot == NULL) 
-    {
-        status = false;
-    } 
-    else 
+    for (int i = 0; i < *num_held; i++) 
     {
-        *assigned_parking_id = freeParkingSlot->parking_id;
-        freeParkingSlot->parking_space_status = OCCUPIED;
-        freeParkingSlot->occupancies = freeParkingSlot->occupancies + 1;
-
-        status = true;
+        versionWriteUnlock(&held[i]->version);
     }
+    *num_held = 0;
 
-    return status;
+    if (*holds_root_latch) 
+    {
+        versionWriteUnlock(&tree->root_latch);
+        *holds_root_latch = false;
+    }
 }
 
-bool Allocation_Policy(GenericBPlusTreeNode* parkingRoot, User* userNode, int* parking_id) 
+// Latch-crabbing insert. Safe to run alongside other writers and optimistic readers.
+status_code Insert_BPlus_OLC(ConcurrentBPlusTree* tree, void* dataPtr, CompareDataFunc cmp_data, CompareInternalKeyFunc cmp_internal, GetKeyFromDataFunc getKey, CopyKeyFunc copyKey, FreeKeyFunc freeKey)
 {
-    bool status = false;
-    int min_id = -1;
-    int max_id = 50;
+    METRIC_SCOPE(METRIC_INSERT_BPLUS_OLC);
 
-    // Determine search range based on membership
-    if (userNode->membership == 2)  // Gold
-    { 
-        min_id = 1; 
-    }
-    else if (userNode->membership == 1) // Premium
-    { 
-        min_id = 11;
-    } 
-    else 
+    GenericBPlusTreeNode* held[OLC_MAX_HEIGHT];
+    int num_held = 0;
+    bool holds_root_latch = true;
+    status_code sc = SUCCESS;
+
+    versionWriteLock(&tree->root_latch);
+
+    if (tree->root == NULL) 
     {
-        min_id = 21;
+        GenericBPlusTreeNode* root = createGenericBPlusTreeNode(true);
+        root->keys[0] = dataPtr;
+        root->num_keys = 1;
+        __atomic_store_n(&tree->root, root, __ATOMIC_RELEASE);
+        versionWriteUnlock(&tree->root_latch);
+
+        return SUCCESS;
     }
 
-    status = Assign_Parking_ID(parkingRoot, min_id, max_id, parking_id);
+    void* key = getKey(dataPtr);
+    GenericBPlusTreeNode* node = tree->root;
+    versionWriteLock(&node->version);
+    held[num_held++] = node;
 
-    if (status) 
+    // A root with room cannot split, so nobody will need to replace it
+    if (node->num_keys < MAXKEYS) 
     {
-        userNode->parking_space_id = *parking_id; // Update user struct immediately
+        versionWriteUnlock(&tree->root_latch);
+        holds_root_latch = false;
     }
 
-    return status;
-}
-
-bool Insert_Update(GenericBPlusTreeNode** parkingRootRef, GenericBPlusTreeNode** userRootRef, const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time)
-{
-    User* userFound = SearchUser_BPlus(*userRootRef, vehicle_num);
-    bool status = true;
-    
-    if (userFound != NULL) 
+    while (!node->is_leaf) 
     {
-        if (userFound->status == PARKED) 
+        int i = 0;
+        while (i < node->num_keys && cmp_internal(key, node->keys[i]) >= 0) 
         {
-            printf("Error: Vehicle %s is already parked.\n", vehicle_num);
-            return false;
+            i++;
         }
 
-        int parkingId = -1;
-        bool allocation_success = Allocation_Policy(*parkingRootRef, userFound, &parkingId);
+        GenericBPlusTreeNode* child = node->children[i];
+        versionWriteLock(&child->version);
 
-        if (!allocation_success) 
-        {
-            printf("No suitable parking space available for your membership level.\n");
-            return false;
-        } 
-        else 
+        // Child has room: any split stops here, so ancestors can go
+        if (child->num_keys < MAXKEYS) 
         {
-            // Update existing user record
-            strcpy(userFound->arrival_date, arrival_date);
-            strcpy(userFound->arrival_time, arrival_time);
-            strcpy(userFound->departure_date, "-");
-            strcpy(userFound->departure_time, "-");
-            userFound->status = PARKED;
-            userFound->parking_space_id = parkingId;
-            userFound->number_of_parkings++;
-            userFound->parking_amt = 0;
-            userFound->spent_time = 0;
-            printf("Vehicle %s assigned to parking ID %d.\n", vehicle_num, parkingId);
-
-            status = true;
+            releaseWriteLatches(tree, held, &num_held, &holds_root_latch);
         }
-    } 
-    else 
+
+        held[num_held++] = child;
+        node = child;
+    }
+
+    for (int i = 0; i < node->num_keys; i++) 
     {
-        Parking* freeParkingSlot = Find_Free_Slot(*parkingRootRef, 21, 50, compareParkingIdInternal);
+        if (cmp_data(key, node->keys[i]) == 0) 
+        {
+            fprintf(stderr, "Error: Duplicate key insertion attempted.\n");
+            sc = FAILURE;
+        }
+    }
 
-        if (freeParkingSlot == NULL) 
+    if (sc == SUCCESS) 
+    {
+        if (node->num_keys < MAXKEYS) 
         {
-            printf("Sorry, %s, no suitable parking space available for new users at the moment.\n", owner_name);
-            return false;
-        } 
+            sc = insertIntoLeaf(node, dataPtr, getKey, cmp_data);
+        }
         else 
         {
-            // Create the full user object *with* the assigned parking ID
-            User* newUser = createUser(vehicle_num, owner_name, arrival_date, arrival_time, freeParkingSlot->parking_id);
-
-            // Insert the new user into the B+ Tree
-            status_code insert_status = Insert_BPlus(userRootRef, newUser, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey);
-
-            if (insert_status == SUCCESS) 
-            {
-                printf("Vehicle %s assigned to parking ID %d and added to database.\n", vehicle_num, freeParkingSlot->parking_id);
-                freeParkingSlot->occupancies = freeParkingSlot->occupancies + 1;
-                freeParkingSlot->parking_space_status = OCCUPIED;
-                status = true;
-            } 
-            else 
-            {
-                freeUser(newUser); // Free the user object we created
-                status = false;
-            }
+            // Every node this split can touch is in held[], plus the root latch if it reaches the top
+            sc = splitLeafAndInsert(&tree->root, node, dataPtr, cmp_data, cmp_internal, getKey, copyKey, freeKey);
         }
     }
 
-    return status;
+    releaseWriteLatches(tree, held, &num_held, &holds_root_latch);
+
+    return sc;
 }
 
 
 
-void Time_spent(User* user) 
+// Leaf Cursor
+// Walks records in key order straight off the leaf chain without allocating. A cursor
+// is either positioned on a record or exhausted (leaf == NULL). Whenever it steps onto
+// a leaf it prefetches the next one, so long scans overlap the pointer chase with work.
+#define CURSOR_BATCH 64
+
+typedef struct BPlusCursor 
 {
-    struct tm arrival_tm = {0}, departure_tm = {0};
-    time_t arrival, departure;
-    double seconds_diff;
+    GenericBPlusTreeNode* leaf;
+    int index;
 
-    sscanf(user->arrival_date, "%d/%d/%d", &arrival_tm.tm_mday, &arrival_tm.tm_mon, &arrival_tm.tm_year);
-    sscanf(user->arrival_time, "%d:%d", &arrival_tm.tm_hour, &arrival_tm.tm_min);
-    arrival_tm.tm_year -= 1900; 
-    arrival_tm.tm_mon -= 1;
+} BPlusCursor;
 
-    // Parse departure date and time
-    sscanf(user->departure_date, "%d/%d/%d", &departure_tm.tm_mday, &departure_tm.tm_mon, &departure_tm.tm_year);
-    sscanf(user->departure_time, "%d:%d", &departure_tm.tm_hour, &departure_tm.tm_min);
-    departure_tm.tm_year -= 1900;
-    departure_tm.tm_mon -= 1; 
+// Move past the end of exhausted leaves (and any empty ones)
+void cursorSettle(BPlusCursor* cursor) 
+{
+    while (cursor->leaf && cursor->index >= cursor->leaf->num_keys) 
+    {
+        cursor->leaf = cursor->leaf->next_leaf;
+        cursor->index = 0;
 
-    arrival = mktime(&arrival_tm);
-    departure = mktime(&departure_tm);
+        if (cursor->leaf) __builtin_prefetch(cursor->leaf->next_leaf);
+    }
+}
 
-    seconds_diff = difftime(departure, arrival);
+void Cursor_First(BPlusCursor* cursor, GenericBPlusTreeNode* root) 
+{
+    GenericBPlusTreeNode* current = root;
 
-    float hours = (float)(seconds_diff / 3600.0);
+    while (current && !current->is_leaf) 
+    {
+        current = current->children[0];
+    }
 
-    user->spent_time = hours;
-    user->total_spent_time += hours; 
+    cursor->leaf = current;
+    cursor->index = 0;
 
-    printf("Time spent by %s: %.2f hours (Total: %.2f hours)\n", user->vehicle_num, user->spent_time, user->total_spent_time);
+    if (current) __builtin_prefetch(current->next_leaf);
+    cursorSettle(cursor);
 }
 
-void Membership(User* user) 
+// Position on the first record whose key is >= key
+void Cursor_Seek(BPlusCursor* cursor, GenericBPlusTreeNode* root, const void* key, CompareDataFunc cmp_data, CompareInternalKeyFunc cmp_internal) 
 {
-    int old_membership = user->membership;
+    GenericBPlusTreeNode* leaf = findLeaf(root, key, cmp_internal);
 
-    if (user->total_spent_time >= 200) 
-    {
-        user->membership = 2; // Gold
-    } 
-    else if (user->total_spent_time >= 100) 
-    {
-        user->membership = 1; // Premium
-    } 
-    else 
+    cursor->leaf = leaf;
+    cursor->index = 0;
+
+    if (!leaf) return;
+
+    __builtin_prefetch(leaf->next_leaf);
+
+    while (cursor->index < leaf->num_keys && cmp_data(key, leaf->keys[cursor->index]) > 0) 
     {
-        user->membership = 0; // Standard
+        cursor->index++;
     }
+
+    cursorSettle(cursor);
 }
 
-void Payment(Parking* parking, User* user) 
+void* Cursor_Peek(const BPlusCursor* cursor) 
 {
-    double integral;
-    double fractional = modf((double)user->spent_time, &integral);
+    return cursor->leaf ? cursor->leaf->keys[cursor->index] : NULL;
+}
 
-    int buffer = (int)(user->spent_time - fractional);
-    int parking_amt = 0;
+void* Cursor_Next(BPlusCursor* cursor) 
+{
+    if (!cursor->leaf) return NULL;
 
-    if(fractional > 0.2)
-    {
-        buffer = buffer + 1;
-    }
+    void* data = cursor->leaf->keys[cursor->index++];
+    cursorSettle(cursor);
+
+    return data;
+}
+
+// Copy up to max record pointers into out; returns how many, 0 once exhausted
+int Cursor_FetchBatch(BPlusCursor* cursor, void** out, int max) 
+{
+    int fetched = 0;
 
-    if(user->spent_time >= 3.0)
+    while (fetched < max && cursor->leaf) 
     {
-        parking_amt = 100 + 50 * ((int)(buffer - 3));
+        int available = cursor->leaf->num_keys - cursor->index;
+        int take = (available < max - fetched) ? available : max - fetched;
 
-        if(user->membership != 0)
-        {
-            parking_amt = (parking_amt * 9) / 10;
-        }
+        memcpy(out + fetched, &cursor->leaf->keys[cursor->index], sizeof(void*) * take);
+        fetched += take;
+        cursor->index += take;
+
+        cursorSettle(cursor);
     }
-    else
+
+    return fetched;
+}
+
+// Visit every record in key order
+void ForEach_BPlus(GenericBPlusTreeNode* root, void (*visit)(const void* data, void* ctx), void* ctx) 
+{
+    BPlusCursor cursor;
+    void* batch[CURSOR_BATCH];
+    int fetched;
+
+    Cursor_First(&cursor, root);
+
+    while ((fetched = Cursor_FetchBatch(&cursor, batch, CURSOR_BATCH)) > 0) 
     {
-        int parking_amt = 100;
-        if(user->membership != 0)
+        for (int i = 0; i < fetched; i++) 
         {
-            parking_amt = (parking_amt * 9) / 10;
+            visit(batch[i], ctx);
         }
     }
-
-    user->parking_amt = parking_amt;
-    user->total_parking_amt += parking_amt;
-    parking->revenue += parking_amt;
 }
 
-bool Exit_Vehicle_BPlus(GenericBPlusTreeNode** parkingRootRef, GenericBPlusTreeNode** userRootRef, const char* vehicle_num, const char* departure_date, const char* departure_time)
+long Count_BPlus(GenericBPlusTreeNode* root) 
 {
-    User* userFound = SearchUser_BPlus(*userRootRef, vehicle_num);
+    long count = 0;
+    BPlusCursor cursor;
 
-    if (!userFound) 
+    Cursor_First(&cursor, root);
+
+    for (GenericBPlusTreeNode* leaf = cursor.leaf; leaf; leaf = leaf->next_leaf) 
     {
-        printf("Error: Vehicle %s not found in database.\n", vehicle_num);
-        return false;
+        count += leaf->num_keys;
     }
 
-    if (userFound->status == NOTPARKED) 
+    return count;
+}
+
+
+// B+ Tree Traversal (Leaf Nodes)
+void traverseLeaves(GenericBPlusTreeNode* root, PrintFunc print) 
+{
+    if (!root) 
     {
-        printf("Error: Vehicle %s is not currently parked.\n", vehicle_num);
-        return false;
+        printf("Tree is empty.\n");
+        return;
     }
 
-    // Vehicle found and is parked
-    int parkingId = userFound->parking_space_id;
-    Parking* parkingFound = SearchParking_BPlus(*parkingRootRef, parkingId);
+    BPlusCursor cursor;
+    Cursor_First(&cursor, root);
 
-    // Update User Record
+    // A blank line between leaves keeps the node boundaries visible
+    GenericBPlusTreeNode* leaf = cursor.leaf;
+
+    while (cursor.leaf != NULL) 
+    {
+        if (cursor.leaf != leaf) 
+        {
+            printf("\n");
+            leaf = cursor.leaf;
+        }
+
+        print(Cursor_Next(&cursor));
+    }
+    printf("\n");
+
+    printf("-- End of Leaf Traversal --\n");
+}
+
+
+void traverseLeavesForFile(GenericBPlusTreeNode* root, PrintFuncFile print, FILE* file) 
+{
+    if (!root || !file) return;
+
+    BPlusCursor cursor;
+    void* batch[CURSOR_BATCH];
+    int fetched;
+
+    Cursor_First(&cursor, root);
+
+    while ((fetched = Cursor_FetchBatch(&cursor, batch, CURSOR_BATCH)) > 0) 
+    {
+        for (int i = 0; i < fetched; i++) 
+        {
+            print(batch[i], file);
+        }
+    }
+}
+
+
+// B+ Tree Introspection
+// One walk over a tree reporting its shape, how full its nodes are and what it costs
+// in memory. Fill factor is num_keys / MAXKEYS per node.
+typedef size_t (*KeySizeFunc)(const void* key);
+
+typedef struct BPlusTreeStats 
+{
+    int height;               // Levels, 1 for a lone leaf
+    long internal_nodes;
+    long leaf_nodes;
+    long records;
+    long leaf_chain_length;   // Leaves reachable through next_leaf from the leftmost one
+    double avg_fill;          // Over all nodes
+    double avg_leaf_fill;
+    double min_fill;
+    size_t node_bytes;
+    size_t key_bytes;         // Separator copies held by internal nodes
+    size_t record_bytes;
+
+} BPlusTreeStats;
+
+size_t userKeySize(const void* key) 
+{
+    return strlen((const char*)key) + 1;
+}
+
+size_t parkingKeySize(const void* key) 
+{
+    (void)key;
+    return sizeof(int);
+}
+
+void collectTreeStats(const GenericBPlusTreeNode* node, int depth, KeySizeFunc keySize, BPlusTreeStats* stats, long* total_keys, long* leaf_keys) 
+{
+    double fill = (double)node->num_keys / MAXKEYS;
+    if (fill < stats->min_fill) stats->min_fill = fill;
+    if (depth > stats->height) stats->height = depth;
+
+    stats->node_bytes += sizeof(GenericBPlusTreeNode);
+    *total_keys += node->num_keys;
+
+    if (node->is_leaf) 
+    {
+        stats->leaf_nodes++;
+        stats->records += node->num_keys;
+        *leaf_keys += node->num_keys;
+        return;
+    }
+
+    stats->internal_nodes++;
+
+    for (int i = 0; i < node->num_keys; i++) 
+    {
+        stats->key_bytes += keySize(node->keys[i]);
+    }
+
+    for (int i = 0; i <= node->num_keys; i++) 
+    {
+        if (node->children[i]) collectTreeStats(node->children[i], depth + 1, keySize, stats, total_keys, leaf_keys);
+    }
+}
+
+void BPlusTree_Stats(GenericBPlusTreeNode* root, KeySizeFunc keySize, size_t record_size, BPlusTreeStats* stats) 
+{
+    memset(stats, 0, sizeof(*stats));
+    if (!root) return;
+
+    long total_keys = 0, leaf_keys = 0;
+    stats->min_fill = 1.0;
+    collectTreeStats(root, 1, keySize, stats, &total_keys, &leaf_keys);
+
+    long nodes = stats->internal_nodes + stats->leaf_nodes;
+    stats->avg_fill = (double)total_keys / ((double)nodes * MAXKEYS);
+    stats->avg_leaf_fill = (double)leaf_keys / ((double)stats->leaf_nodes * MAXKEYS);
+    stats->record_bytes = stats->records * record_size;
+
+    GenericBPlusTreeNode* leaf = root;
+    while (!leaf->is_leaf) leaf = leaf->children[0];
+    for (; leaf; leaf = leaf->next_leaf) stats->leaf_chain_length++;
+}
+
+// The leaf figures of BPlusTree_Stats (leaves, records, leaf fill, chain length) for a
+// concurrent tree while latched inserts run. Each leaf is read consistently, but a leaf
+// that splits under the walk can have a few records counted twice; fine for a heuristic.
+void BPlusTree_LeafStats_OLC(ConcurrentBPlusTree* tree, BPlusTreeStats* stats) 
+{
+    memset(stats, 0, sizeof(*stats));
+
+    GenericBPlusTreeNode* next;
+    for (GenericBPlusTreeNode* leaf = firstLeaf_OLC(tree); leaf; leaf = next) 
+    {
+        stats->records += readLeaf_OLC(leaf, NULL, &next);
+        stats->leaf_nodes++;
+    }
+
+    stats->leaf_chain_length = stats->leaf_nodes;
+    if (stats->leaf_nodes > 0) stats->avg_leaf_fill = (double)stats->records / ((double)stats->leaf_nodes * MAXKEYS);
+}
+
+void printTreeStats(const char* name, const BPlusTreeStats* stats) 
+{
+    printf("\n--- %s Tree Statistics ---\n", name);
+    printf("Height: %d\n", stats->height);
+    printf("Internal nodes: %ld, Leaf nodes: %ld (chain length %ld)\n", stats->internal_nodes, stats->leaf_nodes, stats->leaf_chain_length);
+    printf("Records: %ld\n", stats->records);
+    printf("Fill factor: avg %.1f%%, leaves avg %.1f%%, min %.1f%%\n", stats->avg_fill * 100, stats->avg_leaf_fill * 100, stats->min_fill * 100);
+    printf("Bytes: nodes %zu, keys %zu, records %zu, total %zu\n", stats->node_bytes, stats->key_bytes, stats->record_bytes, stats->node_bytes + stats->key_bytes + stats->record_bytes);
+}
+
+
+// Search User
+User* SearchUser_BPlus(GenericBPlusTreeNode* userRoot, const char* vehicle_num) 
+{
+    return (User*)Search_BPlus(userRoot, vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal);
+}
+
+// Search Parking
+Parking* SearchParking_BPlus(GenericBPlusTreeNode* parkingRoot, int parking_id) 
+{
+    return (Parking*)Search_BPlus(parkingRoot, &parking_id, compareParkingId, compareParkingIdInternal);
+}
+
+// Highest slot id in the parking tree (0 if empty)
+int Max_Parking_ID(GenericBPlusTreeNode* parkingRoot) 
+{
+    GenericBPlusTreeNode* node = parkingRoot;
+
+    while (node && !node->is_leaf) 
+    {
+        node = node->children[node->num_keys];
+    }
+
+    return (node && node->num_keys > 0) ? ((Parking*)node->keys[node->num_keys - 1])->parking_id : 0;
+}
+
+
+// Plate Scans
+// Plates lead with state and district ("MH14..."), and the user tree is ordered by plate,
+// so a region is one contiguous run of leaves: seek to the lower bound with findLeaf and
+// walk next_leaf until the run ends, O(log n + k). A bound is either a prefix or a
+// half-open range [from, to); both hold for a leading run of the records from the seek
+// on, so the walk stops at the first record outside. Counting skips the per-record test
+// on every leaf whose last record is still inside.
+typedef struct PlateBound 
+{
+    const char* prefix; // Prefix scans; NULL for a range
+    size_t prefix_len;
+    const char* to;     // Range end (exclusive); NULL runs to the last plate
+
+} PlateBound;
+
+static inline bool plateInBound(const PlateBound* bound, const char* vehicle_num) 
+{
+    if (bound->prefix) return strncmp(vehicle_num, bound->prefix, bound->prefix_len) == 0;
+    return !bound->to || strcmp(vehicle_num, bound->to) < 0;
+}
+
+long plateScan(GenericBPlusTreeNode* userRoot, const char* from, const PlateBound* bound, void (*visit)(const void* data, void* ctx), void* ctx) 
+{
+    BPlusCursor cursor;
+    long found = 0;
+
+    Cursor_Seek(&cursor, userRoot, from, compareUserVehicleNum, compareUserVehicleNumInternal);
+
+    while (cursor.leaf) 
+    {
+        GenericBPlusTreeNode* leaf = cursor.leaf;
+        const User* last = (const User*)leaf->keys[leaf->num_keys - 1];
+
+        if (!visit && plateInBound(bound, last->vehicle_num)) 
+        {
+            found += leaf->num_keys - cursor.index;
+            cursor.index = leaf->num_keys;
+            cursorSettle(&cursor);
+            continue;
+        }
+
+        const User* user = (const User*)Cursor_Next(&cursor);
+        if (!plateInBound(bound, user->vehicle_num)) break;
+
+        if (visit) visit(user, ctx);
+        found++;
+    }
+
+    return found;
+}
+
+// Visit users whose plate starts with prefix, in plate order (visit may be NULL to only
+// count); returns how many there are
+long Users_ForPrefix(GenericBPlusTreeNode* userRoot, const char* prefix, void (*visit)(const void* data, void* ctx), void* ctx) 
+{
+    PlateBound bound = { prefix, strlen(prefix), NULL };
+    return plateScan(userRoot, prefix, &bound, visit, ctx);
+}
+
+// Visit users with from <= plate < to (to NULL: through the last plate) in plate order
+// (visit may be NULL to only count); returns how many there are
+long Users_ForRange(GenericBPlusTreeNode* userRoot, const char* from, const char* to, void (*visit)(const void* data, void* ctx), void* ctx) 
+{
+    PlateBound bound = { NULL, 0, to };
+    return plateScan(userRoot, from, &bound, visit, ctx);
+}
+
+long Users_CountPrefix(GenericBPlusTreeNode* userRoot, const char* prefix) 
+{
+    return Users_ForPrefix(userRoot, prefix, NULL, NULL);
+}
+
+long Users_CountRange(GenericBPlusTreeNode* userRoot, const char* from, const char* to) 
+{
+    return Users_ForRange(userRoot, from, to, NULL, NULL);
+}
+
+// Plate Matching
+// Cameras misread plates (0/O, 8/B, 1/I), and an exact miss at the gate would register a
+// phantom user. Two indexes over every known plate, sharing one lock since gates add
+// plates while others look them up:
+//  - misreads: a hash table keyed by the plate with confusable characters folded to one
+//    of each pair, so "every known plate that differs only by misreads" is one probe.
+//    Gates only auto-correct these, and only when exactly one known plate fits and that
+//    vehicle can be the one at the gate (not parked on entry, parked here on exit).
+//  - similar plates, for "did you mean": the plates in sorted order searched as an
+//    implicit trie. Walking it depth-first with one edit-distance row per prefix, a
+//    branch is dropped as soon as its row has nothing within the limit, so a lookup only
+//    touches the few thousand prefixes near the query. The dense top of the trie, where a
+//    prefix spans more than PLATE_TRIE_BUCKET plates, is built out as explicit nodes;
+//    below it the sorted run is scanned in place. Built from the user tree on the first
+//    lookup; plates added later wait in a small unsorted tail that lookups check one by
+//    one, and the sorted part is rebuilt once the tail passes PLATE_TAIL_MAX.
+#define PLATE_MAX_LEN 20
+#define PLATE_TABLE_MIN 1024
+#define PLATE_TRIE_BUCKET 32
+#define PLATE_TAIL_MAX 1024
+#define PLATE_SUGGESTIONS 5
+
+typedef struct PlateTrieNode 
+{
+    int32_t lo, hi;      // Sorted plates under this prefix
+    int32_t first_child; // Children are contiguous; -1 for a bucket scanned in place
+    int32_t num_children;
+    char c;              // Last character of the prefix
+
+} PlateTrieNode;
+
+// The plate is copied out while the index is locked: the user it came from may be evicted
+// or written to as soon as the caller lets go of the engine
+typedef struct PlateMatch 
+{
+    char vehicle_num[20];
+    int distance;
+
+} PlateMatch;
+
+typedef struct PlateIndex 
+{
+    const User** table;     // Open addressing by folded plate, NULL is empty
+    uint32_t table_cap;
+    long table_count;
+    char (*sorted)[PLATE_MAX_LEN]; // Plates of the similarity index in order, with their records
+    const User** sorted_users;
+    int32_t num_sorted;
+    PlateTrieNode* nodes;   // nodes[0] is the root (empty prefix)
+    int32_t num_nodes;
+    int32_t node_cap;
+    const User* tail[PLATE_TAIL_MAX]; // Added since the sorted part was built
+    int num_tail;
+    bool built;
+    pthread_mutex_t lock;
+
+} PlateIndex;
+
+PlateIndex g_plateIndex = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static inline char foldMisread(char c) 
+{
+    return c == 'O' ? '0' : c == 'B' ? '8' : c == 'I' ? '1' : c;
+}
+
+uint32_t hashFoldedPlate(const char* vehicle_num) 
+{
+    uint32_t hash = 2166136261u;
+
+    for (const char* c = vehicle_num; *c; c++) 
+    {
+        hash ^= (uint8_t)foldMisread(*c);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool sameFoldedPlate(const char* a, const char* b) 
+{
+    while (*a && foldMisread(*a) == foldMisread(*b)) 
+    {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+
+// Levenshtein distance between two plates (each at most PLATE_MAX_LEN characters)
+int plateDistance(const char* a, const char* b) 
+{
+    int len_a = (int)strnlen(a, PLATE_MAX_LEN), len_b = (int)strnlen(b, PLATE_MAX_LEN);
+    int row[PLATE_MAX_LEN + 1];
+
+    for (int j = 0; j <= len_b; j++) row[j] = j;
+
+    for (int i = 1; i <= len_a; i++) 
+    {
+        int diagonal = row[0];
+        row[0] = i;
+
+        for (int j = 1; j <= len_b; j++) 
+        {
+            int above = row[j];
+            int best = diagonal + (a[i - 1] != b[j - 1]);
+            if (above + 1 < best) best = above + 1;
+            if (row[j - 1] + 1 < best) best = row[j - 1] + 1;
+
+            row[j] = best;
+            diagonal = above;
+        }
+    }
+
+    return row[len_b];
+}
+
+// Index is locked
+bool plateTableInsertLocked(PlateIndex* index, const User* user) 
+{
+    if ((index->table_count + 1) * 2 > (long)index->table_cap) 
+    {
+        uint32_t cap = index->table_cap ? index->table_cap * 2 : PLATE_TABLE_MIN;
+        const User** table = (const User**)trackedCalloc(cap, sizeof(User*), MEM_PLATE_INDEX);
+
+        if (!table) 
+        {
+            perror("Failed to grow plate table");
+            return false;
+        }
+
+        for (uint32_t i = 0; i < index->table_cap; i++) 
+        {
+            if (!index->table[i]) continue;
+
+            uint32_t slot = hashFoldedPlate(index->table[i]->vehicle_num) & (cap - 1);
+            while (table[slot]) slot = (slot + 1) & (cap - 1);
+            table[slot] = index->table[i];
+        }
+
+        trackedFree(index->table);
+        index->table = table;
+        index->table_cap = cap;
+    }
+
+    uint32_t slot = hashFoldedPlate(user->vehicle_num) & (index->table_cap - 1);
+    while (index->table[slot]) slot = (slot + 1) & (index->table_cap - 1);
+
+    index->table[slot] = user;
+    index->table_count++;
+
+    return true;
+}
+
+// Drop the similarity index; the next lookup rebuilds it
+void plateSortedFreeLocked(PlateIndex* index) 
+{
+    trackedFree(index->sorted);
+    trackedFree(index->sorted_users);
+    trackedFree(index->nodes);
+    index->sorted = NULL;
+    index->sorted_users = NULL;
+    index->nodes = NULL;
+    index->num_sorted = 0;
+    index->num_nodes = 0;
+    index->node_cap = 0;
+    index->num_tail = 0;
+    index->built = false;
+}
+
+// Make a newly registered plate findable
+void PlateIndex_Add(PlateIndex* index, const User* user) 
+{
+    pthread_mutex_lock(&index->lock);
+
+    plateTableInsertLocked(index, user);
+
+    if (index->built) 
+    {
+        if (index->num_tail < PLATE_TAIL_MAX) index->tail[index->num_tail++] = user;
+        else plateSortedFreeLocked(index);
+    }
+
+    pthread_mutex_unlock(&index->lock);
+}
+
+void PlateIndex_Destroy(PlateIndex* index) 
+{
+    pthread_mutex_lock(&index->lock);
+
+    plateSortedFreeLocked(index);
+    trackedFree(index->table);
+    index->table = NULL;
+    index->table_cap = 0;
+    index->table_count = 0;
+
+    pthread_mutex_unlock(&index->lock);
+}
+
+void visitIndexPlate(const void* data, void* ctx) 
+{
+    plateTableInsertLocked((PlateIndex*)ctx, (const User*)data);
+}
+
+// Index every plate in the user tree, replacing what was there
+void PlateIndex_Build(PlateIndex* index, GenericBPlusTreeNode* userRoot) 
+{
+    PlateIndex_Destroy(index);
+
+    pthread_mutex_lock(&index->lock);
+    ForEach_BPlus(userRoot, visitIndexPlate, index);
+    pthread_mutex_unlock(&index->lock);
+}
+
+// The one known plate vehicle_num could be a misreading of (differing only in 0/O, 8/B and
+// 1/I), or NULL if there is none or more than one. vehicle_num itself is assumed unknown.
+// When accept is given, only the plates it accepts count as candidates.
+const User* PlateIndex_Misread(PlateIndex* index, const char* vehicle_num, bool (*accept)(const User* user, void* ctx), void* ctx) 
+{
+    const User* match = NULL;
+    int matches = 0;
+
+    pthread_mutex_lock(&index->lock);
+
+    if (index->table_cap > 0) 
+    {
+        uint32_t slot = hashFoldedPlate(vehicle_num) & (index->table_cap - 1);
+
+        for (; index->table[slot]; slot = (slot + 1) & (index->table_cap - 1)) 
+        {
+            const User* user = index->table[slot];
+
+            if (sameFoldedPlate(user->vehicle_num, vehicle_num) && strcmp(user->vehicle_num, vehicle_num) != 0 && (!accept || accept(user, ctx))) 
+            {
+                match = user;
+                matches++;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&index->lock);
+
+    return matches == 1 ? match : NULL;
+}
+
+// Index is locked. Expand node (at prefix length depth) into one child per next character.
+bool plateTrieExpandLocked(PlateIndex* index, int32_t node, int depth) 
+{
+    int32_t lo = index->nodes[node].lo, hi = index->nodes[node].hi;
+
+    if (hi - lo <= PLATE_TRIE_BUCKET || depth >= PLATE_MAX_LEN - 1) return true;
+
+    // Plates ending at this prefix sort first and belong to no child
+    while (lo < hi && index->sorted[lo][depth] == '\0') lo++;
+
+    index->nodes[node].first_child = index->num_nodes;
+
+    while (lo < hi) 
+    {
+        unsigned char c = (unsigned char)index->sorted[lo][depth];
+
+        // First plate past this character, by binary search over the run
+        int32_t first = lo + 1, last = hi;
+        while (first < last) 
+        {
+            int32_t mid = first + (last - first) / 2;
+            if ((unsigned char)index->sorted[mid][depth] <= c) first = mid + 1;
+            else last = mid;
+        }
+
+        if (index->num_nodes == index->node_cap) 
+        {
+            int32_t cap = index->node_cap * 2;
+            PlateTrieNode* nodes = (PlateTrieNode*)trackedRealloc(index->nodes, sizeof(PlateTrieNode) * cap, MEM_PLATE_INDEX);
+            if (!nodes) return false;
+
+            index->nodes = nodes;
+            index->node_cap = cap;
+        }
+
+        index->nodes[index->num_nodes++] = (PlateTrieNode){ lo, first, -1, 0, (char)c };
+        index->nodes[node].num_children++;
+        lo = first;
+    }
+
+    // Children were appended contiguously, so expand them after the whole run is placed
+    int32_t child = index->nodes[node].first_child;
+    int32_t count = index->nodes[node].num_children;
+
+    for (int32_t i = 0; i < count; i++) 
+    {
+        if (!plateTrieExpandLocked(index, child + i, depth + 1)) return false;
+    }
+
+    return true;
+}
+
+// Index is locked. Build the sorted plates and the trie top from the user tree.
+bool plateSortedBuildLocked(PlateIndex* index, GenericBPlusTreeNode* userRoot) 
+{
+    plateSortedFreeLocked(index);
+
+    long count = Count_BPlus(userRoot);
+
+    index->sorted = (char (*)[PLATE_MAX_LEN])trackedMalloc(PLATE_MAX_LEN * (count > 0 ? count : 1), MEM_PLATE_INDEX);
+    index->sorted_users = (const User**)trackedMalloc(sizeof(User*) * (count > 0 ? count : 1), MEM_PLATE_INDEX);
+    index->nodes = (PlateTrieNode*)trackedMalloc(sizeof(PlateTrieNode) * 1024, MEM_PLATE_INDEX);
+    index->node_cap = 1024;
+
+    if (!index->sorted || !index->sorted_users || !index->nodes) 
+    {
+        perror("Failed to allocate plate similarity index");
+        plateSortedFreeLocked(index);
+        return false;
+    }
+
+    BPlusCursor cursor;
+    const User* user;
+
+    Cursor_First(&cursor, userRoot);
+    while ((user = (const User*)Cursor_Next(&cursor)) != NULL && index->num_sorted < count) 
+    {
+        strncpy(index->sorted[index->num_sorted], user->vehicle_num, PLATE_MAX_LEN);
+        index->sorted[index->num_sorted][PLATE_MAX_LEN - 1] = '\0';
+        index->sorted_users[index->num_sorted++] = user;
+    }
+
+    index->nodes[0] = (PlateTrieNode){ 0, index->num_sorted, -1, 0, '\0' };
+    index->num_nodes = 1;
+
+    if (!plateTrieExpandLocked(index, 0, 0)) 
+    {
+        perror("Failed to grow plate trie");
+        plateSortedFreeLocked(index);
+        return false;
+    }
+
+    index->built = true;
+    return true;
+}
+
+typedef struct PlateSearch 
+{
+    const PlateIndex* index;
+    const char* query;
+    int query_len;
+    int max_distance;
+    PlateMatch* out;
+    int max;
+    int kept;
+    int found;
+
+} PlateSearch;
+
+int comparePlateMatches(const void* a, const void* b) 
+{
+    const PlateMatch* match_a = (const PlateMatch*)a;
+    const PlateMatch* match_b = (const PlateMatch*)b;
+
+    if (match_a->distance != match_b->distance) return match_a->distance - match_b->distance;
+    return strcmp(match_a->vehicle_num, match_b->vehicle_num);
+}
+
+void plateSearchKeep(PlateSearch* search, const User* user, int distance) 
+{
+    PlateMatch match;
+    memcpy(match.vehicle_num, user->vehicle_num, sizeof(match.vehicle_num));
+    match.distance = distance;
+    search->found++;
+
+    // Keep the nearest max: replace the farthest kept match if this one is nearer
+    if (search->kept < search->max) 
+    {
+        search->out[search->kept++] = match;
+        return;
+    }
+
+    int farthest = 0;
+    for (int k = 1; k < search->kept; k++) 
+    {
+        if (comparePlateMatches(&search->out[k], &search->out[farthest]) > 0) farthest = k;
+    }
+
+    if (search->kept > 0 && comparePlateMatches(&match, &search->out[farthest]) < 0) search->out[farthest] = match;
+}
+
+// Next edit-distance row after appending c to the prefix; returns the row minimum
+static inline int plateNextRow(const PlateSearch* search, const int* row, char c, int* next) 
+{
+    int minimum = next[0] = row[0] + 1;
+
+    for (int j = 1; j <= search->query_len; j++) 
+    {
+        int best = row[j - 1] + (search->query[j - 1] != c);
+        if (row[j] + 1 < best) best = row[j] + 1;
+        if (next[j - 1] + 1 < best) best = next[j - 1] + 1;
+
+        next[j] = best;
+        if (best < minimum) minimum = best;
+    }
+
+    return minimum;
+}
+
+// Scan sorted plates [lo, hi), which share a prefix of depth characters whose row is given
+void plateSearchRun(PlateSearch* search, int32_t lo, int32_t hi, int depth, const int* row) 
+{
+    const PlateIndex* index = search->index;
+
+    while (lo < hi && index->sorted[lo][depth] == '\0') 
+    {
+        if (row[search->query_len] <= search->max_distance) plateSearchKeep(search, index->sorted_users[lo], row[search->query_len]);
+        lo++;
+    }
+
+    if (depth >= PLATE_MAX_LEN - 1) return;
+
+    while (lo < hi) 
+    {
+        char c = index->sorted[lo][depth];
+        int32_t end = lo + 1;
+        while (end < hi && index->sorted[end][depth] == c) end++;
+
+        int next[PLATE_MAX_LEN + 1];
+        if (plateNextRow(search, row, c, next) <= search->max_distance) plateSearchRun(search, lo, end, depth + 1, next);
+
+        lo = end;
+    }
+}
+
+void plateSearchNode(PlateSearch* search, int32_t node_id, int depth, const int* row) 
+{
+    const PlateTrieNode* node = &search->index->nodes[node_id];
+
+    if (node->first_child < 0) 
+    {
+        plateSearchRun(search, node->lo, node->hi, depth, row);
+        return;
+    }
+
+    // Plates ending here come before the first child's run
+    for (int32_t i = node->lo; i < search->index->nodes[node->first_child].lo; i++) 
+    {
+        if (row[search->query_len] <= search->max_distance) plateSearchKeep(search, search->index->sorted_users[i], row[search->query_len]);
+    }
+
+    for (int32_t i = 0; i < node->num_children; i++) 
+    {
+        const PlateTrieNode* child = &search->index->nodes[node->first_child + i];
+        int next[PLATE_MAX_LEN + 1];
+
+        if (plateNextRow(search, row, child->c, next) <= search->max_distance) plateSearchNode(search, node->first_child + i, depth + 1, next);
+    }
+}
+
+// Known plates within max_distance edits of vehicle_num, nearest first (then by plate), up
+// to max of them in out; returns how many were found in all. userRoot is where the index
+// is (re)built from when needed, and must not change during the call.
+int PlateIndex_Similar(PlateIndex* index, GenericBPlusTreeNode* userRoot, const char* vehicle_num, int max_distance, PlateMatch* out, int max) 
+{
+    PlateSearch search = { index, vehicle_num, (int)strnlen(vehicle_num, PLATE_MAX_LEN), max_distance, out, max, 0, 0 };
+    int row[PLATE_MAX_LEN + 1];
+
+    for (int j = 0; j <= search.query_len; j++) row[j] = j;
+
+    pthread_mutex_lock(&index->lock);
+
+    if (index->built || plateSortedBuildLocked(index, userRoot)) 
+    {
+        plateSearchNode(&search, 0, 0, row);
+
+        for (int i = 0; i < index->num_tail; i++) 
+        {
+            int distance = plateDistance(vehicle_num, index->tail[i]->vehicle_num);
+            if (distance <= max_distance) plateSearchKeep(&search, index->tail[i], distance);
+        }
+    }
+
+    pthread_mutex_unlock(&index->lock);
+
+    qsort(out, search.kept, sizeof(PlateMatch), comparePlateMatches);
+
+    return search.found;
+}
+
+// Plate and Timestamp Helpers
+// FNV-1a over the plate
+uint32_t hashVehicleNum(const char* vehicle_num) 
+{
+    uint32_t hash = 2166136261u;
+
+    while (*vehicle_num) 
+    {
+        hash ^= (unsigned char)*vehicle_num++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+int64_t daysFromCivil(int year, int month, int day) 
+{
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+// "DD/MM/YYYY" and "HH:MM" to minutes since 1970-01-01 00:00; -1 if malformed.
+// time may be NULL for midnight.
+int64_t parseTimestamp(const char* date, const char* time) 
+{
+    int day, month, year, hour = 0, minute = 0;
+
+    if (sscanf(date, "%d/%d/%d", &day, &month, &year) != 3) return -1;
+    if (time && sscanf(time, "%d:%d", &hour, &minute) != 2) return -1;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return -1;
+
+    return daysFromCivil(year, month, day) * 1440 + hour * 60 + minute;
+}
+
+// Minutes since 1970-01-01 00:00 back to "DD/MM/YYYY HH:MM"
+void formatTimestamp(int64_t minutes, char* out, size_t size) 
+{
+    int64_t days = (minutes >= 0 ? minutes : minutes - 1439) / 1440;
+    int minute_of_day = (int)(minutes - days * 1440);
+
+    // Inverse of daysFromCivil
+    int64_t z = days + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    int month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    int year = (int)(yoe + era * 400 + (month <= 2));
+
+    snprintf(out, size, "%02d/%02d/%04d %02d:%02d", day, month, year, minute_of_day / 60, minute_of_day % 60);
+}
+
+
+// Lot Configuration
+// Lot size and the slot range each membership tier may use come from a small key = value
+// config (LOT_CONFIG_FILE, optional); every allocation path reads them from the current
+// facility's lot (g_lotConfig for the default facility).
+// Slots in the range are generated at startup when the parking database lacks them, so
+// a large garage needs only the config. With no config file the lot is the original one:
+// 50 slots, Gold from 1, Premium from 11, Standard (and every new user) from 21.
+#define LOT_CONFIG_FILE "sample_lot.cfg"
+#define LOT_MAX_SLOTS 1000000
+#define LOT_TIERS 3               // Indexed by membership: 0 Standard, 1 Premium, 2 Gold
+#define LOT_MAX_OCCUPANCY_RANGES 100
+
+typedef struct LotConfig 
+{
+    int slots;                    // Slot ids run 1..slots
+    int tier_first[LOT_TIERS];
+    int tier_last[LOT_TIERS];
+    int range_width;              // Slots per occupancy range series
+    bool loaded;                  // Came from a config file
+
+} LotConfig;
+
+#define LOT_DEFAULTS { 50, { 21, 11, 1 }, { 50, 50, 50 }, 10, false }
+
+LotConfig g_lotConfig = LOT_DEFAULTS;
+
+static const char* const lot_tier_keys[LOT_TIERS] = { "standard", "premium", "gold" };
+
+// Read the lot from a config of "key = value" lines ('#' starts a comment). Keys: slots,
+// standard, premium, gold (a slot range "first-last", or "first" to run to the last slot)
+// and occupancy_range_width. Keys not given keep their defaults; the default range width
+// grows with the lot so there are at most LOT_MAX_OCCUPANCY_RANGES range series. Returns
+// false if the file exists but has a bad line or inconsistent ranges.
+bool Lot_ReadConfig(const char* filename, LotConfig* config, bool* found) 
+{
+    int first[LOT_TIERS] = { 21, 11, 1 };
+    int last[LOT_TIERS] = { 0, 0, 0 }; // 0: up to the last slot
+    int slots = 50;
+    int range_width = 0;
+
+    FILE* file = fopen(filename, "r");
+    *found = (file != NULL);
+
+    char line[256];
+    int line_num = 0;
+    bool ok = true;
+
+    while (file && ok && fgets(line, sizeof(line), file) != NULL) 
+    {
+        line_num++;
+
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char key[64], value[64];
+        int fields = sscanf(line, " %63[^= \t] = %63s", key, value);
+
+        if (fields <= 0) continue;
+        if (fields != 2) 
+        {
+            ok = false;
+            break;
+        }
+
+        int tier = -1;
+        for (int t = 0; t < LOT_TIERS; t++) 
+        {
+            if (strcmp(key, lot_tier_keys[t]) == 0) tier = t;
+        }
+
+        if (strcmp(key, "slots") == 0) slots = atoi(value);
+        else if (strcmp(key, "occupancy_range_width") == 0) ok = (range_width = atoi(value)) > 0;
+        else if (tier >= 0) 
+        {
+            int fields_read = sscanf(value, "%d-%d", &first[tier], &last[tier]);
+            if (fields_read == 1) last[tier] = 0;
+            ok = (fields_read >= 1);
+        }
+        else ok = false;
+    }
+
+    if (file) fclose(file);
+
+    ok = ok && slots >= 1 && slots <= LOT_MAX_SLOTS;
+
+    for (int t = 0; ok && t < LOT_TIERS; t++) 
+    {
+        if (last[t] == 0) last[t] = slots;
+        ok = (first[t] >= 1 && first[t] <= last[t] && last[t] <= slots);
+    }
+
+    if (!ok) 
+    {
+        fprintf(stderr, "Invalid lot config %s near line %d.\n", filename, line_num);
+        return false;
+    }
+
+    if (range_width == 0) 
+    {
+        range_width = (slots + LOT_MAX_OCCUPANCY_RANGES - 1) / LOT_MAX_OCCUPANCY_RANGES;
+        if (range_width < 10) range_width = 10;
+    }
+
+    config->slots = slots;
+    config->range_width = range_width;
+    config->loaded = *found;
+    for (int t = 0; t < LOT_TIERS; t++) 
+    {
+        config->tier_first[t] = first[t];
+        config->tier_last[t] = last[t];
+    }
+
+    return true;
+}
+
+// Load the lot config at filename. A missing or bad config leaves the defaults in place.
+bool Lot_Load(LotConfig* config, const char* filename) 
+{
+    bool found = false;
+    bool ok = Lot_ReadConfig(filename, config, &found);
+
+    if (ok && found) 
+    {
+        printf("Lot config loaded from %s (%d slots).\n", filename, config->slots);
+    }
+
+    return ok;
+}
+
+// Facilities
+// One process can host several lots (see Run_Facilities) that share the user index but
+// nothing else: each has its own lot config, parking tree, slot indexes, occupancy and
+// reservations and parked list. The allocation code reaches these through the calling thread's current
+// facility, so it is the same for every lot. Threads start on the default facility, the
+// single lot of the menu, daemon and pipeline modes, whose stores are the g_ globals.
+struct SlotIndex;
+struct SlotAttributes;
+struct OccupancyTimeline;
+struct ReservationStore;
+struct ParkedList;
+
+typedef struct Facility 
+{
+    int id;
+    LotConfig* lot;
+    struct SlotIndex* slot_index;
+    struct SlotAttributes* slot_attributes;
+    struct OccupancyTimeline* occupancy;
+    struct ReservationStore* reservations;
+    struct ParkedList* parked;
+
+} Facility;
+
+extern struct SlotIndex g_slotIndex;
+extern struct SlotAttributes g_slotAttributes;
+extern struct OccupancyTimeline g_occupancy;
+extern struct ReservationStore g_reservations;
+extern struct ParkedList g_parked;
+
+Facility g_defaultFacility = { 0, &g_lotConfig, &g_slotIndex, &g_slotAttributes, &g_occupancy, &g_reservations, &g_parked };
+
+static __thread Facility* t_facility = &g_defaultFacility;
+
+static inline Facility* Facility_Current(void) 
+{
+    return t_facility;
+}
+
+// Point the calling thread at facility (NULL: the default facility)
+void Facility_Enter(Facility* facility) 
+{
+    t_facility = facility ? facility : &g_defaultFacility;
+}
+
+// Slots a membership level may use
+void Membership_Slot_Range(int membership, int* min_id, int* max_id) 
+{
+    const LotConfig* lot = Facility_Current()->lot;
+
+    if (membership < 0 || membership >= LOT_TIERS) membership = 0;
+
+    *min_id = lot->tier_first[membership];
+    *max_id = lot->tier_last[membership];
+}
+
+// Membership tier a slot is reserved for: the lowest tier whose range holds it (with the
+// default lot 2 Gold: 1-10, 1 Premium: 11-20, 0 Standard: 21 up)
+int Slot_Tier(int parking_id) 
+{
+    const LotConfig* lot = Facility_Current()->lot;
+
+    for (int t = 0; t < LOT_TIERS; t++) 
+    {
+        if (parking_id >= lot->tier_first[t] && parking_id <= lot->tier_last[t]) return t;
+    }
+
+    return LOT_TIERS - 1;
+}
+
+
+// What a gate knows about the vehicle it is placing
+typedef struct AllocationRequest 
+{
+    const char* vehicle_num;
+    int64_t arrival;         // Minutes since 1970, -1 if unknown
+    int entrance;            // Gate the vehicle came in through, see SLOT_LAYOUT_FILE
+    uint32_t required_attrs; // Slot features it needs, bits of slot_attribute
+
+} AllocationRequest;
+
+// Extra condition a vacant slot must meet to be handed out
+typedef bool (*SlotFilterFunc)(const Parking* slot, const void* ctx);
+
+
+// Reservations
+// A reservation holds one slot for a future window [start, end) in minutes since 1970.
+// Holds on one slot never overlap, so each slot keeps its holds sorted by start (ends
+// are then sorted too) and "is slot s free for [t1, t2)" is a single binary search.
+// Finding a free slot in a range uses a segment tree over slot ids. Each node keeps the
+// earliest last-hold end, the latest first-hold start and the longest gap between
+// consecutive holds of any slot below it, plus a mask of the RESERVATION_GAP_MINUTES
+// buckets (modulo 64) that those gaps touch. A subtree is skipped unless the window could
+// come after every hold of some slot, before every hold, or inside a gap long enough that
+// touches the buckets of both its ends, so a booking walks O(log n) nodes plus the slots
+// whose gaps pass both tests but still do not contain the window.
+// Walk-ins, whose stay is unknown, are kept off slots held within the next
+// RESERVATION_WALKIN_MINUTES, and a vehicle arriving inside its own window (or up to
+// RESERVATION_EARLY_MINUTES early) is sent to its held slot.
+#define RESERVATION_DB_FILE "sample_reservations.csv"
+#define RESERVATION_WALKIN_MINUTES 180
+#define RESERVATION_EARLY_MINUTES 30
+#define RESERVATION_BUCKETS 4096
+#define RESERVATION_GAP_MINUTES 120
+#define RESERVATION_VACANT_PROBES 64 // Free slots checked for being vacant now before taking the first free one
+
+typedef struct Reservation 
+{
+    int64_t id;
+    char vehicle_num[20];
+    int parking_id;
+    int64_t start;
+    int64_t end;
+    struct Reservation* next_for_plate; // Hash chains
+    struct Reservation* next_for_id;
+
+} Reservation;
+
+typedef struct SlotHolds 
+{
+    Reservation** holds; // Sorted by start
+    int count;
+    int capacity;
+
+} SlotHolds;
+
+// Segment tree node over a run of slot ids
+typedef struct HoldSpan 
+{
+    int64_t clear_from;  // Minimum over the slots of their last hold's end (INT64_MIN if one has none)
+    int64_t clear_until; // Maximum over the slots of their first hold's start (INT64_MAX if one has none)
+    int64_t max_gap;     // Longest time between two consecutive holds of one slot
+    uint64_t gap_mask;   // Bit (t / RESERVATION_GAP_MINUTES) % 64 set if such a gap covers minute t
+
+} HoldSpan;
+
+typedef struct ReservationStore 
+{
+    SlotHolds* slots; // Indexed by parking_id
+    int max_slot;
+    HoldSpan* spans;  // Segment tree, node 1 the root, leaf of slot s at span_size + s
+    int span_size;
+    Reservation* by_plate[RESERVATION_BUCKETS];
+    Reservation* by_id[RESERVATION_BUCKETS];
+    int64_t next_id;
+    long active;
+    pthread_mutex_t lock;
+
+} ReservationStore;
+
+ReservationStore g_reservations = { .next_id = 1, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// Index of the first hold on the slot that ends after t
+int holdsLowerBound(const SlotHolds* slot, int64_t t) 
+{
+    int lo = 0, hi = slot->count;
+
+    while (lo < hi) 
+    {
+        int mid = (lo + hi) / 2;
+
+        if (slot->holds[mid]->end <= t) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return lo;
+}
+
+// Store is locked. Free if no hold overlaps [start, end); holds of ignore_plate don't count.
+bool slotFreeLocked(const ReservationStore* store, int parking_id, int64_t start, int64_t end, const char* ignore_plate) 
+{
+    if (parking_id < 1 || parking_id > store->max_slot) return true;
+
+    const SlotHolds* slot = &store->slots[parking_id];
+
+    for (int i = holdsLowerBound(slot, start); i < slot->count && slot->holds[i]->start < end; i++) 
+    {
+        if (!ignore_plate || strcmp(slot->holds[i]->vehicle_num, ignore_plate) != 0) return false;
+    }
+
+    return true;
+}
+
+bool Reservation_SlotFree(ReservationStore* store, int parking_id, int64_t start, int64_t end) 
+{
+    pthread_mutex_lock(&store->lock);
+    bool free_slot = slotFreeLocked(store, parking_id, start, end, NULL);
+    pthread_mutex_unlock(&store->lock);
+
+    return free_slot;
+}
+
+void holdSpanMerge(HoldSpan* node, const HoldSpan* left, const HoldSpan* right) 
+{
+    node->clear_from = left->clear_from < right->clear_from ? left->clear_from : right->clear_from;
+    node->clear_until = left->clear_until > right->clear_until ? left->clear_until : right->clear_until;
+    node->max_gap = left->max_gap > right->max_gap ? left->max_gap : right->max_gap;
+    node->gap_mask = left->gap_mask | right->gap_mask;
+}
+
+uint64_t holdSpanBit(int64_t minute) 
+{
+    return 1ull << ((minute / RESERVATION_GAP_MINUTES) % 64);
+}
+
+// Buckets touched by the minutes [from, until), until > from
+uint64_t holdSpanGapMask(int64_t from, int64_t until) 
+{
+    int64_t first = from / RESERVATION_GAP_MINUTES, last = (until - 1) / RESERVATION_GAP_MINUTES;
+    if (last - first >= 63) return ~0ull;
+
+    uint64_t mask = 0;
+    for (int64_t bucket = first; bucket <= last; bucket++) mask |= 1ull << (bucket % 64);
+    return mask;
+}
+
+// Store is locked. Recompute a slot's leaf from its holds and fix the path above it.
+void holdSpanUpdateLocked(ReservationStore* store, int parking_id) 
+{
+    const SlotHolds* slot = &store->slots[parking_id];
+    int node = store->span_size + parking_id;
+    HoldSpan* leaf = &store->spans[node];
+
+    if (slot->count == 0) 
+    {
+        *leaf = (HoldSpan){ INT64_MIN, INT64_MAX, 0, 0 };
+    }
+    else 
+    {
+        leaf->clear_from = slot->holds[slot->count - 1]->end;
+        leaf->clear_until = slot->holds[0]->start;
+        leaf->max_gap = 0;
+        leaf->gap_mask = 0;
+
+        for (int i = 1; i < slot->count; i++) 
+        {
+            int64_t gap = slot->holds[i]->start - slot->holds[i - 1]->end;
+            if (gap > leaf->max_gap) leaf->max_gap = gap;
+            if (gap > 0) leaf->gap_mask |= holdSpanGapMask(slot->holds[i - 1]->end, slot->holds[i]->start);
+        }
+    }
+
+    for (node /= 2; node >= 1; node /= 2) holdSpanMerge(&store->spans[node], &store->spans[2 * node], &store->spans[2 * node + 1]);
+}
+
+// Store is locked. Lowest slot in [min_id, max_id] free for [start, end) under node, which
+// covers slot ids [low, high]; -1 if there is none.
+int holdSpanFindLocked(const ReservationStore* store, int node, int low, int high, int min_id, int max_id, int64_t start, int64_t end) 
+{
+    if (high < min_id || low > max_id) return -1;
+
+    const HoldSpan* span = &store->spans[node];
+    if (span->clear_from > start && span->clear_until < end) 
+    {
+        uint64_t ends = holdSpanBit(start) | holdSpanBit(end - 1);
+        if (span->max_gap < end - start || (span->gap_mask & ends) != ends) return -1;
+    }
+
+    if (low == high) return slotFreeLocked(store, low, start, end, NULL) ? low : -1;
+
+    int mid = low + (high - low) / 2;
+    int found = holdSpanFindLocked(store, 2 * node, low, mid, min_id, max_id, start, end);
+
+    return found >= 0 ? found : holdSpanFindLocked(store, 2 * node + 1, mid + 1, high, min_id, max_id, start, end);
+}
+
+// Store is locked
+int freeSlotLocked(const ReservationStore* store, int min_id, int max_id, int64_t start, int64_t end) 
+{
+    if (min_id > max_id || !store->spans) return -1;
+
+    return holdSpanFindLocked(store, 1, 0, store->span_size - 1, min_id, max_id, start, end);
+}
+
+void Reservation_Destroy(ReservationStore* store) 
+{
+    pthread_mutex_lock(&store->lock);
+
+    for (int s = 0; s <= store->max_slot && store->slots; s++) 
+    {
+        for (int i = 0; i < store->slots[s].count; i++) 
+        {
+            trackedFree(store->slots[s].holds[i]);
+        }
+        trackedFree(store->slots[s].holds);
+    }
+    trackedFree(store->slots);
+    trackedFree(store->spans);
+
+    store->slots = NULL;
+    store->max_slot = 0;
+    store->spans = NULL;
+    store->span_size = 0;
+    store->active = 0;
+    memset(store->by_plate, 0, sizeof(store->by_plate));
+    memset(store->by_id, 0, sizeof(store->by_id));
+
+    pthread_mutex_unlock(&store->lock);
+}
+
+bool Reservation_Init(ReservationStore* store, int max_slot) 
+{
+    Reservation_Destroy(store);
+
+    int span_size = 1;
+    while (span_size <= max_slot) span_size *= 2;
+
+    SlotHolds* slots = (SlotHolds*)trackedCalloc(max_slot + 1, sizeof(SlotHolds), MEM_RESERVATION);
+    HoldSpan* spans = (HoldSpan*)trackedMalloc(sizeof(HoldSpan) * 2 * span_size, MEM_RESERVATION);
+
+    if (!slots || !spans) 
+    {
+        trackedFree(slots);
+        trackedFree(spans);
+        return false;
+    }
+
+    // Every real slot starts free at all times; padding leaves are never free
+    for (int leaf = 0; leaf < span_size; leaf++) 
+    {
+        bool real = leaf >= 1 && leaf <= max_slot;
+        spans[span_size + leaf] = real ? (HoldSpan){ INT64_MIN, INT64_MAX, 0, 0 } : (HoldSpan){ INT64_MAX, INT64_MIN, -1, 0 };
+    }
+    for (int node = span_size - 1; node >= 1; node--) holdSpanMerge(&spans[node], &spans[2 * node], &spans[2 * node + 1]);
+
+    pthread_mutex_lock(&store->lock);
+    store->slots = slots;
+    store->max_slot = max_slot;
+    store->spans = spans;
+    store->span_size = span_size;
+    store->next_id = 1;
+    pthread_mutex_unlock(&store->lock);
+
+    return true;
+}
+
+// Store is locked and the slot is known to be free for the window
+bool insertHoldLocked(ReservationStore* store, Reservation* reservation) 
+{
+    SlotHolds* slot = &store->slots[reservation->parking_id];
+
+    if (slot->count == slot->capacity) 
+    {
+        int capacity = slot->capacity ? slot->capacity * 2 : 4;
+        Reservation** holds = (Reservation**)trackedRealloc(slot->holds, sizeof(Reservation*) * capacity, MEM_RESERVATION);
+        if (!holds) return false;
+
+        slot->holds = holds;
+        slot->capacity = capacity;
+    }
+
+    int at = holdsLowerBound(slot, reservation->start);
+    memmove(&slot->holds[at + 1], &slot->holds[at], sizeof(Reservation*) * (slot->count - at));
+    slot->holds[at] = reservation;
+    slot->count++;
+    holdSpanUpdateLocked(store, reservation->parking_id);
+
+    uint32_t plate_bucket = hashVehicleNum(reservation->vehicle_num) % RESERVATION_BUCKETS;
+    uint32_t id_bucket = (uint32_t)(reservation->id % RESERVATION_BUCKETS);
+
+    reservation->next_for_plate = store->by_plate[plate_bucket];
+    store->by_plate[plate_bucket] = reservation;
+    reservation->next_for_id = store->by_id[id_bucket];
+    store->by_id[id_bucket] = reservation;
+
+    if (reservation->id >= store->next_id) store->next_id = reservation->id + 1;
+    store->active++;
+
+    return true;
+}
+
+// Store is locked
+void removeHoldLocked(ReservationStore* store, Reservation* reservation) 
+{
+    SlotHolds* slot = &store->slots[reservation->parking_id];
+
+    for (int i = holdsLowerBound(slot, reservation->start); i < slot->count; i++) 
+    {
+        if (slot->holds[i] == reservation) 
+        {
+            memmove(&slot->holds[i], &slot->holds[i + 1], sizeof(Reservation*) * (slot->count - i - 1));
+            slot->count--;
+            holdSpanUpdateLocked(store, reservation->parking_id);
+            break;
+        }
+    }
+
+    Reservation** link = &store->by_plate[hashVehicleNum(reservation->vehicle_num) % RESERVATION_BUCKETS];
+    while (*link != reservation) link = &(*link)->next_for_plate;
+    *link = reservation->next_for_plate;
+
+    link = &store->by_id[reservation->id % RESERVATION_BUCKETS];
+    while (*link != reservation) link = &(*link)->next_for_id;
+    *link = reservation->next_for_id;
+
+    store->active--;
+    trackedFree(reservation);
+}
+
+// Hold the lowest free slot in [min_id, max_id] for [start, end), preferring slots that
+// are vacant right now in parkingRoot (if given) since walk-ins keep off held slots but
+// a car already parked may overstay. Only the first RESERVATION_VACANT_PROBES free slots
+// are checked for that; if none is vacant the lowest free one is taken. Returns the
+// reservation id and sets *parking_id, or returns -1 if every slot in range is held at
+// some point of the window.
+int64_t Reservation_Create(ReservationStore* store, GenericBPlusTreeNode* parkingRoot, const char* vehicle_num, int min_id, int max_id, int64_t start, int64_t end, int* parking_id) 
+{
+    if (start < 0 || end <= start) return -1;
+
+    int64_t id = -1;
+    int chosen = -1;
+    pthread_mutex_lock(&store->lock);
+
+    if (max_id > store->max_slot) max_id = store->max_slot;
+    if (min_id < 1) min_id = 1;
+
+    chosen = freeSlotLocked(store, min_id, max_id, start, end);
+
+    for (int s = chosen, probes = 0; parkingRoot && s > 0 && probes < RESERVATION_VACANT_PROBES; probes++) 
+    {
+        Parking* slot = SearchParking_BPlus(parkingRoot, s);
+
+        if (slot && __atomic_load_n(&slot->parking_space_status, __ATOMIC_ACQUIRE) == VACANT) 
+        {
+            chosen = s;
+            break;
+        }
+
+        s = freeSlotLocked(store, s + 1, max_id, start, end);
+    }
+
+    Reservation* reservation = (chosen > 0) ? (Reservation*)trackedCalloc(1, sizeof(Reservation), MEM_RESERVATION) : NULL;
+
+    if (reservation) 
+    {
+        reservation->id = store->next_id;
+        strncpy(reservation->vehicle_num, vehicle_num, sizeof(reservation->vehicle_num) - 1);
+        reservation->parking_id = chosen;
+        reservation->start = start;
+        reservation->end = end;
+
+        if (insertHoldLocked(store, reservation)) 
+        {
+            id = reservation->id;
+            *parking_id = chosen;
+        }
+        else 
+        {
+            trackedFree(reservation);
+        }
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    return id;
+}
+
+bool Reservation_Cancel(ReservationStore* store, int64_t id) 
+{
+    pthread_mutex_lock(&store->lock);
+
+    Reservation* reservation = store->by_id[id % RESERVATION_BUCKETS];
+    while (reservation && reservation->id != id) reservation = reservation->next_for_id;
+
+    if (reservation) removeHoldLocked(store, reservation);
+
+    pthread_mutex_unlock(&store->lock);
+
+    return reservation != NULL;
+}
+
+// The hold a vehicle arriving at minute arrival may use; copies it into out
+bool Reservation_Match(ReservationStore* store, const char* vehicle_num, int64_t arrival, Reservation* out) 
+{
+    bool found = false;
+    pthread_mutex_lock(&store->lock);
+
+    for (Reservation* r = store->by_plate[hashVehicleNum(vehicle_num) % RESERVATION_BUCKETS]; r; r = r->next_for_plate) 
+    {
+        if (strcmp(r->vehicle_num, vehicle_num) == 0 && arrival >= r->start - RESERVATION_EARLY_MINUTES && arrival < r->end) 
+        {
+            *out = *r;
+            found = true;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    return found;
+}
+
+// Visit a plate's reservations (in no particular order); returns how many there are
+int Reservation_ForPlate(ReservationStore* store, const char* vehicle_num, void (*visit)(const Reservation* reservation, void* ctx), void* ctx) 
+{
+    int count = 0;
+    pthread_mutex_lock(&store->lock);
+
+    for (Reservation* r = store->by_plate[hashVehicleNum(vehicle_num) % RESERVATION_BUCKETS]; r; r = r->next_for_plate) 
+    {
+        if (strcmp(r->vehicle_num, vehicle_num) == 0) 
+        {
+            visit(r, ctx);
+            count++;
+        }
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    return count;
+}
+
+// Drop holds that ended at or before minute t
+long Reservation_Purge(ReservationStore* store, int64_t t) 
+{
+    long purged = 0;
+    pthread_mutex_lock(&store->lock);
+
+    for (int s = 1; s <= store->max_slot; s++) 
+    {
+        SlotHolds* slot = &store->slots[s];
+
+        while (slot->count > 0 && slot->holds[0]->end <= t) 
+        {
+            removeHoldLocked(store, slot->holds[0]);
+            purged++;
+        }
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    return purged;
+}
+
+// Slot filter for walk-ins: keep vehicles off slots held soon, except for their own holds
+bool walkInMayTake(const Parking* slot, const void* ctx) 
+{
+    const AllocationRequest* request = (const AllocationRequest*)ctx;
+
+    if (request->arrival < 0) return true;
+
+    ReservationStore* store = Facility_Current()->reservations;
+
+    pthread_mutex_lock(&store->lock);
+    bool allowed = slotFreeLocked(store, slot->parking_id, request->arrival, request->arrival + RESERVATION_WALKIN_MINUTES, request->vehicle_num);
+    pthread_mutex_unlock(&store->lock);
+
+    return allowed;
+}
+
+// CSV with one row per hold, in the same date and time format as the gate events
+bool Reservation_Save(ReservationStore* store, const char* filename) 
+{
+    FILE* file = fopen(filename, "w");
+    if (!file) 
+    {
+        perror("Unable to open reservation file for writing");
+        return false;
+    }
+
+    fprintf(file, "Reservation_ID,Vehicle_Number,Parking_ID,Start_Date,Start_Time,End_Date,End_Time");
+
+    pthread_mutex_lock(&store->lock);
+    for (int s = 1; s <= store->max_slot; s++) 
+    {
+        for (int i = 0; i < store->slots[s].count; i++) 
+        {
+            const Reservation* r = store->slots[s].holds[i];
+            char start[24], end[24];
+
+            formatTimestamp(r->start, start, sizeof(start));
+            formatTimestamp(r->end, end, sizeof(end));
+            start[10] = end[10] = ',';
+
+            fprintf(file, "\n%lld,%s,%d,%s,%s", (long long)r->id, r->vehicle_num, r->parking_id, start, end);
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    fclose(file);
+    printf("Reservations written successfully.\n");
+
+    return true;
+}
+
+// Load holds into an initialised store. A missing file means no reservations.
+bool Reservation_Load(ReservationStore* store, const char* filename) 
+{
+    FILE* file = fopen(filename, "r");
+    if (!file) return true;
+
+    char line[256];
+    bool ok = true;
+
+    if (fgets(line, sizeof(line), file) == NULL) 
+    {
+        fclose(file);
+        return true;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    while (fgets(line, sizeof(line), file) != NULL) 
+    {
+        long long id;
+        char vehicle_num[20], start_date[11], start_time[6], end_date[11], end_time[6];
+        int parking_id;
+
+        if (sscanf(line, "%lld,%19[^,],%d,%10[^,],%5[^,],%10[^,],%5[^,\r\n]", &id, vehicle_num, &parking_id, start_date, start_time, end_date, end_time) != 7) 
+        {
+            ok = false;
+            continue;
+        }
+
+        int64_t start = parseTimestamp(start_date, start_time);
+        int64_t end = parseTimestamp(end_date, end_time);
+
+        if (start < 0 || end <= start || !slotFreeLocked(store, parking_id, start, end, NULL) || parking_id < 1 || parking_id > store->max_slot) 
+        {
+            ok = false;
+            continue;
+        }
+
+        Reservation* reservation = (Reservation*)trackedCalloc(1, sizeof(Reservation), MEM_RESERVATION);
+        if (!reservation) 
+        {
+            ok = false;
+            break;
+        }
+
+        reservation->id = id;
+        strcpy(reservation->vehicle_num, vehicle_num);
+        reservation->parking_id = parking_id;
+        reservation->start = start;
+        reservation->end = end;
+
+        if (!insertHoldLocked(store, reservation)) 
+        {
+            trackedFree(reservation);
+            ok = false;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    fclose(file);
+
+    if (!ok) fprintf(stderr, "Skipped invalid or conflicting rows in %s.\n", filename);
+
+    return ok;
+}
+
+void printReservation(const Reservation* reservation, void* ctx) 
+{
+    (void)ctx;
+    char start[24], end[24];
+
+    formatTimestamp(reservation->start, start, sizeof(start));
+    formatTimestamp(reservation->end, end, sizeof(end));
+
+    printf("  Reservation %lld: Slot %d from %s to %s\n", (long long)reservation->id, reservation->parking_id, start, end);
+}
+
+// Nearest-Slot Index
+// Each entrance has a walking distance to every slot (SLOT_LAYOUT_FILE, optional; with no
+// layout there is one entrance and a slot's distance is its id, so allocation picks the
+// lowest vacant id exactly as before). Per entrance, a segment tree over slot ids keeps
+// the minimum of (distance, id) over vacant slots, so "nearest vacant slot in [min, max]
+// from entrance E" is a range-minimum query and occupying or vacating a slot updates one
+// leaf-to-root path, both O(log n). Neither takes a lock: a refresh stores the path
+// (stopping at the first node that already holds the right minimum), then after a fence
+// re-reads the children of each node it stored, rewriting any whose minimum moved, and
+// finally re-reads the slot's status, redoing the path if that moved too. Whichever
+// refresh touches a node last therefore leaves it right, and racing gates can't leave a
+// leaf stale. Meanwhile a query may see a path half updated, which like a stale vacancy
+// bit only costs a failed claim and a retry. The lock guards building and freeing.
+#define SLOT_LAYOUT_FILE "sample_layout.csv"
+#define SLOT_INDEX_NONE UINT64_MAX
+#define SLOT_INDEX_MAX_ENTRANCES 16
+#define SLOT_INDEX_MAX_REJECTS 64
+
+typedef struct SlotIndex 
+{
+    int num_entrances;
+    int max_slot;
+    int size;            // Leaves per tree, a power of two above max_slot
+    Parking** slots;     // By parking_id
+    uint32_t* distances; // [entrance * (max_slot + 1) + parking_id]
+    uint64_t* trees;     // [entrance * 2 * size + node], (distance << 32 | parking_id)
+    pthread_mutex_t lock; // Held by Init and Destroy only
+
+} SlotIndex;
+
+SlotIndex g_slotIndex = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static inline uint64_t slotIndexChildMin(const uint64_t* tree, int node) 
+{
+    uint64_t left = __atomic_load_n(&tree[2 * node], __ATOMIC_ACQUIRE);
+    uint64_t right = __atomic_load_n(&tree[2 * node + 1], __ATOMIC_ACQUIRE);
+
+    return left < right ? left : right;
+}
+
+// Set one slot's leaf in every tree and fix the paths above it
+void slotIndexSet(SlotIndex* index, int parking_id, bool available) 
+{
+    for (int e = 0; e < index->num_entrances; e++) 
+    {
+        uint64_t* tree = &index->trees[(size_t)e * 2 * index->size];
+        int leaf = index->size + parking_id;
+        int top = leaf; // Highest node this refresh stored
+
+        __atomic_store_n(&tree[leaf], available ? ((uint64_t)index->distances[(size_t)e * (index->max_slot + 1) + parking_id] << 32 | (uint32_t)parking_id) : SLOT_INDEX_NONE, __ATOMIC_RELEASE);
+
+        // Store the new minimums up the path while they change. A node that already holds
+        // the right one is left to whoever stored it, who carries it up.
+        for (int node = leaf / 2; node >= 1; node /= 2) 
+        {
+            uint64_t value = slotIndexChildMin(tree, node);
+            if (__atomic_load_n(&tree[node], __ATOMIC_ACQUIRE) == value) break;
+
+            __atomic_store_n(&tree[node], value, __ATOMIC_RELEASE);
+            top = node;
+        }
+
+        // Then read the children of every node stored again, after a full fence, and redo
+        // any whose minimum moved in the meantime
+        for (bool moved = true; moved; ) 
+        {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            moved = false;
+
+            bool rewrote = false;
+            for (int node = leaf / 2; node >= 1 && (node >= top || rewrote); node /= 2) 
+            {
+                uint64_t value = slotIndexChildMin(tree, node);
+                rewrote = (__atomic_load_n(&tree[node], __ATOMIC_ACQUIRE) != value);
+
+                if (rewrote) 
+                {
+                    __atomic_store_n(&tree[node], value, __ATOMIC_RELEASE);
+                    moved = true;
+                    if (node < top) top = node;
+                }
+            }
+        }
+    }
+}
+
+// Bring a slot's leaves in line with its current status
+void SlotIndex_Refresh(SlotIndex* index, const Parking* slot) 
+{
+    if (!index->trees || slot->parking_id < 1 || slot->parking_id > index->max_slot) return;
+
+    int status;
+    do 
+    {
+        status = __atomic_load_n(&slot->parking_space_status, __ATOMIC_ACQUIRE);
+        slotIndexSet(index, slot->parking_id, status == VACANT);
+    } 
+    while (__atomic_load_n(&slot->parking_space_status, __ATOMIC_ACQUIRE) != status); // Ordered by the fence in slotIndexSet
+}
+
+void SlotIndex_Destroy(SlotIndex* index) 
+{
+    pthread_mutex_lock(&index->lock);
+
+    trackedFree(index->slots);
+    trackedFree(index->distances);
+    trackedFree(index->trees);
+
+    index->slots = NULL;
+    index->distances = NULL;
+    index->trees = NULL;
+    index->num_entrances = 0;
+    index->max_slot = 0;
+    index->size = 0;
+
+    pthread_mutex_unlock(&index->lock);
+}
+
+// Layout CSV: a header, then "parking_id,distance_from_entrance_0,distance_from_entrance_1,..."
+// per slot. Slots without a row are placed behind every listed slot. Returns the number of
+// entrances, 0 if there is no layout file, or -1 if it is malformed.
+int readSlotLayout(const char* filename, int max_slot, uint32_t** distances_out) 
+{
+    FILE* file = fopen(filename, "r");
+    if (!file) return 0;
+
+    char line[512];
+    int entrances = 0;
+
+    if (fgets(line, sizeof(line), file) != NULL) 
+    {
+        for (char* c = line; *c; c++) entrances += (*c == ',');
+    }
+
+    if (entrances < 1 || entrances > SLOT_INDEX_MAX_ENTRANCES) 
+    {
+        fclose(file);
+        return -1;
+    }
+
+    uint32_t* distances = (uint32_t*)trackedMalloc(sizeof(uint32_t) * entrances * (max_slot + 1), MEM_SLOT_INDEX);
+    if (!distances) 
+    {
+        fclose(file);
+        return -1;
+    }
+
+    for (int e = 0; e < entrances; e++) 
+    {
+        for (int s = 0; s <= max_slot; s++) 
+        {
+            distances[(size_t)e * (max_slot + 1) + s] = 0x7FFFFFFFu; // Unlisted
+        }
+    }
+
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL) 
+    {
+        char* cursor = line;
+        char* end;
+        long parking_id = strtol(cursor, &end, 10);
+
+        if (end == cursor) continue; // Blank line
+        ok = (parking_id >= 1 && parking_id <= max_slot);
+
+        for (int e = 0; ok && e < entrances; e++) 
+        {
+            cursor = end;
+            ok = (*cursor == ',');
+            if (!ok) break;
+
+            long distance = strtol(cursor + 1, &end, 10);
+            ok = (end != cursor + 1 && distance >= 0 && distance < 0x7FFFFFFF);
+            if (ok) distances[(size_t)e * (max_slot + 1) + parking_id] = (uint32_t)distance;
+        }
+    }
+
+    fclose(file);
+
+    if (!ok) 
+    {
+        trackedFree(distances);
+        return -1;
+    }
+
+    *distances_out = distances;
+    return entrances;
+}
+
+bool SlotIndex_Init(SlotIndex* index, GenericBPlusTreeNode* parkingRoot, const char* layout_file) 
+{
+    SlotIndex_Destroy(index);
+
+    int max_slot = Max_Parking_ID(parkingRoot);
+    if (max_slot < 1) return false;
+
+    uint32_t* distances = NULL;
+    int entrances = readSlotLayout(layout_file, max_slot, &distances);
+
+    if (entrances < 0) 
+    {
+        fprintf(stderr, "Invalid slot layout in %s; allocating by slot id.\n", layout_file);
+    }
+
+    if (entrances <= 0) 
+    {
+        // One entrance with slots in id order
+        entrances = 1;
+        distances = (uint32_t*)trackedMalloc(sizeof(uint32_t) * (max_slot + 1), MEM_SLOT_INDEX);
+        if (!distances) return false;
+
+        for (int s = 0; s <= max_slot; s++) distances[s] = (uint32_t)s;
+    }
+    else 
+    {
+        printf("Slot layout loaded from %s (%d entrances).\n", layout_file, entrances);
+    }
+
+    int size = 1;
+    while (size <= max_slot) size *= 2;
+
+    Parking** slots = (Parking**)trackedCalloc(max_slot + 1, sizeof(Parking*), MEM_SLOT_INDEX);
+    uint64_t* trees = (uint64_t*)trackedMalloc(sizeof(uint64_t) * 2 * size * entrances, MEM_SLOT_INDEX);
+
+    if (!slots || !trees) 
+    {
+        trackedFree(slots);
+        trackedFree(trees);
+        trackedFree(distances);
+        return false;
+    }
+
+    for (size_t i = 0; i < (size_t)2 * size * entrances; i++) trees[i] = SLOT_INDEX_NONE;
+
+    BPlusCursor cursor;
+    Parking* slot;
+    for (Cursor_First(&cursor, parkingRoot); (slot = (Parking*)Cursor_Next(&cursor)) != NULL; ) 
+    {
+        if (slot->parking_id >= 1) slots[slot->parking_id] = slot;
+    }
+
+    pthread_mutex_lock(&index->lock);
+
+    index->num_entrances = entrances;
+    index->max_slot = max_slot;
+    index->size = size;
+    index->slots = slots;
+    index->distances = distances;
+    index->trees = trees;
+
+    // Nobody queries the index before this returns, so leaves first, then one pass up
+    for (int e = 0; e < entrances; e++) 
+    {
+        uint64_t* tree = &trees[(size_t)e * 2 * size];
+
+        for (int s = 1; s <= max_slot; s++) 
+        {
+            if (slots[s] && __atomic_load_n(&slots[s]->parking_space_status, __ATOMIC_ACQUIRE) == VACANT) 
+            {
+                tree[size + s] = (uint64_t)distances[(size_t)e * (max_slot + 1) + s] << 32 | (uint32_t)s;
+            }
+        }
+
+        for (int node = size - 1; node >= 1; node--) tree[node] = slotIndexChildMin(tree, node);
+    }
+
+    pthread_mutex_unlock(&index->lock);
+
+    return true;
+}
+
+bool slotIndexRejected(const int* rejected, int num_rejected, int parking_id) 
+{
+    for (int i = 0; i < num_rejected; i++) 
+    {
+        if (rejected[i] == parking_id) return true;
+    }
+
+    return false;
+}
+
+// Minimum (distance, id) over leaves [lo, hi] of one tree, leaving out the rejected slots.
+// node covers leaves [node_lo, node_hi]; a node whose minimum is not a rejected slot needs
+// no descent, so this visits O(log n) nodes per rejected slot.
+uint64_t slotIndexRangeMin(const uint64_t* tree, int size, int node, int node_lo, int node_hi, int lo, int hi, const int* rejected, int num_rejected) 
+{
+    if (node_hi < lo || node_lo > hi) return SLOT_INDEX_NONE;
+
+    uint64_t value = __atomic_load_n(&tree[node], __ATOMIC_ACQUIRE);
+    if (value == SLOT_INDEX_NONE) return value;
+
+    bool inside = (lo <= node_lo && node_hi <= hi);
+    bool rejected_min = slotIndexRejected(rejected, num_rejected, (int)(uint32_t)value);
+
+    if (inside && !rejected_min) return value;
+    if (node >= size) return SLOT_INDEX_NONE; // A leaf outside the range or rejected
+
+    int mid = node_lo + (node_hi - node_lo) / 2;
+    uint64_t left = slotIndexRangeMin(tree, size, 2 * node, node_lo, mid, lo, hi, rejected, num_rejected);
+    uint64_t right = slotIndexRangeMin(tree, size, 2 * node + 1, mid + 1, node_hi, lo, hi, rejected, num_rejected);
+
+    return left < right ? left : right;
+}
+
+// Nearest vacant slot in [min_id, max_id] from entrance that accept (if given) allows, or NULL.
+// Slots accept turns down are left out of the rest of the search; if too many are turned
+// down *complete is cleared and the caller should scan instead.
+Parking* SlotIndex_Nearest(SlotIndex* index, int entrance, int min_id, int max_id, SlotFilterFunc accept, const void* ctx, bool* complete) 
+{
+    int rejected[SLOT_INDEX_MAX_REJECTS];
+    int num_rejected = 0;
+
+    *complete = true;
+    METRIC_COUNT(slot_searches, 1);
+
+    if (entrance < 0 || entrance >= index->num_entrances) entrance = 0;
+    if (min_id < 1) min_id = 1;
+    if (max_id > index->max_slot) max_id = index->max_slot;
+
+    const uint64_t* tree = &index->trees[(size_t)entrance * 2 * index->size];
+
+    while (min_id <= max_id) 
+    {
+        uint64_t best = slotIndexRangeMin(tree, index->size, 1, 0, index->size - 1, min_id, max_id, rejected, num_rejected);
+        if (best == SLOT_INDEX_NONE) break;
+
+        Parking* candidate = index->slots[(uint32_t)best];
+
+        if (!accept || accept(candidate, ctx)) return candidate;
+
+        if (num_rejected == SLOT_INDEX_MAX_REJECTS) 
+        {
+            *complete = false;
+            break;
+        }
+
+        rejected[num_rejected++] = candidate->parking_id;
+    }
+
+    return NULL;
+}
+
+
+// Slot Attributes
+// Physical features a slot may have (SLOT_ATTRIBUTE_FILE, optional). Each feature is a
+// bitmap over slot ids, alongside a bitmap of vacant slots, stored as 256-bit vector words
+// so matching a request is a handful of wide ANDs per 256 slots: vacant & each required
+// feature & the membership's id range, then the lowest set bit. The vacancy bits follow
+// the slot status the same way the nearest-slot index does; a stale bit only costs a
+// failed claim and a retry.
+#define SLOT_ATTRIBUTE_FILE "sample_slot_attributes.csv"
+#define SLOT_VECTOR_BITS 256
+
+typedef uint64_t slot_vector __attribute__((vector_size(SLOT_VECTOR_BITS / 8)));
+
+typedef enum 
+{
+    SLOT_ATTR_EV,
+    SLOT_ATTR_COMPACT,
+    SLOT_ATTR_LARGE,
+    SLOT_ATTR_COVERED,
+    SLOT_ATTR_ACCESSIBLE,
+    SLOT_ATTR_COUNT
+
+} slot_attribute;
+
+static const char* const slot_attribute_names[SLOT_ATTR_COUNT] = { "ev", "compact", "large", "covered", "accessible" };
+
+typedef struct SlotAttributes 
+{
+    int max_slot;
+    int num_vectors;
+    Parking** slots;                       // By parking_id
+    slot_vector* vacant;
+    slot_vector* features[SLOT_ATTR_COUNT];
+    int counts[SLOT_ATTR_COUNT];           // Slots with each feature
+
+} SlotAttributes;
+
+SlotAttributes g_slotAttributes;
+
+// Parse "ev|covered" (or comma separated) into a feature mask; "-" or "none" is no features
+bool parseSlotAttributes(const char* text, uint32_t* mask) 
+{
+    *mask = 0;
+    if (strcmp(text, "-") == 0 || strcmp(text, "none") == 0) return true;
+
+    while (*text) 
+    {
+        size_t length = strcspn(text, "|,; \t\r\n");
+        int attribute = -1;
+
+        for (int a = 0; a < SLOT_ATTR_COUNT && length > 0; a++) 
+        {
+            if (strlen(slot_attribute_names[a]) == length && strncmp(text, slot_attribute_names[a], length) == 0) attribute = a;
+        }
+
+        if (length > 0 && attribute < 0) return false;
+        if (attribute >= 0) *mask |= 1u << attribute;
+
+        text += length;
+        if (*text) text++;
+    }
+
+    return true;
+}
+
+void formatSlotAttributes(uint32_t mask, char* out, size_t size) 
+{
+    size_t used = 0;
+    out[0] = '\0';
+
+    for (int a = 0; a < SLOT_ATTR_COUNT; a++) 
+    {
+        if (mask & (1u << a)) used += snprintf(out + used, used < size ? size - used : 0, "%s%s", used ? "|" : "", slot_attribute_names[a]);
+    }
+
+    if (used == 0) snprintf(out, size, "-");
+}
+
+static inline void slotBitSet(slot_vector* bitmap, int parking_id, bool value) 
+{
+    uint64_t* word = (uint64_t*)bitmap + parking_id / 64;
+    uint64_t bit = 1ull << (parking_id % 64);
+
+    if (value) __atomic_fetch_or(word, bit, __ATOMIC_RELEASE);
+    else __atomic_fetch_and(word, ~bit, __ATOMIC_RELEASE);
+}
+
+static inline bool slotBitTest(const slot_vector* bitmap, int parking_id) 
+{
+    return (__atomic_load_n((const uint64_t*)bitmap + parking_id / 64, __ATOMIC_ACQUIRE) >> (parking_id % 64)) & 1;
+}
+
+// Bring a slot's vacancy bit in line with its status. Lock-free: whoever writes a bit
+// re-reads the status afterwards and rewrites if it moved, so the last status change
+// always wins.
+void SlotAttributes_Refresh(SlotAttributes* attributes, const Parking* slot) 
+{
+    if (!attributes->vacant || slot->parking_id < 1 || slot->parking_id > attributes->max_slot) return;
+
+    int status = __atomic_load_n(&slot->parking_space_status, __ATOMIC_ACQUIRE);
+
+    for (;;) 
+    {
+        slotBitSet(attributes->vacant, slot->parking_id, status == VACANT);
+
+        int now = __atomic_load_n(&slot->parking_space_status, __ATOMIC_ACQUIRE);
+        if (now == status) break;
+        status = now;
+    }
+}
+
+void SlotAttributes_Destroy(SlotAttributes* attributes) 
+{
+    trackedFree(attributes->slots);
+    trackedFree(attributes->vacant);
+    for (int a = 0; a < SLOT_ATTR_COUNT; a++) trackedFree(attributes->features[a]);
+
+    memset(attributes, 0, sizeof(*attributes));
+}
+
+// Attribute CSV: a header, then "parking_id,ev|covered" per slot. Slots not listed have
+// no features. Without the file nothing is loaded and feature requests find no slot.
+bool SlotAttributes_Init(SlotAttributes* attributes, GenericBPlusTreeNode* parkingRoot, const char* filename) 
+{
+    SlotAttributes_Destroy(attributes);
+
+    FILE* file = fopen(filename, "r");
+    if (!file) return false;
+
+    int max_slot = Max_Parking_ID(parkingRoot);
+    int num_vectors = max_slot / SLOT_VECTOR_BITS + 1;
+    size_t bitmap_size = sizeof(slot_vector) * num_vectors;
+    bool ok = (max_slot >= 1);
+
+    attributes->max_slot = max_slot;
+    attributes->num_vectors = num_vectors;
+    attributes->slots = ok ? (Parking**)trackedCalloc(max_slot + 1, sizeof(Parking*), MEM_SLOT_INDEX) : NULL;
+    attributes->vacant = ok ? (slot_vector*)trackedAlignedAlloc(sizeof(slot_vector), bitmap_size, MEM_SLOT_INDEX) : NULL;
+    ok = ok && attributes->slots && attributes->vacant;
+
+    if (ok) memset(attributes->vacant, 0, bitmap_size);
+
+    for (int a = 0; ok && a < SLOT_ATTR_COUNT; a++) 
+    {
+        attributes->features[a] = (slot_vector*)trackedAlignedAlloc(sizeof(slot_vector), bitmap_size, MEM_SLOT_INDEX);
+        ok = (attributes->features[a] != NULL);
+        if (ok) memset(attributes->features[a], 0, bitmap_size);
+    }
+
+    char line[256];
+    int line_number = 1;
+
+    if (ok && fgets(line, sizeof(line), file) == NULL) ok = false; // Header
+
+    while (ok && fgets(line, sizeof(line), file) != NULL) 
+    {
+        line_number++;
+
+        char* end;
+        long parking_id = strtol(line, &end, 10);
+        if (end == line) continue; // Blank line
+
+        uint32_t mask = 0;
+        if (parking_id < 1 || parking_id > max_slot || *end != ',' || !parseSlotAttributes(end + 1, &mask)) 
+        {
+            fprintf(stderr, "Invalid slot attributes on line %d of %s.\n", line_number, filename);
+            ok = false;
+            break;
+        }
+
+        for (int a = 0; a < SLOT_ATTR_COUNT; a++) 
+        {
+            if (mask & (1u << a)) slotBitSet(attributes->features[a], (int)parking_id, true);
+        }
+    }
+
+    fclose(file);
+
+    if (!ok) 
+    {
+        SlotAttributes_Destroy(attributes);
+        return false;
+    }
+
+    BPlusCursor cursor;
+    Parking* slot;
+    for (Cursor_First(&cursor, parkingRoot); (slot = (Parking*)Cursor_Next(&cursor)) != NULL; ) 
+    {
+        if (slot->parking_id < 1) continue;
+
+        attributes->slots[slot->parking_id] = slot;
+        SlotAttributes_Refresh(attributes, slot);
+    }
+
+    for (int a = 0; a < SLOT_ATTR_COUNT; a++) 
+    {
+        for (int s = 1; s <= max_slot; s++) attributes->counts[a] += slotBitTest(attributes->features[a], s);
+    }
+
+    printf("Slot attributes loaded from %s.\n", filename);
+
+    return true;
+}
+
+// Feature mask of one slot
+uint32_t SlotAttributes_Of(const SlotAttributes* attributes, int parking_id) 
+{
+    uint32_t mask = 0;
+
+    if (!attributes->vacant || parking_id < 1 || parking_id > attributes->max_slot) return 0;
+
+    for (int a = 0; a < SLOT_ATTR_COUNT; a++) 
+    {
+        if (slotBitTest(attributes->features[a], parking_id)) mask |= 1u << a;
+    }
+
+    return mask;
+}
+
+// Keep only bits [first, last] of one vector word (positions relative to the word)
+static inline void slotRangeMask(slot_vector* word, int first, int last) 
+{
+    for (int lane = 0; lane < SLOT_VECTOR_BITS / 64; lane++) 
+    {
+        int lo = first - lane * 64, hi = last - lane * 64;
+        if (lo < 0) lo = 0;
+        if (hi > 63) hi = 63;
+
+        (*word)[lane] &= (lo > hi) ? 0 : ((~0ull << lo) & (~0ull >> (63 - hi)));
+    }
+}
+
+// Lowest-id vacant slot in [min_id, max_id] with every feature in required that accept
+// (if given) allows, or NULL
+Parking* SlotAttributes_First(SlotAttributes* attributes, uint32_t required, int min_id, int max_id, SlotFilterFunc accept, const void* ctx) 
+{
+    if (!attributes->vacant) return NULL;
+
+    if (min_id < 1) min_id = 1;
+    if (max_id > attributes->max_slot) max_id = attributes->max_slot;
+    if (min_id > max_id) return NULL;
+
+    METRIC_COUNT(slot_searches, 1);
+
+    int first_vector = min_id / SLOT_VECTOR_BITS, last_vector = max_id / SLOT_VECTOR_BITS;
+
+    for (int v = first_vector; v <= last_vector; v++) 
+    {
+        slot_vector word = attributes->vacant[v];
+
+        for (int a = 0; a < SLOT_ATTR_COUNT; a++) 
+        {
+            if (required & (1u << a)) word &= attributes->features[a][v];
+        }
+
+        if (v == first_vector || v == last_vector) 
+        {
+            int base = v * SLOT_VECTOR_BITS;
+            slotRangeMask(&word, (v == first_vector) ? min_id - base : 0, (v == last_vector) ? max_id - base : SLOT_VECTOR_BITS - 1);
+        }
+
+        for (int lane = 0; lane < SLOT_VECTOR_BITS / 64; lane++) 
+        {
+            for (uint64_t bits = word[lane]; bits != 0; bits &= bits - 1) 
+            {
+                Parking* slot = attributes->slots[v * SLOT_VECTOR_BITS + lane * 64 + __builtin_ctzll(bits)];
+
+                if (slot && (!accept || accept(slot, ctx))) return slot;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+Parking* Find_Free_Slot(GenericBPlusTreeNode* parkingRoot, int min_id, int max_id, CompareInternalKeyFunc cmp_internal, SlotFilterFunc accept, const void* ctx) 
+{
+    METRIC_SCOPE(METRIC_FIND_FREE_SLOT);
+
+    if (parkingRoot == NULL)
+    {
+        return NULL;
+    }
+
+    // Find the leaf node where min_id would reside or start
+    GenericBPlusTreeNode* leaf = findLeaf(parkingRoot, &min_id, cmp_internal);
+
+    GenericBPlusTreeNode* current_leaf = leaf;
+    METRIC_COUNT(slot_searches, 1);
+
+    // Search starting from this leaf, potentially moving to next leaves
+    while (current_leaf) 
+    {
+        METRIC_COUNT(slot_leaves_scanned, 1);
+
+        for (int i = 0; i < current_leaf->num_keys; i++) 
+        {
+            Parking* p = (Parking*)current_leaf->keys[i];
+
+            if (p->parking_id > max_id) 
+            {
+                return NULL; // Slots are in key order, nothing further is in range
+            }
+
+            if (p->parking_id >= min_id) 
+            {
+                if (__atomic_load_n(&p->parking_space_status, __ATOMIC_ACQUIRE) == VACANT && (!accept || accept(p, ctx))) 
+                {
+                    return p; // Found a suitable vacant slot
+                }
+            }
+        }
+
+        current_leaf = current_leaf->next_leaf;
+    }
+
+    return NULL; // No vacant slot found in the range
+}
+
+// Atomically flip a slot from VACANT to OCCUPIED. Fails if another gate claimed it first.
+// The parking tree never changes shape after loading, so the slot status is the only
+// thing gates race on; the claimer owns the slot's counters until Release_Slot.
+bool Claim_Slot(Parking* slot) 
+{
+    int expected = VACANT;
+
+    if (!__atomic_compare_exchange_n(&slot->parking_space_status, &expected, OCCUPIED, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) 
+    {
+        return false;
+    }
+
+    slot->occupancies = slot->occupancies + 1;
+    SlotIndex_Refresh(Facility_Current()->slot_index, slot);
+    SlotAttributes_Refresh(Facility_Current()->slot_attributes, slot);
+
+    return true;
+}
+
+// Hand the slot back; revenue must already be booked since the next claimer may start writing
+void Release_Slot(Parking* slot) 
+{
+    __atomic_store_n(&slot->parking_space_status, VACANT, __ATOMIC_RELEASE);
+    SlotIndex_Refresh(Facility_Current()->slot_index, slot);
+    SlotAttributes_Refresh(Facility_Current()->slot_attributes, slot);
+}
+
+// Find and claim the first vacant slot in [min_id, max_id] that accept (if given) allows,
+// retrying if we lose a race
+Parking* Claim_Free_Slot(GenericBPlusTreeNode* parkingRoot, int min_id, int max_id, SlotFilterFunc accept, const void* ctx) 
+{
+    Parking* freeParkingSlot = Find_Free_Slot(parkingRoot, min_id, max_id, compareParkingIdInternal, accept, ctx);
+
+    while (freeParkingSlot != NULL && !Claim_Slot(freeParkingSlot)) 
+    {
+        freeParkingSlot = Find_Free_Slot(parkingRoot, min_id, max_id, compareParkingIdInternal, accept, ctx);
+    }
+
+    return freeParkingSlot;
+}
+
+// Claim the vacant slot in [min_id, max_id] nearest to entrance that accept (if given) allows.
+// Without a slot index, or when the index gives up, this is Claim_Free_Slot.
+Parking* Claim_Nearest_Slot(GenericBPlusTreeNode* parkingRoot, int entrance, int min_id, int max_id, SlotFilterFunc accept, const void* ctx) 
+{
+    SlotIndex* index = Facility_Current()->slot_index;
+
+    if (!index->trees) 
+    {
+        return Claim_Free_Slot(parkingRoot, min_id, max_id, accept, ctx);
+    }
+
+    bool complete;
+    Parking* freeParkingSlot;
+
+    while ((freeParkingSlot = SlotIndex_Nearest(index, entrance, min_id, max_id, accept, ctx, &complete)) != NULL) 
+    {
+        if (Claim_Slot(freeParkingSlot)) return freeParkingSlot;
+
+        // Lost the race; the winner's refresh may not have landed yet
+        SlotIndex_Refresh(index, freeParkingSlot);
+    }
+
+    return complete ? NULL : Claim_Free_Slot(parkingRoot, min_id, max_id, accept, ctx);
+}
+
+// Claim the lowest-id vacant slot in [min_id, max_id] with every feature in required
+Parking* Claim_Matching_Slot(uint32_t required, int min_id, int max_id, SlotFilterFunc accept, const void* ctx) 
+{
+    SlotAttributes* attributes = Facility_Current()->slot_attributes;
+    Parking* slot;
+
+    while ((slot = SlotAttributes_First(attributes, required, min_id, max_id, accept, ctx)) != NULL) 
+    {
+        if (Claim_Slot(slot)) return slot;
+
+        // Lost the race; make sure the bit no longer claims the slot is free
+        SlotAttributes_Refresh(attributes, slot);
+    }
+
+    return NULL;
+}
+
+// Claim a slot for an arriving vehicle: its reserved slot if it holds one for now,
+// otherwise a vacant slot in [min_id, max_id] not held for the near future: the lowest id
+// with every feature it asked for, or with no features asked for, the nearest its entrance
+Parking* Allocate_Slot(GenericBPlusTreeNode* parkingRoot, int min_id, int max_id, const AllocationRequest* request) 
+{
+    ReservationStore* reservations = Facility_Current()->reservations;
+    Reservation reservation;
+
+    if (request->arrival >= 0 && Reservation_Match(reservations, request->vehicle_num, request->arrival, &reservation)) 
+    {
+        Parking* held = SearchParking_BPlus(parkingRoot, reservation.parking_id);
+
+        if (held && Claim_Slot(held)) 
+        {
+            // The vehicle is in; its hold has served its purpose
+            Reservation_Cancel(reservations, reservation.id);
+            return held;
+        }
+    }
+
+    if (request->required_attrs) 
+    {
+        return Claim_Matching_Slot(request->required_attrs, min_id, max_id, walkInMayTake, request);
+    }
+
+    return Claim_Nearest_Slot(parkingRoot, request->entrance, min_id, max_id, walkInMayTake, request);
+}
+
+bool Assign_Parking_ID(GenericBPlusTreeNode* parkingRoot, int min_id, int max_id, const AllocationRequest* request, int* assigned_parking_id) 
+{
+    bool status = true;
+
+    Parking* freeParkingSlot = Allocate_Slot(parkingRoot, min_id, max_id, request);
+
+    if (freeParkingSlot == NULL) 
+    {
+        status = false;
+    } 
+    else 
+    {
+        *assigned_parking_id = freeParkingSlot->parking_id;
+
+        status = true;
+    }
+
+    return status;
+}
+
+bool Allocation_Policy(GenericBPlusTreeNode* parkingRoot, User* userNode, const AllocationRequest* request, int* parking_id) 
+{
+    bool status = false;
+    int min_id = -1;
+    int max_id = -1;
+
+    // Determine search range based on membership
+    Membership_Slot_Range(userNode->membership, &min_id, &max_id);
+
+    status = Assign_Parking_ID(parkingRoot, min_id, max_id, request, parking_id);
+
+    if (status) 
+    {
+        userNode->parking_space_id = *parking_id; // Update user struct immediately
+    }
+
+    return status;
+}
+
+
+// Session History
+// Every completed exit appends one row to an append-only, columnar session log. Rows
+// collect in an uncompressed tail block; a full block is sealed by encoding each
+// column on its own as varints (departure times as zigzag deltas), which keeps years
+// of history to a few bytes per visit. Each sealed block keeps its departure range so
+// time-range scans skip whole blocks and decode only the columns they need, and every
+// plate keeps the row numbers of its visits.
+#define SESSION_DB_FILE "sample_sessions.dat"
+#define SESSION_BLOCK_ROWS 1024
+#define SESSION_FILE_MAGIC 0x53534553u // "SESS"
+
+typedef enum 
+{
+    SESSION_COL_DEPARTURE, // Minutes since 1970-01-01 00:00
+    SESSION_COL_DURATION,  // Minutes parked
+    SESSION_COL_SLOT,
+    SESSION_COL_PLATE,     // Index into the plate dictionary
+    SESSION_COL_AMOUNT,    // Paise
+    SESSION_COLUMNS
+
+} session_column;
+
+typedef struct SessionRecord 
+{
+    const char* vehicle_num;
+    int64_t arrival;   // Minutes since 1970-01-01 00:00
+    int64_t departure;
+    int parking_id;
+    int64_t amount_paise;
+
+} SessionRecord;
+
+typedef struct SessionBlock 
+{
+    int rows;
+    int64_t min_departure;
+    int64_t max_departure;
+    uint32_t offsets[SESSION_COLUMNS + 1]; // Column c is bytes[offsets[c], offsets[c + 1])
+    uint8_t* bytes;
+
+} SessionBlock;
+
+typedef struct SessionPlate 
+{
+    char vehicle_num[20];
+    uint32_t* rows; // Global row numbers of this plate's visits, ascending
+    uint32_t count;
+    uint32_t capacity;
+
+} SessionPlate;
+
+typedef struct SessionStore 
+{
+    SessionBlock* blocks;
+    int num_blocks;
+    int block_capacity;
+
+    int64_t tail[SESSION_COLUMNS][SESSION_BLOCK_ROWS];
+    int tail_rows;
+
+    SessionPlate* plates;
+    uint32_t num_plates;
+    uint32_t plate_capacity;
+    uint32_t* plate_table; // Open addressing, plate index + 1 (0 = empty)
+    uint32_t plate_table_size;
+
+    bool keep_file; // Loading failed and the damaged file could not be moved aside: never save over it
+
+    pthread_mutex_t lock;
+
+} SessionStore;
+
+SessionStore g_sessionStore = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint8_t* putVarint(uint8_t* out, uint64_t value) 
+{
+    while (value >= 0x80) 
+    {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+
+    return out;
+}
+
+// Read one varint from [in, end); NULL if it runs past end or over 10 bytes
+static const uint8_t* getVarint(const uint8_t* in, const uint8_t* end, uint64_t* value) 
+{
+    uint64_t result = 0;
+
+    for (int shift = 0; in < end && shift < 70; shift += 7) 
+    {
+        uint8_t byte = *in++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+
+        if (!(byte & 0x80)) 
+        {
+            *value = result;
+            return in;
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t zigzagEncode(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+static int64_t zigzagDecode(uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+bool sessionReserveBlock(SessionStore* store) 
+{
+    if (store->num_blocks < store->block_capacity) return true;
+
+    int capacity = store->block_capacity ? store->block_capacity * 2 : 16;
+    SessionBlock* blocks = (SessionBlock*)trackedRealloc(store->blocks, sizeof(SessionBlock) * capacity, MEM_SESSION);
+    if (!blocks) return false;
+
+    store->blocks = blocks;
+    store->block_capacity = capacity;
+
+    return true;
+}
+
+// Encode rows of uncompressed columns into block
+bool sessionEncodeBlock(int64_t (*columns)[SESSION_BLOCK_ROWS], int rows, SessionBlock* block) 
+{
+    uint8_t* buffer = (uint8_t*)trackedMalloc((size_t)rows * SESSION_COLUMNS * 10 + 1, MEM_SCRATCH);
+    if (!buffer) return false;
+
+    uint8_t* p = buffer;
+
+    block->rows = rows;
+    block->min_departure = INT64_MAX;
+    block->max_departure = INT64_MIN;
+
+    for (int c = 0; c < SESSION_COLUMNS; c++) 
+    {
+        block->offsets[c] = (uint32_t)(p - buffer);
+        int64_t previous = 0;
+
+        for (int r = 0; r < rows; r++) 
+        {
+            int64_t value = columns[c][r];
+
+            if (c == SESSION_COL_DEPARTURE) 
+            {
+                if (value < block->min_departure) block->min_departure = value;
+                if (value > block->max_departure) block->max_departure = value;
+
+                p = putVarint(p, zigzagEncode(value - previous));
+                previous = value;
+            }
+            else 
+            {
+                p = putVarint(p, zigzagEncode(value));
+            }
+        }
+    }
+    block->offsets[SESSION_COLUMNS] = (uint32_t)(p - buffer);
+
+    // Keep only the encoded size
+    block->bytes = (uint8_t*)trackedMalloc(block->offsets[SESSION_COLUMNS] + 1, MEM_SESSION);
+    if (block->bytes) memcpy(block->bytes, buffer, block->offsets[SESSION_COLUMNS]);
+
+    trackedFree(buffer);
+
+    return block->bytes != NULL;
+}
+
+// Encode the full tail into a new sealed block
+bool sessionSealTail(SessionStore* store) 
+{
+    if (!sessionReserveBlock(store) || !sessionEncodeBlock(store->tail, store->tail_rows, &store->blocks[store->num_blocks])) 
+    {
+        return false;
+    }
+
+    store->num_blocks++;
+    store->tail_rows = 0;
+
+    return true;
+}
+
+bool writeSessionBlock(FILE* file, const SessionBlock* block) 
+{
+    return fwrite(&block->rows, sizeof(block->rows), 1, file) == 1
+        && fwrite(&block->min_departure, sizeof(int64_t), 1, file) == 1
+        && fwrite(&block->max_departure, sizeof(int64_t), 1, file) == 1
+        && fwrite(block->offsets, sizeof(block->offsets), 1, file) == 1
+        && fwrite(block->bytes, 1, block->offsets[SESSION_COLUMNS], file) == block->offsets[SESSION_COLUMNS];
+}
+
+// False unless the column's bytes hold exactly the block's rows
+bool sessionDecodeColumn(const SessionBlock* block, session_column column, int64_t* out) 
+{
+    const uint8_t* p = block->bytes + block->offsets[column];
+    const uint8_t* end = block->bytes + block->offsets[column + 1];
+    int64_t previous = 0;
+    uint64_t raw;
+
+    for (int r = 0; r < block->rows; r++) 
+    {
+        p = getVarint(p, end, &raw);
+        if (!p) return false;
+
+        out[r] = (column == SESSION_COL_DEPARTURE) ? (previous += zigzagDecode(raw)) : zigzagDecode(raw);
+    }
+
+    return p == end;
+}
+
+// Columns of block b, or of the tail when b == num_blocks; returns the row count.
+// decoded is scratch space with room for a block's worth of each requested column.
+int sessionLoadColumns(const SessionStore* store, int b, const session_column* columns, int count, int64_t (*decoded)[SESSION_BLOCK_ROWS], const int64_t** out) 
+{
+    if (b == store->num_blocks) 
+    {
+        for (int i = 0; i < count; i++) out[i] = store->tail[columns[i]];
+        return store->tail_rows;
+    }
+
+    for (int i = 0; i < count; i++) 
+    {
+        sessionDecodeColumn(&store->blocks[b], columns[i], decoded[i]);
+        out[i] = decoded[i];
+    }
+
+    return store->blocks[b].rows;
+}
+
+bool sessionBlockOverlaps(const SessionStore* store, int b, int64_t from, int64_t to) 
+{
+    if (b == store->num_blocks) return store->tail_rows > 0;
+
+    return store->blocks[b].max_departure >= from && store->blocks[b].min_departure <= to;
+}
+
+// Find or add a plate in the dictionary; returns its index or UINT32_MAX
+uint32_t sessionPlateId(SessionStore* store, const char* vehicle_num, bool add) 
+{
+    if (store->plate_table_size) 
+    {
+        uint32_t mask = store->plate_table_size - 1;
+
+        for (uint32_t i = hashVehicleNum(vehicle_num) & mask; store->plate_table[i]; i = (i + 1) & mask) 
+        {
+            if (strcmp(store->plates[store->plate_table[i] - 1].vehicle_num, vehicle_num) == 0) 
+            {
+                return store->plate_table[i] - 1;
+            }
+        }
+    }
+
+    if (!add) return UINT32_MAX;
+
+    // Keep the table at most half full
+    if ((store->num_plates + 1) * 2 > store->plate_table_size) 
+    {
+        uint32_t size = store->plate_table_size ? store->plate_table_size * 2 : 1024;
+        uint32_t* table = (uint32_t*)trackedCalloc(size, sizeof(uint32_t), MEM_SESSION);
+        if (!table) return UINT32_MAX;
+
+        for (uint32_t id = 0; id < store->num_plates; id++) 
+        {
+            uint32_t i = hashVehicleNum(store->plates[id].vehicle_num) & (size - 1);
+            while (table[i]) i = (i + 1) & (size - 1);
+            table[i] = id + 1;
+        }
+
+        trackedFree(store->plate_table);
+        store->plate_table = table;
+        store->plate_table_size = size;
+    }
+
+    if (store->num_plates == store->plate_capacity) 
+    {
+        uint32_t capacity = store->plate_capacity ? store->plate_capacity * 2 : 256;
+        SessionPlate* plates = (SessionPlate*)trackedRealloc(store->plates, sizeof(SessionPlate) * capacity, MEM_SESSION);
+        if (!plates) return UINT32_MAX;
+
+        store->plates = plates;
+        store->plate_capacity = capacity;
+    }
+
+    uint32_t id = store->num_plates++;
+    SessionPlate* plate = &store->plates[id];
+
+    memset(plate, 0, sizeof(SessionPlate));
+    strncpy(plate->vehicle_num, vehicle_num, sizeof(plate->vehicle_num) - 1);
+
+    uint32_t mask = store->plate_table_size - 1;
+    uint32_t i = hashVehicleNum(vehicle_num) & mask;
+    while (store->plate_table[i]) i = (i + 1) & mask;
+    store->plate_table[i] = id + 1;
+
+    return id;
+}
+
+bool sessionPlateAddRow(SessionStore* store, uint32_t id, uint32_t row) 
+{
+    SessionPlate* plate = &store->plates[id];
+
+    if (plate->count == plate->capacity) 
+    {
+        uint32_t capacity = plate->capacity ? plate->capacity * 2 : 4;
+        uint32_t* rows = (uint32_t*)trackedRealloc(plate->rows, sizeof(uint32_t) * capacity, MEM_SESSION);
+        if (!rows) return false;
+
+        plate->rows = rows;
+        plate->capacity = capacity;
+    }
+
+    plate->rows[plate->count++] = row;
+    return true;
+}
+
+// Store is locked by the caller
+bool sessionAppendLocked(SessionStore* store, uint32_t plate_id, int64_t arrival, int64_t departure, int parking_id, int64_t amount_paise) 
+{
+    if (store->tail_rows == SESSION_BLOCK_ROWS && !sessionSealTail(store)) return false;
+
+    uint32_t row = (uint32_t)store->num_blocks * SESSION_BLOCK_ROWS + store->tail_rows;
+    if (!sessionPlateAddRow(store, plate_id, row)) return false;
+
+    int r = store->tail_rows++;
+    store->tail[SESSION_COL_DEPARTURE][r] = departure;
+    store->tail[SESSION_COL_DURATION][r] = departure - arrival;
+    store->tail[SESSION_COL_SLOT][r] = parking_id;
+    store->tail[SESSION_COL_PLATE][r] = plate_id;
+    store->tail[SESSION_COL_AMOUNT][r] = amount_paise;
+
+    return true;
+}
+
+bool Session_Append(SessionStore* store, const char* vehicle_num, int64_t arrival, int64_t departure, int parking_id, int64_t amount_paise) 
+{
+    pthread_mutex_lock(&store->lock);
+
+    uint32_t id = sessionPlateId(store, vehicle_num, true);
+    bool ok = (id != UINT32_MAX) && sessionAppendLocked(store, id, arrival, departure, parking_id, amount_paise);
+
+    pthread_mutex_unlock(&store->lock);
+
+    return ok;
+}
+
+// Log the visit a user has just been billed for
+bool Session_RecordExit(SessionStore* store, const User* user, int parking_id) 
+{
+    int64_t arrival = parseTimestamp(user->arrival_date, user->arrival_time);
+    int64_t departure = parseTimestamp(user->departure_date, user->departure_time);
+
+    if (arrival < 0 || departure < 0) return false;
+
+    return Session_Append(store, user->vehicle_num, arrival, departure, parking_id, llroundf(user->parking_amt * 100.0f));
+}
+
+// Total billed for sessions that departed in [from, to]; returns the number of sessions
+long Session_RevenueBetween(SessionStore* store, int64_t from, int64_t to, int64_t* revenue_paise) 
+{
+    static const session_column columns[] = { SESSION_COL_DEPARTURE, SESSION_COL_AMOUNT };
+    int64_t (*decoded)[SESSION_BLOCK_ROWS] = trackedMalloc(sizeof(int64_t) * 2 * SESSION_BLOCK_ROWS, MEM_SCRATCH);
+    long sessions = 0;
+    int64_t total = 0;
+
+    if (!decoded) return -1;
+
+    pthread_mutex_lock(&store->lock);
+    for (int b = 0; b <= store->num_blocks; b++) 
+    {
+        if (!sessionBlockOverlaps(store, b, from, to)) continue;
+
+        const int64_t* cols[2];
+        int rows = sessionLoadColumns(store, b, columns, 2, decoded, cols);
+
+        for (int r = 0; r < rows; r++) 
+        {
+            if (cols[0][r] >= from && cols[0][r] <= to) 
+            {
+                sessions++;
+                total += cols[1][r];
+            }
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    trackedFree(decoded);
+
+    *revenue_paise = total;
+    return sessions;
+}
+
+// Visit every session of one plate, oldest first; returns the number of sessions
+long Session_ForPlate(SessionStore* store, const char* vehicle_num, void (*visit)(const SessionRecord* session, void* ctx), void* ctx) 
+{
+    static const session_column columns[] = { SESSION_COL_DEPARTURE, SESSION_COL_DURATION, SESSION_COL_SLOT, SESSION_COL_AMOUNT };
+    int64_t (*decoded)[SESSION_BLOCK_ROWS] = trackedMalloc(sizeof(int64_t) * 4 * SESSION_BLOCK_ROWS, MEM_SCRATCH);
+    long visits = 0;
+
+    if (!decoded) return -1;
+
+    pthread_mutex_lock(&store->lock);
+
+    uint32_t id = sessionPlateId(store, vehicle_num, false);
+    if (id != UINT32_MAX) 
+    {
+        const SessionPlate* plate = &store->plates[id];
+        const int64_t* cols[4];
+        int loaded = -1;
+
+        for (uint32_t i = 0; i < plate->count; i++) 
+        {
+            int b = (int)(plate->rows[i] / SESSION_BLOCK_ROWS);
+            int r = (int)(plate->rows[i] % SESSION_BLOCK_ROWS);
+
+            // Rows are ascending, so each block is decoded once
+            if (b != loaded) 
+            {
+                sessionLoadColumns(store, b, columns, 4, decoded, cols);
+                loaded = b;
+            }
+
+            SessionRecord session = { plate->vehicle_num, cols[0][r] - cols[1][r], cols[0][r], (int)cols[2][r], cols[3][r] };
+            visit(&session, ctx);
+            visits++;
+        }
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    trackedFree(decoded);
+
+    return visits;
+}
+
+// Count sessions per slot per departure day for days [from_day, from_day + days).
+// counts is days * (max_slot + 1) entries, indexed [day - from_day][slot], and is zeroed here.
+long Session_SlotDayCounts(SessionStore* store, int64_t from_day, int days, int max_slot, uint32_t* counts) 
+{
+    static const session_column columns[] = { SESSION_COL_DEPARTURE, SESSION_COL_SLOT };
+    int64_t (*decoded)[SESSION_BLOCK_ROWS] = trackedMalloc(sizeof(int64_t) * 2 * SESSION_BLOCK_ROWS, MEM_SCRATCH);
+    int64_t from = from_day * 1440;
+    int64_t to = (from_day + days) * 1440 - 1;
+    long sessions = 0;
+
+    if (!decoded) return -1;
+
+    memset(counts, 0, sizeof(uint32_t) * days * (max_slot + 1));
+
+    pthread_mutex_lock(&store->lock);
+    for (int b = 0; b <= store->num_blocks; b++) 
+    {
+        if (!sessionBlockOverlaps(store, b, from, to)) continue;
+
+        const int64_t* cols[2];
+        int rows = sessionLoadColumns(store, b, columns, 2, decoded, cols);
+
+        for (int r = 0; r < rows; r++) 
+        {
+            if (cols[0][r] < from || cols[0][r] > to || cols[1][r] < 0 || cols[1][r] > max_slot) continue;
+
+            counts[(cols[0][r] / 1440 - from_day) * (max_slot + 1) + cols[1][r]]++;
+            sessions++;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    trackedFree(decoded);
+
+    return sessions;
+}
+
+// File layout: magic, plate count, plates (length byte + text), block count, then each
+// block's header and encoded bytes. The tail is written as a final short block.
+// The history is written to filename.tmp, synced and renamed over filename, so a crash
+// mid-save leaves the previous history intact.
+bool Session_Save(SessionStore* store, const char* filename) 
+{
+    if (store->keep_file) 
+    {
+        fprintf(stderr, "Not saving session history over the damaged %s.\n", filename);
+        return false;
+    }
+
+    char temp_name[512];
+    snprintf(temp_name, sizeof(temp_name), "%s.tmp", filename);
+
+    FILE* file = fopen(temp_name, "wb");
+    if (!file) 
+    {
+        perror("Unable to open session file for writing");
+        return false;
+    }
+
+    pthread_mutex_lock(&store->lock);
+
+    uint32_t magic = SESSION_FILE_MAGIC;
+    uint32_t num_blocks = (uint32_t)store->num_blocks + (store->tail_rows > 0);
+
+    bool ok = fwrite(&magic, sizeof(magic), 1, file) == 1
+           && fwrite(&store->num_plates, sizeof(store->num_plates), 1, file) == 1;
+
+    for (uint32_t i = 0; ok && i < store->num_plates; i++) 
+    {
+        uint8_t length = (uint8_t)strlen(store->plates[i].vehicle_num);
+        ok = fwrite(&length, 1, 1, file) == 1 && fwrite(store->plates[i].vehicle_num, 1, length, file) == length;
+    }
+
+    ok = ok && fwrite(&num_blocks, sizeof(num_blocks), 1, file) == 1;
+
+    for (int b = 0; ok && b < store->num_blocks; b++) 
+    {
+        ok = writeSessionBlock(file, &store->blocks[b]);
+    }
+
+    if (ok && store->tail_rows > 0) 
+    {
+        SessionBlock tail;
+
+        ok = sessionEncodeBlock(store->tail, store->tail_rows, &tail);
+        if (ok) 
+        {
+            ok = writeSessionBlock(file, &tail);
+            trackedFree(tail.bytes);
+        }
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    ok = ok && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0) ok = false;
+
+    ok = ok && rename(temp_name, filename) == 0;
+    if (!ok) unlink(temp_name);
+
+    if (ok) 
+    {
+        printf("Session history written successfully.\n");
+    }
+    else 
+    {
+        fprintf(stderr, "Failed to write session history to %s.\n", filename);
+    }
+
+    return ok;
+}
+
+void Session_Destroy(SessionStore* store) 
+{
+    pthread_mutex_lock(&store->lock);
+
+    for (int b = 0; b < store->num_blocks; b++) 
+    {
+        trackedFree(store->blocks[b].bytes);
+    }
+    for (uint32_t i = 0; i < store->num_plates; i++) 
+    {
+        trackedFree(store->plates[i].rows);
+    }
+
+    trackedFree(store->blocks);
+    trackedFree(store->plates);
+    trackedFree(store->plate_table);
+
+    store->blocks = NULL;
+    store->num_blocks = store->block_capacity = 0;
+    store->tail_rows = 0;
+    store->plates = NULL;
+    store->num_plates = store->plate_capacity = 0;
+    store->plate_table = NULL;
+    store->plate_table_size = 0;
+
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Replace the store's contents with a saved history. A missing file is an empty history.
+// A damaged one is moved aside to filename.corrupt so the next save cannot destroy it;
+// if that fails too, the store refuses to save over it.
+bool Session_Load(SessionStore* store, const char* filename) 
+{
+    Session_Destroy(store);
+    store->keep_file = false;
+
+    FILE* file = fopen(filename, "rb");
+    if (!file) return true;
+
+    pthread_mutex_lock(&store->lock);
+
+    uint32_t magic = 0, num_plates = 0, num_blocks = 0;
+    bool ok = fread(&magic, sizeof(magic), 1, file) == 1 && magic == SESSION_FILE_MAGIC
+           && fread(&num_plates, sizeof(num_plates), 1, file) == 1;
+
+    for (uint32_t i = 0; ok && i < num_plates; i++) 
+    {
+        char vehicle_num[20] = {0};
+        uint8_t length = 0;
+
+        ok = fread(&length, 1, 1, file) == 1 && length < sizeof(vehicle_num) && fread(vehicle_num, 1, length, file) == length;
+        ok = ok && sessionPlateId(store, vehicle_num, true) == i;
+    }
+
+    ok = ok && fread(&num_blocks, sizeof(num_blocks), 1, file) == 1;
+
+    int64_t* plates = (int64_t*)trackedMalloc(sizeof(int64_t) * SESSION_BLOCK_ROWS, MEM_SCRATCH);
+    ok = ok && plates;
+
+    for (uint32_t b = 0; ok && b < num_blocks; b++) 
+    {
+        SessionBlock block;
+
+        ok = fread(&block.rows, sizeof(block.rows), 1, file) == 1 && block.rows > 0 && block.rows <= SESSION_BLOCK_ROWS
+          && fread(&block.min_departure, sizeof(int64_t), 1, file) == 1
+          && fread(&block.max_departure, sizeof(int64_t), 1, file) == 1
+          && fread(block.offsets, sizeof(block.offsets), 1, file) == 1
+          && block.offsets[0] == 0
+          && block.offsets[SESSION_COLUMNS] <= (uint32_t)block.rows * SESSION_COLUMNS * 10;
+        for (int c = 0; ok && c < SESSION_COLUMNS; c++) 
+        {
+            ok = block.offsets[c] <= block.offsets[c + 1];
+        }
+        if (!ok) break;
+
+        block.bytes = (uint8_t*)trackedMalloc(block.offsets[SESSION_COLUMNS] + 1, MEM_SESSION);
+        ok = block.bytes && fread(block.bytes, 1, block.offsets[SESSION_COLUMNS], file) == block.offsets[SESSION_COLUMNS];
+        if (!ok) 
+        {
+            trackedFree(block.bytes);
+            break;
+        }
+
+        // A short block is the tail that was open when the history was saved. Every column
+        // is decoded once here, so queries never meet a block that does not decode.
+        bool tail = (block.rows < SESSION_BLOCK_ROWS);
+        uint32_t first_row = (uint32_t)store->num_blocks * SESSION_BLOCK_ROWS;
+
+        ok = !tail || b == num_blocks - 1;
+        for (int c = 0; ok && c < SESSION_COLUMNS; c++) 
+        {
+            ok = sessionDecodeColumn(&block, (session_column)c, tail ? store->tail[c] : plates);
+        }
+        ok = ok && sessionDecodeColumn(&block, SESSION_COL_PLATE, plates);
+
+        for (int r = 0; ok && r < block.rows; r++) 
+        {
+            ok = plates[r] >= 0 && plates[r] < (int64_t)store->num_plates && sessionPlateAddRow(store, (uint32_t)plates[r], first_row + r);
+        }
+
+        if (ok && tail) 
+        {
+            store->tail_rows = block.rows;
+            trackedFree(block.bytes);
+        }
+        else if (ok && sessionReserveBlock(store)) 
+        {
+            store->blocks[store->num_blocks++] = block;
+        }
+        else 
+        {
+            ok = false;
+            trackedFree(block.bytes);
+        }
+    }
+
+    trackedFree(plates);
+    pthread_mutex_unlock(&store->lock);
+    fclose(file);
+
+    if (!ok) 
+    {
+        char corrupt_name[512];
+        snprintf(corrupt_name, sizeof(corrupt_name), "%s.corrupt", filename);
+
+        Session_Destroy(store);
+
+        if (rename(filename, corrupt_name) == 0) 
+        {
+            fprintf(stderr, "Session history in %s is damaged; kept it as %s and starting with an empty history.\n", filename, corrupt_name);
+        }
+        else 
+        {
+            fprintf(stderr, "Session history in %s is damaged and could not be moved aside; it will not be saved over.\n", filename);
+            store->keep_file = true;
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+void Session_PrintStats(SessionStore* store) 
+{
+    pthread_mutex_lock(&store->lock);
+
+    long rows = (long)store->num_blocks * SESSION_BLOCK_ROWS + store->tail_rows;
+    uint64_t encoded = 0;
+
+    for (int b = 0; b < store->num_blocks; b++) 
+    {
+        encoded += store->blocks[b].offsets[SESSION_COLUMNS];
+    }
+
+    printf("\nSession history: %ld sessions, %u vehicles, %d sealed blocks", rows, store->num_plates, store->num_blocks);
+    if (store->num_blocks > 0) 
+    {
+        printf(" (%.2f bytes per sealed session)", (double)encoded / ((double)store->num_blocks * SESSION_BLOCK_ROWS));
+    }
+    printf("\n");
+
+    pthread_mutex_unlock(&store->lock);
+}
+
+void printSessionRecord(const SessionRecord* session, void* ctx) 
+{
+    (void)ctx;
+    char arrival[24], departure[24];
+
+    formatTimestamp(session->arrival, arrival, sizeof(arrival));
+    formatTimestamp(session->departure, departure, sizeof(departure));
+
+    printf("  Slot %d: %s -> %s, Amount: %.2f\n", session->parking_id, arrival, departure, session->amount_paise / 100.0);
+}
+
+// Menu reports over the history
+void Session_PrintRevenue(SessionStore* store, const char* from_date, const char* to_date) 
+{
+    int64_t from = parseTimestamp(from_date, NULL), to = parseTimestamp(to_date, NULL);
+
+    if (from < 0 || to < from) 
+    {
+        printf("Invalid date range.\n");
+        return;
+    }
+
+    int64_t revenue = 0;
+    long sessions = Session_RevenueBetween(store, from, to + 1439, &revenue);
+
+    printf("Revenue from %s to %s: %.2f over %ld sessions.\n", from_date, to_date, revenue / 100.0, sessions);
+}
+
+void Session_PrintVisits(SessionStore* store, const char* vehicle_num) 
+{
+    printf("Visits of %s:\n", vehicle_num);
+
+    if (Session_ForPlate(store, vehicle_num, printSessionRecord, NULL) <= 0) 
+    {
+        printf("  No recorded visits.\n");
+    }
+}
+
+void Session_PrintSlotDays(SessionStore* store, const char* from_date, const char* to_date, int max_slot) 
+{
+    int64_t from = parseTimestamp(from_date, NULL), to = parseTimestamp(to_date, NULL);
+
+    if (from < 0 || to < from || (to - from) / 1440 >= 366) 
+    {
+        printf("Invalid date range (at most a year).\n");
+        return;
+    }
+
+    int days = (int)((to - from) / 1440) + 1;
+    uint32_t* counts = (uint32_t*)trackedMalloc(sizeof(uint32_t) * days * (max_slot + 1), MEM_SCRATCH);
+    if (!counts) return;
+
+    long sessions = Session_SlotDayCounts(store, from / 1440, days, max_slot, counts);
+    char date[24];
+
+    printf("Sessions per slot per day (%ld in total):\n", sessions);
+    for (int d = 0; d < days; d++) 
+    {
+        bool any = false;
+        formatTimestamp(from + (int64_t)d * 1440, date, sizeof(date));
+
+        for (int slot = 0; slot <= max_slot; slot++) 
+        {
+            uint32_t count = counts[d * (max_slot + 1) + slot];
+            if (!count) continue;
+
+            if (!any) printf("  %.10s:", date);
+            printf(" [%d]=%u", slot, count);
+            any = true;
+        }
+        if (any) printf("\n");
+    }
+
+    trackedFree(counts);
+}
+
+// Occupancy Time Series
+// Occupancy curves are maintained as the gates run rather than replayed from history.
+// There is one series per membership tier and one per block of range_width slots (from
+// the lot config), and each series keeps a ring of minute, hour and day buckets. A gate event only
+// touches the current bucket of each ring; buckets skipped over are filled in on the next
+// event, so updates are amortized O(1) and reading a window is a copy out of a ring.
+// Time is gate time (the date and time on the events) in minutes since 1970. An event
+// older than the newest one seen is counted at the newest time.
+#define OCCUPANCY_TIERS LOT_TIERS
+
+typedef enum { OCC_MINUTE, OCC_HOUR, OCC_DAY, OCC_RESOLUTIONS } occupancy_resolution;
+
+static const int occupancy_bucket_minutes[OCC_RESOLUTIONS] = { 1, 60, 1440 };
+static const int occupancy_ring_length[OCC_RESOLUTIONS] = { 1440, 24 * 60, 730 }; // A day of minutes, 60 days of hours, 2 years of days
+static const char* const occupancy_resolution_names[OCC_RESOLUTIONS] = { "minute", "hour", "day" };
+
+typedef struct OccupancyBucket 
+{
+    int32_t level;            // Occupied slots at the end of the bucket
+    int32_t peak;
+    int64_t occupied_minutes; // Integral of the level over the bucket
+
+} OccupancyBucket;
+
+typedef struct OccupancyRing 
+{
+    OccupancyBucket* buckets;
+    int64_t head;        // Absolute number of the current bucket
+    int64_t last_change; // Minute the level last changed, within the head bucket
+
+} OccupancyRing;
+
+typedef struct OccupancySeries 
+{
+    int32_t level;
+    int32_t capacity;
+    OccupancyRing rings[OCC_RESOLUTIONS];
+
+} OccupancySeries;
+
+typedef struct OccupancyPoint 
+{
+    int64_t start; // Minutes since 1970
+    int32_t level;
+    int32_t peak;
+    double average;
+
+} OccupancyPoint;
+
+typedef struct OccupancyTimeline 
+{
+    int num_series;
+    int max_slot;
+    int range_width;
+    OccupancySeries* series;
+    int64_t start; // First event, -1 until there is one
+    int64_t now;   // Newest event
+    pthread_mutex_t lock;
+
+} OccupancyTimeline;
+
+OccupancyTimeline g_occupancy = { .start = -1, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+int Occupancy_SeriesForTier(int tier) 
+{
+    return tier;
+}
+
+int Occupancy_SeriesForSlot(const OccupancyTimeline* timeline, int parking_id) 
+{
+    return OCCUPANCY_TIERS + (parking_id - 1) / timeline->range_width;
+}
+
+void Occupancy_SeriesName(const OccupancyTimeline* timeline, int series, char* out, size_t size) 
+{
+    if (series < OCCUPANCY_TIERS) 
+    {
+        snprintf(out, size, "tier:%s", lot_tier_keys[series]);
+        return;
+    }
+
+    int first = (series - OCCUPANCY_TIERS) * timeline->range_width + 1;
+    int last = first + timeline->range_width - 1;
+
+    snprintf(out, size, "slots:%d-%d", first, last < timeline->max_slot ? last : timeline->max_slot);
+}
+
+void Occupancy_Destroy(OccupancyTimeline* timeline) 
+{
+    pthread_mutex_lock(&timeline->lock);
+
+    for (int s = 0; s < timeline->num_series; s++) 
+    {
+        for (int r = 0; r < OCC_RESOLUTIONS; r++) 
+        {
+            trackedFree(timeline->series[s].rings[r].buckets);
+        }
+    }
+    trackedFree(timeline->series);
+
+    timeline->series = NULL;
+    timeline->num_series = 0;
+    timeline->max_slot = 0;
+    timeline->start = -1;
+    timeline->now = 0;
+
+    pthread_mutex_unlock(&timeline->lock);
+}
+
+// Size the series for the slots in parkingRoot and take their current state as the starting levels
+bool Occupancy_Init(OccupancyTimeline* timeline, GenericBPlusTreeNode* parkingRoot) 
+{
+    Occupancy_Destroy(timeline);
+
+    BPlusCursor cursor;
+    const Parking* slot;
+    int max_slot = Max_Parking_ID(parkingRoot);
+    int range_width = Facility_Current()->lot->range_width;
+
+    int num_series = OCCUPANCY_TIERS + (max_slot + range_width - 1) / range_width;
+    OccupancySeries* series = (OccupancySeries*)trackedCalloc(num_series, sizeof(OccupancySeries), MEM_OCCUPANCY);
+    if (!series) return false;
+
+    for (int s = 0; s < num_series; s++) 
+    {
+        for (int r = 0; r < OCC_RESOLUTIONS; r++) 
+        {
+            series[s].rings[r].buckets = (OccupancyBucket*)trackedCalloc(occupancy_ring_length[r], sizeof(OccupancyBucket), MEM_OCCUPANCY);
+            if (!series[s].rings[r].buckets) 
+            {
+                timeline->series = series;
+                timeline->num_series = s + 1;
+                Occupancy_Destroy(timeline);
+                return false;
+            }
+        }
+    }
+
+    for (Cursor_First(&cursor, parkingRoot); (slot = (const Parking*)Cursor_Next(&cursor)) != NULL; ) 
+    {
+        if (slot->parking_id < 1) continue;
+
+        int occupied = (slot->parking_space_status == OCCUPIED);
+        int tier = Occupancy_SeriesForTier(Slot_Tier(slot->parking_id));
+        int range = OCCUPANCY_TIERS + (slot->parking_id - 1) / range_width;
+
+        series[tier].capacity++;
+        series[tier].level += occupied;
+        series[range].capacity++;
+        series[range].level += occupied;
+    }
+
+    pthread_mutex_lock(&timeline->lock);
+    timeline->series = series;
+    timeline->num_series = num_series;
+    timeline->max_slot = max_slot;
+    timeline->range_width = range_width;
+    pthread_mutex_unlock(&timeline->lock);
+
+    return true;
+}
+
+// Close buckets up to the one holding minute t, carrying the level across any gap
+void occupancyAdvance(OccupancyRing* ring, int resolution, int32_t level, int64_t t) 
+{
+    int width = occupancy_bucket_minutes[resolution];
+    int length = occupancy_ring_length[resolution];
+    int64_t target = t / width;
+
+    if (ring->head >= target) return;
+
+    OccupancyBucket* bucket = &ring->buckets[ring->head % length];
+    bucket->occupied_minutes += (int64_t)level * ((ring->head + 1) * width - ring->last_change);
+    bucket->level = level;
+
+    // Buckets older than a full ring would be overwritten anyway
+    if (target - ring->head > length) ring->head = target - length;
+
+    while (++ring->head < target) 
+    {
+        bucket = &ring->buckets[ring->head % length];
+        bucket->level = bucket->peak = level;
+        bucket->occupied_minutes = (int64_t)level * width;
+    }
+
+    bucket = &ring->buckets[target % length];
+    bucket->level = bucket->peak = level;
+    bucket->occupied_minutes = 0;
+    ring->last_change = target * width;
+}
+
+void occupancyChange(OccupancySeries* series, int delta, int64_t t) 
+{
+    for (int r = 0; r < OCC_RESOLUTIONS; r++) 
+    {
+        OccupancyRing* ring = &series->rings[r];
+        occupancyAdvance(ring, r, series->level, t);
+
+        OccupancyBucket* bucket = &ring->buckets[ring->head % occupancy_ring_length[r]];
+        bucket->occupied_minutes += (int64_t)series->level * (t - ring->last_change);
+        bucket->level = series->level + delta;
+        if (bucket->level > bucket->peak) bucket->peak = bucket->level;
+        ring->last_change = t;
+    }
+
+    series->level += delta;
+}
+
+// A slot was taken (delta +1) or freed (delta -1) at minute t
+void Occupancy_Record(OccupancyTimeline* timeline, int parking_id, int delta, int64_t t) 
+{
+    if (t < 0) return;
+
+    pthread_mutex_lock(&timeline->lock);
+
+    if (parking_id >= 1 && parking_id <= timeline->max_slot) 
+    {
+        if (timeline->start < 0) 
+        {
+            // Every series starts at the first event with its level from load time
+            timeline->start = timeline->now = t;
+
+            for (int s = 0; s < timeline->num_series; s++) 
+            {
+                for (int r = 0; r < OCC_RESOLUTIONS; r++) 
+                {
+                    OccupancyRing* ring = &timeline->series[s].rings[r];
+                    int width = occupancy_bucket_minutes[r];
+
+                    ring->head = t / width;
+                    ring->last_change = t;
+                    ring->buckets[ring->head % occupancy_ring_length[r]] = (OccupancyBucket){ timeline->series[s].level, timeline->series[s].level, 0 };
+                }
+            }
+        }
+
+        if (t < timeline->now) t = timeline->now;
+        timeline->now = t;
+
+        occupancyChange(&timeline->series[Occupancy_SeriesForTier(Slot_Tier(parking_id))], delta, t);
+        occupancyChange(&timeline->series[Occupancy_SeriesForSlot(timeline, parking_id)], delta, t);
+    }
+
+    pthread_mutex_unlock(&timeline->lock);
+}
+
+// Fill out with the buckets of one series covering minutes [from, to], oldest first, up to
+// max points. Buckets before the first event or already rotated out of the ring are left
+// out; the newest bucket covers only the time up to the newest event. Returns the count.
+int Occupancy_Window(OccupancyTimeline* timeline, int series_index, occupancy_resolution resolution, int64_t from, int64_t to, OccupancyPoint* out, int max) 
+{
+    int width = occupancy_bucket_minutes[resolution];
+    int length = occupancy_ring_length[resolution];
+    int count = 0;
+
+    pthread_mutex_lock(&timeline->lock);
+
+    if (series_index >= 0 && series_index < timeline->num_series && timeline->start >= 0) 
+    {
+        const OccupancySeries* series = &timeline->series[series_index];
+        const OccupancyRing* ring = &series->rings[resolution];
+        int64_t now_bucket = timeline->now / width;
+        int64_t first = from / width, last = to / width;
+
+        if (first < timeline->start / width) first = timeline->start / width;
+        if (first < now_bucket - length + 1) first = now_bucket - length + 1;
+        if (last > now_bucket) last = now_bucket;
+
+        for (int64_t k = first; k <= last && count < max; k++) 
+        {
+            OccupancyPoint* point = &out[count++];
+            int64_t start = k * width;
+            int64_t end = (k == now_bucket) ? timeline->now : start + width;
+
+            point->start = start;
+
+            if (k < ring->head) 
+            {
+                // Closed bucket
+                const OccupancyBucket* bucket = &ring->buckets[k % length];
+                point->level = bucket->level;
+                point->peak = bucket->peak;
+                point->average = (double)bucket->occupied_minutes / width;
+            }
+            else if (k == ring->head) 
+            {
+                // Open bucket, integrated up to the newest event
+                const OccupancyBucket* bucket = &ring->buckets[k % length];
+                int64_t span = end - start;
+                int64_t occupied = bucket->occupied_minutes + (int64_t)series->level * (end - ring->last_change);
+
+                point->level = series->level;
+                point->peak = bucket->peak;
+                point->average = span > 0 ? (double)occupied / span : series->level;
+            }
+            else 
+            {
+                // No event in this series since: the level held throughout
+                point->level = point->peak = series->level;
+                point->average = series->level;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&timeline->lock);
+
+    return count;
+}
+
+int32_t Occupancy_Capacity(OccupancyTimeline* timeline, int series_index) 
+{
+    pthread_mutex_lock(&timeline->lock);
+    int32_t capacity = (series_index >= 0 && series_index < timeline->num_series) ? timeline->series[series_index].capacity : 0;
+    pthread_mutex_unlock(&timeline->lock);
+
+    return capacity;
+}
+
+void Occupancy_PrintWindow(OccupancyTimeline* timeline, int series_index, occupancy_resolution resolution, const char* from_date, const char* to_date) 
+{
+    int64_t from = parseTimestamp(from_date, NULL), to = parseTimestamp(to_date, NULL);
+
+    if (series_index < 0 || series_index >= timeline->num_series || from < 0 || to < from) 
+    {
+        printf("Invalid series or date range.\n");
+        return;
+    }
+
+    int max = occupancy_ring_length[resolution];
+    OccupancyPoint* points = (OccupancyPoint*)trackedMalloc(sizeof(OccupancyPoint) * max, MEM_SCRATCH);
+    if (!points) return;
+
+    struct timespec begin, finish;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    int count = Occupancy_Window(timeline, series_index, resolution, from, to + 1439, points, max);
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+
+    int32_t capacity = Occupancy_Capacity(timeline, series_index);
+    char name[32], when[24];
+    int peak = -1;
+
+    Occupancy_SeriesName(timeline, series_index, name, sizeof(name));
+    printf("\n%s occupancy by %s (%d slots):\n", name, occupancy_resolution_names[resolution], capacity);
+
+    for (int i = 0; i < count; i++) 
+    {
+        formatTimestamp(points[i].start, when, sizeof(when));
+        printf("  %s  Level: %d, Peak: %d, Average: %.2f (%.1f%%)\n", when, points[i].level, points[i].peak, points[i].average, capacity ? 100.0 * points[i].average / capacity : 0.0);
+
+        if (peak < 0 || points[i].peak > points[peak].peak) peak = i;
+    }
+
+    if (peak < 0) 
+    {
+        printf("  No data in range.\n");
+    }
+    else 
+    {
+        formatTimestamp(points[peak].start, when, sizeof(when));
+        printf("Peak utilization: %d of %d (%.1f%%) in the %s from %s\n", points[peak].peak, capacity, capacity ? 100.0 * points[peak].peak / capacity : 0.0, occupancy_resolution_names[resolution], when);
+    }
+
+    printf("Window of %d buckets read in %.1f us\n", count, ((finish.tv_sec - begin.tv_sec) * 1e9 + (finish.tv_nsec - begin.tv_nsec)) / 1e3);
+
+    trackedFree(points);
+}
+
+// Parked Vehicles
+// Every occupied slot points back at the user parked in it, and each facility threads its
+// parked users on an intrusive doubly linked list, so "who is in slot 37" is one slot
+// lookup and listing the floor costs O(occupied) instead of a walk over every user. Both
+// links are set by the gate that claims a slot and cleared before the slot is released.
+// The list has its own lock because sharded gates enter and exit side by side.
+//
+// Parked vehicles are also kept in a min-heap by arrival, with each user recording its
+// position so an exit removes it in O(log n). "Parked longer than N hours" walks the heap
+// best-first and stops at the first vehicle that arrived too late, O(k log n) for k
+// results. An optional overstay alarm keeps a second heap of vehicles it has not yet fired
+// for and fires as soon as gate time (the latest event seen) carries one past the limit.
+typedef struct ParkedEntry 
+{
+    int64_t arrival; // Minutes since 1970
+    User* user;
+
+} ParkedEntry;
+
+typedef struct ArrivalHeap 
+{
+    ParkedEntry* entries;
+    int count;
+    int cap;
+    int which; // This heap's index into User.heap_pos
+
+} ArrivalHeap;
+
+// Called with the list locked, so it must not call back into the list
+typedef void (*OverstayFunc)(const User* user, int64_t arrival, void* ctx);
+
+typedef struct ParkedList 
+{
+    User* head;
+    long count;
+    ArrivalHeap by_arrival;
+    ArrivalHeap pending;     // Vehicles the alarm has yet to fire for
+    int64_t clock;           // Latest gate time seen, -1 before the first event
+    int64_t alarm_minutes;
+    OverstayFunc alarm;      // NULL while no alarm is set
+    void* alarm_ctx;
+    pthread_mutex_t lock;
+
+} ParkedList;
+
+ParkedList g_parked = { .pending.which = 1, .clock = -1, .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static inline void heapPlace(ArrivalHeap* heap, int pos, ParkedEntry entry) 
+{
+    heap->entries[pos] = entry;
+    entry.user->heap_pos[heap->which] = pos;
+}
+
+void heapSiftUp(ArrivalHeap* heap, int pos) 
+{
+    ParkedEntry entry = heap->entries[pos];
+
+    while (pos > 0 && heap->entries[(pos - 1) / 2].arrival > entry.arrival) 
+    {
+        heapPlace(heap, pos, heap->entries[(pos - 1) / 2]);
+        pos = (pos - 1) / 2;
+    }
+
+    heapPlace(heap, pos, entry);
+}
+
+void heapSiftDown(ArrivalHeap* heap, int pos) 
+{
+    ParkedEntry entry = heap->entries[pos];
+
+    for (;;) 
+    {
+        int child = 2 * pos + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && heap->entries[child + 1].arrival < heap->entries[child].arrival) child++;
+        if (heap->entries[child].arrival >= entry.arrival) break;
+
+        heapPlace(heap, pos, heap->entries[child]);
+        pos = child;
+    }
+
+    heapPlace(heap, pos, entry);
+}
+
+bool heapPush(ArrivalHeap* heap, User* user, int64_t arrival) 
+{
+    if (heap->count == heap->cap) 
+    {
+        int cap = heap->cap ? heap->cap * 2 : 64;
+        ParkedEntry* entries = (ParkedEntry*)trackedRealloc(heap->entries, sizeof(ParkedEntry) * cap, MEM_PARKED);
+
+        if (!entries) 
+        {
+            perror("Failed to grow parked vehicle heap");
+            return false;
+        }
+
+        heap->entries = entries;
+        heap->cap = cap;
+    }
+
+    heap->entries[heap->count] = (ParkedEntry){ arrival, user };
+    heapSiftUp(heap, heap->count++);
+
+    return true;
+}
+
+// Remove user if it is in the heap
+void heapRemove(ArrivalHeap* heap, User* user) 
+{
+    int pos = user->heap_pos[heap->which];
+    if (pos < 0) return;
+
+    user->heap_pos[heap->which] = -1;
+    if (pos == --heap->count) return;
+
+    // The last entry fills the hole and moves whichever way its arrival says
+    ParkedEntry last = heap->entries[heap->count];
+    heapPlace(heap, pos, last);
+    heapSiftUp(heap, pos);
+    heapSiftDown(heap, last.user->heap_pos[heap->which]);
+}
+
+void heapClear(ArrivalHeap* heap) 
+{
+    for (int i = 0; i < heap->count; i++) heap->entries[i].user->heap_pos[heap->which] = -1;
+    heap->count = 0;
+}
+
+// List is locked. Fire the alarm for every pending vehicle the clock has carried past the limit.
+void parkedFireLocked(ParkedList* list) 
+{
+    if (!list->alarm || list->clock < 0) return;
+
+    while (list->pending.count > 0 && list->pending.entries[0].arrival + list->alarm_minutes <= list->clock) 
+    {
+        ParkedEntry due = list->pending.entries[0];
+        heapRemove(&list->pending, due.user);
+        list->alarm(due.user, due.arrival, list->alarm_ctx);
+    }
+}
+
+// List is locked. Gate time only moves forward; events arriving out of order don't rewind it.
+void parkedAdvanceLocked(ParkedList* list, int64_t t) 
+{
+    if (t > list->clock) list->clock = t;
+    parkedFireLocked(list);
+}
+
+// Record user as the occupant of slot, which the caller has just claimed, from minute arrival
+void Parked_Link(ParkedList* list, Parking* slot, User* user, int64_t arrival) 
+{
+    pthread_mutex_lock(&list->lock);
+
+    user->prev_parked = NULL;
+    user->next_parked = list->head;
+    if (list->head) list->head->prev_parked = user;
+    list->head = user;
+    list->count++;
+
+    if (arrival >= 0) 
+    {
+        heapPush(&list->by_arrival, user, arrival);
+        if (list->alarm) heapPush(&list->pending, user, arrival);
+        parkedAdvanceLocked(list, arrival);
+    }
+
+    pthread_mutex_unlock(&list->lock);
+
+    __atomic_store_n(&slot->occupant, user, __ATOMIC_RELEASE);
+}
+
+// Undo Parked_Link for a departure at minute departure. Runs before the slot is released,
+// since the next claimer sets its own occupant.
+void Parked_Unlink(ParkedList* list, Parking* slot, User* user, int64_t departure) 
+{
+    if (slot) __atomic_store_n(&slot->occupant, NULL, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&list->lock);
+
+    // A record that never made it onto the list (a stale database row) is left alone
+    if (user->prev_parked || list->head == user) 
+    {
+        if (user->prev_parked) user->prev_parked->next_parked = user->next_parked;
+        else list->head = user->next_parked;
+        if (user->next_parked) user->next_parked->prev_parked = user->prev_parked;
+
+        user->prev_parked = NULL;
+        user->next_parked = NULL;
+        list->count--;
+
+        heapRemove(&list->by_arrival, user);
+        heapRemove(&list->pending, user);
+    }
+
+    // The vehicle leaving is no longer pending, so its own departure can't fire the alarm for it
+    if (departure >= 0) parkedAdvanceLocked(list, departure);
+
+    pthread_mutex_unlock(&list->lock);
+}
+
+// Vehicle parked in slot, or NULL
+User* Slot_Occupant(const Parking* slot) 
+{
+    return __atomic_load_n(&slot->occupant, __ATOMIC_ACQUIRE);
+}
+
+// Empty the list. Its users keep stale links, so this is only for teardown and rebuilds.
+void Parked_Reset(ParkedList* list) 
+{
+    pthread_mutex_lock(&list->lock);
+    list->head = NULL;
+    list->count = 0;
+    list->by_arrival.count = 0;
+    list->pending.count = 0;
+    list->clock = -1;
+    pthread_mutex_unlock(&list->lock);
+}
+
+void Parked_Destroy(ParkedList* list) 
+{
+    Parked_Reset(list);
+
+    pthread_mutex_lock(&list->lock);
+    trackedFree(list->by_arrival.entries);
+    trackedFree(list->pending.entries);
+    list->by_arrival = (ArrivalHeap){ NULL, 0, 0, 0 };
+    list->pending = (ArrivalHeap){ NULL, 0, 0, 1 };
+    list->alarm = NULL;
+    pthread_mutex_unlock(&list->lock);
+}
+
+// The frontier of a best-first walk is a small heap of positions in the arrival heap
+void frontierPush(const ArrivalHeap* heap, int* frontier, int* size, int pos) 
+{
+    int at = (*size)++;
+
+    while (at > 0 && heap->entries[frontier[(at - 1) / 2]].arrival > heap->entries[pos].arrival) 
+    {
+        frontier[at] = frontier[(at - 1) / 2];
+        at = (at - 1) / 2;
+    }
+
+    frontier[at] = pos;
+}
+
+int frontierPop(const ArrivalHeap* heap, int* frontier, int* size) 
+{
+    int top = frontier[0];
+    int last = frontier[--(*size)];
+    int at = 0;
+
+    for (;;) 
+    {
+        int child = 2 * at + 1;
+        if (child >= *size) break;
+        if (child + 1 < *size && heap->entries[frontier[child + 1]].arrival < heap->entries[frontier[child]].arrival) child++;
+        if (heap->entries[frontier[child]].arrival >= heap->entries[last].arrival) break;
+
+        frontier[at] = frontier[child];
+        at = child;
+    }
+
+    if (*size > 0) frontier[at] = last;
+
+    return top;
+}
+
+// Visit every vehicle parked at or before minute cutoff, oldest first; returns how many.
+// Vehicles due form the top of the arrival heap, so the walk pops the oldest unvisited one
+// and only looks at its two children. Runs with the list locked.
+long Parked_ArrivedBy(ParkedList* list, int64_t cutoff, OverstayFunc visit, void* ctx) 
+{
+    long found = 0;
+
+    pthread_mutex_lock(&list->lock);
+
+    const ArrivalHeap* heap = &list->by_arrival;
+    int* frontier = (heap->count > 0 && heap->entries[0].arrival <= cutoff) ? (int*)trackedMalloc(sizeof(int) * (heap->count + 1), MEM_SCRATCH) : NULL;
+    int size = 0;
+
+    if (frontier) frontierPush(heap, frontier, &size, 0);
+
+    while (size > 0) 
+    {
+        int pos = frontierPop(heap, frontier, &size);
+
+        visit(heap->entries[pos].user, heap->entries[pos].arrival, ctx);
+        found++;
+
+        for (int child = 2 * pos + 1; child <= 2 * pos + 2 && child < heap->count; child++) 
+        {
+            if (heap->entries[child].arrival <= cutoff) frontierPush(heap, frontier, &size, child);
+        }
+    }
+
+    pthread_mutex_unlock(&list->lock);
+
+    trackedFree(frontier);
+
+    return found;
+}
+
+// Vehicles that by minute now have been parked for at least minutes, oldest first
+long Parked_Overstays(ParkedList* list, int64_t now, int64_t minutes, OverstayFunc visit, void* ctx) 
+{
+    return Parked_ArrivedBy(list, now - minutes, visit, ctx);
+}
+
+// Call alarm for each vehicle as gate time carries it past minutes parked (NULL alarm
+// turns it off). Vehicles already past the limit are reported at once.
+void Parked_SetOverstayAlarm(ParkedList* list, int64_t minutes, OverstayFunc alarm, void* ctx) 
+{
+    pthread_mutex_lock(&list->lock);
+
+    heapClear(&list->pending);
+    list->alarm = alarm;
+    list->alarm_minutes = minutes;
+    list->alarm_ctx = ctx;
+
+    if (alarm) 
+    {
+        for (int i = 0; i < list->by_arrival.count; i++) 
+        {
+            heapPush(&list->pending, list->by_arrival.entries[i].user, list->by_arrival.entries[i].arrival);
+        }
+        parkedFireLocked(list);
+    }
+
+    pthread_mutex_unlock(&list->lock);
+}
+
+// Move gate time forward without an event, e.g. from a wall clock; fires any alarms now due
+void Parked_AdvanceClock(ParkedList* list, int64_t now) 
+{
+    pthread_mutex_lock(&list->lock);
+    parkedAdvanceLocked(list, now);
+    pthread_mutex_unlock(&list->lock);
+}
+
+typedef struct ParkedRebuild 
+{
+    ParkedList* list;
+    GenericBPlusTreeNode* parkingRoot;
+    int lot_id;
+
+} ParkedRebuild;
+
+void linkParkedUser(const void* data, void* ctx) 
+{
+    User* user = (User*)data;
+    ParkedRebuild* rebuild = (ParkedRebuild*)ctx;
+
+    if (user->status != PARKED || user->lot_id != rebuild->lot_id) return;
+
+    Parking* slot = SearchParking_BPlus(rebuild->parkingRoot, user->parking_space_id);
+
+    // Left parked, such a row would have its next exit bill and free a slot it does not hold
+    if (!slot || slot->parking_space_status != OCCUPIED || slot->occupant) 
+    {
+        fprintf(stderr, "Vehicle %s is marked parked in slot %d, which does not hold it; taken as not parked.\n", user->vehicle_num, user->parking_space_id);
+        user->status = NOTPARKED;
+        user->parking_space_id = -1;
+        return;
+    }
+
+    Parked_Link(rebuild->list, slot, user, parseTimestamp(user->arrival_date, user->arrival_time));
+}
+
+// Rebuild the current facility's links from the users it has parked, after loading
+long Parked_Rebuild(GenericBPlusTreeNode* parkingRoot, GenericBPlusTreeNode* userRoot) 
+{
+    ParkedRebuild rebuild = { Facility_Current()->parked, parkingRoot, Facility_Current()->id };
+
+    Parked_Reset(rebuild.list);
+    ForEach_BPlus(userRoot, linkParkedUser, &rebuild);
+
+    return rebuild.list->count;
+}
+
+int compareParkedBySlot(const void* a, const void* b) 
+{
+    const User* user_a = *(const User* const*)a;
+    const User* user_b = *(const User* const*)b;
+
+    return (user_a->parking_space_id > user_b->parking_space_id) - (user_a->parking_space_id < user_b->parking_space_id);
+}
+
+// Copy the parked users out in slot order; the caller frees the array. NULL (with
+// *count 0) when nothing is parked.
+User** Parked_BySlot(ParkedList* list, long* count) 
+{
+    pthread_mutex_lock(&list->lock);
+
+    User** users = (list->count > 0) ? (User**)trackedMalloc(sizeof(User*) * list->count, MEM_SCRATCH) : NULL;
+    long n = 0;
+
+    if (users) 
+    {
+        for (User* user = list->head; user; user = user->next_parked) users[n++] = user;
+    }
+
+    pthread_mutex_unlock(&list->lock);
+
+    if (n > 1) qsort(users, n, sizeof(User*), compareParkedBySlot);
+
+    *count = n;
+    return users;
+}
+
+// Menu listing: the occupant of one slot, or every parked vehicle with parking_id 0
+void Parked_Print(ParkedList* list, GenericBPlusTreeNode* parkingRoot, int parking_id) 
+{
+    if (parking_id > 0) 
+    {
+        Parking* slot = SearchParking_BPlus(parkingRoot, parking_id);
+        User* user = slot ? Slot_Occupant(slot) : NULL;
+
+        if (!slot) printf("No parking slot %d.\n", parking_id);
+        else if (!user) printf("Parking Slot %d is vacant.\n", parking_id);
+        else printf("Parking Slot %d: %s (%s) since %s %s\n", parking_id, user->vehicle_num, user->owner_name, user->arrival_date, user->arrival_time);
+
+        return;
+    }
+
+    long count = 0;
+    User** users = Parked_BySlot(list, &count);
+
+    printf("%-6s %-20s %-20s %s\n", "Slot", "Vehicle", "Owner", "Since");
+    for (long i = 0; i < count; i++) 
+    {
+        printf("%-6d %-20s %-20s %-11s %s\n", users[i]->parking_space_id, users[i]->vehicle_num, users[i]->owner_name, users[i]->arrival_date, users[i]->arrival_time);
+    }
+    printf("%ld vehicle(s) parked.\n", count);
+
+    trackedFree(users);
+}
+
+// ctx is the minute the stay is measured to
+void printOverstay(const User* user, int64_t arrival, void* ctx) 
+{
+    int64_t minutes = *(const int64_t*)ctx - arrival;
+    printf("%-6d %-20s %s %s  %lldh %02lldm\n", user->parking_space_id, user->vehicle_num, user->arrival_date, user->arrival_time, (long long)(minutes / 60), (long long)(minutes % 60));
+}
+
+void printOverstayAlarm(const User* user, int64_t arrival, void* ctx) 
+{
+    (void)arrival;
+    printf("Overstay: vehicle %s in Parking Slot %d, parked since %s %s, is past %lld minutes.\n", user->vehicle_num, user->parking_space_id, user->arrival_date, user->arrival_time, (long long)*(const int64_t*)ctx);
+}
+
+// Outcome of a single gate event
+typedef enum 
+{
+    GATE_OK,
+    GATE_ALREADY_PARKED,
+    GATE_NO_SLOT,
+    GATE_NOT_FOUND,
+    GATE_NOT_PARKED,
+    GATE_FAILED
+
+} gate_status;
+
+// Misread candidates a gate may correct to (see PlateIndex_Misread); ctx is the owner name on entry
+bool misreadCanEnter(const User* user, void* ctx) 
+{
+    return user->status != PARKED && strcmp(user->owner_name, (const char*)ctx) == 0;
+}
+
+bool misreadCanExit(const User* user, void* ctx) 
+{
+    (void)ctx;
+    return user->status == PARKED && user->lot_id == Facility_Current()->id;
+}
+
+// Entry for a vehicle whose user record has already been looked up. *userRef is the
+// existing record or NULL for a new user; on success it points at the parked record,
+// which is then the slot's occupant and on the facility's parked list. An unknown plate
+// that is a misreading of exactly one known plate of the same owner, not parked right
+// now, is taken as that vehicle.
+// New records come from pool when one is given, otherwise from createUser. They go
+// into *userRootRef, or into concurrentUsers (latched insert) when that is given instead.
+// entrance picks which gate's distances decide the nearest slot (0 with no layout);
+// required_attrs, when nonzero, limits the choice to slots with those features.
+gate_status Gate_Enter(GenericBPlusTreeNode** parkingRootRef, GenericBPlusTreeNode** userRootRef, ConcurrentBPlusTree* concurrentUsers, UserPool* pool, User** userRef, const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time, int entrance, uint32_t required_attrs, int* parking_id)
+{
+    METRIC_SCOPE(METRIC_INSERT_UPDATE);
+
+    User* userFound = *userRef;
+    Parking* slot = NULL;
+    gate_status status = GATE_OK;
+
+    // A plate we have never seen may be a camera misreading one we have. Only a vehicle
+    // that is not parked and has the same owner can be the one at the gate; anything else
+    // is registered as the new vehicle it may well be.
+    if (userFound == NULL) 
+    {
+        User* known = (User*)PlateIndex_Misread(&g_plateIndex, vehicle_num, misreadCanEnter, (void*)owner_name);
+
+        if (known) 
+        {
+            printf("Plate %s read as known vehicle %s.\n", vehicle_num, known->vehicle_num);
+            userFound = *userRef = known;
+            vehicle_num = known->vehicle_num;
+        }
+        else if ((known = (User*)PlateIndex_Misread(&g_plateIndex, vehicle_num, NULL, NULL)) != NULL) 
+        {
+            printf("Plate %s resembles known vehicle %s; registering it as a new vehicle.\n", vehicle_num, known->vehicle_num);
+        }
+    }
+
+    AllocationRequest request = { vehicle_num, parseTimestamp(arrival_date, arrival_time), entrance, required_attrs };
+    
+    if (userFound != NULL) 
+    {
+        if (userFound->status == PARKED) 
+        {
+            printf("Error: Vehicle %s is already parked.\n", vehicle_num);
+            return GATE_ALREADY_PARKED;
+        }
+
+        int parkingId = -1;
+        bool allocation_success = Allocation_Policy(*parkingRootRef, userFound, &request, &parkingId);
+
+        if (!allocation_success) 
+        {
+            printf("No suitable parking space available for your membership level.\n");
+            return GATE_NO_SLOT;
+        } 
+        else 
+        {
+            // Update existing user record
+            strcpy(userFound->arrival_date, arrival_date);
+            strcpy(userFound->arrival_time, arrival_time);
+            strcpy(userFound->departure_date, "-");
+            strcpy(userFound->departure_time, "-");
+            userFound->status = PARKED;
+            userFound->parking_space_id = parkingId;
+            userFound->number_of_parkings++;
+            userFound->parking_amt = 0;
+            userFound->spent_time = 0;
+            printf("Vehicle %s assigned to parking ID %d.\n", vehicle_num, parkingId);
+
+            slot = SearchParking_BPlus(*parkingRootRef, parkingId);
+            *parking_id = parkingId;
+            status = GATE_OK;
+        }
+    } 
+    else 
+    {
+        int min_id, max_id;
+        Membership_Slot_Range(0, &min_id, &max_id); // New users start as Standard
+
+        Parking* freeParkingSlot = Allocate_Slot(*parkingRootRef, min_id, max_id, &request);
+
+        if (freeParkingSlot == NULL) 
+        {
+            printf("Sorry, %s, no suitable parking space available for new users at the moment.\n", owner_name);
+            return GATE_NO_SLOT;
+        } 
+        else 
+        {
+            // Create the full user object *with* the assigned parking ID
+            User* newUser = NULL;
+            if (pool) 
+            {
+                newUser = UserPool_Alloc(pool);
+                initUser(newUser, vehicle_num, owner_name, arrival_date, arrival_time, freeParkingSlot->parking_id);
+            }
+            else 
+            {
+                newUser = createUser(vehicle_num, owner_name, arrival_date, arrival_time, freeParkingSlot->parking_id);
+            }
+
+            // Insert the new user into the B+ Tree
+            status_code insert_status = concurrentUsers 
+                ? Insert_BPlus_OLC(concurrentUsers, newUser, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey)
+                : Insert_BPlus(userRootRef, newUser, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey);
+
+            if (insert_status == SUCCESS) 
+            {
+                PlateIndex_Add(&g_plateIndex, newUser);
+                printf("Vehicle %s assigned to parking ID %d and added to database.\n", vehicle_num, freeParkingSlot->parking_id);
+                *userRef = newUser;
+                slot = freeParkingSlot;
+                *parking_id = freeParkingSlot->parking_id;
+                status = GATE_OK;
+            } 
+            else 
+            {
+                freeParkingSlot->occupancies = freeParkingSlot->occupancies - 1;
+                Release_Slot(freeParkingSlot);
+
+                // Free the user object we created
+                if (pool) 
+                {
+                    UserPool_Free(pool, newUser);
+                }
+                else 
+                {
+                    freeUser(newUser);
+                }
+                status = GATE_FAILED;
+            }
+        }
+    }
+
+
+    if (status == GATE_OK) 
+    {
+        (*userRef)->lot_id = Facility_Current()->id;
+        Parked_Link(Facility_Current()->parked, slot, *userRef, request.arrival);
+        Occupancy_Record(Facility_Current()->occupancy, *parking_id, +1, request.arrival);
+    }
+
+    return status;
+}
+
+// Same as Insert_Update, but new User records come from pool when one is given
+bool Insert_Update_Pooled(GenericBPlusTreeNode** parkingRootRef, GenericBPlusTreeNode** userRootRef, UserPool* pool, const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time, int entrance, uint32_t required_attrs)
+{
+    User* userFound = SearchUser_BPlus(*userRootRef, vehicle_num);
+    int parkingId = -1;
+
+    return Gate_Enter(parkingRootRef, userRootRef, NULL, pool, &userFound, vehicle_num, owner_name, arrival_date, arrival_time, entrance, required_attrs, &parkingId) == GATE_OK;
+}
+
+bool Insert_Update(GenericBPlusTreeNode** parkingRootRef, GenericBPlusTreeNode** userRootRef, const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time)
+{
+    return Insert_Update_Pooled(parkingRootRef, userRootRef, NULL, vehicle_num, owner_name, arrival_date, arrival_time, 0, 0);
+}
+
+
+
+void Time_spent(User* user) 
+{
+    struct tm arrival_tm = {0}, departure_tm = {0};
+    time_t arrival, departure;
+    double seconds_diff;
+
+    sscanf(user->arrival_date, "%d/%d/%d", &arrival_tm.tm_mday, &arrival_tm.tm_mon, &arrival_tm.tm_year);
+    sscanf(user->arrival_time, "%d:%d", &arrival_tm.tm_hour, &arrival_tm.tm_min);
+    arrival_tm.tm_year -= 1900; 
+    arrival_tm.tm_mon -= 1;
+
+    // Parse departure date and time
+    sscanf(user->departure_date, "%d/%d/%d", &departure_tm.tm_mday, &departure_tm.tm_mon, &departure_tm.tm_year);
+    sscanf(user->departure_time, "%d:%d", &departure_tm.tm_hour, &departure_tm.tm_min);
+    departure_tm.tm_year -= 1900;
+    departure_tm.tm_mon -= 1; 
+
+    arrival = mktime(&arrival_tm);
+    departure = mktime(&departure_tm);
+
+    seconds_diff = difftime(departure, arrival);
+
+    float hours = (float)(seconds_diff / 3600.0);
+
+    user->spent_time = hours;
+    user->total_spent_time += hours; 
+
+    printf("Time spent by %s: %.2f hours (Total: %.2f hours)\n", user->vehicle_num, user->spent_time, user->total_spent_time);
+}
+
+// Membership earned by total_spent_time hours in the lot
+int membershipForHours(float total_spent_time) 
+{
+    if (total_spent_time >= 200) 
+    {
+        return 2; // Gold
+    } 
+    else if (total_spent_time >= 100) 
+    {
+        return 1; // Premium
+    } 
+    else 
+    {
+        return 0; // Standard
+    }
+}
+
+void Membership(User* user) 
+{
+    int old_membership = user->membership;
+
+    user->membership = membershipForHours(user->total_spent_time);
+}
+
+// Tariff Engine
+// Fares are defined in a small key = value config (TARIFF_CONFIG_FILE, optional) and
+// compiled into fee tables of integer paise indexed by schedule (weekday/weekend x
+// off-peak/peak arrival), membership and parked minute, so pricing a stay is one
+// table load. Stays longer than the table fall back to evaluating the rules directly.
+// With no config file the defaults reproduce the original fares: 100.00 for the first
+// three hours, then 50.00 for every further started hour (leftover minutes up to 12
+// are free), and 10% off for Premium and Gold members.
+#define TARIFF_CONFIG_FILE "sample_tariff.cfg"
+#define TARIFF_TABLE_MINUTES (2 * 1440)
+#define TARIFF_MEMBERSHIPS 3
+#define TARIFF_SCHEDULES 4 // Bit 0: arrived in the peak band, bit 1: arrived on a weekend
+
+typedef struct TariffRules 
+{
+    int64_t base_fee;         // Paise, covers the first base_minutes
+    int32_t base_minutes;
+    int64_t hourly_fee;       // Paise per started hour after base_minutes
+    int32_t round_up_after;   // Leftover minutes beyond this are charged as a full hour
+    int32_t discount_percent[TARIFF_MEMBERSHIPS];
+    int32_t peak_percent;     // Surcharge (100 = none) for arrivals in [peak_start, peak_end)
+    int32_t peak_start;       // Hours
+    int32_t peak_end;
+    int32_t weekend_percent;  // Surcharge (100 = none) for arrivals on Saturday or Sunday
+
+} TariffRules;
+
+typedef struct Tariff 
+{
+    TariffRules rules;
+    int32_t fees[TARIFF_SCHEDULES][TARIFF_MEMBERSHIPS][TARIFF_TABLE_MINUTES]; // Paise
+    bool ready;
+
+} Tariff;
+
+Tariff g_tariff;
+
+void Tariff_DefaultRules(TariffRules* rules) 
+{
+    rules->base_fee = 10000;
+    rules->base_minutes = 180;
+    rules->hourly_fee = 5000;
+    rules->round_up_after = 12;
+    rules->discount_percent[0] = 0;
+    rules->discount_percent[1] = 10;
+    rules->discount_percent[2] = 10;
+    rules->peak_percent = 100;
+    rules->peak_start = 8;
+    rules->peak_end = 20;
+    rules->weekend_percent = 100;
+}
+
+// Fee in paise for one stay, straight from the rules
+int64_t tariffEvaluate(const TariffRules* rules, int schedule, int membership, int64_t minutes) 
+{
+    int64_t fee = rules->base_fee;
+
+    if (minutes < 0) minutes = 0;
+
+    if (minutes >= rules->base_minutes) 
+    {
+        int64_t extra = minutes - rules->base_minutes;
+        int64_t hours = extra / 60 + (extra % 60 > rules->round_up_after);
+
+        fee += rules->hourly_fee * hours;
+    }
+
+    if (schedule & 1) fee = fee * rules->peak_percent / 100;
+    if (schedule & 2) fee = fee * rules->weekend_percent / 100;
+
+    return fee * (100 - rules->discount_percent[membership]) / 100;
+}
+
+void Tariff_Compile(Tariff* tariff, const TariffRules* rules) 
+{
+    tariff->rules = *rules;
+
+    for (int s = 0; s < TARIFF_SCHEDULES; s++) 
+    {
+        for (int m = 0; m < TARIFF_MEMBERSHIPS; m++) 
+        {
+            for (int minute = 0; minute < TARIFF_TABLE_MINUTES; minute++) 
+            {
+                tariff->fees[s][m][minute] = (int32_t)tariffEvaluate(rules, s, m, minute);
+            }
+        }
+    }
+
+    tariff->ready = true;
+}
+
+// Parse "123" or "123.45" into paise
+bool parseMoney(const char* text, int64_t* paise) 
+{
+    long rupees = 0, fraction = 0;
+    int digits = 0;
+    char* end;
+
+    rupees = strtol(text, &end, 10);
+    if (end == text || rupees < 0) return false;
+
+    if (*end == '.') 
+    {
+        for (end++; *end >= '0' && *end <= '9' && digits < 2; end++, digits++) 
+        {
+            fraction = fraction * 10 + (*end - '0');
+        }
+        if (digits == 1) fraction *= 10;
+    }
+
+    while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') end++;
+    if (*end) return false;
+
+    *paise = (int64_t)rupees * 100 + fraction;
+    return true;
+}
+
+// Read rules from a config of "key = value" lines ('#' starts a comment). Keys:
+// base_fee, hourly_fee (rupees, e.g. 100.00), base_minutes, round_up_after (minutes),
+// premium_discount, gold_discount, peak_percent, weekend_percent (percent), and
+// peak_start, peak_end (hours). Keys not given keep their defaults. Returns false if
+// the file exists but has a bad line.
+bool Tariff_ReadConfig(const char* filename, TariffRules* rules, bool* found) 
+{
+    Tariff_DefaultRules(rules);
+
+    FILE* file = fopen(filename, "r");
+    *found = (file != NULL);
+    if (!file) return true;
+
+    char line[256];
+    int line_num = 0;
+    bool ok = true;
+
+    while (ok && fgets(line, sizeof(line), file) != NULL) 
+    {
+        line_num++;
+
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+
+        char key[64], value[64];
+        int fields = sscanf(line, " %63[^= \t] = %63s", key, value);
+
+        if (fields <= 0) continue;
+        if (fields != 2) 
+        {
+            ok = false;
+            break;
+        }
+
+        int number = atoi(value);
+
+        if (strcmp(key, "base_fee") == 0) ok = parseMoney(value, &rules->base_fee);
+        else if (strcmp(key, "hourly_fee") == 0) ok = parseMoney(value, &rules->hourly_fee);
+        else if (strcmp(key, "base_minutes") == 0) rules->base_minutes = number;
+        else if (strcmp(key, "round_up_after") == 0) rules->round_up_after = number;
+        else if (strcmp(key, "premium_discount") == 0) rules->discount_percent[1] = number;
+        else if (strcmp(key, "gold_discount") == 0) rules->discount_percent[2] = number;
+        else if (strcmp(key, "peak_percent") == 0) rules->peak_percent = number;
+        else if (strcmp(key, "peak_start") == 0) rules->peak_start = number;
+        else if (strcmp(key, "peak_end") == 0) rules->peak_end = number;
+        else if (strcmp(key, "weekend_percent") == 0) rules->weekend_percent = number;
+        else ok = false;
+
+    }
+
+    fclose(file);
+
+    if (ok) 
+    {
+        for (int m = 0; m < TARIFF_MEMBERSHIPS; m++) 
+        {
+            ok = ok && rules->discount_percent[m] >= 0 && rules->discount_percent[m] <= 100;
+        }
+        ok = ok && rules->base_minutes >= 0 && rules->round_up_after >= 0 && rules->round_up_after < 60
+                && rules->peak_percent >= 0 && rules->weekend_percent >= 0
+                && rules->peak_start >= 0 && rules->peak_end <= 24 && rules->peak_start <= rules->peak_end;
+    }
+
+    if (!ok) 
+    {
+        fprintf(stderr, "Invalid tariff config %s near line %d.\n", filename, line_num);
+    }
+
+    return ok;
+}
+
+// Compile the config at filename, or the defaults if there is none. A bad config keeps the defaults.
+bool Tariff_Load(Tariff* tariff, const char* filename) 
+{
+    TariffRules rules;
+    bool found = false;
+    bool ok = Tariff_ReadConfig(filename, &rules, &found);
+
+    if (!ok) Tariff_DefaultRules(&rules);
+
+    Tariff_Compile(tariff, &rules);
+
+    if (ok && found) printf("Tariff loaded from %s.\n", filename);
+
+    return ok;
+}
+
+static pthread_once_t tariff_default_once = PTHREAD_ONCE_INIT;
+
+void compileDefaultTariff(void) 
+{
+    TariffRules rules;
+    Tariff_DefaultRules(&rules);
+    Tariff_Compile(&g_tariff, &rules);
+}
+
+// The active tariff, falling back to the defaults if none was loaded
+const Tariff* Tariff_Current(void) 
+{
+    if (!g_tariff.ready) pthread_once(&tariff_default_once, compileDefaultTariff);
+
+    return &g_tariff;
+}
+
+// Schedule of a stay from its arrival (minutes since 1970)
+int Tariff_Schedule(const Tariff* tariff, int64_t arrival) 
+{
+    int64_t days = (arrival >= 0 ? arrival : arrival - 1439) / 1440;
+    int hour = (int)((arrival - days * 1440) / 60);
+    int weekday = (int)(((days + 4) % 7 + 7) % 7); // 1970-01-01 was a Thursday; 0 = Sunday
+
+    bool peak = hour >= tariff->rules.peak_start && hour < tariff->rules.peak_end;
+    bool weekend = (weekday == 0 || weekday == 6);
+
+    return (weekend ? 2 : 0) | (peak ? 1 : 0);
+}
+
+int64_t Tariff_Price(const Tariff* tariff, int schedule, int membership, int64_t minutes) 
+{
+    if (membership < 0 || membership >= TARIFF_MEMBERSHIPS) membership = 0;
+
+    if (minutes >= 0 && minutes < TARIFF_TABLE_MINUTES) 
+    {
+        return tariff->fees[schedule][membership][minutes];
+    }
+
+    return tariffEvaluate(&tariff->rules, schedule, membership, minutes);
+}
+
+// Price count stays at once: fees[i] for minutes[i] at membership tiers[i] (0-2) under
+// schedules[i] (NULL for all weekday off-peak). The main loop is a branch-free table
+// gather the compiler can vectorize; stays beyond the table are fixed up afterwards.
+void Tariff_PriceBatch(const Tariff* tariff, const int32_t* restrict minutes, const uint8_t* restrict tiers, const uint8_t* restrict schedules, int32_t* restrict fees, int count) 
+{
+    const int32_t* restrict table = &tariff->fees[0][0][0];
+    int32_t longest = 0;
+
+    for (int i = 0; i < count; i++) 
+    {
+        int32_t m = minutes[i];
+        int32_t clamped = m < 0 ? 0 : (m >= TARIFF_TABLE_MINUTES ? TARIFF_TABLE_MINUTES - 1 : m);
+        int32_t tier = tiers[i] < TARIFF_MEMBERSHIPS ? tiers[i] : 0;
+        int32_t schedule = schedules ? (schedules[i] & (TARIFF_SCHEDULES - 1)) : 0;
+
+        fees[i] = table[(schedule * TARIFF_MEMBERSHIPS + tier) * TARIFF_TABLE_MINUTES + clamped];
+        longest = m > longest ? m : longest;
+    }
+
+    if (longest < TARIFF_TABLE_MINUTES) return;
+
+    for (int i = 0; i < count; i++) 
+    {
+        if (minutes[i] >= TARIFF_TABLE_MINUTES) 
+        {
+            fees[i] = (int32_t)Tariff_Price(tariff, schedules ? (schedules[i] & (TARIFF_SCHEDULES - 1)) : 0, tiers[i], minutes[i]);
+        }
+    }
+}
+
+// Bill the stay that just ended from the active tariff
+void Payment(Parking* parking, User* user) 
+{
+    const Tariff* tariff = Tariff_Current();
+    int64_t arrival = parseTimestamp(user->arrival_date, user->arrival_time);
+    int64_t departure = parseTimestamp(user->departure_date, user->departure_time);
+
+    // Whole minutes from the timestamps themselves, so no float rounding decides a fare
+    int64_t minutes = (arrival >= 0 && departure >= 0) ? departure - arrival : llroundf(user->spent_time * 60.0f);
+    int schedule = (arrival >= 0) ? Tariff_Schedule(tariff, arrival) : 0;
+
+    float parking_amt = Tariff_Price(tariff, schedule, user->membership, minutes) / 100.0f;
+
+    user->parking_amt = parking_amt;
+    user->total_parking_amt += parking_amt;
+    parking->revenue += parking_amt;
+}
+
+// Exit for a vehicle whose user record has already been looked up. *userRef is NULL if
+// the plate is unknown; if it is a misreading of exactly one vehicle parked at this lot,
+// that vehicle exits and *userRef is set to it.
+gate_status Gate_Exit(GenericBPlusTreeNode** parkingRootRef, User** userRef, const char* vehicle_num, const char* departure_date, const char* departure_time, int* parking_id)
+{
+    METRIC_SCOPE(METRIC_EXIT_VEHICLE);
+
+    User* userFound = *userRef;
+
+    // Only a vehicle parked at this lot can be the one leaving through its gate
+    if (!userFound && (userFound = (User*)PlateIndex_Misread(&g_plateIndex, vehicle_num, misreadCanExit, NULL)) != NULL) 
+    {
+        printf("Plate %s read as known vehicle %s.\n", vehicle_num, userFound->vehicle_num);
+        vehicle_num = userFound->vehicle_num;
+        *userRef = userFound;
+    }
+
+    if (!userFound) 
+    {
+        const User* similar = PlateIndex_Misread(&g_plateIndex, vehicle_num, NULL, NULL);
+
+        printf("Error: Vehicle %s not found in database.\n", vehicle_num);
+        if (similar) printf("Did you mean: %s\n", similar->vehicle_num);
+
+        return GATE_NOT_FOUND;
+    }
+
+    if (userFound->status == NOTPARKED || userFound->lot_id != Facility_Current()->id) 
+    {
+        printf("Error: Vehicle %s is not currently parked.\n", vehicle_num);
+        return GATE_NOT_PARKED;
+    }
+
+    // Vehicle found and is parked
+    int parkingId = userFound->parking_space_id;
+    Parking* parkingFound = SearchParking_BPlus(*parkingRootRef, parkingId);
+    int64_t departure = parseTimestamp(departure_date, departure_time);
+
+    // Never bill or free a slot the vehicle is not actually in
+    if (!parkingFound || Slot_Occupant(parkingFound) != userFound) 
+    {
+        printf("Error: Vehicle %s is not in its recorded slot %d.\n", vehicle_num, parkingId);
+        return GATE_FAILED;
+    }
+
+    // Update User Record
     strcpy(userFound->departure_date, departure_date);
     strcpy(userFound->departure_time, departure_time);
     userFound->status = NOTPARKED;
 
-    Time_spent(userFound);
-    Membership(userFound);
+    Time_spent(userFound);
+    Membership(userFound);
+
+    Payment(parkingFound, userFound);
+    Parked_Unlink(Facility_Current()->parked, parkingFound, userFound, departure);
+    Release_Slot(parkingFound);
+
+    Session_RecordExit(&g_sessionStore, userFound, parkingId);
+    Occupancy_Record(Facility_Current()->occupancy, parkingId, -1, departure);
+
+    userFound->parking_space_id = -1;
+
+    printf("Vehicle %s has exited Parking Slot %d.\n", vehicle_num, parkingId);
+
+    *parking_id = parkingId;
+    return GATE_OK;
+}
+
+bool Exit_Vehicle_BPlus(GenericBPlusTreeNode** parkingRootRef, GenericBPlusTreeNode** userRootRef, const char* vehicle_num, const char* departure_date, const char* departure_time)
+{
+    User* userFound = SearchUser_BPlus(*userRootRef, vehicle_num);
+    int parkingId = -1;
+
+    return Gate_Exit(parkingRootRef, &userFound, vehicle_num, departure_date, departure_time, &parkingId) == GATE_OK;
+}
+
+
+// Shift Settlement
+// Prices every vehicle parked in the current facility as if it left at a cutoff, without
+// touching the records. The parked list's arrival heap is copied into columns under its
+// lock (arrivals there are already minutes, so nothing is parsed), then worker threads
+// each take a share of rows: stay minutes, the membership the stay would earn, the
+// schedule, and one Tariff_PriceBatch call per share, the same fare Gate_Exit would bill.
+#define SETTLEMENT_REPORT_FILE "sample_settlement.csv"
+#define SETTLEMENT_MAX_THREADS 8
+#define SETTLEMENT_MIN_ROWS 4096 // Rows per thread below which more threads don't pay off
+
+typedef struct Settlement 
+{
+    int64_t cutoff;
+    long count;          // Vehicles priced
+    long arrived_later;  // Parked vehicles that arrived after the cutoff, left out
+    int32_t* parking_ids;
+    char (*plates)[20];
+    int64_t* arrivals;
+    float* total_hours;  // Hours on record before this stay
+    int32_t* minutes;
+    uint8_t* tiers;
+    uint8_t* schedules;
+    int32_t* fees;       // Paise
+    int64_t tier_paise[TARIFF_MEMBERSHIPS];
+    long tier_count[TARIFF_MEMBERSHIPS];
+    int64_t total_paise;
+
+} Settlement;
+
+typedef struct SettlementShare 
+{
+    Settlement* settlement;
+    const Tariff* tariff;
+    long first;
+    long count;
+    int64_t tier_paise[TARIFF_MEMBERSHIPS];
+    long tier_count[TARIFF_MEMBERSHIPS];
+
+} SettlementShare;
+
+void Settlement_Free(Settlement* settlement) 
+{
+    trackedFree(settlement->parking_ids);
+    trackedFree(settlement->plates);
+    trackedFree(settlement->arrivals);
+    trackedFree(settlement->total_hours);
+    trackedFree(settlement->minutes);
+    trackedFree(settlement->tiers);
+    trackedFree(settlement->schedules);
+    trackedFree(settlement->fees);
+    memset(settlement, 0, sizeof(*settlement));
+}
+
+void* settlementWorker(void* arg) 
+{
+    SettlementShare* share = (SettlementShare*)arg;
+    Settlement* settlement = share->settlement;
+    long end = share->first + share->count;
+
+    for (long i = share->first; i < end; i++) 
+    {
+        int64_t minutes = settlement->cutoff - settlement->arrivals[i];
+
+        settlement->minutes[i] = minutes < INT32_MAX ? (int32_t)minutes : INT32_MAX;
+        settlement->tiers[i] = (uint8_t)membershipForHours(settlement->total_hours[i] + minutes / 60.0f);
+        settlement->schedules[i] = (uint8_t)Tariff_Schedule(share->tariff, settlement->arrivals[i]);
+    }
+
+    Tariff_PriceBatch(share->tariff, settlement->minutes + share->first, settlement->tiers + share->first, settlement->schedules + share->first, settlement->fees + share->first, (int)share->count);
+
+    for (long i = share->first; i < end; i++) 
+    {
+        share->tier_paise[settlement->tiers[i]] += settlement->fees[i];
+        share->tier_count[settlement->tiers[i]]++;
+    }
+
+    return NULL;
+}
+
+// Price every vehicle on list as of minute cutoff into settlement, on up to threads
+// workers (0 picks by size). The caller keeps the users from changing meanwhile.
+bool Settlement_Run(ParkedList* list, int64_t cutoff, int threads, Settlement* settlement) 
+{
+    memset(settlement, 0, sizeof(*settlement));
+    settlement->cutoff = cutoff;
+
+    pthread_mutex_lock(&list->lock);
+
+    const ArrivalHeap* heap = &list->by_arrival;
+    long rows = heap->count;
+    bool ok = true;
+
+    if (rows > 0) 
+    {
+        settlement->parking_ids = (int32_t*)trackedMalloc(sizeof(int32_t) * rows, MEM_SCRATCH);
+        settlement->plates = (char (*)[20])trackedMalloc(sizeof(*settlement->plates) * rows, MEM_SCRATCH);
+        settlement->arrivals = (int64_t*)trackedMalloc(sizeof(int64_t) * rows, MEM_SCRATCH);
+        settlement->total_hours = (float*)trackedMalloc(sizeof(float) * rows, MEM_SCRATCH);
+        settlement->minutes = (int32_t*)trackedMalloc(sizeof(int32_t) * rows, MEM_SCRATCH);
+        settlement->tiers = (uint8_t*)trackedMalloc(rows, MEM_SCRATCH);
+        settlement->schedules = (uint8_t*)trackedMalloc(rows, MEM_SCRATCH);
+        settlement->fees = (int32_t*)trackedMalloc(sizeof(int32_t) * rows, MEM_SCRATCH);
+
+        ok = settlement->parking_ids && settlement->plates && settlement->arrivals && settlement->total_hours && settlement->minutes && settlement->tiers && settlement->schedules && settlement->fees;
+    }
+
+    for (long i = 0; ok && i < rows; i++) 
+    {
+        const ParkedEntry* entry = &heap->entries[i];
+
+        if (entry->arrival > cutoff) 
+        {
+            settlement->arrived_later++;
+            continue;
+        }
+
+        long row = settlement->count++;
+        settlement->parking_ids[row] = entry->user->parking_space_id;
+        memcpy(settlement->plates[row], entry->user->vehicle_num, sizeof(settlement->plates[row]));
+        settlement->arrivals[row] = entry->arrival;
+        settlement->total_hours[row] = entry->user->total_spent_time;
+    }
+
+    pthread_mutex_unlock(&list->lock);
+
+    if (!ok) 
+    {
+        perror("Failed to allocate settlement batch");
+        Settlement_Free(settlement);
+        return false;
+    }
+
+    if (settlement->count == 0) return true;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) 
+    {
+        long wanted = (settlement->count + SETTLEMENT_MIN_ROWS - 1) / SETTLEMENT_MIN_ROWS;
+        threads = (int)(wanted < cpus ? wanted : cpus);
+    }
+    if (threads > SETTLEMENT_MAX_THREADS) threads = SETTLEMENT_MAX_THREADS;
+    if (threads > settlement->count) threads = (int)settlement->count;
+    if (threads < 1) threads = 1;
+
+    SettlementShare shares[SETTLEMENT_MAX_THREADS];
+    pthread_t workers[SETTLEMENT_MAX_THREADS];
+    bool started[SETTLEMENT_MAX_THREADS];
+    const Tariff* tariff = Tariff_Current();
+    long per_share = (settlement->count + threads - 1) / threads;
+
+    for (int t = 0; t < threads; t++) 
+    {
+        long first = t * per_share;
+        long count = settlement->count - first;
+        if (count > per_share) count = per_share;
+        if (count < 0) count = 0;
+
+        shares[t] = (SettlementShare){ settlement, tariff, first, count, {0}, {0} };
+
+        // The calling thread takes the last share itself, and any a thread can't be started for
+        started[t] = (t < threads - 1) && pthread_create(&workers[t], NULL, settlementWorker, &shares[t]) == 0;
+        if (!started[t]) settlementWorker(&shares[t]);
+    }
+
+    for (int t = 0; t < threads; t++) 
+    {
+        if (started[t]) pthread_join(workers[t], NULL);
+
+        for (int tier = 0; tier < TARIFF_MEMBERSHIPS; tier++) 
+        {
+            settlement->tier_paise[tier] += shares[t].tier_paise[tier];
+            settlement->tier_count[tier] += shares[t].tier_count[tier];
+            settlement->total_paise += shares[t].tier_paise[tier];
+        }
+    }
+
+    return true;
+}
+
+// Report CSV, one row per vehicle in slot order, then the totals on stdout
+bool Settlement_Write(const Settlement* settlement, const char* filename) 
+{
+    FILE* file = fopen(filename, "w");
+
+    if (!file) 
+    {
+        perror("Unable to open settlement report");
+        return false;
+    }
+
+    // Each slot holds at most one vehicle, so rows are placed by slot id rather than sorted
+    int32_t max_id = 0;
+    for (long i = 0; i < settlement->count; i++) 
+    {
+        if (settlement->parking_ids[i] > max_id) max_id = settlement->parking_ids[i];
+    }
+
+    long* by_slot = (long*)trackedMalloc(sizeof(long) * (max_id + 1), MEM_SCRATCH);
+    if (!by_slot) 
+    {
+        perror("Failed to allocate settlement order");
+        fclose(file);
+        return false;
+    }
+
+    for (int32_t id = 0; id <= max_id; id++) by_slot[id] = -1;
+    for (long i = 0; i < settlement->count; i++) 
+    {
+        if (settlement->parking_ids[i] >= 0) by_slot[settlement->parking_ids[i]] = i;
+    }
+
+    char arrival[24];
+    fprintf(file, "Parking_ID,Vehicle_Number,Arrival,Minutes,Membership,Amount\n");
+
+    for (int32_t id = 0; id <= max_id; id++) 
+    {
+        long i = by_slot[id];
+        if (i < 0) continue;
+
+        formatTimestamp(settlement->arrivals[i], arrival, sizeof(arrival));
+        fprintf(file, "%d,%s,%s,%d,%d,%.2f\n", settlement->parking_ids[i], settlement->plates[i], arrival, settlement->minutes[i], settlement->tiers[i], settlement->fees[i] / 100.0);
+    }
+
+    trackedFree(by_slot);
+    fclose(file);
+
+    char cutoff[24];
+    formatTimestamp(settlement->cutoff, cutoff, sizeof(cutoff));
+    printf("Settlement at %s: %ld vehicle(s), %.2f due", cutoff, settlement->count, settlement->total_paise / 100.0);
+    for (int tier = 0; tier < TARIFF_MEMBERSHIPS; tier++) 
+    {
+        printf("%s%s %ld / %.2f", tier ? ", " : " (", lot_tier_keys[tier], settlement->tier_count[tier], settlement->tier_paise[tier] / 100.0);
+    }
+    printf(")\n");
+    if (settlement->arrived_later > 0) printf("%ld vehicle(s) arrived after the cutoff and are not included.\n", settlement->arrived_later);
+    printf("Report written to %s.\n", filename);
+
+    return true;
+}
+
+// Batched Gate Events
+// Camera gateways deliver plates in bursts. A batch is resolved in two passes: first
+// every plate is looked up in key order with one merged walk over the leaf chain, then
+// the events are applied in arrival order against the resolved records, so slot
+// assignment and billing come out exactly as if the events ran one by one. The user
+// tree is a latched concurrent tree other gates write to at the same time, so the walk
+// is optimistic: every leaf it reads or hops across is validated against its version,
+// and it descends afresh from the root when a validation fails or the chain gets long.
+// Each event is then applied under its plate's striped lock, and a plate pass 1 did not
+// find is looked up again under the lock in case another gate registered it meanwhile.
+#define BATCH_MAX_LEAF_HOPS 8 // Beyond this, a fresh descent is cheaper than walking the chain
+#define GATE_PLATE_LOCKS 256
+
+typedef enum { GATE_ENTRY, GATE_EXIT } gate_event_type;
+
+typedef struct GateEvent 
+{
+    gate_event_type type;
+    char vehicle_num[20];
+    char owner_name[50];     // Entry only
+    char date[11];           // Arrival or departure date
+    char time[6];            // Arrival or departure time
+    int entrance;            // Entry only, 0 unless given
+    uint32_t required_attrs; // Entry only, slot features asked for
+    gate_status result;      // Filled in by Process_Gate_Batch
+    int parking_id;          // Slot assigned on entry or vacated on exit
+    float amount;            // Fee charged on exit
+
+} GateEvent;
+
+// Build an event from protocol arguments: plate owner date time [entrance [features]] (entry)
+// or plate date time (exit). False if the feature list names an unknown feature.
+bool fillGateEvent(GateEvent* event, bool is_enter, char** args) 
+{
+    memset(event, 0, sizeof(*event));
+    event->type = is_enter ? GATE_ENTRY : GATE_EXIT;
+    snprintf(event->vehicle_num, sizeof(event->vehicle_num), "%s", args[0]);
+    snprintf(event->owner_name, sizeof(event->owner_name), "%s", is_enter ? args[1] : "");
+    snprintf(event->date, sizeof(event->date), "%s", args[is_enter ? 2 : 1]);
+    snprintf(event->time, sizeof(event->time), "%s", args[is_enter ? 3 : 2]);
+    event->entrance = (is_enter && args[4]) ? atoi(args[4]) : 0;
+
+    return !(is_enter && args[4] && args[5]) || parseSlotAttributes(args[5], &event->required_attrs);
+}
+
+// Parse an "ENTER ..." or "EXIT ..." line; false for anything else or a malformed line
+bool parseGateEventLine(char* line, GateEvent* event) 
+{
+    char* save = NULL;
+    char* command = strtok_r(line, " \t\r\n", &save);
+    if (!command) return false;
+
+    char* args[6] = { NULL };
+    int argc = 0;
+    while (argc < 6 && (args[argc] = strtok_r(NULL, " \t\r\n", &save)) != NULL) argc++;
+
+    if (strcmp(command, "ENTER") == 0 && argc >= 4) 
+    {
+        return fillGateEvent(event, true, args);
+    }
+
+    if (strcmp(command, "EXIT") == 0 && argc == 3) 
+    {
+        return fillGateEvent(event, false, args);
+    }
+
+    return false;
+}
+
+// Lock for a plate among GATE_PLATE_LOCKS; folded, so a misread plate takes the same lock
+// as the vehicle it gets corrected to
+pthread_mutex_t* gatePlateLock(pthread_mutex_t* plate_locks, const char* vehicle_num) 
+{
+    return &plate_locks[hashFoldedPlate(vehicle_num) % GATE_PLATE_LOCKS];
+}
+
+// Order by plate, then by arrival (events sit in one array, so address order is arrival order)
+int compareGateEventsByPlate(const void* a, const void* b) 
+{
+    const GateEvent* eventA = *(const GateEvent* const*)a;
+    const GateEvent* eventB = *(const GateEvent* const*)b;
+
+    int cmp = strcmp(eventA->vehicle_num, eventB->vehicle_num);
+    if (cmp != 0) return cmp;
+
+    return (eventA < eventB) ? -1 : (eventA > eventB);
+}
+
+// Pass 1 lookup: find key from *leafRef, the leaf (read at *versionRef) a smaller plate
+// was found in, hopping right while key reaches into the next leaf. NULL *leafRef, a leaf
+// that changed since it was read, or too many hops start over with a descent from the root.
+// On return *leafRef and *versionRef hold the leaf key belongs in, for the next plate.
+User* batchWalkToUser(ConcurrentBPlusTree* users, const char* key, GenericBPlusTreeNode** leafRef, uint64_t* versionRef) 
+{
+    GenericBPlusTreeNode* leaf = *leafRef;
+    uint64_t version = *versionRef;
+    int hops = 0;
+
+    while (true) 
+    {
+        if (leaf == NULL || hops > BATCH_MAX_LEAF_HOPS) 
+        {
+            leaf = findLeaf_OLC(users, key, compareUserVehicleNumInternal, &version);
+            hops = 0;
+
+            if (!leaf) 
+            {
+                *leafRef = NULL;
+                return NULL;
+            }
+        }
+
+        // Records are never removed while the tree is shared, so the next leaf's first
+        // record is its lower bound for as long as this leaf is unchanged
+        GenericBPlusTreeNode* next = __atomic_load_n(&leaf->next_leaf, __ATOMIC_ACQUIRE);
+        if (next) 
+        {
+            uint64_t next_version;
+            void* first = NULL;
+            bool readable = versionReadLock(&next->version, &next_version)
+                && __atomic_load_n(&next->num_keys, __ATOMIC_RELAXED) > 0
+                && (first = __atomic_load_n(&next->keys[0], __ATOMIC_RELAXED)) != NULL;
+            bool beyond = readable && compareUserVehicleNum(key, first) >= 0;
+
+            if (!readable || !versionValidate(&next->version, next_version) || !versionValidate(&leaf->version, version)) 
+            {
+                leaf = NULL;
+                continue;
+            }
+
+            if (beyond) 
+            {
+                leaf = next;
+                version = next_version;
+                hops++;
+                continue;
+            }
+        }
+
+        User* found = NULL;
+        bool torn = false;
+        int num_keys = __atomic_load_n(&leaf->num_keys, __ATOMIC_RELAXED);
+
+        for (int k = 0; k < num_keys && k < MAXKEYS; k++) 
+        {
+            void* data = __atomic_load_n(&leaf->keys[k], __ATOMIC_RELAXED);
+            if (data == NULL) 
+            {
+                torn = true;
+                break;
+            }
+
+            if (compareUserVehicleNum(key, data) == 0) 
+            {
+                found = (User*)data;
+                break;
+            }
+        }
+
+        if (!torn && num_keys <= MAXKEYS && versionValidate(&leaf->version, version)) 
+        {
+            *leafRef = leaf;
+            *versionRef = version;
+            return found;
+        }
+
+        leaf = NULL;
+    }
+}
+
+// Process count events against users, with plate_locks (GATE_PLATE_LOCKS of them) shared
+// by every gate writing to it. Each event's result and parking_id are filled in.
+// Returns the number of events that succeeded.
+int Process_Gate_Batch(GenericBPlusTreeNode** parkingRootRef, ConcurrentBPlusTree* users, pthread_mutex_t* plate_locks, UserPool* pool, GateEvent* events, int count) 
+{
+    METRIC_SCOPE(METRIC_GATE_BATCH);
+
+    if (count <= 0) return 0;
+
+    // One allocation for all per-batch scratch: sorted view, plate group per event, record per group
+    size_t scratch_size = count * (sizeof(GateEvent*) + sizeof(int) + sizeof(User*));
+    char* scratch = (char*)trackedMalloc(scratch_size, MEM_SCRATCH);
+
+    if (!scratch) 
+    {
+        perror("Failed to allocate gate batch");
+        for (int i = 0; i < count; i++) events[i].result = GATE_FAILED;
+        return 0;
+    }
+
+    GateEvent** sorted = (GateEvent**)scratch;
+    User** groupUser = (User**)(scratch + count * sizeof(GateEvent*));
+    int* group = (int*)(scratch + count * (sizeof(GateEvent*) + sizeof(User*)));
+
+    for (int i = 0; i < count; i++) 
+    {
+        sorted[i] = &events[i];
+    }
+
+    qsort(sorted, count, sizeof(GateEvent*), compareGateEventsByPlate);
+
+    // Pass 1: merged walk. Keys only grow, so the leaf for the next plate is this one or further right.
+    GenericBPlusTreeNode* leaf = NULL;
+    uint64_t leaf_version = 0;
+    int num_groups = 0;
+
+    for (int i = 0; i < count; i++) 
+    {
+        const char* key = sorted[i]->vehicle_num;
+
+        if (i > 0 && strcmp(key, sorted[i - 1]->vehicle_num) == 0) 
+        {
+            group[sorted[i] - events] = num_groups - 1;
+            continue;
+        }
+
+        groupUser[num_groups] = batchWalkToUser(users, key, &leaf, &leaf_version);
+        group[sorted[i] - events] = num_groups;
+        num_groups++;
+    }
+
+    // Pass 2: apply in arrival order; a plate's first entry creates the record its later events reuse
+    int succeeded = 0;
+
+    for (int i = 0; i < count; i++) 
+    {
+        GateEvent* event = &events[i];
+        User** userRef = &groupUser[group[i]];
+        event->parking_id = -1;
+        event->amount = 0;
+
+        pthread_mutex_t* plate_lock = gatePlateLock(plate_locks, event->vehicle_num);
+        pthread_mutex_lock(plate_lock);
+
+        if (*userRef == NULL) 
+        {
+            *userRef = (User*)Search_BPlus_OLC(users, event->vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal);
+        }
+
+        if (event->type == GATE_ENTRY) 
+        {
+            event->result = Gate_Enter(parkingRootRef, NULL, users, pool, userRef, event->vehicle_num, event->owner_name, event->date, event->time, event->entrance, event->required_attrs, &event->parking_id);
+        }
+        else 
+        {
+            event->result = Gate_Exit(parkingRootRef, userRef, event->vehicle_num, event->date, event->time, &event->parking_id);
+            event->amount = (event->result == GATE_OK) ? (*userRef)->parking_amt : 0;
+        }
+
+        pthread_mutex_unlock(plate_lock);
+
+        if (event->result == GATE_OK) succeeded++;
+    }
+
+    trackedFree(scratch);
+
+    return succeeded;
+}
+
+void PrintOneEntry_BPlus(GenericBPlusTreeNode* userRoot, const char* vehicle_num) 
+{
+    User* userFound = SearchUser_BPlus(userRoot, vehicle_num);
+
+    if(userFound) 
+    {
+        printf("\n--- Details for Vehicle: %s ---\n", userFound->vehicle_num);
+        printf("Owner name: %s\n", userFound->owner_name);
+        printf("Membership: %d (%s)\n", userFound->membership, userFound->membership == 2 ? "Gold" : (userFound->membership == 1 ? "Premium" : "Standard"));
+        printf("Status: %s\n", userFound->status == PARKED ? "Parked" : "Not Parked");
+
+        if(userFound->status == PARKED)
+        {
+            printf("Current Parking space id: %d\n", userFound->parking_space_id);
+            printf("Current Arrival Date: %s\n", userFound->arrival_date);
+            printf("Current Arrival time: %s\n", userFound->arrival_time);
+            printf("Current Time Spent (so far): Calculation requires exit.\n");
+            printf("Current Parking amount due: Calculation requires exit.\n");
+        }
+        else 
+        {
+            printf("Last Arrival Date: %s\n", userFound->arrival_date);
+            printf("Last Arrival time: %s\n", userFound->arrival_time);
+            printf("Last Departure Date: %s\n", userFound->departure_date);
+            printf("Last Departure time: %s\n", userFound->departure_time);
+            printf("Last Time Spent: %.2f hours\n", userFound->spent_time);
+            printf("Last Parking amount paid: %.2f\n", userFound->parking_amt);
+        }
+
+        printf("Total Time Spent: %.2f hours\n", userFound->total_spent_time);
+        printf("Total Parking amount paid: %.2f\n", userFound->total_parking_amt);
+        printf("Number of parkings done: %d\n", userFound->number_of_parkings);
+        printf("---------------------------------\n");
+
+    } 
+    else 
+    {
+        printf("User with vehicle number '%s' does not exist in Database!\n", vehicle_num);
+
+        PlateMatch matches[PLATE_SUGGESTIONS];
+        int found = PlateIndex_Similar(&g_plateIndex, userRoot, vehicle_num, 2, matches, PLATE_SUGGESTIONS);
+
+        for (int i = 0; i < found && i < PLATE_SUGGESTIONS; i++) 
+        {
+            printf("%s %s (%d edit%s away)\n", i == 0 ? "Did you mean:" : "              ", matches[i].vehicle_num, matches[i].distance, matches[i].distance == 1 ? "" : "s");
+        }
+    }
+}
+
+
+// Buffered Exporter
+// Saves are dominated by fprintf's locale-aware float formatting, so records are
+// formatted by hand (integers and 2-decimal fixed point) into large chunk buffers.
+// Worker threads claim chunks of records off a shared cursor and format them in
+// parallel; the calling thread writes finished chunks in order with writev. A
+// bounded window of chunk buffers keeps memory flat however big the tree is.
+#define EXPORT_CHUNK_RECORDS 2048
+#define EXPORT_MAX_THREADS 8
+#define EXPORT_WINDOW_PER_THREAD 2
+#define EXPORT_MAX_WINDOW (EXPORT_MAX_THREADS * EXPORT_WINDOW_PER_THREAD)
+#define EXPORT_USER_RECORD_MAX 1024   // Worst case JSON with every string byte escaped
+#define EXPORT_PARKING_RECORD_MAX 256
+
+typedef enum { EXPORT_CSV, EXPORT_JSONL } export_format;
+
+// Format one record into out (at least the format's record maximum); returns its length
+typedef size_t (*ExportFormatFunc)(const void* record, char* out, export_format format);
+
+static char* formatUInt(char* out, uint64_t value) 
+{
+    char digits[20];
+    int n = 0;
+
+    do 
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    while (n) *out++ = digits[--n];
+
+    return out;
+}
+
+static char* formatInt(char* out, int value) 
+{
+    if (value < 0) 
+    {
+        *out++ = '-';
+        return formatUInt(out, (uint64_t)(-(int64_t)value));
+    }
+
+    return formatUInt(out, (uint64_t)value);
+}
+
+// Same text as printf("%.2f"): a float times 100 is exact in a double, and rint
+// breaks exact ties to even just like glibc does
+static char* formatFixed2(char* out, float value) 
+{
+    double scaled = (double)value * 100.0;
+
+    if (!isfinite(scaled) || fabs(scaled) >= 9e15) 
+    {
+        return out + sprintf(out, "%.2f", value);
+    }
+
+    int64_t cents = (int64_t)rint(scaled);
+
+    if (cents < 0 || (cents == 0 && signbit(value))) *out++ = '-';
+    if (cents < 0) cents = -cents;
+
+    out = formatUInt(out, (uint64_t)cents / 100);
+    *out++ = '.';
+    *out++ = (char)('0' + cents / 10 % 10);
+    *out++ = (char)('0' + cents % 10);
+
+    return out;
+}
+
+static char* formatRaw(char* out, const char* text) 
+{
+    while (*text) *out++ = *text++;
+
+    return out;
+}
+
+// Quoted JSON string with quotes, backslashes and control bytes escaped
+static char* formatJsonString(char* out, const char* text) 
+{
+    static const char hex[] = "0123456789abcdef";
+
+    *out++ = '"';
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) 
+    {
+        if (*c == '"' || *c == '\\') 
+        {
+            *out++ = '\\';
+            *out++ = (char)*c;
+        }
+        else if (*c < 0x20) 
+        {
+            out = formatRaw(out, "\\u00");
+            *out++ = hex[*c >> 4];
+            *out++ = hex[*c & 0xF];
+        }
+        else 
+        {
+            *out++ = (char)*c;
+        }
+    }
+    *out++ = '"';
+
+    return out;
+}
+
+// Same row layout as printUserInFile, or one JSON object per line
+size_t formatUserRecord(const void* record, char* out, export_format format) 
+{
+    const User* user = (const User*)record;
+    char* p = out;
+
+    if (format == EXPORT_CSV) 
+    {
+        *p++ = '\n';
+        p = formatRaw(p, user->vehicle_num);   *p++ = ',';
+        p = formatRaw(p, user->owner_name);    *p++ = ',';
+        p = formatRaw(p, user->arrival_date);  *p++ = ',';
+        p = formatRaw(p, user->arrival_time);  *p++ = ',';
+        p = formatRaw(p, user->departure_date); *p++ = ',';
+        p = formatRaw(p, user->departure_time); *p++ = ',';
+        p = formatInt(p, user->parking_space_id);   *p++ = ',';
+        p = formatInt(p, user->number_of_parkings); *p++ = ',';
+        p = formatInt(p, user->membership);         *p++ = ',';
+        p = formatFixed2(p, user->spent_time);        *p++ = ',';
+        p = formatFixed2(p, user->total_spent_time);  *p++ = ',';
+        p = formatFixed2(p, user->parking_amt);       *p++ = ',';
+        p = formatFixed2(p, user->total_parking_amt); *p++ = ',';
+        p = formatInt(p, (int)user->status);        *p++ = ',';
+        p = formatInt(p, user->lot_id);
+    }
+    else 
+    {
+        p = formatRaw(p, "{\"vehicle_num\":");         p = formatJsonString(p, user->vehicle_num);
+        p = formatRaw(p, ",\"owner_name\":");          p = formatJsonString(p, user->owner_name);
+        p = formatRaw(p, ",\"arrival_date\":");        p = formatJsonString(p, user->arrival_date);
+        p = formatRaw(p, ",\"arrival_time\":");        p = formatJsonString(p, user->arrival_time);
+        p = formatRaw(p, ",\"departure_date\":");      p = formatJsonString(p, user->departure_date);
+        p = formatRaw(p, ",\"departure_time\":");      p = formatJsonString(p, user->departure_time);
+        p = formatRaw(p, ",\"parking_space_id\":");    p = formatInt(p, user->parking_space_id);
+        p = formatRaw(p, ",\"number_of_parkings\":");  p = formatInt(p, user->number_of_parkings);
+        p = formatRaw(p, ",\"membership\":");          p = formatInt(p, user->membership);
+        p = formatRaw(p, ",\"spent_time\":");          p = formatFixed2(p, user->spent_time);
+        p = formatRaw(p, ",\"total_spent_time\":");    p = formatFixed2(p, user->total_spent_time);
+        p = formatRaw(p, ",\"parking_amt\":");         p = formatFixed2(p, user->parking_amt);
+        p = formatRaw(p, ",\"total_parking_amt\":");   p = formatFixed2(p, user->total_parking_amt);
+        p = formatRaw(p, ",\"status\":");              p = formatInt(p, (int)user->status);
+        p = formatRaw(p, ",\"lot_id\":");              p = formatInt(p, user->lot_id);
+        p = formatRaw(p, "}\n");
+    }
+
+    return (size_t)(p - out);
+}
+
+// Same row layout as printParkingInFile, or one JSON object per line
+size_t formatParkingRecord(const void* record, char* out, export_format format) 
+{
+    const Parking* slot = (const Parking*)record;
+    char* p = out;
+
+    if (format == EXPORT_CSV) 
+    {
+        *p++ = '\n';
+        p = formatInt(p, slot->parking_id);           *p++ = ',';
+        p = formatInt(p, slot->parking_space_status); *p++ = ',';
+        p = formatFixed2(p, slot->revenue);           *p++ = ',';
+        p = formatInt(p, slot->occupancies);
+    }
+    else 
+    {
+        p = formatRaw(p, "{\"parking_id\":");   p = formatInt(p, slot->parking_id);
+        p = formatRaw(p, ",\"status\":");       p = formatInt(p, slot->parking_space_status);
+        p = formatRaw(p, ",\"revenue\":");      p = formatFixed2(p, slot->revenue);
+        p = formatRaw(p, ",\"occupancies\":");  p = formatInt(p, slot->occupancies);
+        p = formatRaw(p, "}\n");
+    }
+
+    return (size_t)(p - out);
+}
+
+typedef struct ExportChunk 
+{
+    void* records[EXPORT_CHUNK_RECORDS];
+    char* buffer;
+    size_t length;
+    bool ready;
+
+} ExportChunk;
+
+typedef struct ExportJob 
+{
+    BPlusCursor cursor;
+    export_format format;
+    ExportFormatFunc formatRecord;
+
+    ExportChunk* chunks; // Ring of window buffers, chunk c lives in chunks[c % window]
+    int window;
+    long next_chunk;     // Next chunk to claim
+    long written_chunks; // Chunks already handed to writev
+    long total_chunks;   // Set once the cursor is exhausted, -1 until then
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+
+} ExportJob;
+
+void* exportWorker(void* arg) 
+{
+    ExportJob* job = (ExportJob*)arg;
+
+    pthread_mutex_lock(&job->lock);
+    while (true) 
+    {
+        while (job->total_chunks < 0 && job->next_chunk >= job->written_chunks + job->window) 
+        {
+            pthread_cond_wait(&job->changed, &job->lock);
+        }
+
+        if (job->total_chunks >= 0) break;
+
+        // Claiming a chunk is just copying its record pointers off the cursor
+        long c = job->next_chunk;
+        ExportChunk* chunk = &job->chunks[c % job->window];
+        int count = Cursor_FetchBatch(&job->cursor, chunk->records, EXPORT_CHUNK_RECORDS);
+
+        if (count == 0) 
+        {
+            job->total_chunks = c;
+            pthread_cond_broadcast(&job->changed);
+            break;
+        }
+
+        job->next_chunk++;
+        pthread_mutex_unlock(&job->lock);
+
+        size_t length = 0;
+        for (int i = 0; i < count; i++) 
+        {
+            length += job->formatRecord(chunk->records[i], chunk->buffer + length, job->format);
+        }
+
+        pthread_mutex_lock(&job->lock);
+        chunk->length = length;
+        chunk->ready = true;
+        pthread_cond_broadcast(&job->changed);
+    }
+    pthread_mutex_unlock(&job->lock);
+
+    return NULL;
+}
+
+// writev the whole vector, resuming after short writes
+bool writeAllVectored(int fd, struct iovec* iov, int count) 
+{
+    while (count > 0) 
+    {
+        ssize_t written = writev(fd, iov, count);
+
+        if (written < 0) 
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        while (count > 0 && (size_t)written >= iov->iov_len) 
+        {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count > 0) 
+        {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+int exportThreadCount(long records) 
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long chunks = (records + EXPORT_CHUNK_RECORDS - 1) / EXPORT_CHUNK_RECORDS;
+    long threads = (cpus < EXPORT_MAX_THREADS) ? cpus : EXPORT_MAX_THREADS;
+
+    if (threads > chunks) threads = chunks;
+
+    return threads > 0 ? (int)threads : 1;
+}
+
+// Write header (may be NULL) and then every record of root, in key order, to fd.
+// threads <= 0 picks one per CPU. Returns the number of records written, or -1.
+long Export_BPlus(GenericBPlusTreeNode* root, int fd, const char* header, export_format format, ExportFormatFunc formatRecord, size_t record_max, int threads) 
+{
+    long records = Count_BPlus(root);
+
+    if (threads <= 0) threads = exportThreadCount(records);
+    if (threads > EXPORT_MAX_THREADS) threads = EXPORT_MAX_THREADS;
+
+    ExportJob job;
+    Cursor_First(&job.cursor, root);
+    job.format = format;
+    job.formatRecord = formatRecord;
+    job.window = threads * EXPORT_WINDOW_PER_THREAD;
+    job.next_chunk = 0;
+    job.written_chunks = 0;
+    job.total_chunks = -1;
+
+    job.chunks = (ExportChunk*)trackedCalloc(job.window, sizeof(ExportChunk), MEM_EXPORT);
+    if (!job.chunks) 
+    {
+        perror("Failed to allocate export chunks");
+        return -1;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < job.window && ok; i++) 
+    {
+        job.chunks[i].buffer = (char*)trackedMalloc(EXPORT_CHUNK_RECORDS * record_max, MEM_EXPORT);
+        ok = (job.chunks[i].buffer != NULL);
+    }
+
+    if (ok && header) 
+    {
+        struct iovec iov = { (void*)header, strlen(header) };
+        ok = writeAllVectored(fd, &iov, 1);
+    }
+
+    pthread_t workers[EXPORT_MAX_THREADS];
+    int started = 0;
+
+    if (ok) 
+    {
+        pthread_mutex_init(&job.lock, NULL);
+        pthread_cond_init(&job.changed, NULL);
+
+        for (; started < threads; started++) 
+        {
+            if (pthread_create(&workers[started], NULL, exportWorker, &job) != 0) break;
+        }
+
+        if (started == 0) 
+        {
+            // No threads available; format and write one chunk at a time on this one
+            ExportChunk* chunk = &job.chunks[0];
+            int count;
+
+            while (ok && (count = Cursor_FetchBatch(&job.cursor, chunk->records, EXPORT_CHUNK_RECORDS)) > 0) 
+            {
+                struct iovec iov = { chunk->buffer, 0 };
+                for (int i = 0; i < count; i++) 
+                {
+                    iov.iov_len += formatRecord(chunk->records[i], chunk->buffer + iov.iov_len, format);
+                }
+                ok = writeAllVectored(fd, &iov, 1);
+            }
+            job.total_chunks = job.written_chunks = 0;
+        }
+
+        // Write finished chunks in order, as many contiguous ones per writev as are ready
+        struct iovec iov[EXPORT_MAX_WINDOW];
+
+        pthread_mutex_lock(&job.lock);
+        while (ok) 
+        {
+            while (!job.chunks[job.written_chunks % job.window].ready && job.total_chunks != job.written_chunks) 
+            {
+                pthread_cond_wait(&job.changed, &job.lock);
+            }
+
+            if (job.total_chunks == job.written_chunks) break;
+
+            int count = 0;
+            while (count < job.window && job.chunks[(job.written_chunks + count) % job.window].ready) 
+            {
+                ExportChunk* chunk = &job.chunks[(job.written_chunks + count) % job.window];
+                iov[count].iov_base = chunk->buffer;
+                iov[count].iov_len = chunk->length;
+                count++;
+            }
+            pthread_mutex_unlock(&job.lock);
+
+            ok = writeAllVectored(fd, iov, count);
+
+            pthread_mutex_lock(&job.lock);
+            for (int i = 0; i < count; i++) 
+            {
+                job.chunks[(job.written_chunks + i) % job.window].ready = false;
+            }
+            job.written_chunks += count;
+
+            if (!ok) job.total_chunks = job.next_chunk; // Stop the workers claiming more
+            pthread_cond_broadcast(&job.changed);
+        }
+        pthread_mutex_unlock(&job.lock);
+
+        for (int i = 0; i < started; i++) 
+        {
+            pthread_join(workers[i], NULL);
+        }
+
+        pthread_cond_destroy(&job.changed);
+        pthread_mutex_destroy(&job.lock);
+    }
+
+    for (int i = 0; i < job.window; i++) 
+    {
+        trackedFree(job.chunks[i].buffer);
+    }
+    trackedFree(job.chunks);
+
+    return ok ? records : -1;
+}
+
+// Export a tree to path, replacing it. Returns the number of records written, or -1.
+long exportToFile(GenericBPlusTreeNode* root, const char* path, const char* csv_header, export_format format, ExportFormatFunc formatRecord, size_t record_max, int threads) 
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) return -1;
+
+    long written = Export_BPlus(root, fd, format == EXPORT_CSV ? csv_header : NULL, format, formatRecord, record_max, threads);
+
+    if (close(fd) != 0) written = -1;
+
+    return written;
+}
+
+#define USER_CSV_HEADER "Vehicle_Number,Owner_Name,Arrival_Date,Arrival_Time,Departure_Date,Departure_Time,Parking_Space_ID,Number_of_Parkings,Membership,Spent_Time,Total_Spent_Time,Parking_Amt,Total_Parking_Amt,Status,Lot_ID"
+#define PARKING_CSV_HEADER "Parking_ID,Status,Revenue,Occupancies"
+
+long Export_Users(GenericBPlusTreeNode* userRoot, const char* path, export_format format, int threads) 
+{
+    return exportToFile(userRoot, path, USER_CSV_HEADER, format, formatUserRecord, EXPORT_USER_RECORD_MAX, threads);
+}
+
+long Export_Parking(GenericBPlusTreeNode* parkingRoot, const char* path, export_format format, int threads) 
+{
+    return exportToFile(parkingRoot, path, PARKING_CSV_HEADER, format, formatParkingRecord, EXPORT_PARKING_RECORD_MAX, threads);
+}
+
+
+// Parse one CSV row of the user database into user. Lot_ID, the last column, is optional.
+void parseUserLine(const char* line, User* user) 
+{
+    user->lot_id = 0;
+    user->prev_parked = NULL;
+    user->next_parked = NULL;
+    for (int h = 0; h < PARKED_HEAPS; h++) user->heap_pos[h] = -1;
+
+    sscanf(line, "%19[^,],%49[^,],%10[^,],%5[^,],%10[^,],%5[^,],%d,%d,%d,%f,%f,%f,%f,%d,%d",
+        user->vehicle_num,
+        user->owner_name,
+        user->arrival_date,
+        user->arrival_time,
+        user->departure_date,
+        user->departure_time,
+        &user->parking_space_id,
+        &user->number_of_parkings,
+        &user->membership,
+        &user->spent_time,
+        &user->total_spent_time,
+        &user->parking_amt,
+        &user->total_parking_amt,
+        (int*)&user->status,
+        &user->lot_id);
+}
+
+// Read User Database. Records come from pool when one is given, otherwise from the heap.
+GenericBPlusTreeNode* READ_DATABASE_Pooled(const char* filename, UserPool* pool) 
+{
+    METRIC_SCOPE(METRIC_READ_USERS);
+
+    GenericBPlusTreeNode* userRoot = NULL;
+    FILE* file = fopen(filename, "r");
+
+    if (!file) 
+    {
+        perror("Unable to open user file for reading");
+        return NULL;
+    }
+
+    char line[512];
+
+    if (fgets(line, sizeof(line), file) == NULL) 
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    int line_num = 1;
+    while (fgets(line, sizeof(line), file) != NULL) 
+    {
+        line_num++;
+
+        User* newUser = pool ? UserPool_Alloc(pool) : (User*)trackedMalloc(sizeof(User), MEM_USER);
+        
+        if (!newUser) 
+        {
+            perror("Unable to allocate memory for new user during read");
+            fclose(file);
+            return userRoot;
+        }
+
+        parseUserLine(line, newUser);
+
+        status_code status = Insert_BPlus(&userRoot, newUser, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey);
+        
+        if (status != SUCCESS) 
+        {
+            fprintf(stderr, "Failed to insert user record from line %d: %s\n", line_num, line);
+
+            if (pool) UserPool_Free(pool, newUser);
+            else freeUser(newUser);
+        }
+    }
+
+    fclose(file);
+    printf("Read user records successfully.\n");
+
+    return userRoot;
+}
+
+GenericBPlusTreeNode* READ_DATABASE_BPlus(const char* filename) 
+{
+    return READ_DATABASE_Pooled(filename, NULL);
+}
+
+// Write User Database
+void WRITE_DATABASE_BPlus(const char* filename, GenericBPlusTreeNode* userRoot) 
+{
+    METRIC_SCOPE(METRIC_WRITE_USERS);
+
+    if (Export_Users(userRoot, filename, EXPORT_CSV, 0) < 0) 
+    {
+        perror("Unable to write user file");
+        return;
+    }
+
+    printf("User database written successfully.\n");
+}
+
+// Read Parking Database
+GenericBPlusTreeNode* READ_PARKING_BPlus(const char* filename) 
+{
+    METRIC_SCOPE(METRIC_READ_PARKING);
+
+    GenericBPlusTreeNode* parkingRoot = NULL;
+    FILE* file = fopen(filename, "r");
+    bool file_existed = (file != NULL);
+
+    if (!file) 
+    {
+        perror("Error, No parking database exists!");
+        exit(EXIT_FAILURE);
+    } 
+    else 
+    {
+        char line[256];
+        if (fgets(line, sizeof(line), file) == NULL)
+        {
+            // File exists but is empty, treat as initialization case?
+            fclose(file);
+        }
+
+        int line_num = 1;
+        while (fgets(line, sizeof(line), file) != NULL) 
+        {
+            line_num++;
+
+            Parking* newParking = (Parking*)trackedMalloc(sizeof(Parking), MEM_PARKING);
+
+                if (!newParking) 
+                {
+                    perror("Unable to allocate memory for new user");
+                    fclose(file);
+                    return NULL;
+                }
+
+                // Parse the line
+                sscanf(line,"%d, %d, %f, %d", &newParking->parking_id, &newParking->parking_space_status, &newParking->revenue, &newParking->occupancies);
+                newParking->occupant = NULL;
+
+                status_code insert_status = Insert_BPlus(&parkingRoot, newParking, compareParkingId, compareParkingIdInternal, getParkingKey, copyParkingKey, freeParkingKey);
+                if(insert_status == FAILURE)
+                {
+                    fprintf(stderr, "Failed to insert parking record from line: %s\n", line);
+                    trackedFree(newParking);
+                    fclose(file);
+                    exit(EXIT_FAILURE);
+                }
+        }
+
+        fclose(file);
+
+        printf("Read parking data successfully from %s.\n", filename);
+    }
+
+    return parkingRoot;
+}
+
+// Write Parking Database
+void WRITE_PARKING_BPlus(const char* filename, GenericBPlusTreeNode* parkingRoot) 
+{
+    METRIC_SCOPE(METRIC_WRITE_PARKING);
+
+    if (Export_Parking(parkingRoot, filename, EXPORT_CSV, 0) < 0) 
+    {
+        perror("Unable to write parking file");
+        return;
+    }
+
+    printf("Parking database written successfully.\n");
+}
+
+// B+ Tree Destruction
+void destroyGenericBPlusTreeNode(GenericBPlusTreeNode* node, FreeDataFunc freeData, FreeKeyFunc freeKey) 
+{
+    if (!node) return;
+
+    if (!node->is_leaf) 
+    {
+        // Recursively destroy children
+        for (int i = 0; i < node->num_keys + 1; ++i) 
+        {
+            destroyGenericBPlusTreeNode(node->children[i], freeData, freeKey);
+        }
+
+        // Free internal keys (copies)
+        for (int i = 0; i < node->num_keys; ++i) 
+        {
+            if (node->keys[i]) 
+            {
+                freeKey(node->keys[i]);
+            }
+        }
+    } 
+    else 
+    {
+        // Free actual data pointers in leaf
+        if (freeData) 
+        {
+            for (int i = 0; i < node->num_keys; ++i) 
+            {
+                 if (node->keys[i]) 
+                 {
+                    freeData(node->keys[i]);
+                }
+            }
+        }
+    }
+
+    trackedFree(node);
+}
+
+void Destroy_BPlus_Tree(GenericBPlusTreeNode** rootRef, FreeDataFunc freeData, FreeKeyFunc freeKey) 
+{
+    if (rootRef && *rootRef) 
+    {
+        destroyGenericBPlusTreeNode(*rootRef, freeData, freeKey);
+        *rootRef = NULL;
+    }
+}
+
+
+
+
+// Bulk Loading and Compaction
+// Builds a tree bottom-up from records already in key order: leaves are packed with
+// up to leaf_fill records, and every internal level groups as many children as a node
+// holds. Entries are spread evenly across each level so no node ends up nearly empty.
+// Compaction is bulk loading the leaf chain of a live tree into a fresh one.
+#define COMPACT_CHECK_INTERVAL 4096 // Gate writes between automatic fill-factor checks
+#define COMPACT_DEFAULT_THRESHOLD 0.65
+#define COMPACT_LEAF_FILL (MAXKEYS - 1) // Room for one insert per leaf before the next split
+#define COMPACT_SWAP_ATTEMPTS 3 // Builds of a live tree thrown away to racing inserts before giving up
+
+GenericBPlusTreeNode* BulkLoad_BPlus(void** records, long count, int leaf_fill, GetKeyFromDataFunc getKey, CopyKeyFunc copyKey) 
+{
+    if (count <= 0) return NULL;
+    if (leaf_fill < 1 || leaf_fill > MAXKEYS) leaf_fill = MAXKEYS;
+
+    long num_leaves = (count + leaf_fill - 1) / leaf_fill;
+
+    // level[] holds the current level's nodes, first[] the smallest record under each one
+    GenericBPlusTreeNode** level = (GenericBPlusTreeNode**)trackedMalloc(sizeof(GenericBPlusTreeNode*) * num_leaves, MEM_SCRATCH);
+    void** first = (void**)trackedMalloc(sizeof(void*) * num_leaves, MEM_SCRATCH);
+
+    if (!level || !first) 
+    {
+        perror("Failed to allocate bulk load scratch");
+        trackedFree(level);
+        trackedFree(first);
+        return NULL;
+    }
+
+    long next = 0;
+    GenericBPlusTreeNode* previous = NULL;
+
+    for (long i = 0; i < num_leaves; i++) 
+    {
+        // Even split: the first (count % num_leaves) leaves take one extra record
+        int take = (int)(count / num_leaves + (i < count % num_leaves ? 1 : 0));
+        GenericBPlusTreeNode* leaf = createGenericBPlusTreeNode(true);
+
+        for (int k = 0; k < take; k++) 
+        {
+            leaf->keys[k] = records[next++];
+        }
+        leaf->num_keys = take;
+
+        if (previous) previous->next_leaf = leaf;
+        previous = leaf;
+
+        level[i] = leaf;
+        first[i] = leaf->keys[0];
+    }
+
+    long level_size = num_leaves;
+
+    while (level_size > 1) 
+    {
+        long parents = (level_size + MAXCHILDREN - 1) / MAXCHILDREN;
+        long child = 0;
+
+        for (long i = 0; i < parents; i++) 
+        {
+            int take = (int)(level_size / parents + (i < level_size % parents ? 1 : 0));
+            GenericBPlusTreeNode* node = createGenericBPlusTreeNode(false);
+            void* node_first = first[child];
+
+            for (int k = 0; k < take; k++, child++) 
+            {
+                node->children[k] = level[child];
+                level[child]->parent = node;
+
+                if (k > 0) 
+                {
+                    node->keys[k - 1] = copyKey(getKey(first[child]));
+                }
+            }
+            node->num_keys = take - 1;
+
+            // Parents are written over the front of the arrays; child always runs ahead of i
+            level[i] = node;
+            first[i] = node_first;
+        }
+
+        level_size = parents;
+    }
+
+    GenericBPlusTreeNode* root = level[0];
+    trackedFree(level);
+    trackedFree(first);
+
+    return root;
+}
+
+// Gather the records of a tree in key order into a new array; caller frees it
+void** collectRecords(GenericBPlusTreeNode* root, long* count) 
+{
+    *count = Count_BPlus(root);
+    if (!root) return NULL;
+
+    void** records = (void**)trackedMalloc(sizeof(void*) * (*count > 0 ? *count : 1), MEM_SCRATCH);
+    if (!records) 
+    {
+        perror("Failed to allocate record array");
+        *count = 0;
+        return NULL;
+    }
+
+    BPlusCursor cursor;
+    Cursor_First(&cursor, root);
+    Cursor_FetchBatch(&cursor, records, (int)*count);
+
+    return records;
+}
+
+// Build a densely packed copy of a tree sharing the same records into *compacted. The old
+// tree is untouched. An empty tree is already compact: *compacted is NULL and that is success.
+bool Compact_BPlus(GenericBPlusTreeNode* root, int leaf_fill, GetKeyFromDataFunc getKey, CopyKeyFunc copyKey, GenericBPlusTreeNode** compacted) 
+{
+    long count = 0;
+    void** records = collectRecords(root, &count);
+
+    *compacted = NULL;
+    if (count == 0) 
+    {
+        trackedFree(records);
+        return true;
+    }
+    if (!records) return false;
+
+    *compacted = BulkLoad_BPlus(records, count, leaf_fill, getKey, copyKey);
+    trackedFree(records);
+
+    return *compacted != NULL;
+}
+
+// collectRecords for a concurrent tree while latched inserts run. Every leaf is read as a
+// consistent snapshot, but the array is only a snapshot of the tree if nothing was inserted
+// during the walk, which the caller has to rule out. Caller frees it; NULL if out of memory.
+void** collectRecords_OLC(ConcurrentBPlusTree* tree, long* count) 
+{
+    long capacity = 1024;
+    void** records = (void**)trackedMalloc(sizeof(void*) * capacity, MEM_SCRATCH);
+
+    *count = 0;
+    if (!records) 
+    {
+        perror("Failed to allocate record array");
+        return NULL;
+    }
+
+    GenericBPlusTreeNode* next;
+    for (GenericBPlusTreeNode* leaf = firstLeaf_OLC(tree); leaf; leaf = next) 
+    {
+        if (*count + MAXKEYS > capacity) 
+        {
+            capacity *= 2;
+            void** grown = (void**)trackedRealloc(records, sizeof(void*) * capacity, MEM_SCRATCH);
+            if (!grown) 
+            {
+                perror("Failed to grow record array");
+                trackedFree(records);
+                *count = 0;
+                return NULL;
+            }
+            records = grown;
+        }
+
+        *count += readLeaf_OLC(leaf, records + *count, &next);
+    }
+
+    return records;
+}
+
+// Compact_BPlus for a concurrent tree; see collectRecords_OLC for what the copy is worth
+bool Compact_BPlus_OLC(ConcurrentBPlusTree* tree, int leaf_fill, GetKeyFromDataFunc getKey, CopyKeyFunc copyKey, GenericBPlusTreeNode** compacted) 
+{
+    long count = 0;
+    void** records = collectRecords_OLC(tree, &count);
+
+    *compacted = NULL;
+    if (!records) return false;
+    if (count == 0) 
+    {
+        trackedFree(records);
+        return true;
+    }
+
+    *compacted = BulkLoad_BPlus(records, count, leaf_fill, getKey, copyKey);
+    trackedFree(records);
+
+    return *compacted != NULL;
+}
+
+// Make sure every slot 1..slots of the lot has a record, adding vacant ones where missing.
+// Existing records stay, including any beyond the lot (those are never allocated). Returns
+// the tree to use: parkingRoot itself if nothing was missing, else a bulk-loaded rebuild.
+GenericBPlusTreeNode* Lot_GenerateSlots(GenericBPlusTreeNode* parkingRoot, int slots) 
+{
+    long count = 0;
+    void** existing = collectRecords(parkingRoot, &count);
+    long present = 0;
+
+    for (long i = 0; i < count; i++) 
+    {
+        int parking_id = ((Parking*)existing[i])->parking_id;
+        present += (parking_id >= 1 && parking_id <= slots);
+    }
+
+    if (present == slots) 
+    {
+        trackedFree(existing);
+        return parkingRoot;
+    }
+
+    long total = count + (slots - present);
+    void** records = (void**)trackedMalloc(sizeof(void*) * total, MEM_SCRATCH);
+
+    if (!records) 
+    {
+        perror("Unable to allocate parking slots");
+        exit(EXIT_FAILURE);
+    }
+
+    // Merge the generated ids into the existing records, keeping key order
+    long i = 0, n = 0;
+    for (int parking_id = 1; parking_id <= slots; parking_id++) 
+    {
+        while (i < count && ((Parking*)existing[i])->parking_id < parking_id) records[n++] = existing[i++];
+
+        if (i < count && ((Parking*)existing[i])->parking_id == parking_id) 
+        {
+            records[n++] = existing[i++];
+            continue;
+        }
+
+        Parking* slot = (Parking*)trackedCalloc(1, sizeof(Parking), MEM_PARKING);
+        if (!slot) 
+        {
+            perror("Unable to allocate parking slots");
+            exit(EXIT_FAILURE);
+        }
+
+        slot->parking_id = parking_id;
+        slot->parking_space_status = VACANT;
+        records[n++] = slot;
+    }
+    while (i < count) records[n++] = existing[i++];
+
+    GenericBPlusTreeNode* generated = BulkLoad_BPlus(records, n, MAXKEYS, getParkingKey, copyParkingKey);
+
+    // The records now belong to the new tree
+    Destroy_BPlus_Tree(&parkingRoot, NULL, freeParkingKey);
+    trackedFree(existing);
+    trackedFree(records);
+
+    printf("Generated %ld parking slots.\n", slots - present);
+
+    return generated;
+}
+
+// Read the parking database and fill in the rest of the lot. A lot defined by a config
+// file may start with no parking database at all.
+GenericBPlusTreeNode* Lot_LoadParking(const char* filename) 
+{
+    GenericBPlusTreeNode* parkingRoot = NULL;
+
+    const LotConfig* lot = Facility_Current()->lot;
+
+    if (!lot->loaded || access(filename, F_OK) == 0) 
+    {
+        parkingRoot = READ_PARKING_BPlus(filename);
+    }
+
+    return Lot_GenerateSlots(parkingRoot, lot->slots);
+}
+
+// Path of one of a facility's files: name inside directory, or name itself for NULL
+void facilityPath(char* out, size_t size, const char* directory, const char* name) 
+{
+    if (directory) snprintf(out, size, "%s/%s", directory, name);
+    else snprintf(out, size, "%s", name);
+}
+
+// Load a facility's lot config, parking tree (parking_file, inside directory like the
+// rest; NULL directory is the working directory) and per-lot stores. Returns the tree,
+// which stays the caller's. Leaves the calling thread on facility.
+GenericBPlusTreeNode* Facility_Load(Facility* facility, const char* directory, const char* parking_file) 
+{
+    char path[512];
+
+    Facility_Enter(facility);
+
+    facilityPath(path, sizeof(path), directory, LOT_CONFIG_FILE);
+    Lot_Load(facility->lot, path);
+
+    facilityPath(path, sizeof(path), directory, parking_file);
+    GenericBPlusTreeNode* parkingRoot = Lot_LoadParking(path);
+
+    Occupancy_Init(facility->occupancy, parkingRoot);
+    Reservation_Init(facility->reservations, Max_Parking_ID(parkingRoot));
+
+    facilityPath(path, sizeof(path), directory, RESERVATION_DB_FILE);
+    Reservation_Load(facility->reservations, path);
+
+    facilityPath(path, sizeof(path), directory, SLOT_LAYOUT_FILE);
+    SlotIndex_Init(facility->slot_index, parkingRoot, path);
+
+    facilityPath(path, sizeof(path), directory, SLOT_ATTRIBUTE_FILE);
+    SlotAttributes_Init(facility->slot_attributes, parkingRoot, path);
+
+    return parkingRoot;
+}
+
+void Facility_Save(Facility* facility, GenericBPlusTreeNode* parkingRoot, const char* directory, const char* parking_file) 
+{
+    char path[512];
+
+    facilityPath(path, sizeof(path), directory, parking_file);
+    WRITE_PARKING_BPlus(path, parkingRoot);
+
+    facilityPath(path, sizeof(path), directory, RESERVATION_DB_FILE);
+    Reservation_Save(facility->reservations, path);
+}
+
+// Release a facility's per-lot stores; its parking tree is the caller's to destroy
+void Facility_Unload(Facility* facility) 
+{
+    Occupancy_Destroy(facility->occupancy);
+    Reservation_Destroy(facility->reservations);
+    SlotIndex_Destroy(facility->slot_index);
+    SlotAttributes_Destroy(facility->slot_attributes);
+    Parked_Destroy(facility->parked);
+}
+
+
+// Sorted Reports
+// A report copies the record pointers out with collectRecords, sorts that array and prints it.
+
+// Comparison function pointer type for report sorting (compares the records themselves)
+typedef int (*ListCompareFunc)(const void* dataA, const void* dataB);
+
+// Stable bottom-up merge sort over record pointers, so ties keep their key order
+// like the old list merge sort did
+void sortRecords(void** records, long count, ListCompareFunc cmp) 
+{
+    if (count < 2) return;
+
+    void** scratch = (void**)trackedMalloc(sizeof(void*) * count, MEM_SCRATCH);
+    if (!scratch) 
+    {
+        perror("Failed to allocate sort buffer");
+        return;
+    }
+
+    void** src = records;
+    void** dst = scratch;
+
+    for (long width = 1; width < count; width *= 2) 
+    {
+        for (long lo = 0; lo < count; lo += 2 * width) 
+        {
+            long mid = (lo + width < count) ? lo + width : count;
+            long hi = (lo + 2 * width < count) ? lo + 2 * width : count;
+            long i = lo, j = mid, k = lo;
+
+            while (i < mid && j < hi) 
+            {
+                dst[k++] = (cmp(src[j], src[i]) < 0) ? src[j++] : src[i++];
+            }
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi) dst[k++] = src[j++];
+        }
+
+        void** swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != records) memcpy(records, src, sizeof(void*) * count);
+
+    trackedFree(scratch);
+}
+
+int compareUsersByNumParkings_list(const void *a, const void *b) 
+{
+    User *userA = (User *)a; 
+    User *userB = (User *)b;
+
+    if (userA->number_of_parkings != userB->number_of_parkings)
+    {
+        return userA->number_of_parkings - userB->number_of_parkings;
+    }
+    else
+    {
+        return strcmp(userA->vehicle_num, userB->vehicle_num);
+    }
+}
+
+int compareUsersByParkingAmt_list(const void *a, const void *b) 
+{
+    User *userA = (User *)a; 
+    User *userB = (User *)b;
+
+    if (userA->total_parking_amt != userB->total_parking_amt)
+    {
+        return (userA->total_parking_amt > userB->total_parking_amt) ? 1 : -1;
+    }
+    else
+    {
+        return strcmp(userA->vehicle_num, userB->vehicle_num);
+    }    
+}
+
+int compareParkingByOccupancy_list(const void *a, const void *b) 
+{
+    Parking *pA = (Parking *)a;
+    Parking *pB = (Parking *)b;
+
+    if (pA->occupancies != pB->occupancies)
+    {
+        return pB->occupancies - pA->occupancies; // Descending
+    }
+    else
+    {
+        return pA->parking_id - pB->parking_id;
+    }   
+    
+}
+
+int compareParkingByRevenue_list(const void *a, const void *b) 
+{
+    Parking *pA = (Parking *)a; 
+    Parking *pB = (Parking *)b;
+
+    if (pA->revenue != pB->revenue)
+    {
+        return (pB->revenue > pA->revenue) ? 1 : -1; // Descending
+    }
+    else
+    {
+        return pA->parking_id - pB->parking_id;
+    }
+    
+}
+
+void printRecordList(void** records, long count, PrintFunc printData, const char* listName) 
+{
+    if (!printData) 
+    {
+        printf("Error: Cannot print list '%s'. No data printing function provided.\n", listName);
+        return;
+    }
+
+    printf("\n--- Printing Linked List: %s ---\n", listName);
+
+    if (count == 0) 
+    {
+        printf("List is empty.\n");
+        printf("--- End of List: %s ---\n\n", listName);
+        return;
+    }
+
+    for (long i = 0; i < count; i++) 
+    {
+        printf("Node %ld: \n", i + 1);
+        printData(records[i]);
+    }
+
+    printf("--- End of List ---\n\n");
+}
+
+
+int compareUserAmtVsBoundary(const User* userData, const float boundaryVal) 
+{
+    if (!userData || !boundaryVal) 
+    {
+        return -1;
+    }
+    
+    const User* user = userData;
+    const float boundaryAmount = boundaryVal;
+
+    if (user->total_parking_amt < boundaryAmount) 
+    {
+        return -1; // User amount is less than the boundary
+    } 
+    else 
+    {
+        return 1; // User amount is greater than the boundary
+    }
+}
+
+void printRecordListRange(void** records, long count, const float min_val, const float max_val, PrintFunc printData) 
+{
+    printf("\n--- Printing List ---\n");
+
+    if (count == 0) 
+    {
+        printf("List is empty. No items to check in range.\n");
+        printf("--- End of List ---\n\n");
+        return;
+    }
+
+    int printed = 0; // Count of items printed within the range
+    bool first_printed = true;
+
+    for (long i = 0; i < count; i++) 
+    {
+        // Check if data is within the range [min_val, max_val]
+        bool greater_equal_min = (compareUserAmtVsBoundary(records[i], min_val) >= 0);
+        bool less_equal_max    = (compareUserAmtVsBoundary(records[i], max_val) <= 0);
+
+        if (greater_equal_min && less_equal_max) 
+        {
+            // Data is in range, print it
+            if (first_printed) 
+            {
+                printf("Items found within the specified range:\n");
+                first_printed = false;
+            }
+
+            printData(records[i]);
+            printed++;
+        }
+    }
+
+    if (printed == 0) 
+    {
+        printf("No items found within the specified range.\n");
+    }
+
+    printf("--- End of List (%d items printed) ---\n\n", printed);
+}
+
+
+void UsersByNumParkings_ListTree(GenericBPlusTreeNode* userRootPrimary) 
+{
+    if (!userRootPrimary) 
+    { 
+        printf("Primary user tree is empty.\n");
+        return; 
+    }
+
+    long count = 0;
+    void** userList = collectRecords(userRootPrimary, &count);
+    if(!userList) 
+    { 
+        printf("Failed to extract user data to list.\n"); 
+        return; 
+    }
+
+    sortRecords(userList, count, compareUsersByNumParkings_list);
+
+    printf("\n>>> Printing Sorted List <<<\n");
+    printRecordList(userList, count, printUser, "Sorted User List (by Num Parkings)");
+    
+    trackedFree(userList);
+}
+
+void UsersByParkingAmountRange_ListTree(GenericBPlusTreeNode* userRootPrimary) 
+{
+    if (!userRootPrimary) 
+    { 
+        printf("Primary user tree is empty.\n");
+        return; 
+    }
+
+    float min_amount, max_amount;
+    printf("Enter minimum parking amount: ");
+    scanf("%f", &min_amount);
+
+    printf("\nEnter maximum parking amount: ");
+    scanf("%f", &max_amount);
+
+    if (min_amount > max_amount)
+    { 
+        printf("Min > Max invalid.\n"); 
+        return; 
+    }
+
+    long count = 0;
+    void** userList = collectRecords(userRootPrimary, &count);
+    if(!userList) 
+    { 
+        printf("Failed to extract user data to list.\n"); 
+        return; 
+    }
+
+    sortRecords(userList, count, compareUsersByParkingAmt_list);
+
+    printRecordListRange(userList, count, min_amount, max_amount, printUser);
+
+    trackedFree(userList);
+}
+
+void ParkingByOccupancy_ListTree(GenericBPlusTreeNode* parkingRootPrimary)
+{
+    if (!parkingRootPrimary) 
+    { 
+        printf("Primary parking tree is empty.\n");
+        return; 
+    }
+
+    long count = 0;
+    void** parkingList = collectRecords(parkingRootPrimary, &count);
+    if(!parkingList) 
+    { 
+        printf("Failed to extract parking data to list.\n"); 
+        return; 
+    }
+
+    sortRecords(parkingList, count, compareParkingByOccupancy_list);
+
+    printf("\n>>> Printing Sorted List <<<\n");
+    printRecordList(parkingList, count, printParking, "Sorted Parking List (by Occupancy)");
+
+    trackedFree(parkingList);
+}
+
+void ParkingByRevenue_ListTree(GenericBPlusTreeNode* parkingRootPrimary)
+{    
+    if (!parkingRootPrimary) 
+    { 
+        printf("Primary parking tree is empty.\n");
+        return; 
+    }
+
+    long count = 0;
+    void** parkingList = collectRecords(parkingRootPrimary, &count);
+    if(!parkingList) 
+    { 
+        printf("Failed to extract parking data to list.\n"); 
+        return; 
+    }
+
+    sortRecords(parkingList, count, compareParkingByRevenue_list);
+
+
+    printf("\n>>> Printing Sorted List <<<\n");
+    printRecordList(parkingList, count, printParking, "Sorted Parking List (by Revenue)");
+
+    trackedFree(parkingList);
+}
+
+
+// Paged User Tree
+// For user databases that do not fit in memory: the user tree kept in one file of
+// fixed-size pages, nodes addressed by page number instead of pointer. Only a bounded
+// pool of pages is ever in memory; lookups and inserts fault pages in on demand and the
+// pool evicts with CLOCK (a frame used since the hand last passed gets a second chance),
+// so the upper levels and hot plates stay cached. Opening reads only the header page.
+// Inserts split full nodes on the way down, so a descent pins at most three pages, and a
+// full last leaf being appended to is left full rather than halved, so a database
+// imported in plate order (as the CSV is written) ends up densely packed. One mutex
+// guards the whole tree, as with a single user shard. The gate daemon can serve its
+// users from one (--daemon <address> --paged <db> [frames], see Thread-safe Engine).
+#define PAGED_PAGE_SIZE 4096
+#define PAGED_FILE_MAGIC 0x45474150u // "PAGE"
+#define PAGED_DEFAULT_FRAMES 256
+#define PAGED_MIN_FRAMES 8
+#define PAGED_NODE_HEADER 8
+
+// A user as stored in a leaf page, without the in-memory parked links
+typedef struct PagedRecord 
+{
+    char vehicle_num[20];
+    char owner_name[50];
+    char arrival_date[11];
+    char departure_date[11];
+    char arrival_time[6];
+    char departure_time[6];
+    float spent_time;
+    float total_spent_time;
+    float parking_amt;
+    float total_parking_amt;
+    int32_t membership;
+    int32_t number_of_parkings;
+    int32_t parking_space_id;
+    int32_t status;
+    int32_t lot_id;
+
+} PagedRecord;
+
+#define PAGED_LEAF_MAX ((PAGED_PAGE_SIZE - PAGED_NODE_HEADER) / sizeof(PagedRecord))
+#define PAGED_INTERNAL_MAX ((PAGED_PAGE_SIZE - PAGED_NODE_HEADER - sizeof(uint32_t)) / (sizeof(uint32_t) + 20))
+
+typedef struct PagedNode 
+{
+    uint16_t is_leaf;
+    uint16_t num_keys;
+    uint32_t next_leaf; // Leaf: next leaf in plate order, 0 for the last one
+    union 
+    {
+        PagedRecord records[PAGED_LEAF_MAX];
+        struct 
+        {
+            uint32_t children[PAGED_INTERNAL_MAX + 1];
+            char keys[PAGED_INTERNAL_MAX][20]; // keys[i] is the smallest plate under children[i + 1]
+        };
+    };
+
+} PagedNode;
+
+_Static_assert(sizeof(PagedNode) <= PAGED_PAGE_SIZE, "paged node must fit in a page");
+
+// Page 0 of the file
+typedef struct PagedHeader 
+{
+    uint32_t magic;
+    uint32_t page_size;
+    uint32_t root;      // 0 while the tree is empty
+    uint32_t num_pages; // Including the header page
+    uint32_t height;
+    int64_t count;
+
+} PagedHeader;
+
+typedef struct PageFrame 
+{
+    uint32_t page_id; // 0 while the frame holds no page
+    int32_t next;     // Next frame in the same hash bucket, -1 at the end
+    int pins;
+    bool referenced;  // Used since the CLOCK hand last passed
+    bool dirty;
+
+} PageFrame;
+
+typedef struct PagedUserTree 
+{
+    int fd;
+    PagedHeader header;
+    bool header_dirty;
+    uint8_t* pages;    // num_frames page buffers, frame f at f * PAGED_PAGE_SIZE
+    PageFrame* frames;
+    int num_frames;
+    int32_t* buckets;  // Page id hash -> first frame holding a page with that hash, -1 if none
+    uint32_t num_buckets;
+    int hand;
+    uint64_t hits, misses, writes;
+    pthread_mutex_t lock;
+
+} PagedUserTree;
+
+static inline PagedNode* pagedFrameNode(PagedUserTree* tree, int frame) 
+{
+    return (PagedNode*)(tree->pages + (size_t)frame * PAGED_PAGE_SIZE);
+}
+
+static inline uint32_t pagedBucket(const PagedUserTree* tree, uint32_t page_id) 
+{
+    return (page_id * 2654435761u) & (tree->num_buckets - 1);
+}
+
+void userToPagedRecord(const User* user, PagedRecord* record) 
+{
+    memset(record, 0, sizeof(*record));
+    snprintf(record->vehicle_num, sizeof(record->vehicle_num), "%s", user->vehicle_num);
+    snprintf(record->owner_name, sizeof(record->owner_name), "%s", user->owner_name);
+    snprintf(record->arrival_date, sizeof(record->arrival_date), "%s", user->arrival_date);
+    snprintf(record->departure_date, sizeof(record->departure_date), "%s", user->departure_date);
+    snprintf(record->arrival_time, sizeof(record->arrival_time), "%s", user->arrival_time);
+    snprintf(record->departure_time, sizeof(record->departure_time), "%s", user->departure_time);
+    record->spent_time = user->spent_time;
+    record->total_spent_time = user->total_spent_time;
+    record->parking_amt = user->parking_amt;
+    record->total_parking_amt = user->total_parking_amt;
+    record->membership = user->membership;
+    record->number_of_parkings = user->number_of_parkings;
+    record->parking_space_id = user->parking_space_id;
+    record->status = (int32_t)user->status;
+    record->lot_id = user->lot_id;
+}
+
+void pagedRecordToUser(const PagedRecord* record, User* user) 
+{
+    memcpy(user->vehicle_num, record->vehicle_num, sizeof(user->vehicle_num));
+    memcpy(user->owner_name, record->owner_name, sizeof(user->owner_name));
+    memcpy(user->arrival_date, record->arrival_date, sizeof(user->arrival_date));
+    memcpy(user->departure_date, record->departure_date, sizeof(user->departure_date));
+    memcpy(user->arrival_time, record->arrival_time, sizeof(user->arrival_time));
+    memcpy(user->departure_time, record->departure_time, sizeof(user->departure_time));
+    user->spent_time = record->spent_time;
+    user->total_spent_time = record->total_spent_time;
+    user->parking_amt = record->parking_amt;
+    user->total_parking_amt = record->total_parking_amt;
+    user->membership = record->membership;
+    user->number_of_parkings = record->number_of_parkings;
+    user->parking_space_id = record->parking_space_id;
+    user->status = (parked)record->status;
+    user->lot_id = record->lot_id;
+    user->prev_parked = NULL;
+    user->next_parked = NULL;
+    for (int h = 0; h < PARKED_HEAPS; h++) user->heap_pos[h] = -1;
+}
+
+// Tree is locked
+bool pagedWriteFrameLocked(PagedUserTree* tree, int frame) 
+{
+    off_t offset = (off_t)tree->frames[frame].page_id * PAGED_PAGE_SIZE;
+
+    if (pwrite(tree->fd, pagedFrameNode(tree, frame), PAGED_PAGE_SIZE, offset) != PAGED_PAGE_SIZE) 
+    {
+        perror("Failed to write user page");
+        return false;
+    }
+
+    tree->frames[frame].dirty = false;
+    tree->writes++;
+
+    return true;
+}
+
+// Tree is locked. Drop frame's page from the page table.
+void pagedUnhashLocked(PagedUserTree* tree, int frame) 
+{
+    int32_t* link = &tree->buckets[pagedBucket(tree, tree->frames[frame].page_id)];
+
+    while (*link != frame) link = &tree->frames[*link].next;
+
+    *link = tree->frames[frame].next;
+    tree->frames[frame].page_id = 0;
+}
+
+// Tree is locked. Next frame the CLOCK hand finds unpinned and not recently used, or -1
+// if every frame is pinned.
+int pagedVictimLocked(PagedUserTree* tree) 
+{
+    for (int step = 0; step < 2 * tree->num_frames; step++) 
+    {
+        int frame = tree->hand;
+        PageFrame* candidate = &tree->frames[frame];
+
+        tree->hand = (tree->hand + 1) % tree->num_frames;
+
+        if (candidate->page_id == 0) return frame;
+        if (candidate->pins > 0) continue;
+
+        if (candidate->referenced) 
+        {
+            candidate->referenced = false;
+            continue;
+        }
+
+        return frame;
+    }
+
+    return -1;
+}
+
+// Tree is locked. Pin a page in the pool, reading it in on a miss. A fresh page is a
+// newly allocated one that is not in the file yet: it starts zeroed instead.
+PagedNode* pagedPinLocked(PagedUserTree* tree, uint32_t page_id, bool fresh) 
+{
+    for (int32_t frame = tree->buckets[pagedBucket(tree, page_id)]; frame >= 0; frame = tree->frames[frame].next) 
+    {
+        if (tree->frames[frame].page_id == page_id) 
+        {
+            tree->hits++;
+            tree->frames[frame].pins++;
+            tree->frames[frame].referenced = true;
+            return pagedFrameNode(tree, frame);
+        }
+    }
+
+    tree->misses++;
+
+    int frame = pagedVictimLocked(tree);
+    if (frame < 0) 
+    {
+        fprintf(stderr, "User page pool exhausted: all %d frames are pinned.\n", tree->num_frames);
+        return NULL;
+    }
+
+    PageFrame* slot = &tree->frames[frame];
+
+    if (slot->page_id != 0) 
+    {
+        if (slot->dirty && !pagedWriteFrameLocked(tree, frame)) return NULL;
+        pagedUnhashLocked(tree, frame);
+    }
+
+    PagedNode* node = pagedFrameNode(tree, frame);
+
+    if (fresh) 
+    {
+        memset(node, 0, PAGED_PAGE_SIZE);
+    }
+    else if (pread(tree->fd, node, PAGED_PAGE_SIZE, (off_t)page_id * PAGED_PAGE_SIZE) != PAGED_PAGE_SIZE) 
+    {
+        perror("Failed to read user page");
+        return NULL;
+    }
+
+    uint32_t bucket = pagedBucket(tree, page_id);
+
+    slot->page_id = page_id;
+    slot->next = tree->buckets[bucket];
+    slot->pins = 1;
+    slot->referenced = true;
+    slot->dirty = fresh;
+    tree->buckets[bucket] = frame;
+
+    return node;
+}
+
+// Tree is locked
+void pagedUnpinLocked(PagedUserTree* tree, PagedNode* node, bool dirty) 
+{
+    int frame = (int)(((uint8_t*)node - tree->pages) / PAGED_PAGE_SIZE);
+
+    tree->frames[frame].pins--;
+    if (dirty) tree->frames[frame].dirty = true;
+}
+
+// Tree is locked. A new, pinned, empty node at the end of the file.
+PagedNode* pagedAllocateLocked(PagedUserTree* tree, bool is_leaf, uint32_t* page_id) 
+{
+    PagedNode* node = pagedPinLocked(tree, tree->header.num_pages, true);
+    if (!node) return NULL;
+
+    *page_id = tree->header.num_pages++;
+    tree->header_dirty = true;
+    node->is_leaf = is_leaf;
+
+    return node;
+}
+
+// First record in a leaf with a plate not below vehicle_num
+int pagedLeafSlot(const PagedNode* leaf, const char* vehicle_num) 
+{
+    int low = 0, high = leaf->num_keys;
+
+    while (low < high) 
+    {
+        int mid = (low + high) / 2;
+        if (strcmp(leaf->records[mid].vehicle_num, vehicle_num) < 0) low = mid + 1;
+        else high = mid;
+    }
+
+    return low;
+}
+
+// Child of an internal node whose range holds vehicle_num
+int pagedChildSlot(const PagedNode* node, const char* vehicle_num) 
+{
+    int low = 0, high = node->num_keys;
+
+    while (low < high) 
+    {
+        int mid = (low + high) / 2;
+        if (strcmp(node->keys[mid], vehicle_num) <= 0) low = mid + 1;
+        else high = mid;
+    }
+
+    return low;
+}
+
+static inline bool pagedNodeFull(const PagedNode* node) 
+{
+    return node->num_keys == (node->is_leaf ? PAGED_LEAF_MAX : PAGED_INTERNAL_MAX);
+}
+
+// Tree is locked. Pin the leaf that holds or would hold vehicle_num, or NULL for an empty tree.
+PagedNode* pagedFindLeafLocked(PagedUserTree* tree, const char* vehicle_num) 
+{
+    uint32_t page_id = tree->header.root;
+
+    while (page_id != 0) 
+    {
+        PagedNode* node = pagedPinLocked(tree, page_id, false);
+        if (!node || node->is_leaf) return node;
+
+        page_id = node->children[pagedChildSlot(node, vehicle_num)];
+        pagedUnpinLocked(tree, node, false);
+    }
+
+    return NULL;
+}
+
+// Tree is locked. Split parent's full child at index into two, inserting the separator
+// into parent, which has room. vehicle_num is the plate being inserted (a record's field).
+bool pagedSplitChildLocked(PagedUserTree* tree, PagedNode* parent, int index, PagedNode* child, const char* vehicle_num) 
+{
+    uint32_t sibling_id;
+    PagedNode* sibling = pagedAllocateLocked(tree, child->is_leaf, &sibling_id);
+    if (!sibling) return false;
+
+    char separator[20];
+    int count = child->num_keys;
+
+    if (child->is_leaf) 
+    {
+        // Appending past the last leaf: leave it full and start the next one
+        bool append = child->next_leaf == 0 && strcmp(vehicle_num, child->records[count - 1].vehicle_num) > 0;
+        int keep = append ? count : count / 2;
+
+        memcpy(sibling->records, &child->records[keep], sizeof(PagedRecord) * (count - keep));
+        sibling->num_keys = (uint16_t)(count - keep);
+        child->num_keys = (uint16_t)keep;
+
+        sibling->next_leaf = child->next_leaf;
+        child->next_leaf = sibling_id;
+
+        memcpy(separator, append ? vehicle_num : sibling->records[0].vehicle_num, sizeof(separator));
+    }
+    else 
+    {
+        int mid = count / 2;
+
+        memcpy(separator, child->keys[mid], sizeof(separator));
+        memcpy(sibling->keys, &child->keys[mid + 1], sizeof(child->keys[0]) * (count - mid - 1));
+        memcpy(sibling->children, &child->children[mid + 1], sizeof(uint32_t) * (count - mid));
+        sibling->num_keys = (uint16_t)(count - mid - 1);
+        child->num_keys = (uint16_t)mid;
+    }
+
+    memmove(&parent->keys[index + 1], &parent->keys[index], sizeof(parent->keys[0]) * (parent->num_keys - index));
+    memmove(&parent->children[index + 2], &parent->children[index + 1], sizeof(uint32_t) * (parent->num_keys - index));
+    memcpy(parent->keys[index], separator, sizeof(separator));
+    parent->children[index + 1] = sibling_id;
+    parent->num_keys++;
+
+    pagedUnpinLocked(tree, sibling, true);
+
+    return true;
+}
+
+// Tree is locked. record's plate is known to be absent.
+bool pagedInsertLocked(PagedUserTree* tree, const PagedRecord* record) 
+{
+    const char* vehicle_num = record->vehicle_num;
+    PagedNode* node;
+
+    if (tree->header.root == 0) 
+    {
+        node = pagedAllocateLocked(tree, true, &tree->header.root);
+        if (!node) return false;
+
+        tree->header.height = 1;
+    }
+    else 
+    {
+        node = pagedPinLocked(tree, tree->header.root, false);
+        if (!node) return false;
+
+        if (pagedNodeFull(node)) 
+        {
+            // Grow a level: a new root above the old one, which is then split under it
+            uint32_t root_id;
+            PagedNode* root = pagedAllocateLocked(tree, false, &root_id);
+
+            if (!root) 
+            {
+                pagedUnpinLocked(tree, node, false);
+                return false;
+            }
+
+            root->children[0] = tree->header.root;
+
+            bool split = pagedSplitChildLocked(tree, root, 0, node, vehicle_num);
+            pagedUnpinLocked(tree, node, split);
+
+            if (!split) 
+            {
+                pagedUnpinLocked(tree, root, true);
+                return false;
+            }
+
+            tree->header.root = root_id;
+            tree->header.height++;
+            node = root;
+        }
+    }
+
+    // Every node reached has room, so a split below never has to go back up
+    bool node_dirty = false;
+
+    while (!node->is_leaf) 
+    {
+        int index = pagedChildSlot(node, vehicle_num);
+        PagedNode* child = pagedPinLocked(tree, node->children[index], false);
+
+        if (child && pagedNodeFull(child)) 
+        {
+            bool split = pagedSplitChildLocked(tree, node, index, child, vehicle_num);
+            pagedUnpinLocked(tree, child, split);
+            child = NULL;
+
+            if (split) 
+            {
+                node_dirty = true;
+                child = pagedPinLocked(tree, node->children[pagedChildSlot(node, vehicle_num)], false);
+            }
+        }
+
+        pagedUnpinLocked(tree, node, node_dirty);
+        if (!child) return false;
+
+        node = child;
+        node_dirty = false;
+    }
+
+    int slot = pagedLeafSlot(node, vehicle_num);
+
+    memmove(&node->records[slot + 1], &node->records[slot], sizeof(PagedRecord) * (node->num_keys - slot));
+    node->records[slot] = *record;
+    node->num_keys++;
+    pagedUnpinLocked(tree, node, true);
+
+    tree->header.count++;
+    tree->header_dirty = true;
+
+    return true;
+}
+
+// Open (or create) a paged user database with a pool of frames pages
+bool PagedTree_Open(PagedUserTree* tree, const char* path, int frames) 
+{
+    memset(tree, 0, sizeof(*tree));
+
+    tree->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (tree->fd < 0) 
+    {
+        perror("Unable to open paged user database");
+        return false;
+    }
+
+    ssize_t bytes = pread(tree->fd, &tree->header, sizeof(tree->header), 0);
+
+    if (bytes == 0) 
+    {
+        tree->header = (PagedHeader){ PAGED_FILE_MAGIC, PAGED_PAGE_SIZE, 0, 1, 0, 0 };
+        tree->header_dirty = true;
+    }
+    else if (bytes != (ssize_t)sizeof(tree->header) || tree->header.magic != PAGED_FILE_MAGIC || tree->header.page_size != PAGED_PAGE_SIZE) 
+    {
+        fprintf(stderr, "%s is not a paged user database.\n", path);
+        close(tree->fd);
+        return false;
+    }
+
+    if (frames < PAGED_MIN_FRAMES) frames = PAGED_MIN_FRAMES;
+
+    tree->num_frames = frames;
+    tree->num_buckets = 1;
+    while (tree->num_buckets < 2 * (uint32_t)frames) tree->num_buckets *= 2;
+
+    tree->pages = (uint8_t*)trackedAlignedAlloc(PAGED_PAGE_SIZE, (size_t)frames * PAGED_PAGE_SIZE, MEM_PAGE_CACHE);
+    tree->frames = (PageFrame*)trackedCalloc(frames, sizeof(PageFrame), MEM_PAGE_CACHE);
+    tree->buckets = (int32_t*)trackedMalloc(sizeof(int32_t) * tree->num_buckets, MEM_PAGE_CACHE);
+
+    if (!tree->pages || !tree->frames || !tree->buckets) 
+    {
+        perror("Failed to allocate user page pool");
+        trackedFree(tree->pages);
+        trackedFree(tree->frames);
+        trackedFree(tree->buckets);
+        close(tree->fd);
+        return false;
+    }
+
+    for (uint32_t b = 0; b < tree->num_buckets; b++) tree->buckets[b] = -1;
+
+    pthread_mutex_init(&tree->lock, NULL);
+
+    return true;
+}
+
+// Copy out the user with vehicle_num; false if there is none
+bool PagedTree_Get(PagedUserTree* tree, const char* vehicle_num, User* out) 
+{
+    bool found = false;
+
+    pthread_mutex_lock(&tree->lock);
+
+    PagedNode* leaf = pagedFindLeafLocked(tree, vehicle_num);
+    if (leaf) 
+    {
+        int slot = pagedLeafSlot(leaf, vehicle_num);
+
+        found = slot < leaf->num_keys && strcmp(leaf->records[slot].vehicle_num, vehicle_num) == 0;
+        if (found) pagedRecordToUser(&leaf->records[slot], out);
+
+        pagedUnpinLocked(tree, leaf, false);
+    }
+
+    pthread_mutex_unlock(&tree->lock);
+
+    return found;
+}
+
+// Store user, replacing the record with the same plate if there is one
+bool PagedTree_Put(PagedUserTree* tree, const User* user) 
+{
+    PagedRecord record;
+    userToPagedRecord(user, &record);
+
+    pthread_mutex_lock(&tree->lock);
+
+    bool ok;
+    PagedNode* leaf = pagedFindLeafLocked(tree, record.vehicle_num);
+    int slot = leaf ? pagedLeafSlot(leaf, record.vehicle_num) : 0;
+
+    if (leaf && slot < leaf->num_keys && strcmp(leaf->records[slot].vehicle_num, record.vehicle_num) == 0) 
+    {
+        leaf->records[slot] = record;
+        pagedUnpinLocked(tree, leaf, true);
+        ok = true;
+    }
+    else 
+    {
+        if (leaf) pagedUnpinLocked(tree, leaf, false);
+        ok = (tree->header.root == 0 || leaf) && pagedInsertLocked(tree, &record);
+    }
+
+    pthread_mutex_unlock(&tree->lock);
+
+    return ok;
+}
+
+// Visit every user in plate order, one leaf in memory at a time; returns how many
+long PagedTree_ForEach(PagedUserTree* tree, void (*visit)(const void* data, void* ctx), void* ctx) 
+{
+    long visited = 0;
+
+    pthread_mutex_lock(&tree->lock);
+
+    PagedNode* leaf = pagedFindLeafLocked(tree, "");
+
+    while (leaf) 
+    {
+        for (int i = 0; i < leaf->num_keys; i++) 
+        {
+            User user;
+            pagedRecordToUser(&leaf->records[i], &user);
+            visit(&user, ctx);
+            visited++;
+        }
+
+        uint32_t next = leaf->next_leaf;
+        pagedUnpinLocked(tree, leaf, false);
+        leaf = next ? pagedPinLocked(tree, next, false) : NULL;
+    }
+
+    pthread_mutex_unlock(&tree->lock);
+
+    return visited;
+}
+
+// Load a user CSV into the tree; returns how many rows were stored, or -1
+long PagedTree_Import(PagedUserTree* tree, const char* filename) 
+{
+    FILE* file = fopen(filename, "r");
+
+    if (!file) 
+    {
+        perror("Unable to open user file for reading");
+        return -1;
+    }
+
+    char line[512];
+    long stored = 0;
+    int line_num = 1;
+
+    if (fgets(line, sizeof(line), file) != NULL) 
+    {
+        while (fgets(line, sizeof(line), file) != NULL) 
+        {
+            line_num++;
+
+            User scratch;
+            parseUserLine(line, &scratch);
+
+            if (PagedTree_Put(tree, &scratch)) 
+            {
+                stored++;
+            }
+            else 
+            {
+                fprintf(stderr, "Failed to store user record from line %d: %s\n", line_num, line);
+            }
+        }
+    }
+
+    fclose(file);
+
+    return stored;
+}
+
+// Write back every dirty page and the header
+bool PagedTree_Flush(PagedUserTree* tree) 
+{
+    bool ok = true;
+
+    pthread_mutex_lock(&tree->lock);
+
+    for (int f = 0; f < tree->num_frames; f++) 
+    {
+        if (tree->frames[f].page_id != 0 && tree->frames[f].dirty && !pagedWriteFrameLocked(tree, f)) ok = false;
+    }
+
+    if (tree->header_dirty) 
+    {
+        if (pwrite(tree->fd, &tree->header, sizeof(tree->header), 0) != (ssize_t)sizeof(tree->header)) 
+        {
+            perror("Failed to write paged user database header");
+            ok = false;
+        }
+        else 
+        {
+            tree->header_dirty = false;
+        }
+    }
+
+    if (ok && fsync(tree->fd) != 0) ok = false;
+
+    pthread_mutex_unlock(&tree->lock);
+
+    return ok;
+}
+
+bool PagedTree_Close(PagedUserTree* tree) 
+{
+    bool ok = PagedTree_Flush(tree);
+
+    if (close(tree->fd) != 0) ok = false;
+
+    trackedFree(tree->pages);
+    trackedFree(tree->frames);
+    trackedFree(tree->buckets);
+    pthread_mutex_destroy(&tree->lock);
+
+    return ok;
+}
+
+void PagedTree_PrintStats(PagedUserTree* tree) 
+{
+    pthread_mutex_lock(&tree->lock);
+
+    uint64_t lookups = tree->hits + tree->misses;
+
+    printf("%lld users in %u pages (%.1f MB), height %u.\n", (long long)tree->header.count, tree->header.num_pages,
+           (double)tree->header.num_pages * PAGED_PAGE_SIZE / (1024.0 * 1024.0), tree->header.height);
+    printf("Page pool: %d frames (%.1f MB), %llu hits, %llu misses (%.1f%% hit rate), %llu pages written.\n", tree->num_frames,
+           (double)tree->num_frames * PAGED_PAGE_SIZE / (1024.0 * 1024.0), (unsigned long long)tree->hits, (unsigned long long)tree->misses,
+           lookups ? 100.0 * tree->hits / lookups : 0.0, (unsigned long long)tree->writes);
+
+    pthread_mutex_unlock(&tree->lock);
+}
+
+
+// Thread-safe Engine
+// Lets several gate threads and a dashboard share one process, the way the facility host
+// shares its user index. Gate events take the reader/writer lock shared and the striped
+// lock of their plate (see Process_Gate_Batch), find users optimistically and register
+// new ones with a latched insert into the concurrent user tree, so entries and exits for
+// different plates run in parallel; slot allocation itself is lock-free (see Claim_Slot).
+// Point lookups take the lock shared and the plate's lock while they copy a record out.
+// The lock is taken exclusive by whatever walks the whole user tree or many records at
+// once (reports, scans, saves, settlement) and by compaction for the moment it swaps in
+// a rebuilt root; the rebuild itself runs under the shared lock (see Engine_CompactTree).
+// Slot counters read under the shared lock may be one gate event behind.
+// With a paged user database the users live on disk and userTree holds only the resident
+// ones: a plate not in memory is faulted in from the paged tree under its plate's lock,
+// and records go back to disk on save and when the resident set outgrows
+// PAGED_RESIDENT_USERS, which keeps only parked users (slots and the parked list point
+// at them). The resident set is counted every PAGED_FAULT_CHECK_INTERVAL fault-ins, by
+// whichever call brought in the last of them, and with the fill-factor check of gates. The users resident at a save are written to PAGED_RESIDENT_FILE so the next
+// start has its parked vehicles without reading the paged database. Misread correction,
+// plate scans and similar-plate search only know the resident users.
+#define PAGED_RESIDENT_FILE "sample_user_resident.csv"
+#define PAGED_RESIDENT_USERS 65536
+#define PAGED_FAULT_CHECK_INTERVAL 1024
+
+typedef struct ParkingEngine 
+{
+    GenericBPlusTreeNode* parkingRoot;
+    ConcurrentBPlusTree userTree;
+    UserPool users;            // Every user record of userTree, loaded or registered at a gate
+    PagedUserTree* paged;      // The user database when it is paged, else NULL
+    pthread_mutex_t plate_locks[GATE_PLATE_LOCKS];
+    pthread_rwlock_t lock;
+    uint64_t write_epoch;      // Bumped whenever userTree may have gained or lost records
+    uint64_t writes_since_check;
+    uint64_t faults_since_check; // Paged fault-ins since the resident set was last counted
+    double compact_threshold;  // Auto-compact the user tree when average leaf fill drops below this
+
+} ParkingEngine;
+
+// A pool record holding a user read from the paged database, not on any list yet
+User* engineAdoptUser(ParkingEngine* engine, const User* paged_user) 
+{
+    User* user = UserPool_Alloc(&engine->users);
+
+    *user = *paged_user;
+    user->prev_parked = NULL;
+    user->next_parked = NULL;
+    for (int h = 0; h < PARKED_HEAPS; h++) user->heap_pos[h] = -1;
+
+    return user;
+}
+
+void visitAdoptParkedUser(const void* data, void* ctx) 
+{
+    ParkingEngine* engine = (ParkingEngine*)ctx;
+
+    if (((const User*)data)->status != PARKED) return;
+
+    User* user = engineAdoptUser(engine, (const User*)data);
+    if (Insert_BPlus(&engine->userTree.root, user, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey) != SUCCESS) 
+    {
+        UserPool_Free(&engine->users, user);
+    }
+}
+
+// user_file is the user database, or with paged given, the resident users of the last save
+bool Engine_Init(ParkingEngine* engine, const char* parking_file, const char* user_file, PagedUserTree* paged) 
+{
+    if (pthread_rwlock_init(&engine->lock, NULL) != 0) 
+    {
+        perror("Failed to initialise engine lock");
+        return false;
+    }
+
+    for (int i = 0; i < GATE_PLATE_LOCKS; i++) pthread_mutex_init(&engine->plate_locks[i], NULL);
+
+    engine->parkingRoot = Facility_Load(&g_defaultFacility, NULL, parking_file);
+    engine->paged = paged;
+    UserPool_Init(&engine->users);
+
+    // A paged database never served before (just imported) has no resident file yet; its
+    // parked users are then found with one pass over it
+    bool resident = !paged || access(user_file, F_OK) == 0;
+    Init_Concurrent_BPlus(&engine->userTree, resident ? READ_DATABASE_Pooled(user_file, &engine->users) : NULL);
+    if (!resident) PagedTree_ForEach(paged, visitAdoptParkedUser, engine);
+    PlateIndex_Build(&g_plateIndex, engine->userTree.root);
+    Parked_Rebuild(engine->parkingRoot, engine->userTree.root);
+    Session_Load(&g_sessionStore, SESSION_DB_FILE);
+    Tariff_Load(&g_tariff, TARIFF_CONFIG_FILE);
+    engine->write_epoch = 0;
+    engine->writes_since_check = 0;
+    engine->faults_since_check = 0;
+    engine->compact_threshold = COMPACT_DEFAULT_THRESHOLD;
+
+    return true;
+}
+
+// Rebuild one tree into densely packed nodes. The copy is built under the shared lock while
+// gates keep running, and only the root swap is exclusive. Gates add to the user tree under
+// the shared lock and bump write_epoch after they may have, so a user copy is swapped in
+// only if the epoch did not move while it was built; otherwise it is thrown away and built
+// again. The parking tree never changes shape after loading, so its copy always stands.
+bool Engine_CompactTree(ParkingEngine* engine, bool users) 
+{
+    GetKeyFromDataFunc getKey = users ? getUserKey : getParkingKey;
+    CopyKeyFunc copyKey = users ? copyUserKey : copyParkingKey;
+    FreeKeyFunc freeKey = users ? freeUserKey : freeParkingKey;
+    GenericBPlusTreeNode** rootRef = users ? &engine->userTree.root : &engine->parkingRoot;
+
+    for (int attempt = 0; attempt < COMPACT_SWAP_ATTEMPTS; attempt++) 
+    {
+        GenericBPlusTreeNode* compacted;
+
+        pthread_rwlock_rdlock(&engine->lock);
+        uint64_t epoch = __atomic_load_n(&engine->write_epoch, __ATOMIC_ACQUIRE);
+        bool built = users
+                   ? Compact_BPlus_OLC(&engine->userTree, COMPACT_LEAF_FILL, getKey, copyKey, &compacted)
+                   : Compact_BPlus(engine->parkingRoot, COMPACT_LEAF_FILL, getKey, copyKey, &compacted);
+        pthread_rwlock_unlock(&engine->lock);
+
+        if (!built) return false;
+
+        pthread_rwlock_wrlock(&engine->lock);
+
+        if (!users || __atomic_load_n(&engine->write_epoch, __ATOMIC_ACQUIRE) == epoch) 
+        {
+            GenericBPlusTreeNode* old_root = *rootRef;
+            *rootRef = compacted;
+
+            // Nobody can be inside the old tree while we hold the lock; records now belong to the new one
+            Destroy_BPlus_Tree(&old_root, NULL, freeKey);
+            pthread_rwlock_unlock(&engine->lock);
+
+            return true;
+        }
+
+        pthread_rwlock_unlock(&engine->lock);
+        Destroy_BPlus_Tree(&compacted, NULL, freeKey);
+    }
+
+    return false;
+}
+
+bool Engine_Compact(ParkingEngine* engine) 
+{
+    bool users = Engine_CompactTree(engine, true);
+    bool parking = Engine_CompactTree(engine, false);
+
+    return users && parking;
+}
+
+void visitWriteBackUser(const void* data, void* ctx) 
+{
+    if (!PagedTree_Put((PagedUserTree*)ctx, (const User*)data)) fprintf(stderr, "Failed to write back user %s.\n", ((const User*)data)->vehicle_num);
+}
+
+// Paged mode, engine lock held exclusive: bring the paged database up to date with every
+// resident user, then keep only the parked ones in memory. Returns how many were evicted.
+long engineEvictLocked(ParkingEngine* engine) 
+{
+    ForEach_BPlus(engine->userTree.root, visitWriteBackUser, engine->paged);
+
+    long count = 0;
+    void** records = collectRecords(engine->userTree.root, &count);
+    if (!records) return 0;
+
+    // Parked users to the front in plate order, the rest behind them
+    long kept = 0;
+    for (long i = 0; i < count; i++) 
+    {
+        if (((User*)records[i])->status != PARKED) continue;
+
+        void* parked = records[i];
+        records[i] = records[kept];
+        records[kept++] = parked;
+    }
+
+    GenericBPlusTreeNode* resident = BulkLoad_BPlus(records, kept, COMPACT_LEAF_FILL, getUserKey, copyUserKey);
+
+    if (kept > 0 && !resident) 
+    {
+        trackedFree(records);
+        return 0;
+    }
+
+    GenericBPlusTreeNode* old_root = engine->userTree.root;
+    engine->userTree.root = resident;
+    __atomic_add_fetch(&engine->write_epoch, 1, __ATOMIC_RELEASE);
+    Destroy_BPlus_Tree(&old_root, NULL, freeUserKey);
+    PlateIndex_Build(&g_plateIndex, resident);
+
+    for (long i = kept; i < count; i++) UserPool_Free(&engine->users, (User*)records[i]);
+    trackedFree(records);
+
+    return count - kept;
+}
+
+// Called by writers after they drop the lock; only every COMPACT_CHECK_INTERVAL writes pays for the stats walk
+void Engine_MaybeCompact(ParkingEngine* engine, int writes) 
+{
+    if (__atomic_add_fetch(&engine->writes_since_check, writes, __ATOMIC_RELAXED) < COMPACT_CHECK_INTERVAL) return;
+    __atomic_store_n(&engine->writes_since_check, 0, __ATOMIC_RELAXED);
+
+    BPlusTreeStats stats;
+    pthread_rwlock_rdlock(&engine->lock);
+    BPlusTree_LeafStats_OLC(&engine->userTree, &stats);
+    pthread_rwlock_unlock(&engine->lock);
+
+    if (engine->paged && stats.records > PAGED_RESIDENT_USERS) 
+    {
+        pthread_rwlock_wrlock(&engine->lock);
+        engineEvictLocked(engine);
+        pthread_rwlock_unlock(&engine->lock);
+    }
+    else if (stats.leaf_nodes > 1 && stats.avg_leaf_fill < engine->compact_threshold) 
+    {
+        Engine_CompactTree(engine, true);
+    }
+}
+
+// Paged mode: make a plate's record resident, or NULL if the paged database has none.
+// Engine lock held shared and the plate's lock held, so nobody else faults it in meanwhile.
+User* engineFaultIn(ParkingEngine* engine, const char* vehicle_num) 
+{
+    User scratch;
+    if (!PagedTree_Get(engine->paged, vehicle_num, &scratch)) return NULL;
+
+    User* user = engineAdoptUser(engine, &scratch);
+
+    // Every vehicle parked here is resident, so a parked record on disk is from a run that
+    // was never saved; its slot was not saved either
+    if (user->status == PARKED) 
+    {
+        user->status = NOTPARKED;
+        user->parking_space_id = -1;
+    }
+
+    if (Insert_BPlus_OLC(&engine->userTree, user, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey) != SUCCESS) 
+    {
+        UserPool_Free(&engine->users, user);
+        return NULL;
+    }
+
+    __atomic_add_fetch(&engine->write_epoch, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&engine->faults_since_check, 1, __ATOMIC_RELAXED);
+    PlateIndex_Add(&g_plateIndex, user);
+
+    return user;
+}
+
+// Engine lock held shared. Find a plate's record; the caller holds the plate's lock.
+User* engineFindUser(ParkingEngine* engine, const char* vehicle_num) 
+{
+    User* user = (User*)Search_BPlus_OLC(&engine->userTree, vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal);
+
+    if (!user && engine->paged) user = engineFaultIn(engine, vehicle_num);
+
+    return user;
+}
+
+// Called after dropping the lock by everything that may fault users in; every
+// PAGED_FAULT_CHECK_INTERVAL fault-ins pay for counting the resident set
+void Engine_MaybeEvict(ParkingEngine* engine) 
+{
+    if (!engine->paged || __atomic_load_n(&engine->faults_since_check, __ATOMIC_RELAXED) < PAGED_FAULT_CHECK_INTERVAL) return;
+    __atomic_store_n(&engine->faults_since_check, 0, __ATOMIC_RELAXED);
+
+    BPlusTreeStats stats;
+    pthread_rwlock_rdlock(&engine->lock);
+    BPlusTree_LeafStats_OLC(&engine->userTree, &stats);
+    pthread_rwlock_unlock(&engine->lock);
+
+    if (stats.records > PAGED_RESIDENT_USERS) 
+    {
+        pthread_rwlock_wrlock(&engine->lock);
+        engineEvictLocked(engine);
+        pthread_rwlock_unlock(&engine->lock);
+    }
+}
+
+bool Engine_Enter(ParkingEngine* engine, const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time, int entrance, uint32_t required_attrs) 
+{
+    int parking_id = -1;
+    pthread_mutex_t* plate_lock = gatePlateLock(engine->plate_locks, vehicle_num);
+
+    pthread_rwlock_rdlock(&engine->lock);
+    pthread_mutex_lock(plate_lock);
+    User* user = engineFindUser(engine, vehicle_num);
+    bool known = user != NULL;
+    gate_status status = Gate_Enter(&engine->parkingRoot, NULL, &engine->userTree, &engine->users, &user, vehicle_num, owner_name, arrival_date, arrival_time, entrance, required_attrs, &parking_id);
+    if (!known && user) __atomic_add_fetch(&engine->write_epoch, 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(plate_lock);
+    pthread_rwlock_unlock(&engine->lock);
+
+    Engine_MaybeEvict(engine);
+    Engine_MaybeCompact(engine, 1);
+
+    return status == GATE_OK;
+}
+
+bool Engine_Exit(ParkingEngine* engine, const char* vehicle_num, const char* departure_date, const char* departure_time) 
+{
+    int parking_id = -1;
+    pthread_mutex_t* plate_lock = gatePlateLock(engine->plate_locks, vehicle_num);
+
+    pthread_rwlock_rdlock(&engine->lock);
+    pthread_mutex_lock(plate_lock);
+    User* user = engineFindUser(engine, vehicle_num);
+    gate_status status = Gate_Exit(&engine->parkingRoot, &user, vehicle_num, departure_date, departure_time, &parking_id);
+    pthread_mutex_unlock(plate_lock);
+    pthread_rwlock_unlock(&engine->lock);
+
+    Engine_MaybeEvict(engine);
+
+    return status == GATE_OK;
+}
+
+// Copy the fields a plate's lock guards; the parked-list links and heap positions belong
+// to the list's own lock and mean nothing outside it, so they are left cleared
+void engineCopyUser(User* out, const User* user) 
+{
+    memcpy(out, user, offsetof(User, prev_parked));
+    out->prev_parked = NULL;
+    out->next_parked = NULL;
+    for (int h = 0; h < PARKED_HEAPS; h++) out->heap_pos[h] = -1;
+}
+
+// Copies the record out so the caller never holds a pointer a writer may be changing
+bool Engine_LookupUser(ParkingEngine* engine, const char* vehicle_num, User* out) 
+{
+    pthread_mutex_t* plate_lock = gatePlateLock(engine->plate_locks, vehicle_num);
+
+    pthread_rwlock_rdlock(&engine->lock);
+    pthread_mutex_lock(plate_lock);
+    User* userFound = engineFindUser(engine, vehicle_num);
+
+    if (userFound) 
+    {
+        engineCopyUser(out, userFound);
+    }
+
+    pthread_mutex_unlock(plate_lock);
+    pthread_rwlock_unlock(&engine->lock);
+
+    Engine_MaybeEvict(engine);
+
+    return userFound != NULL;
+}
+
+bool Engine_LookupParking(ParkingEngine* engine, int parking_id, Parking* out) 
+{
+    pthread_rwlock_rdlock(&engine->lock);
+    Parking* parkingFound = SearchParking_BPlus(engine->parkingRoot, parking_id);
+
+    if (parkingFound) 
+    {
+        *out = *parkingFound;
+    }
+
+    pthread_rwlock_unlock(&engine->lock);
+
+    return parkingFound != NULL;
+}
+
+// Copies out the user parked in a slot; false if the slot is vacant or unknown
+bool Engine_LookupOccupant(ParkingEngine* engine, int parking_id, User* out) 
+{
+    pthread_rwlock_rdlock(&engine->lock);
+    Parking* parkingFound = SearchParking_BPlus(engine->parkingRoot, parking_id);
+    User* occupant = parkingFound ? Slot_Occupant(parkingFound) : NULL;
+
+    // Plates never change, so the occupant's lock can be found first; then make sure it is still there
+    while (occupant) 
+    {
+        pthread_mutex_t* plate_lock = gatePlateLock(engine->plate_locks, occupant->vehicle_num);
+        pthread_mutex_lock(plate_lock);
+
+        User* current = Slot_Occupant(parkingFound);
+        if (current == occupant) engineCopyUser(out, occupant);
+
+        pthread_mutex_unlock(plate_lock);
+
+        if (current == occupant) break;
+        occupant = current;
+    }
+
+    pthread_rwlock_unlock(&engine->lock);
+
+    return occupant != NULL;
+}
+
+// Visit vehicles parked for at least minutes as of minute now, oldest first; returns how many
+long Engine_Overstays(ParkingEngine* engine, int64_t now, int64_t minutes, OverstayFunc visit, void* ctx) 
+{
+    pthread_rwlock_rdlock(&engine->lock);
+    long found = Parked_Overstays(&g_parked, now, minutes, visit, ctx);
+    pthread_rwlock_unlock(&engine->lock);
+
+    return found;
+}
+
+// Price every parked vehicle as of minute cutoff; exclusive, since it reads the hours on
+// record of every parked user
+bool Engine_Settle(ParkingEngine* engine, int64_t cutoff, Settlement* settlement) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    bool ok = Settlement_Run(&g_parked, cutoff, 0, settlement);
+    pthread_rwlock_unlock(&engine->lock);
+
+    return ok;
+}
+
+// Alarms fire from inside gate events, so they are changed with every gate shut out
+void Engine_SetOverstayAlarm(ParkingEngine* engine, int64_t minutes, OverstayFunc alarm, void* ctx) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    Parked_SetOverstayAlarm(&g_parked, minutes, alarm, ctx);
+    pthread_rwlock_unlock(&engine->lock);
+}
+
+// Whole batch runs under one shared acquisition, each event under its plate's lock
+int Engine_ProcessBatch(ParkingEngine* engine, GateEvent* events, int count) 
+{
+    pthread_rwlock_rdlock(&engine->lock);
+
+    // The batch only looks in memory, so paged-out plates are faulted in first
+    for (int i = 0; engine->paged && i < count; i++) 
+    {
+        pthread_mutex_t* plate_lock = gatePlateLock(engine->plate_locks, events[i].vehicle_num);
+        pthread_mutex_lock(plate_lock);
+        engineFindUser(engine, events[i].vehicle_num);
+        pthread_mutex_unlock(plate_lock);
+    }
+
+    int succeeded = Process_Gate_Batch(&engine->parkingRoot, &engine->userTree, engine->plate_locks, &engine->users, events, count);
+    __atomic_add_fetch(&engine->write_epoch, 1, __ATOMIC_RELEASE); // It may have registered plates
+    pthread_rwlock_unlock(&engine->lock);
+
+    Engine_MaybeEvict(engine);
+    Engine_MaybeCompact(engine, count);
+
+    return succeeded;
+}
+
+// Hold a slot for [start, end) in the tier of the vehicle's membership (Standard if it is
+// new). Returns the reservation id or -1.
+int64_t Engine_Reserve(ParkingEngine* engine, const char* vehicle_num, int64_t start, int64_t end, int* parking_id) 
+{
+    int min_id, max_id;
+    pthread_mutex_t* plate_lock = gatePlateLock(engine->plate_locks, vehicle_num);
+
+    pthread_rwlock_rdlock(&engine->lock);
+    pthread_mutex_lock(plate_lock);
+    User* user = engineFindUser(engine, vehicle_num);
+    Membership_Slot_Range(user ? user->membership : 0, &min_id, &max_id);
+    pthread_mutex_unlock(plate_lock);
+
+    int64_t reservation = Reservation_Create(&g_reservations, engine->parkingRoot, vehicle_num, min_id, max_id, start, end, parking_id);
+    pthread_rwlock_unlock(&engine->lock);
+
+    Engine_MaybeEvict(engine);
+
+    return reservation;
+}
+
+void Engine_PrintOneEntry(ParkingEngine* engine, const char* vehicle_num) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    PrintOneEntry_BPlus(engine->userTree.root, vehicle_num);
+    pthread_rwlock_unlock(&engine->lock);
+}
+
+void Engine_PrintParked(ParkingEngine* engine, int parking_id) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    Parked_Print(&g_parked, engine->parkingRoot, parking_id);
+    pthread_rwlock_unlock(&engine->lock);
+}
+
+// Known plates near vehicle_num; see PlateIndex_Similar. Exclusive, since the index may
+// sort its plates again from the user tree.
+int Engine_SimilarPlates(ParkingEngine* engine, const char* vehicle_num, int max_distance, PlateMatch* out, int max) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    int found = PlateIndex_Similar(&g_plateIndex, engine->userTree.root, vehicle_num, max_distance, out, max);
+    pthread_rwlock_unlock(&engine->lock);
+
+    return found;
+}
+
+// Plate scans: a prefix when to is NULL, otherwise [from, to)
+long Engine_ScanPlates(ParkingEngine* engine, const char* from, const char* to, void (*visit)(const void* data, void* ctx), void* ctx) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    long found = to ? Users_ForRange(engine->userTree.root, from, to, visit, ctx) : Users_ForPrefix(engine->userTree.root, from, visit, ctx);
+    pthread_rwlock_unlock(&engine->lock);
+
+    return found;
+}
+
+// Run a read-only report against one of the trees; the parking tree's needs only the shared lock
+void Engine_UserReport(ParkingEngine* engine, void (*report)(GenericBPlusTreeNode*)) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    report(engine->userTree.root);
+    pthread_rwlock_unlock(&engine->lock);
+}
+
+void Engine_ParkingReport(ParkingEngine* engine, void (*report)(GenericBPlusTreeNode*)) 
+{
+    pthread_rwlock_rdlock(&engine->lock);
+    report(engine->parkingRoot);
+    pthread_rwlock_unlock(&engine->lock);
+}
+
+// In paged mode user_file gets the resident users, after they are written back and flushed
+void Engine_Save(ParkingEngine* engine, const char* parking_file, const char* user_file) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    if (engine->paged) 
+    {
+        ForEach_BPlus(engine->userTree.root, visitWriteBackUser, engine->paged);
+        if (!PagedTree_Flush(engine->paged)) fprintf(stderr, "Failed to write paged user database.\n");
+    }
+    WRITE_DATABASE_BPlus(user_file, engine->userTree.root);
+    Facility_Save(&g_defaultFacility, engine->parkingRoot, NULL, parking_file);
+    pthread_rwlock_unlock(&engine->lock);
+
+    Session_Save(&g_sessionStore, SESSION_DB_FILE);
+}
+
+// Export both trees in one format
+bool Engine_Export(ParkingEngine* engine, export_format format, const char* user_file, const char* parking_file) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    long users = Export_Users(engine->userTree.root, user_file, format, 0);
+    long slots = Export_Parking(engine->parkingRoot, parking_file, format, 0);
+    pthread_rwlock_unlock(&engine->lock);
+
+    return users >= 0 && slots >= 0;
+}
+
+void Engine_PrintStats(ParkingEngine* engine) 
+{
+    BPlusTreeStats stats;
+
+    pthread_rwlock_wrlock(&engine->lock);
+    BPlusTree_Stats(engine->userTree.root, userKeySize, sizeof(User), &stats);
+    printTreeStats("User", &stats);
+    BPlusTree_Stats(engine->parkingRoot, parkingKeySize, sizeof(Parking), &stats);
+    printTreeStats("Parking", &stats);
+    pthread_rwlock_unlock(&engine->lock);
+
+    Memory_Report(stdout);
+}
+
+void Engine_Destroy(ParkingEngine* engine) 
+{
+    pthread_rwlock_wrlock(&engine->lock);
+    // User records belong to the pool, so only the tree structure is freed here
+    Destroy_BPlus_Tree(&engine->userTree.root, NULL, freeUserKey);
+    UserPool_Destroy(&engine->users);
+    Destroy_BPlus_Tree(&engine->parkingRoot, freeParking, freeParkingKey);
+    pthread_rwlock_unlock(&engine->lock);
+
+    Session_Destroy(&g_sessionStore);
+    Facility_Unload(&g_defaultFacility);
+    PlateIndex_Destroy(&g_plateIndex);
+
+    pthread_rwlock_destroy(&engine->lock);
+    for (int i = 0; i < GATE_PLATE_LOCKS; i++) pthread_mutex_destroy(&engine->plate_locks[i]);
+}
+
+
+// Hash-Sharded User Index
+// Alternative to locking one big user tree: plates are spread over N independent
+// shards by hash, each with its own tree, record pool and mutex. Gate events for
+// plates in different shards never touch the same lock; slot claims stay race-free
+// through Claim_Slot. Ordered output merges the shards' leaf chains on the fly.
+// --shardtest drives it with one worker thread per shard (see Shard Test).
+#define DEFAULT_USER_SHARDS 16
+
+typedef struct UserShard 
+{
+    GenericBPlusTreeNode* root;
+    UserPool pool;
+    pthread_mutex_t lock;
+
+} __attribute__((aligned(64))) UserShard; // One shard per cache line group, no false sharing
+
+typedef struct ShardedUserIndex 
+{
+    int num_shards;
+    UserShard* shards;
+
+} ShardedUserIndex;
+
+bool Sharded_Init(ShardedUserIndex* index, int num_shards) 
+{
+    if (num_shards <= 0) num_shards = DEFAULT_USER_SHARDS;
+
+    index->shards = (UserShard*)trackedAlignedAlloc(64, sizeof(UserShard) * num_shards, MEM_USER_POOL);
+
+    if (!index->shards) 
+    {
+        perror("Failed to allocate user shards");
+        return false;
+    }
+
+    index->num_shards = num_shards;
+
+    for (int i = 0; i < num_shards; i++) 
+    {
+        index->shards[i].root = NULL;
+        UserPool_Init(&index->shards[i].pool);
+        pthread_mutex_init(&index->shards[i].lock, NULL);
+    }
+
+    return true;
+}
+
+// Plates are placed by their folded form, so a misread plate is corrected within its own shard
+UserShard* Sharded_ShardFor(ShardedUserIndex* index, const char* vehicle_num) 
+{
+    return &index->shards[hashFoldedPlate(vehicle_num) % (uint32_t)index->num_shards];
+}
+
+// Load the user CSV, routing every row to its shard
+bool Sharded_Load(ShardedUserIndex* index, const char* filename) 
+{
+    FILE* file = fopen(filename, "r");
+
+    if (!file) 
+    {
+        perror("Unable to open user file for reading");
+        return false;
+    }
+
+    char line[512];
+
+    if (fgets(line, sizeof(line), file) == NULL) 
+    {
+        fclose(file);
+        return true;
+    }
+
+    int line_num = 1;
+    while (fgets(line, sizeof(line), file) != NULL) 
+    {
+        line_num++;
+
+        User scratch;
+        parseUserLine(line, &scratch);
+
+        UserShard* shard = Sharded_ShardFor(index, scratch.vehicle_num);
+        pthread_mutex_lock(&shard->lock);
+
+        User* newUser = UserPool_Alloc(&shard->pool);
+        *newUser = scratch;
+
+        status_code status = Insert_BPlus(&shard->root, newUser, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey);
+
+        if (status != SUCCESS) 
+        {
+            fprintf(stderr, "Failed to insert user record from line %d: %s\n", line_num, line);
+            UserPool_Free(&shard->pool, newUser);
+        }
+        else 
+        {
+            PlateIndex_Add(&g_plateIndex, newUser);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    fclose(file);
+    printf("Read user records into %d shards successfully.\n", index->num_shards);
+
+    return true;
+}
+
+bool Sharded_Enter(ShardedUserIndex* index, GenericBPlusTreeNode** parkingRootRef, const char* vehicle_num, const char* owner_name, const char* arrival_date, const char* arrival_time) 
+{
+    UserShard* shard = Sharded_ShardFor(index, vehicle_num);
+
+    pthread_mutex_lock(&shard->lock);
+    bool status = Insert_Update_Pooled(parkingRootRef, &shard->root, &shard->pool, vehicle_num, owner_name, arrival_date, arrival_time, 0, 0);
+    pthread_mutex_unlock(&shard->lock);
+
+    return status;
+}
+
+bool Sharded_Exit(ShardedUserIndex* index, GenericBPlusTreeNode** parkingRootRef, const char* vehicle_num, const char* departure_date, const char* departure_time) 
+{
+    UserShard* shard = Sharded_ShardFor(index, vehicle_num);
+
+    pthread_mutex_lock(&shard->lock);
+    bool status = Exit_Vehicle_BPlus(parkingRootRef, &shard->root, vehicle_num, departure_date, departure_time);
+    pthread_mutex_unlock(&shard->lock);
+
+    return status;
+}
+
+bool Sharded_LookupUser(ShardedUserIndex* index, const char* vehicle_num, User* out) 
+{
+    UserShard* shard = Sharded_ShardFor(index, vehicle_num);
+
+    pthread_mutex_lock(&shard->lock);
+    User* userFound = SearchUser_BPlus(shard->root, vehicle_num);
+
+    if (userFound) 
+    {
+        *out = *userFound;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return userFound != NULL;
+}
+
+// Visit every user in vehicle_num order across all shards. All shard locks are held
+// (taken in shard order) for the duration so the merge sees one consistent snapshot.
+void Sharded_ForEachOrdered(ShardedUserIndex* index, void (*visit)(const void* data, void* ctx), void* ctx) 
+{
+    BPlusCursor* cursors = (BPlusCursor*)trackedMalloc(sizeof(BPlusCursor) * index->num_shards, MEM_SCRATCH);
+
+    if (!cursors) 
+    {
+        perror("Failed to allocate shard cursors");
+        return;
+    }
+
+    for (int i = 0; i < index->num_shards; i++) 
+    {
+        pthread_mutex_lock(&index->shards[i].lock);
+        Cursor_First(&cursors[i], index->shards[i].root);
+    }
+
+    while (true) 
+    {
+        int best = -1;
+        const User* bestUser = NULL;
+
+        for (int i = 0; i < index->num_shards; i++) 
+        {
+            const User* candidate = (const User*)Cursor_Peek(&cursors[i]);
+            if (!candidate) continue;
+
+            if (bestUser == NULL || strcmp(candidate->vehicle_num, bestUser->vehicle_num) < 0) 
+            {
+                best = i;
+                bestUser = candidate;
+            }
+        }
+
+        if (best < 0) break;
+
+        visit(bestUser, ctx);
+        Cursor_Next(&cursors[best]);
+    }
+
+    for (int i = index->num_shards - 1; i >= 0; i--) 
+    {
+        pthread_mutex_unlock(&index->shards[i].lock);
+    }
+
+    trackedFree(cursors);
+}
+
+void visitPrintUser(const void* data, void* ctx) 
+{
+    (void)ctx;
+    printUser(data);
+}
+
+void visitPrintUserInFile(const void* data, void* ctx) 
+{
+    printUserInFile(data, (FILE*)ctx);
+}
+
+// Same file layout as WRITE_DATABASE_BPlus
+void Sharded_WriteDatabase(const char* filename, ShardedUserIndex* index) 
+{
+    FILE* file = fopen(filename, "w");
+
+    if (!file) 
+    {
+        perror("Unable to open user file for writing");
+        return;
+    }
+
+    fprintf(file, USER_CSV_HEADER);
+
+    Sharded_ForEachOrdered(index, visitPrintUserInFile, file);
+
+    fclose(file);
+
+    printf("User database written successfully.\n");
+}
+
+void Sharded_Destroy(ShardedUserIndex* index) 
+{
+    for (int i = 0; i < index->num_shards; i++) 
+    {
+        UserShard* shard = &index->shards[i];
+
+        // Records belong to the pool, so only the tree structure is freed here
+        Destroy_BPlus_Tree(&shard->root, NULL, freeUserKey);
+        UserPool_Destroy(&shard->pool);
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    trackedFree(index->shards);
+    index->shards = NULL;
+    index->num_shards = 0;
+}
+
+
+// Gate Server
+// Daemon mode: one long-lived engine process serving gate terminals over a Unix
+// domain socket or localhost TCP. The protocol is one request per line, one
+// response line per request (reports answer "OK <n>" followed by n lines):
+//
+//   ENTER <plate> <owner> <DD/MM/YYYY> <HH:MM> [entrance [ev|covered|...]]   -> OK <slot>
+//   EXIT <plate> <DD/MM/YYYY> <HH:MM>            -> OK <slot> <amount>
+//   GET <plate>                                  -> OK <plate> <owner> <parked> <slot> <parkings> <membership> <total_amt>
+//   SLOT <id>                                    -> OK <id> <occupied> <revenue> <occupancies>
+//   OCCUPANT <id>                                -> OK <plate> <owner> <arrival date> <arrival time>
+//   PARKED                                       -> OK <n>, then n lines <slot> <plate> <owner> <date> <time> by slot
+//   OVERSTAY <hours> <DD/MM/YYYY> <HH:MM>        -> OK <n>, then n lines <slot> <plate> <date> <time> <minutes>,
+//                                                   vehicles parked at least that long by then, oldest first
+//   SETTLE <DD/MM/YYYY> <HH:MM>                  -> OK <vehicles> <total> <standard> <premium> <gold>, due if all left then
+//   REPORT USERS | REPORT PARKING                -> OK <n>, then n record lines in key order
+//   PLATES <prefix> | PLATES <from> <to>         -> OK <n>, then n user lines (as REPORT USERS) for plates
+//                                                   starting with prefix, or in [from, to)
+//   PLATECOUNT <prefix> | PLATECOUNT <from> <to> -> OK <n>
+//   SIMILAR <plate> [distance]                   -> OK <n>, then n lines <plate> <edits>, known plates within
+//                                                   distance (default 2) edits, nearest first, at most 16
+//   METRICS                                      -> OK <n>, then n exposition lines (metrics builds only)
+//   COMPACT                                      -> OK once both trees are rebuilt densely packed
+//   REVENUE <DD/MM/YYYY> <DD/MM/YYYY>            -> OK <sessions> <revenue> for departures on those days
+//   VISITS <plate>                               -> OK <n>, then n lines <slot> <arrival> <departure> <amount>
+//   RESERVE <plate> <DD/MM/YYYY> <HH:MM> <DD/MM/YYYY> <HH:MM>  -> OK <reservation> <slot>
+//   CANCEL <reservation>                         -> OK
+//   OCCUPANCY <series> minute|hour|day <DD/MM/YYYY> <DD/MM/YYYY>
+//                                                -> OK <n>, then n lines <bucket start> <level> <peak> <average>
+//   SAVE | PING
+//
+// With --paged <db> [frames] after the address, users are served from a paged user
+// database (see Paged User Tree) instead of being loaded whole. REPORT USERS then answers
+// ERR PAGED: SAVE writes back and flushes the database, and the full listing comes from
+// --paged <db> <frames> export <user_csv>.
+//
+// Clients may pipeline: everything already received on a connection is parsed in one
+// go, runs of consecutive ENTER/EXIT lines go through Engine_ProcessBatch together,
+// and responses are queued in request order. A client that sends faster than it reads
+// is not read from while more than SERVER_MAX_PENDING_OUT bytes of its responses are
+// unsent. A client may shut down its sending side after its last request; the
+// connection stays open until every response has been sent.
+#define SERVER_MAX_EVENTS 64
+#define SERVER_MAX_LINE 512
+#define SERVER_MAX_BATCH 64
+#define SERVER_READ_CHUNK 16384
+#define SERVER_MAX_PENDING_OUT (1 << 20)
+#define SERVER_MAX_SIMILAR 16
+
+typedef struct ServerConnection 
+{
+    int fd;
+    char* in;
+    size_t in_len;
+    size_t in_cap;
+    char* out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    uint32_t armed;    // Events epoll is watching for
+    bool read_closed;  // Nothing more will be read: the peer is done sending, or a line was too long
+    bool stalled;      // Complete lines wait in `in` for the output to drain
+
+    // Gate events parsed but not yet run, flushed before any other request
+    GateEvent batch[SERVER_MAX_BATCH];
+    int batch_len;
+
+} ServerConnection;
+
+static volatile sig_atomic_t g_server_stop = 0;
+
+void serverStopHandler(int sig) 
+{
+    (void)sig;
+    g_server_stop = 1;
+}
+
+const char* gateStatusName(gate_status status) 
+{
+    switch (status) 
+    {
+        case GATE_OK: return "OK";
+        case GATE_ALREADY_PARKED: return "ALREADY_PARKED";
+        case GATE_NO_SLOT: return "NO_SLOT";
+        case GATE_NOT_FOUND: return "NOT_FOUND";
+        case GATE_NOT_PARKED: return "NOT_PARKED";
+        default: return "FAILED";
+    }
+}
+
+bool setNonBlocking(int fd) 
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// "tcp:<port>" listens on 127.0.0.1, anything else is a Unix socket path
+int Server_Listen(const char* address) 
+{
+    int fd = -1;
+
+    if (strncmp(address, "tcp:", 4) == 0) 
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(address + 4));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) 
+        {
+            perror("Unable to bind TCP listener");
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    }
+    else 
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, address, sizeof(addr.sun_path) - 1);
+        unlink(address);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) 
+        {
+            perror("Unable to bind Unix socket");
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, 128) != 0 || !setNonBlocking(fd)) 
+    {
+        perror("Unable to listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Connect as a client to the same address syntax Server_Listen accepts
+int Server_Connect(const char* address) 
+{
+    int fd = -1;
+
+    if (strncmp(address, "tcp:", 4) == 0) 
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)atoi(address + 4));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) 
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        int one = 1;
+        if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    else 
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, address, sizeof(addr.sun_path) - 1);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) 
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    return fd;
+}
+
+bool ensureCapacity(char** buffer, size_t* cap, size_t needed) 
+{
+    if (needed <= *cap) return true;
+
+    size_t new_cap = (*cap == 0) ? 4096 : *cap;
+    while (new_cap < needed) new_cap *= 2;
+
+    char* grown = (char*)trackedRealloc(*buffer, new_cap, MEM_SERVER);
+    if (!grown) 
+    {
+        perror("Failed to grow connection buffer");
+        return false;
+    }
+
+    *buffer = grown;
+    *cap = new_cap;
+
+    return true;
+}
+
+void connectionAppend(ServerConnection* conn, const char* fmt, ...) 
+{
+    va_list args;
+    va_start(args, fmt);
+    char line[SERVER_MAX_LINE];
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (len < 0) return;
+    if (len >= (int)sizeof(line)) len = sizeof(line) - 1;
+
+    if (!ensureCapacity(&conn->out, &conn->out_cap, conn->out_len + len)) return;
+
+    memcpy(conn->out + conn->out_len, line, len);
+    conn->out_len += len;
+}
+
+void Server_FlushBatch(ParkingEngine* engine, ServerConnection* conn) 
+{
+    if (conn->batch_len == 0) return;
+
+    Engine_ProcessBatch(engine, conn->batch, conn->batch_len);
+
+    for (int i = 0; i < conn->batch_len; i++) 
+    {
+        GateEvent* event = &conn->batch[i];
+
+        if (event->result != GATE_OK) 
+        {
+            connectionAppend(conn, "ERR %s\n", gateStatusName(event->result));
+        }
+        else if (event->type == GATE_ENTRY) 
+        {
+            connectionAppend(conn, "OK %d\n", event->parking_id);
+        }
+        else 
+        {
+            connectionAppend(conn, "OK %d %.2f\n", event->parking_id, event->amount);
+        }
+    }
+
+    conn->batch_len = 0;
+}
+
+void appendUserLine(ServerConnection* conn, const User* user) 
+{
+    connectionAppend(conn, "%s %s %d %d %d %d %.2f\n", user->vehicle_num, user->owner_name, user->status == PARKED, user->parking_space_id, user->number_of_parkings, user->membership, user->total_parking_amt);
+}
+
+void Server_Report(ParkingEngine* engine, ServerConnection* conn, bool users) 
+{
+    // Only the paged database has every user, and a listing of it would sit whole in the
+    // connection's output; it is exported offline instead (SAVE, then --paged ... export)
+    if (users && engine->paged) 
+    {
+        connectionAppend(conn, "ERR PAGED\n");
+        return;
+    }
+
+    if (users) 
+    {
+        pthread_rwlock_wrlock(&engine->lock);
+    }
+    else 
+    {
+        pthread_rwlock_rdlock(&engine->lock);
+    }
+
+    GenericBPlusTreeNode* root = users ? engine->userTree.root : engine->parkingRoot;
+    connectionAppend(conn, "OK %ld\n", Count_BPlus(root));
+
+    BPlusCursor cursor;
+    void* batch[CURSOR_BATCH];
+    int fetched;
+
+    Cursor_First(&cursor, root);
+
+    while ((fetched = Cursor_FetchBatch(&cursor, batch, CURSOR_BATCH)) > 0) 
+    {
+        for (int i = 0; i < fetched; i++) 
+        {
+            if (users) 
+            {
+                appendUserLine(conn, (const User*)batch[i]);
+            }
+            else 
+            {
+                const Parking* slot = (const Parking*)batch[i];
+                connectionAppend(conn, "%d %d %.2f %d\n", slot->parking_id, slot->parking_space_status, slot->revenue, slot->occupancies);
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&engine->lock);
+}
+
+void Server_Parked(ParkingEngine* engine, ServerConnection* conn) 
+{
+    long count = 0;
+
+    pthread_rwlock_wrlock(&engine->lock);
+
+    User** users = Parked_BySlot(&g_parked, &count);
+    connectionAppend(conn, "OK %ld\n", count);
+
+    for (long i = 0; i < count; i++) 
+    {
+        connectionAppend(conn, "%d %s %s %s %s\n", users[i]->parking_space_id, users[i]->vehicle_num, users[i]->owner_name, users[i]->arrival_date, users[i]->arrival_time);
+    }
+
+    pthread_rwlock_unlock(&engine->lock);
+
+    trackedFree(users);
+}
+
+void visitAppendSession(const SessionRecord* session, void* ctx) 
+{
+    char arrival[24], departure[24];
+
+    formatTimestamp(session->arrival, arrival, sizeof(arrival));
+    formatTimestamp(session->departure, departure, sizeof(departure));
+
+    // Dates and times are joined with '-' to keep one token per field
+    arrival[10] = departure[10] = '-';
+    connectionAppend((ServerConnection*)ctx, "%d %s %s %.2f\n", session->parking_id, arrival, departure, session->amount_paise / 100.0);
+}
+
+// For replies whose count is only known after the walk: slot "OK <count>" in ahead of
+// the lines appended since start
+void connectionInsertCount(ServerConnection* conn, size_t start, long count) 
+{
+    char header[32];
+    int header_len = snprintf(header, sizeof(header), "OK %ld\n", count > 0 ? count : 0);
+
+    if (!ensureCapacity(&conn->out, &conn->out_cap, conn->out_len + header_len)) return;
+
+    memmove(conn->out + start + header_len, conn->out + start, conn->out_len - start);
+    memcpy(conn->out + start, header, header_len);
+    conn->out_len += header_len;
+}
+
+void Server_Visits(ServerConnection* conn, const char* vehicle_num) 
+{
+    size_t start = conn->out_len;
+    long visits = Session_ForPlate(&g_sessionStore, vehicle_num, visitAppendSession, conn);
+
+    connectionInsertCount(conn, start, visits);
+}
+
+typedef struct OverstayReply 
+{
+    ServerConnection* conn;
+    int64_t now;
+
+} OverstayReply;
+
+void visitAppendOverstay(const User* user, int64_t arrival, void* ctx) 
+{
+    OverstayReply* reply = (OverstayReply*)ctx;
+    connectionAppend(reply->conn, "%d %s %s %s %lld\n", user->parking_space_id, user->vehicle_num, user->arrival_date, user->arrival_time, (long long)(reply->now - arrival));
+}
+
+void visitAppendUser(const void* data, void* ctx) 
+{
+    appendUserLine((ServerConnection*)ctx, (const User*)data);
+}
+
+// PLATES <prefix> | PLATES <from> <to>, with count_only for PLATECOUNT
+void Server_Plates(ParkingEngine* engine, ServerConnection* conn, char** args, int argc, bool count_only) 
+{
+    const char* to = (argc == 2) ? args[1] : NULL;
+
+    if (count_only) 
+    {
+        connectionAppend(conn, "OK %ld\n", Engine_ScanPlates(engine, args[0], to, NULL, NULL));
+        return;
+    }
+
+    size_t start = conn->out_len;
+    long found = Engine_ScanPlates(engine, args[0], to, visitAppendUser, conn);
+
+    connectionInsertCount(conn, start, found);
+}
+
+// args: hours date time
+void Server_Overstay(ParkingEngine* engine, ServerConnection* conn, char** args) 
+{
+    double hours = atof(args[0]);
+    OverstayReply reply = { conn, parseTimestamp(args[1], args[2]) };
+
+    if (hours < 0 || reply.now < 0) 
+    {
+        connectionAppend(conn, "ERR USAGE\n");
+        return;
+    }
+
+    size_t start = conn->out_len;
+    long found = Engine_Overstays(engine, reply.now, llround(hours * 60), visitAppendOverstay, &reply);
+
+    connectionInsertCount(conn, start, found);
+}
+
+// args: series resolution from_date to_date
+void Server_Occupancy(ServerConnection* conn, char** args) 
+{
+    int resolution = -1;
+    for (int r = 0; r < OCC_RESOLUTIONS; r++) 
+    {
+        if (strcmp(args[1], occupancy_resolution_names[r]) == 0) resolution = r;
+    }
+
+    int64_t from = parseTimestamp(args[2], NULL), to = parseTimestamp(args[3], NULL);
+
+    if (resolution < 0 || from < 0 || to < from) 
+    {
+        connectionAppend(conn, "ERR USAGE\n");
+        return;
+    }
+
+    int max = occupancy_ring_length[resolution];
+    OccupancyPoint* points = (OccupancyPoint*)trackedMalloc(sizeof(OccupancyPoint) * max, MEM_SCRATCH);
+    if (!points) 
+    {
+        connectionAppend(conn, "ERR FAILED\n");
+        return;
+    }
+
+    int count = Occupancy_Window(&g_occupancy, atoi(args[0]), (occupancy_resolution)resolution, from, to + 1439, points, max);
+    char when[24];
+
+    connectionAppend(conn, "OK %d\n", count);
+    for (int i = 0; i < count; i++) 
+    {
+        formatTimestamp(points[i].start, when, sizeof(when));
+        when[10] = '-';
+        connectionAppend(conn, "%s %d %d %.3f\n", when, points[i].level, points[i].peak, points[i].average);
+    }
+
+    trackedFree(points);
+}
+
+// Handle one request line (already NUL-terminated, newline stripped)
+void Server_HandleLine(ParkingEngine* engine, ServerConnection* conn, char* line) 
+{
+    char* save = NULL;
+    char* command = strtok_r(line, " \t\r", &save);
+    if (!command) return;
+
+    char* args[6] = { NULL };
+    int argc = 0;
+    while (argc < 6 && (args[argc] = strtok_r(NULL, " \t\r", &save)) != NULL) argc++;
+
+    bool is_enter = strcmp(command, "ENTER") == 0;
+    bool is_exit = strcmp(command, "EXIT") == 0;
+
+    if (is_enter || is_exit) 
+    {
+        if (conn->batch_len == SERVER_MAX_BATCH) Server_FlushBatch(engine, conn);
+
+        if ((is_enter && argc < 4) || (is_exit && argc != 3) || !fillGateEvent(&conn->batch[conn->batch_len], is_enter, args)) 
+        {
+            Server_FlushBatch(engine, conn);
+            connectionAppend(conn, "ERR USAGE\n");
+            return;
+        }
+
+        conn->batch_len++;
+        return;
+    }
+
+    // Anything else must see the effect of the gate events queued before it
+    Server_FlushBatch(engine, conn);
+
+    if (strcmp(command, "GET") == 0 && argc == 1) 
+    {
+        User user;
+        if (Engine_LookupUser(engine, args[0], &user)) 
+        {
+            connectionAppend(conn, "OK %s %s %d %d %d %d %.2f\n", user.vehicle_num, user.owner_name, user.status == PARKED, user.parking_space_id, user.number_of_parkings, user.membership, user.total_parking_amt);
+        }
+        else 
+        {
+            connectionAppend(conn, "ERR NOT_FOUND\n");
+        }
+    }
+    else if (strcmp(command, "SLOT") == 0 && argc == 1) 
+    {
+        Parking slot;
+        if (Engine_LookupParking(engine, atoi(args[0]), &slot)) 
+        {
+            connectionAppend(conn, "OK %d %d %.2f %d\n", slot.parking_id, slot.parking_space_status, slot.revenue, slot.occupancies);
+        }
+        else 
+        {
+            connectionAppend(conn, "ERR NOT_FOUND\n");
+        }
+    }
+    else if (strcmp(command, "OCCUPANT") == 0 && argc == 1) 
+    {
+        User user;
+        if (Engine_LookupOccupant(engine, atoi(args[0]), &user)) 
+        {
+            connectionAppend(conn, "OK %s %s %s %s\n", user.vehicle_num, user.owner_name, user.arrival_date, user.arrival_time);
+        }
+        else 
+        {
+            connectionAppend(conn, "ERR NOT_FOUND\n");
+        }
+    }
+    else if (strcmp(command, "PARKED") == 0 && argc == 0) 
+    {
+        Server_Parked(engine, conn);
+    }
+    else if (strcmp(command, "OVERSTAY") == 0 && argc == 3) 
+    {
+        Server_Overstay(engine, conn, args);
+    }
+    else if (strcmp(command, "SETTLE") == 0 && argc == 2) 
+    {
+        Settlement settlement;
+        int64_t cutoff = parseTimestamp(args[0], args[1]);
+
+        if (cutoff >= 0 && Engine_Settle(engine, cutoff, &settlement)) 
+        {
+            connectionAppend(conn, "OK %ld %.2f %.2f %.2f %.2f\n", settlement.count, settlement.total_paise / 100.0, settlement.tier_paise[0] / 100.0, settlement.tier_paise[1] / 100.0, settlement.tier_paise[2] / 100.0);
+            Settlement_Free(&settlement);
+        }
+        else 
+        {
+            connectionAppend(conn, cutoff < 0 ? "ERR USAGE\n" : "ERR FAILED\n");
+        }
+    }
+    else if ((strcmp(command, "PLATES") == 0 || strcmp(command, "PLATECOUNT") == 0) && (argc == 1 || argc == 2)) 
+    {
+        Server_Plates(engine, conn, args, argc, strcmp(command, "PLATECOUNT") == 0);
+    }
+    else if (strcmp(command, "SIMILAR") == 0 && (argc == 1 || argc == 2)) 
+    {
+        PlateMatch matches[SERVER_MAX_SIMILAR];
+        int distance = (argc == 2) ? atoi(args[1]) : 2;
+        int found = (distance >= 0) ? Engine_SimilarPlates(engine, args[0], distance, matches, SERVER_MAX_SIMILAR) : 0;
+        int shown = found < SERVER_MAX_SIMILAR ? found : SERVER_MAX_SIMILAR;
+
+        connectionAppend(conn, "OK %d\n", shown);
+        for (int i = 0; i < shown; i++) 
+        {
+            connectionAppend(conn, "%s %d\n", matches[i].vehicle_num, matches[i].distance);
+        }
+    }
+    else if (strcmp(command, "REPORT") == 0 && argc == 1 && (strcmp(args[0], "USERS") == 0 || strcmp(args[0], "PARKING") == 0)) 
+    {
+        Server_Report(engine, conn, strcmp(args[0], "USERS") == 0);
+    }
+    else if (strcmp(command, "REVENUE") == 0 && argc == 2) 
+    {
+        int64_t from = parseTimestamp(args[0], NULL), to = parseTimestamp(args[1], NULL);
+        int64_t revenue = 0;
+        long sessions = (from >= 0 && to >= from) ? Session_RevenueBetween(&g_sessionStore, from, to + 1439, &revenue) : -1;
+
+        if (sessions >= 0) connectionAppend(conn, "OK %ld %.2f\n", sessions, revenue / 100.0);
+        else connectionAppend(conn, "ERR USAGE\n");
+    }
+    else if (strcmp(command, "VISITS") == 0 && argc == 1) 
+    {
+        Server_Visits(conn, args[0]);
+    }
+    else if (strcmp(command, "RESERVE") == 0 && argc == 5) 
+    {
+        int parking_id = -1;
+        int64_t reservation = Engine_Reserve(engine, args[0], parseTimestamp(args[1], args[2]), parseTimestamp(args[3], args[4]), &parking_id);
+
+        if (reservation >= 0) connectionAppend(conn, "OK %lld %d\n", (long long)reservation, parking_id);
+        else connectionAppend(conn, "ERR NO_SLOT\n");
+    }
+    else if (strcmp(command, "CANCEL") == 0 && argc == 1) 
+    {
+        connectionAppend(conn, Reservation_Cancel(&g_reservations, atoll(args[0])) ? "OK\n" : "ERR NOT_FOUND\n");
+    }
+    else if (strcmp(command, "OCCUPANCY") == 0 && argc == 4) 
+    {
+        Server_Occupancy(conn, args);
+    }
+    else if (strcmp(command, "COMPACT") == 0) 
+    {
+        connectionAppend(conn, Engine_Compact(engine) ? "OK\n" : "ERR FAILED\n");
+    }
+    else if (strcmp(command, "SAVE") == 0) 
+    {
+        Engine_Save(engine, PARKING_DB_FILE, engine->paged ? PAGED_RESIDENT_FILE : USER_DB_FILE);
+        connectionAppend(conn, "OK\n");
+    }
+#ifdef PARKING_METRICS
+    else if (strcmp(command, "METRICS") == 0) 
+    {
+        // Render into memory first so the response can be framed with its line count
+        char* text = NULL;
+        size_t text_len = 0;
+        FILE* memory = open_memstream(&text, &text_len);
+
+        if (memory) 
+        {
+            Metrics_Dump(memory);
+            fclose(memory);
+
+            int lines = 0;
+            for (size_t i = 0; i < text_len; i++) if (text[i] == '\n') lines++;
+
+            connectionAppend(conn, "OK %d\n", lines);
+            if (ensureCapacity(&conn->out, &conn->out_cap, conn->out_len + text_len)) 
+            {
+                memcpy(conn->out + conn->out_len, text, text_len);
+                conn->out_len += text_len;
+            }
+            free(text);
+        }
+        else 
+        {
+            connectionAppend(conn, "ERR FAILED\n");
+        }
+    }
+#endif
+    else if (strcmp(command, "PING") == 0) 
+    {
+        connectionAppend(conn, "OK\n");
+    }
+    else 
+    {
+        connectionAppend(conn, "ERR UNKNOWN\n");
+    }
+}
+
+void Server_CloseConnection(int epoll_fd, ServerConnection* conn) 
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    trackedFree(conn->in);
+    trackedFree(conn->out);
+    trackedFree(conn);
+}
+
+size_t serverPendingOut(const ServerConnection* conn) 
+{
+    return conn->out_len - conn->out_sent;
+}
+
+// Push queued responses until the socket backs up; false if the peer is gone
+bool serverSend(ServerConnection* conn) 
+{
+    while (conn->out_sent < conn->out_len) 
+    {
+        ssize_t n = send(conn->fd, conn->out + conn->out_sent, conn->out_len - conn->out_sent, MSG_NOSIGNAL);
+
+        if (n < 0) 
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        conn->out_sent += n;
+    }
+
+    if (conn->out_sent == conn->out_len) 
+    {
+        conn->out_sent = conn->out_len = 0;
+    }
+
+    return true;
+}
+
+// Push queued responses, then watch for what the connection can use next: input while it
+// still reads and its unsent output is under SERVER_MAX_PENDING_OUT, writability while
+// output is queued or stalled lines wait (a writable socket wakes us to answer them)
+bool Server_Drain(int epoll_fd, ServerConnection* conn) 
+{
+    if (!serverSend(conn)) return false;
+
+    uint32_t wanted = 0;
+    if (!conn->read_closed && serverPendingOut(conn) < SERVER_MAX_PENDING_OUT) wanted |= EPOLLIN;
+    if (conn->out_len > 0 || conn->stalled) wanted |= EPOLLOUT;
+
+    if (wanted != conn->armed) 
+    {
+        struct epoll_event ev;
+        ev.events = wanted;
+        ev.data.ptr = conn;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+        conn->armed = wanted;
+    }
+
+    return true;
+}
+
+// Answer the complete lines received so far, in order, until the unsent output reaches
+// SERVER_MAX_PENDING_OUT; the rest stay in `in` until it drains
+void serverHandleInput(ParkingEngine* engine, ServerConnection* conn) 
+{
+    size_t start = 0;
+    conn->stalled = false;
+
+    for (size_t i = 0; i < conn->in_len; i++) 
+    {
+        if (conn->in[i] != '\n') continue;
+
+        if (serverPendingOut(conn) >= SERVER_MAX_PENDING_OUT) 
+        {
+            conn->stalled = true;
+            break;
+        }
+
+        conn->in[i] = '\0';
+        Server_HandleLine(engine, conn, conn->in + start);
+        start = i + 1;
+    }
+
+    Server_FlushBatch(engine, conn);
+
+    // Keep the partial tail (or the stalled lines) for later
+    memmove(conn->in, conn->in + start, conn->in_len - start);
+    conn->in_len -= start;
+
+    if (!conn->stalled && conn->in_len > SERVER_MAX_LINE) 
+    {
+        connectionAppend(conn, "ERR LINE_TOO_LONG\n");
+        conn->read_closed = true;
+        conn->in_len = 0;
+    }
+}
+
+// Answer stalled lines, then read and answer more until the socket runs dry or the output
+// backs up. A read of end-of-file only stops reading; false on a connection error.
+bool Server_OnReadable(ParkingEngine* engine, ServerConnection* conn) 
+{
+    serverHandleInput(engine, conn);
+
+    while (!conn->read_closed && !conn->stalled && serverPendingOut(conn) < SERVER_MAX_PENDING_OUT) 
+    {
+        if (!ensureCapacity(&conn->in, &conn->in_cap, conn->in_len + SERVER_READ_CHUNK)) return false;
+
+        ssize_t n = recv(conn->fd, conn->in + conn->in_len, SERVER_READ_CHUNK, 0);
+
+        if (n > 0) 
+        {
+            conn->in_len += n;
+            serverHandleInput(engine, conn);
+            continue;
+        }
+
+        if (n == 0) conn->read_closed = true;
+        else if (errno == EINTR) continue;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+
+        break;
+    }
+
+    // A request cut off by end-of-file is never answered
+    if (conn->read_closed && !conn->stalled) conn->in_len = 0;
+
+    return true;
+}
+
+// paged_file, when given, is the paged user database to serve users from, with a pool of frames pages
+int Run_Server(const char* address, const char* paged_file, int frames) 
+{
+    ParkingEngine engine;
+    PagedUserTree paged;
+
+    if (paged_file && !PagedTree_Open(&paged, paged_file, frames > 0 ? frames : PAGED_DEFAULT_FRAMES)) return EXIT_FAILURE;
+
+    if (!Engine_Init(&engine, PARKING_DB_FILE, paged_file ? PAGED_RESIDENT_FILE : USER_DB_FILE, paged_file ? &paged : NULL)) 
+    {
+        if (paged_file) PagedTree_Close(&paged);
+        return EXIT_FAILURE;
+    }
+
+    int listen_fd = Server_Listen(address);
+    int epoll_fd = epoll_create1(0);
+
+    if (listen_fd < 0 || epoll_fd < 0) 
+    {
+        Engine_Destroy(&engine);
+        if (paged_file) PagedTree_Close(&paged);
+        return EXIT_FAILURE;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // NULL marks the listener
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = serverStopHandler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    fprintf(stderr, "Gate server listening on %s\n", address);
+
+    // Per-event console chatter belongs to the interactive menu, not the daemon
+    fflush(stdout);
+    if (!freopen("/dev/null", "w", stdout)) 
+    {
+        perror("Unable to silence stdout");
+    }
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+
+    while (!g_server_stop) 
+    {
+        int ready = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, -1);
+
+        if (ready < 0) 
+        {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) 
+        {
+            ServerConnection* conn = (ServerConnection*)events[i].data.ptr;
+
+            if (conn == NULL) 
+            {
+                int client_fd;
+                while ((client_fd = accept(listen_fd, NULL, NULL)) >= 0) 
+                {
+                    ServerConnection* fresh = (ServerConnection*)trackedCalloc(1, sizeof(ServerConnection), MEM_SERVER);
+                    if (!fresh || !setNonBlocking(client_fd)) 
+                    {
+                        trackedFree(fresh);
+                        close(client_fd);
+                        continue;
+                    }
+
+                    int one = 1;
+                    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                    fresh->fd = client_fd;
+                    fresh->armed = EPOLLIN;
+                    struct epoll_event client_ev;
+                    client_ev.events = EPOLLIN;
+                    client_ev.data.ptr = fresh;
+                    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_ev);
+                }
+                continue;
+            }
+
+            // Send first so stalled lines get room, then answer, then send the answers
+            bool open = serverSend(conn) && Server_OnReadable(&engine, conn) && Server_Drain(epoll_fd, conn);
+
+            // A peer that is done sending keeps its connection until it has every response
+            if (!open || (conn->read_closed && conn->out_len == 0 && !conn->stalled)) 
+            {
+                Server_CloseConnection(epoll_fd, conn);
+            }
+        }
+    }
+
+    fprintf(stderr, "Gate server shutting down, saving data...\n");
+
+    close(listen_fd);
+    close(epoll_fd);
+    if (strncmp(address, "tcp:", 4) != 0) unlink(address);
+
+    Engine_Save(&engine, PARKING_DB_FILE, paged_file ? PAGED_RESIDENT_FILE : USER_DB_FILE);
+    Engine_Destroy(&engine);
+
+    if (paged_file && !PagedTree_Close(&paged)) 
+    {
+        fprintf(stderr, "Failed to write paged user database %s.\n", paged_file);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+// Load-Test Client
+// Each connection runs on its own thread, keeps `depth` requests in flight and
+// cycles ENTER / GET / EXIT for its own plates. Prints aggregate requests/sec.
+typedef struct LoadTestWorker 
+{
+    const char* address;
+    int id;
+    int requests;
+    int depth;
+    long completed;
+    long errors;
+
+} LoadTestWorker;
+
+void loadTestRequest(char* buffer, size_t size, int worker, int n) 
+{
+    int plate = n / 3;
+
+    switch (n % 3) 
+    {
+        case 0: snprintf(buffer, size, "ENTER LT%02dX%06d load 01/01/2025 08:00\n", worker, plate); break;
+        case 1: snprintf(buffer, size, "GET LT%02dX%06d\n", worker, plate); break;
+        default: snprintf(buffer, size, "EXIT LT%02dX%06d 01/01/2025 12:30\n", worker, plate); break;
+    }
+}
+
+void* loadTestThread(void* arg) 
+{
+    LoadTestWorker* worker = (LoadTestWorker*)arg;
+    int fd = Server_Connect(worker->address);
+
+    if (fd < 0) 
+    {
+        perror("Load test connect failed");
+        return NULL;
+    }
+
+    char request[128];
+    char response[SERVER_READ_CHUNK];
+    int sent = 0;
+
+    while (worker->completed < worker->requests) 
+    {
+        // Top up the pipeline to depth outstanding requests in one write
+        char batch[SERVER_MAX_BATCH * 128];
+        size_t batch_len = 0;
+
+        while (sent < worker->requests && sent - worker->completed < worker->depth && batch_len + sizeof(request) < sizeof(batch)) 
+        {
+            loadTestRequest(request, sizeof(request), worker->id, sent++);
+            size_t len = strlen(request);
+            memcpy(batch + batch_len, request, len);
+            batch_len += len;
+        }
+
+        size_t written = 0;
+        while (written < batch_len) 
+        {
+            ssize_t n = send(fd, batch + written, batch_len - written, MSG_NOSIGNAL);
+            if (n <= 0) 
+            {
+                close(fd);
+                return NULL;
+            }
+            written += n;
+        }
+
+        ssize_t n = recv(fd, response, sizeof(response), 0);
+        if (n <= 0) break;
+
+        for (ssize_t i = 0; i < n; i++) 
+        {
+            if (response[i] == '\n') worker->completed++;
+            if (response[i] == 'E' && (i == 0 || response[i - 1] == '\n')) worker->errors++;
+        }
+    }
+
+    close(fd);
+    return NULL;
+}
+
+int Run_Load_Test(const char* address, int connections, int requests, int depth) 
+{
+    if (connections <= 0 || requests <= 0) 
+    {
+        fprintf(stderr, "Connections and requests must be positive.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (depth <= 0) depth = 1;
+    if (depth > SERVER_MAX_BATCH) depth = SERVER_MAX_BATCH;
+
+    LoadTestWorker* workers = (LoadTestWorker*)trackedCalloc(connections, sizeof(LoadTestWorker), MEM_SCRATCH);
+    pthread_t* threads = (pthread_t*)trackedMalloc(sizeof(pthread_t) * connections, MEM_SCRATCH);
+
+    if (!workers || !threads) 
+    {
+        perror("Failed to allocate load test workers");
+        trackedFree(workers);
+        trackedFree(threads);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int i = 0; i < connections; i++) 
+    {
+        workers[i].address = address;
+        workers[i].id = i;
+        workers[i].requests = requests;
+        workers[i].depth = depth;
+        pthread_create(&threads[i], NULL, loadTestThread, &workers[i]);
+    }
 
-    Payment(parkingFound, userFound);
-    parkingFound->parking_space_status = VACANT;
+    long completed = 0, errors = 0;
+    for (int i = 0; i < connections; i++) 
+    {
+        pthread_join(threads[i], NULL);
+        completed += workers[i].completed;
+        errors += workers[i].errors;
+    }
 
-    userFound->parking_space_id = -1;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
 
-    printf("Vehicle %s has exited Parking Slot %d.\n", vehicle_num, parkingId);
-    return true;
+    printf("Load test: %ld responses (%ld errors) over %d connections, depth %d, in %.3f s = %.0f req/s\n",
+           completed, errors, connections, depth, seconds, seconds > 0 ? completed / seconds : 0.0);
+
+    trackedFree(workers);
+    trackedFree(threads);
+
+    return EXIT_SUCCESS;
 }
 
-void PrintOneEntry_BPlus(GenericBPlusTreeNode* userRoot, const char* vehicle_num) 
+
+// Scale Test
+// In-memory allocation benchmark on a generated lot: fills it through Allocate_Slot
+// (memberships in turn, so every tier range is exercised), then churns random exits and
+// entries, and reports the cost per operation and the memory used. Tier ranges scale
+// with the lot (Gold the first fifth, Premium from the second fifth, Standard from the
+// third), occupancy and the nearest-slot index are maintained as in the engine, and the
+// databases are neither read nor written.
+
+// Generate a vacant lot of the given size as the default facility (also used by the shard test)
+GenericBPlusTreeNode* generateTestLot(int slots) 
 {
-    User* userFound = SearchUser_BPlus(userRoot, vehicle_num);
+    g_lotConfig.slots = slots;
+    g_lotConfig.tier_first[2] = 1;
+    g_lotConfig.tier_first[1] = slots / 5 + 1;
+    g_lotConfig.tier_first[0] = 2 * (slots / 5) + 1;
+    for (int t = 0; t < LOT_TIERS; t++) g_lotConfig.tier_last[t] = slots;
+    g_lotConfig.range_width = (slots + LOT_MAX_OCCUPANCY_RANGES - 1) / LOT_MAX_OCCUPANCY_RANGES;
+    if (g_lotConfig.range_width < 10) g_lotConfig.range_width = 10;
+
+    GenericBPlusTreeNode* parkingRoot = Lot_GenerateSlots(NULL, slots);
+    Occupancy_Init(&g_occupancy, parkingRoot);
+    Reservation_Init(&g_reservations, slots);
+    SlotIndex_Init(&g_slotIndex, parkingRoot, SLOT_LAYOUT_FILE);
 
-    if(userFound) 
+    return parkingRoot;
+}
+
+int Run_Scale_Test(int slots, int operations) 
+{
+    if (slots < 10 || slots > LOT_MAX_SLOTS || operations < 0) 
     {
-        printf("\n--- Details for Vehicle: %s ---\n", userFound->vehicle_num);
-        printf("Owner name: %s\n", userFound->owner_name);
-        printf("Membership: %d (%s)\n", userFound->membership, userFound->membership == 2 ? "Gold" : (userFound->membership == 1 ? "Premium" : "Standard"));
-        printf("Status: %s\n", userFound->status == PARKED ? "Parked" : "Not Parked");
+        fprintf(stderr, "Slots must be between 10 and %d, operations not negative.\n", LOT_MAX_SLOTS);
+        return EXIT_FAILURE;
+    }
 
-        if(userFound->status == PARKED)
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    GenericBPlusTreeNode* parkingRoot = generateTestLot(slots);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double setup = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    Parking** parked = (Parking**)trackedMalloc(sizeof(Parking*) * slots, MEM_SCRATCH);
+    if (!parkingRoot || !parked) 
+    {
+        perror("Failed to set up scale test");
+        return EXIT_FAILURE;
+    }
+
+    char plate[20];
+    AllocationRequest request = { plate, parseTimestamp("01/01/2025", "08:00"), 0, 0 };
+    int num_parked = 0;
+    uint64_t random = 88172645463325252ull;
+
+    // Fill
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < slots; i++) 
+    {
+        int min_id, max_id;
+        Membership_Slot_Range(i % LOT_TIERS, &min_id, &max_id);
+        snprintf(plate, sizeof(plate), "SC%08d", i);
+
+        Parking* slot = Allocate_Slot(parkingRoot, min_id, max_id, &request);
+        if (slot) 
         {
-            printf("Current Parking space id: %d\n", userFound->parking_space_id);
-            printf("Current Arrival Date: %s\n", userFound->arrival_date);
-            printf("Current Arrival time: %s\n", userFound->arrival_time);
-            printf("Current Time Spent (so far): Calculation requires exit.\n");
-            printf("Current Parking amount due: Calculation requires exit.\n");
+            parked[num_parked++] = slot;
+            Occupancy_Record(&g_occupancy, slot->parking_id, +1, request.arrival);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double fill = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    int filled = num_parked;
+
+    // Churn: one random exit, then one entry with a random membership
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int op = 0; op < operations && num_parked > 0; op++) 
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
+
+        int victim = (int)(random % (uint64_t)num_parked);
+        request.arrival += 1;
+
+        Release_Slot(parked[victim]);
+        Occupancy_Record(&g_occupancy, parked[victim]->parking_id, -1, request.arrival);
+
+        int min_id, max_id;
+        Membership_Slot_Range((int)((random >> 32) % LOT_TIERS), &min_id, &max_id);
+        snprintf(plate, sizeof(plate), "SC%08d", slots + op);
+
+        Parking* slot = Allocate_Slot(parkingRoot, min_id, max_id, &request);
+        if (slot) 
+        {
+            parked[victim] = slot;
+            Occupancy_Record(&g_occupancy, slot->parking_id, +1, request.arrival);
         }
         else 
         {
-            printf("Last Arrival Date: %s\n", userFound->arrival_date);
-            printf("Last Arrival time: %s\n", userFound->arrival_time);
-            printf("Last Departure Date: %s\n", userFound->departure_date);
-            printf("Last Departure time: %s\n", userFound->departure_time);
-            printf("Last Time Spent: %.2f hours\n", userFound->spent_time);
-            printf("Last Parking amount paid: %.2f\n", userFound->parking_amt);
+            parked[victim] = parked[--num_parked];
         }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double churn = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // Book: random windows of 30 minutes to 4 hours over the next week, one per operation
+    // (capped at the lot size), each through the slot-id segment tree
+    int bookings = operations < slots ? operations : slots, booked = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int op = 0; op < bookings; op++) 
+    {
+        random ^= random << 13;
+        random ^= random >> 7;
+        random ^= random << 17;
 
-        printf("Total Time Spent: %.2f hours\n", userFound->total_spent_time);
-        printf("Total Parking amount paid: %.2f\n", userFound->total_parking_amt);
-        printf("Number of parkings done: %d\n", userFound->number_of_parkings);
-        printf("---------------------------------\n");
+        int min_id, max_id, parking_id;
+        Membership_Slot_Range((int)(random % LOT_TIERS), &min_id, &max_id);
+        snprintf(plate, sizeof(plate), "SR%08d", op);
 
-    } 
-    else 
+        int64_t from = request.arrival + (int64_t)((random >> 8) % (7 * 24 * 60));
+        int64_t until = from + 30 + (int64_t)((random >> 40) % 211);
+        if (Reservation_Create(&g_reservations, NULL, plate, min_id, max_id, from, until, &parking_id) >= 0) booked++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double book = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("Scale test: %d slots generated and indexed in %.3f s\n", slots, setup);
+    printf("  Fill:  %d vehicles parked in %.3f s (%.0f ns per entry)\n", filled, fill, filled ? fill * 1e9 / filled : 0.0);
+    printf("  Churn: %d exit/entry pairs in %.3f s (%.0f ns per pair), %d parked at the end\n",
+           operations, churn, operations ? churn * 1e9 / operations : 0.0, num_parked);
+    printf("  Book:  %d reservations, %d made, in %.3f s (%.0f ns per booking)\n",
+           bookings, booked, book, bookings ? book * 1e9 / bookings : 0.0);
+    Memory_Report(stdout);
+
+    trackedFree(parked);
+    SlotIndex_Destroy(&g_slotIndex);
+    Reservation_Destroy(&g_reservations);
+    Occupancy_Destroy(&g_occupancy);
+    Destroy_BPlus_Tree(&parkingRoot, freeParking, freeParkingKey);
+
+    return EXIT_SUCCESS;
+}
+
+
+// OLC Stress Test
+// Hammers one ConcurrentBPlusTree with 1, 2, 4, ... up to max_threads threads. Each thread
+// inserts its own share of plates in a scrambled order through Insert_BPlus_OLC and, after
+// every insert, searches one of its earlier plates (which must be there) and the plate of
+// the same rank from the next thread (which may not be yet). Plates of different threads
+// are adjacent in key order, so writers keep splitting the same leaves. Afterwards the
+// tree is checked against the serial model - every plate exactly once and in order along
+// the leaf chain, all leaves at one depth, every key within its parent's separators - and
+// the throughput is reported per thread count.
+#define OLC_TEST_LOOKUPS 2 // Searches per insert
+
+typedef struct OlcTestWorker 
+{
+    ConcurrentBPlusTree* tree;
+    User* users;     // All threads' records, rank-major: users[rank * threads + thread]
+    int thread;
+    int threads;
+    int per_thread;
+    long lost;       // Own plates that were not found after being inserted
+    long failed;     // Inserts that did not succeed
+    long seen;       // Neighbour plates already there when searched
+
+} OlcTestWorker;
+
+void* olcTestWorker(void* arg) 
+{
+    OlcTestWorker* worker = (OlcTestWorker*)arg;
+    int n = worker->per_thread;
+
+    // Visit ranks in the order rank = i * stride mod n, stride coprime with n
+    int stride = n / 2 + 1;
+    while (n > 1) 
     {
-        printf("User with vehicle number '%s' does not exist in Database!\n", vehicle_num);
+        int a = stride, b = n;
+        while (b) 
+        {
+            int r = a % b;
+            a = b;
+            b = r;
+        }
+        if (a == 1) break;
+        stride++;
+    }
+
+    for (int i = 0; i < n; i++) 
+    {
+        int rank = (int)(((int64_t)i * stride) % n);
+        User* user = &worker->users[(size_t)rank * worker->threads + worker->thread];
+
+        if (Insert_BPlus_OLC(worker->tree, user, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey) != SUCCESS) 
+        {
+            worker->failed++;
+        }
+
+        int earlier = (int)(((int64_t)(i / 2) * stride) % n);
+        const User* own = &worker->users[(size_t)earlier * worker->threads + worker->thread];
+        if (Search_BPlus_OLC(worker->tree, own->vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal) != own) worker->lost++;
+
+        const User* other = &worker->users[(size_t)rank * worker->threads + (worker->thread + 1) % worker->threads];
+        if (Search_BPlus_OLC(worker->tree, other->vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal) == other) worker->seen++;
     }
+
+    return NULL;
 }
 
+// Depth of the leaves under node, or -1 if they differ or a key falls outside [low, high)
+// (NULL bounds are open) or out of order
+int olcTestCheckNode(const GenericBPlusTreeNode* node, const char* low, const char* high) 
+{
+    if (!node || node->num_keys < 1 || node->num_keys > MAXKEYS) return -1;
 
-// Read User Database
-GenericBPlusTreeNode* READ_DATABASE_BPlus(const char* filename) 
+    for (int i = 0; i < node->num_keys; i++) 
+    {
+        const char* key = node->is_leaf ? ((const User*)node->keys[i])->vehicle_num : (const char*)node->keys[i];
+        const char* prev = i == 0 ? low : (node->is_leaf ? ((const User*)node->keys[i - 1])->vehicle_num : (const char*)node->keys[i - 1]);
+
+        if (prev && (i == 0 ? strcmp(key, prev) < 0 : strcmp(key, prev) <= 0)) return -1;
+        if (high && strcmp(key, high) >= 0) return -1;
+    }
+
+    if (node->is_leaf) return 1;
+
+    int depth = -1;
+    for (int i = 0; i <= node->num_keys; i++) 
+    {
+        const char* child_low = i == 0 ? low : (const char*)node->keys[i - 1];
+        const char* child_high = i == node->num_keys ? high : (const char*)node->keys[i];
+        int child_depth = olcTestCheckNode(node->children[i], child_low, child_high);
+
+        if (child_depth < 0 || (depth >= 0 && child_depth != depth)) return -1;
+        depth = child_depth;
+    }
+
+    return depth + 1;
+}
+
+int Run_OLC_Test(int max_threads, int inserts) 
 {
-    GenericBPlusTreeNode* userRoot = NULL;
-    FILE* file = fopen(filename, "r");
+    if (max_threads < 1 || max_threads > 256 || inserts < max_threads) 
+    {
+        fprintf(stderr, "Threads must be between 1 and 256, inserts at least one per thread.\n");
+        return EXIT_FAILURE;
+    }
 
-    if (!file) 
+    printf("OLC test: %d inserts and %d searches per run\n", inserts, inserts * OLC_TEST_LOOKUPS);
+    printf("  %7s %12s %14s %14s  %s\n", "threads", "seconds", "ops/s", "ops/s/thread", "check");
+
+    bool passed = true;
+
+    for (int threads = 1; ; threads = (threads * 2 < max_threads) ? threads * 2 : max_threads) 
     {
-        perror("Unable to open user file for reading");
-        return NULL;
+        int per_thread = inserts / threads;
+        int total = per_thread * threads;
+
+        ConcurrentBPlusTree tree;
+        Init_Concurrent_BPlus(&tree, NULL);
+
+        User* users = (User*)trackedCalloc(total, sizeof(User), MEM_USER);
+        OlcTestWorker* workers = (OlcTestWorker*)trackedCalloc(threads, sizeof(OlcTestWorker), MEM_SCRATCH);
+        pthread_t* handles = (pthread_t*)trackedMalloc(sizeof(pthread_t) * threads, MEM_SCRATCH);
+
+        if (!users || !workers || !handles) 
+        {
+            perror("Failed to set up OLC test");
+            trackedFree(users);
+            trackedFree(workers);
+            trackedFree(handles);
+            return EXIT_FAILURE;
+        }
+
+        // The serial model: record k is the k-th plate in key order
+        for (int k = 0; k < total; k++) 
+        {
+            snprintf(users[k].vehicle_num, sizeof(users[k].vehicle_num), "OL%09u%03u", (unsigned)(k / threads) % 1000000000u, (unsigned)(k % threads) % 1000u);
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        int started = 0;
+        for (int t = 0; t < threads; t++) 
+        {
+            workers[t] = (OlcTestWorker){ &tree, users, t, threads, per_thread, 0, 0, 0 };
+            if (pthread_create(&handles[t], NULL, olcTestWorker, &workers[t]) != 0) break;
+            started++;
+        }
+        for (int t = 0; t < started; t++) pthread_join(handles[t], NULL);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        long lost = 0, failed = 0;
+        for (int t = 0; t < threads; t++) 
+        {
+            lost += workers[t].lost;
+            failed += workers[t].failed;
+        }
+
+        // Compare the leaf chain with the model, then the shape of the tree
+        BPlusCursor cursor;
+        Cursor_First(&cursor, tree.root);
+
+        int matched = 0;
+        const User* record;
+        while ((record = (const User*)Cursor_Next(&cursor)) != NULL && matched < total && record == &users[matched]) 
+        {
+            matched++;
+        }
+
+        bool ordered = (record == NULL && matched == total);
+        bool shaped = olcTestCheckNode(tree.root, NULL, NULL) > 0;
+        bool ok = started == threads && lost == 0 && failed == 0 && ordered && shaped;
+        passed = passed && ok;
+
+        long ops = (long)total * (1 + OLC_TEST_LOOKUPS);
+        printf("  %7d %12.3f %14.0f %14.0f  %s\n", threads, seconds, ops / seconds, ops / seconds / threads, ok ? "ok" : "FAILED");
+
+        if (!ok) 
+        {
+            printf("    %d of %d threads started, %ld inserts failed, %ld plates lost, %d of %d records in order%s\n",
+                   started, threads, failed, lost, matched, total, shaped ? "" : ", tree malformed");
+        }
+
+        Destroy_BPlus_Tree(&tree.root, NULL, freeUserKey);
+        trackedFree(users);
+        trackedFree(workers);
+        trackedFree(handles);
+
+        if (threads == max_threads) break;
     }
 
-    char line[512];
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-    if (fgets(line, sizeof(line), file) == NULL) 
+
+// Shard Test
+// Gate throughput of the sharded user index with 1, 2, 4, ... up to max_shards shards,
+// each drained by its own worker thread. A stream of enter events over a set of plates
+// (each plate returning every plates-th event) is dealt to the shards by plate hash
+// before the clock starts; a worker enters its plates in stream order and lets each one
+// out SHARD_TEST_STAY of its events later, so only the lot's shared stores (slot claims,
+// occupancy, parked list, sessions, plate index) are ever contended. Afterwards the
+// merged ordered view must list every plate once, in order, not parked, with its visits
+// on record; the last run's users can be written out through Sharded_WriteDatabase and
+// are then loaded back to check the file.
+#define SHARD_TEST_SLOTS 10000
+#define SHARD_TEST_STAY 16 // A worker's vehicles parked at once
+
+typedef struct ShardTestWorker 
+{
+    ShardedUserIndex* index;
+    GenericBPlusTreeNode** parkingRootRef;
+    char (*plates)[20];   // Every plate, by number
+    int* events;          // Plate numbers of this shard's enter events, in stream order
+    int count;
+    long failed;          // Enters or exits that did not succeed
+
+} ShardTestWorker;
+
+void* shardTestWorker(void* arg) 
+{
+    ShardTestWorker* worker = (ShardTestWorker*)arg;
+
+    for (int i = 0; i < worker->count + SHARD_TEST_STAY; i++) 
     {
-        fclose(file);
-        return NULL;
+        if (i >= SHARD_TEST_STAY) 
+        {
+            const char* plate = worker->plates[worker->events[i - SHARD_TEST_STAY]];
+            if (!Sharded_Exit(worker->index, worker->parkingRootRef, plate, "01/01/2025", "10:30")) worker->failed++;
+        }
+
+        if (i < worker->count) 
+        {
+            // Owner names differ per plate, so no new plate is taken as a misread of a known one
+            const char* plate = worker->plates[worker->events[i]];
+            if (!Sharded_Enter(worker->index, worker->parkingRootRef, plate, plate, "01/01/2025", "08:00")) worker->failed++;
+        }
     }
 
-    int line_num = 1;
-    while (fgets(line, sizeof(line), file) != NULL) 
+    return NULL;
+}
+
+typedef struct ShardTestCheck 
+{
+    const char* last;  // Previous plate visited
+    long users;
+    long visits;
+    long misplaced;    // Out of order or still parked
+
+} ShardTestCheck;
+
+void visitShardTestUser(const void* data, void* ctx) 
+{
+    const User* user = (const User*)data;
+    ShardTestCheck* check = (ShardTestCheck*)ctx;
+
+    if ((check->last && strcmp(user->vehicle_num, check->last) <= 0) || user->status == PARKED) check->misplaced++;
+
+    check->last = user->vehicle_num;
+    check->users++;
+    check->visits += user->number_of_parkings;
+}
+
+int Run_Shard_Test(int max_shards, int events, const char* users_out) 
+{
+    if (max_shards < 1 || max_shards > 256 || events < 1) 
     {
-        line_num++;
+        fprintf(stderr, "Shards must be between 1 and 256, events at least 1.\n");
+        return EXIT_FAILURE;
+    }
 
-        User* newUser = (User*)malloc(sizeof(User));
-        
-        if (!newUser) 
+    // Enough plates that a plate is always out again before its shard reaches it once more
+    int num_plates = events / 4;
+    if (num_plates < max_shards * SHARD_TEST_STAY * 4) num_plates = max_shards * SHARD_TEST_STAY * 4;
+    if (num_plates > events) events = num_plates;
+
+    char (*plates)[20] = (char (*)[20])trackedMalloc(sizeof(*plates) * num_plates, MEM_SCRATCH);
+    int* routed = (int*)trackedMalloc(sizeof(int) * events, MEM_SCRATCH);
+
+    if (!plates || !routed) 
+    {
+        perror("Failed to set up shard test");
+        trackedFree(plates);
+        trackedFree(routed);
+        return EXIT_FAILURE;
+    }
+
+    for (int p = 0; p < num_plates; p++) 
+    {
+        snprintf(plates[p], sizeof(plates[p]), "SH%08u", (unsigned)p % 100000000u);
+    }
+
+    GenericBPlusTreeNode* parkingRoot = generateTestLot(SHARD_TEST_SLOTS);
+
+    // Per-event console chatter from the gate functions is not wanted here
+    fflush(stdout);
+    if (!freopen("/dev/null", "w", stdout)) 
+    {
+        perror("Unable to silence stdout");
+    }
+
+    fprintf(stderr, "Shard test: %d gate events (half entries, half exits) over %d plates\n", 2 * events, num_plates);
+    fprintf(stderr, "  %7s %12s %14s %14s  %s\n", "shards", "seconds", "events/s", "events/s/shard", "check");
+
+    bool passed = true;
+
+    for (int shards = 1; ; shards = (shards * 2 < max_shards) ? shards * 2 : max_shards) 
+    {
+        ShardedUserIndex index;
+        ShardTestWorker* workers = (ShardTestWorker*)trackedCalloc(shards, sizeof(ShardTestWorker), MEM_SCRATCH);
+        pthread_t* handles = (pthread_t*)trackedMalloc(sizeof(pthread_t) * shards, MEM_SCRATCH);
+
+        if (!workers || !handles || !Sharded_Init(&index, shards)) 
         {
-            perror("Unable to allocate memory for new user during read");
-            fclose(file);
-            return userRoot;
+            perror("Failed to set up shard test");
+            trackedFree(workers);
+            trackedFree(handles);
+            passed = false;
+            break;
         }
 
-        sscanf(line, "%19[^,],%49[^,],%10[^,],%5[^,],%10[^,],%5[^,],%d,%d,%d,%f,%f,%f,%f,%d",
-            newUser->vehicle_num,
-            newUser->owner_name,
-            newUser->arrival_date,
-            newUser->arrival_time,
-            newUser->departure_date,
-            newUser->departure_time,
-            &newUser->parking_space_id,
-            &newUser->number_of_parkings,
-            &newUser->membership,
-            &newUser->spent_time,
-            &newUser->total_spent_time,
-            &newUser->parking_amt,
-            &newUser->total_parking_amt,
-            (int*)&newUser->status);
+        // Deal the stream out by shard, each shard's events kept contiguous and in order
+        int* counts = (int*)trackedCalloc(shards + 1, sizeof(int), MEM_SCRATCH);
+        for (int e = 0; e < events; e++) counts[Sharded_ShardFor(&index, plates[e % num_plates]) - index.shards + 1]++;
+        for (int s = 0; s < shards; s++) counts[s + 1] += counts[s];
 
-        status_code status = Insert_BPlus(&userRoot, newUser, compareUserVehicleNum, compareUserVehicleNumInternal, getUserKey, copyUserKey, freeUserKey);
-        
-        if (status != SUCCESS) 
+        for (int s = 0; s < shards; s++) 
         {
-            fprintf(stderr, "Failed to insert user record from line %d: %s\n", line_num, line);
-            freeUser(newUser);
+            workers[s] = (ShardTestWorker){ &index, &parkingRoot, plates, routed + counts[s], 0, 0 };
+        }
+        for (int e = 0; e < events; e++) 
+        {
+            ShardTestWorker* worker = &workers[Sharded_ShardFor(&index, plates[e % num_plates]) - index.shards];
+            worker->events[worker->count++] = e % num_plates;
+        }
+        trackedFree(counts);
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        int started = 0;
+        for (int s = 0; s < shards; s++) 
+        {
+            if (pthread_create(&handles[s], NULL, shardTestWorker, &workers[s]) != 0) break;
+            started++;
+        }
+        for (int s = 0; s < started; s++) pthread_join(handles[s], NULL);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+        long failed = 0;
+        for (int s = 0; s < shards; s++) failed += workers[s].failed;
+
+        ShardTestCheck check = { NULL, 0, 0, 0 };
+        Sharded_ForEachOrdered(&index, visitShardTestUser, &check);
+
+        long missing = 0;
+        for (int p = 0; p < num_plates; p++) 
+        {
+            User user;
+            if (!Sharded_LookupUser(&index, plates[p], &user)) missing++;
+        }
+
+        bool ok = started == shards && failed == 0 && missing == 0 && check.misplaced == 0 &&
+                  check.users == num_plates && check.visits == events && g_parked.count == 0;
+
+        // The last run's users go to the file, which must load back in full
+        if (ok && users_out && shards == max_shards) 
+        {
+            ShardedUserIndex reloaded;
+            ShardTestCheck recheck = { NULL, 0, 0, 0 };
+
+            Sharded_WriteDatabase(users_out, &index);
+            if (Sharded_Init(&reloaded, shards)) 
+            {
+                Sharded_Load(&reloaded, users_out);
+                Sharded_ForEachOrdered(&reloaded, visitShardTestUser, &recheck);
+                Sharded_Destroy(&reloaded);
+            }
+
+            ok = recheck.users == check.users && recheck.visits == check.visits && recheck.misplaced == 0;
+        }
+
+        passed = passed && ok;
+
+        long total = 2L * events;
+        fprintf(stderr, "  %7d %12.3f %14.0f %14.0f  %s\n", shards, seconds, total / seconds, total / seconds / shards, ok ? "ok" : "FAILED");
+
+        if (!ok) 
+        {
+            fprintf(stderr, "    %d of %d workers started, %ld events failed, %ld plates missing, %ld of %d users listed, %ld out of place, %ld still parked\n",
+                    started, shards, failed, missing, check.users, num_plates, check.misplaced, g_parked.count);
         }
+
+        Sharded_Destroy(&index);
+        PlateIndex_Destroy(&g_plateIndex);
+        Session_Destroy(&g_sessionStore);
+        trackedFree(workers);
+        trackedFree(handles);
+
+        if (shards == max_shards) break;
     }
 
-    fclose(file);
-    printf("Read user records successfully.\n");
+    SlotIndex_Destroy(&g_slotIndex);
+    Reservation_Destroy(&g_reservations);
+    Occupancy_Destroy(&g_occupancy);
+    Destroy_BPlus_Tree(&parkingRoot, freeParking, freeParkingKey);
+    trackedFree(plates);
+    trackedFree(routed);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+// Staged Pipeline
+// Offline/stream mode that spreads each gate event over four threads:
+//   parse  -> lookup (optimistic, read-only) -> mutate (allocate, bill) -> format
+// connected by bounded single-producer/single-consumer rings. Mutation is the only
+// writer, so events are applied in input order; lookups run ahead of it against the
+// concurrent user tree and the mutator re-checks plates the lookup missed, since an
+// earlier event in the stream may have registered them in the meantime.
+#define PIPELINE_RING_SIZE 1024 // Per ring, power of two
+#define PIPELINE_STAGES 4
+
+typedef struct SpscRing 
+{
+    void** slots;
+    size_t mask;
+    size_t head __attribute__((aligned(64))); // Next slot to pop, written by the consumer only
+    size_t tail __attribute__((aligned(64))); // Next slot to push, written by the producer only
+
+} SpscRing;
+
+bool Spsc_Init(SpscRing* ring, size_t capacity) 
+{
+    ring->slots = (void**)trackedMalloc(sizeof(void*) * capacity, MEM_PIPELINE);
+
+    if (!ring->slots) 
+    {
+        perror("Failed to allocate ring");
+        return false;
+    }
+
+    ring->mask = capacity - 1;
+    ring->head = 0;
+    ring->tail = 0;
+
+    return true;
+}
+
+bool Spsc_TryPush(SpscRing* ring, void* item) 
+{
+    size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) > ring->mask) return false; // Full
+
+    ring->slots[tail & ring->mask] = item;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool Spsc_TryPop(SpscRing* ring, void** item) 
+{
+    size_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) return false; // Empty
+
+    *item = ring->slots[head & ring->mask];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void Spsc_Push(SpscRing* ring, void* item) 
+{
+    while (!Spsc_TryPush(ring, item)) sched_yield();
+}
+
+void* Spsc_Pop(SpscRing* ring) 
+{
+    void* item;
+    while (!Spsc_TryPop(ring, &item)) sched_yield();
 
-    return userRoot;
+    return item;
 }
 
-// Write User Database
-void WRITE_DATABASE_BPlus(const char* filename, GenericBPlusTreeNode* userRoot) 
+typedef struct PipelineItem 
 {
-    FILE* file = fopen(filename, "w");
+    GateEvent event;
+    User* user;         // Lookup result, then the record the mutator touched
+    bool end;           // Stream terminator, passed through every stage
+    uint64_t stamp;     // When the previous stage handed it on
 
-    if (!file) 
-    {
-        perror("Unable to open user file for writing");
-        return;
-    }
+} PipelineItem;
 
-    fprintf(file, "Vehicle_Number,Owner_Name,Arrival_Date,Arrival_Time,Departure_Date,Departure_Time,Parking_Space_ID,Number_of_Parkings,Membership,Spent_Time,Total_Spent_Time,Parking_Amt,Total_Parking_Amt,Status");
+// Per-stage latency: service is time spent working, wait is time queued in front of the stage
+typedef struct StageStats 
+{
+    const char* name;
+    uint64_t items;
+    uint64_t service_ns;
+    uint64_t service_max_ns;
+    uint64_t wait_ns;
 
-    // Write user data by traversing leaves
-    traverseLeavesForFile(userRoot, printUserInFile, file);
+} StageStats;
 
-    fclose(file);
+typedef struct Pipeline 
+{
+    FILE* input;
+    FILE* output;
+    GenericBPlusTreeNode* parkingRoot;
+    ConcurrentBPlusTree users;
+    SpscRing rings[PIPELINE_STAGES]; // parse->lookup, lookup->mutate, mutate->format, format->parse (recycling)
+    PipelineItem* items;
+    StageStats stats[PIPELINE_STAGES];
+    long rejected_lines;
+
+} Pipeline;
+
+uint64_t monotonicNanos(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    printf("User database written successfully.\n");
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 }
 
-// Read Parking Database
-GenericBPlusTreeNode* READ_PARKING_BPlus(const char* filename) 
+// Book a finished item against its stage and stamp it for the next one
+void stageDone(StageStats* stats, PipelineItem* item, uint64_t started) 
 {
-    GenericBPlusTreeNode* parkingRoot = NULL;
-    FILE* file = fopen(filename, "r");
-    bool file_existed = (file != NULL);
+    uint64_t now = monotonicNanos();
+    uint64_t service = now - started;
 
-    if (!file) 
-    {
-        perror("Error, No parking database exists!");
-        exit(EXIT_FAILURE);
-    } 
-    else 
+    stats->items++;
+    stats->service_ns += service;
+    if (service > stats->service_max_ns) stats->service_max_ns = service;
+    stats->wait_ns += started - item->stamp;
+
+    item->stamp = now;
+}
+
+void* pipelineParseStage(void* arg) 
+{
+    Pipeline* pipeline = (Pipeline*)arg;
+    char line[SERVER_MAX_LINE];
+
+    while (true) 
     {
-        char line[256];
-        if (fgets(line, sizeof(line), file) == NULL)
+        PipelineItem* item = (PipelineItem*)Spsc_Pop(&pipeline->rings[3]);
+        item->stamp = monotonicNanos();
+        uint64_t started = item->stamp;
+
+        bool parsed = false;
+        while (!parsed && fgets(line, sizeof(line), pipeline->input)) 
         {
-            // File exists but is empty, treat as initialization case?
-            fclose(file);
+            parsed = parseGateEventLine(line, &item->event);
+            if (!parsed && line[0] != '\n') pipeline->rejected_lines++;
         }
 
-        int line_num = 1;
-        while (fgets(line, sizeof(line), file) != NULL) 
-        {
-            line_num++;
+        item->end = !parsed;
+        item->user = NULL;
+        stageDone(&pipeline->stats[0], item, started);
+        Spsc_Push(&pipeline->rings[0], item);
 
-            Parking* newParking = (Parking*)malloc(sizeof(Parking));
+        if (item->end) return NULL;
+    }
+}
 
-                if (!newParking) 
-                {
-                    perror("Unable to allocate memory for new user");
-                    fclose(file);
-                    return NULL;
-                }
+void* pipelineLookupStage(void* arg) 
+{
+    Pipeline* pipeline = (Pipeline*)arg;
 
-                // Parse the line
-                sscanf(line,"%d, %d, %f, %d", &newParking->parking_id, &newParking->parking_space_status, &newParking->revenue, &newParking->occupancies);
+    while (true) 
+    {
+        PipelineItem* item = (PipelineItem*)Spsc_Pop(&pipeline->rings[0]);
+        uint64_t started = monotonicNanos();
 
-                status_code insert_status = Insert_BPlus(&parkingRoot, newParking, compareParkingId, compareParkingIdInternal, getParkingKey, copyParkingKey, freeParkingKey);
-                if(insert_status == FAILURE)
-                {
-                    fprintf(stderr, "Failed to insert parking record from line: %s\n", line);
-                    free(newParking);
-                    fclose(file);
-                    exit(EXIT_FAILURE);
-                }
+        if (!item->end) 
+        {
+            item->user = (User*)Search_BPlus_OLC(&pipeline->users, item->event.vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal);
         }
 
-        fclose(file);
+        stageDone(&pipeline->stats[1], item, started);
+        Spsc_Push(&pipeline->rings[1], item);
 
-        printf("Read parking data successfully from %s.\n", filename);
+        if (item->end) return NULL;
     }
-
-    return parkingRoot;
 }
 
-// Write Parking Database
-void WRITE_PARKING_BPlus(const char* filename, GenericBPlusTreeNode* parkingRoot) 
+void* pipelineMutateStage(void* arg) 
 {
-    FILE* file = fopen(filename, "w");
+    Pipeline* pipeline = (Pipeline*)arg;
 
-    if (!file) 
+    while (true) 
     {
-        perror("Unable to open parking file for writing");
-        return;
-    }
+        PipelineItem* item = (PipelineItem*)Spsc_Pop(&pipeline->rings[1]);
+        uint64_t started = monotonicNanos();
+
+        if (!item->end) 
+        {
+            GateEvent* event = &item->event;
 
-    fprintf(file, "Parking_ID,Status,Revenue,Occupancies");
+            // Only this thread inserts, so a plain search of its own tree is safe here
+            if (item->user == NULL) 
+            {
+                item->user = SearchUser_BPlus(pipeline->users.root, event->vehicle_num);
+            }
 
-    traverseLeavesForFile(parkingRoot, printParkingInFile, file);
+            event->parking_id = -1;
+            event->amount = 0;
 
-    fclose(file);
-    printf("Parking database written successfully.\n");
+            if (event->type == GATE_ENTRY) 
+            {
+                event->result = Gate_Enter(&pipeline->parkingRoot, NULL, &pipeline->users, NULL, &item->user, event->vehicle_num, event->owner_name, event->date, event->time, event->entrance, event->required_attrs, &event->parking_id);
+            }
+            else 
+            {
+                event->result = Gate_Exit(&pipeline->parkingRoot, &item->user, event->vehicle_num, event->date, event->time, &event->parking_id);
+                event->amount = (event->result == GATE_OK) ? item->user->parking_amt : 0;
+            }
+        }
+
+        stageDone(&pipeline->stats[2], item, started);
+        Spsc_Push(&pipeline->rings[2], item);
+
+        if (item->end) return NULL;
+    }
 }
 
-// B+ Tree Destruction
-void destroyGenericBPlusTreeNode(GenericBPlusTreeNode* node, FreeDataFunc freeData, FreeKeyFunc freeKey) 
+void* pipelineFormatStage(void* arg) 
 {
-    if (!node) return;
+    Pipeline* pipeline = (Pipeline*)arg;
 
-    if (!node->is_leaf) 
+    while (true) 
     {
-        // Recursively destroy children
-        for (int i = 0; i < node->num_keys + 1; ++i) 
-        {
-            destroyGenericBPlusTreeNode(node->children[i], freeData, freeKey);
-        }
+        PipelineItem* item = (PipelineItem*)Spsc_Pop(&pipeline->rings[2]);
+        uint64_t started = monotonicNanos();
+        bool end = item->end;
 
-        // Free internal keys (copies)
-        for (int i = 0; i < node->num_keys; ++i) 
+        if (!end) 
         {
-            if (node->keys[i]) 
+            GateEvent* event = &item->event;
+
+            if (event->result != GATE_OK) 
             {
-                freeKey(node->keys[i]);
+                fprintf(pipeline->output, "%s ERR %s\n", event->vehicle_num, gateStatusName(event->result));
             }
-        }
-    } 
-    else 
-    {
-        // Free actual data pointers in leaf
-        if (freeData) 
-        {
-            for (int i = 0; i < node->num_keys; ++i) 
+            else if (event->type == GATE_ENTRY) 
             {
-                 if (node->keys[i]) 
-                 {
-                    freeData(node->keys[i]);
-                }
+                fprintf(pipeline->output, "%s OK %d\n", event->vehicle_num, event->parking_id);
+            }
+            else 
+            {
+                fprintf(pipeline->output, "%s OK %d %.2f\n", event->vehicle_num, event->parking_id, event->amount);
             }
         }
-    }
 
-    free(node);
+        stageDone(&pipeline->stats[3], item, started);
+
+        if (end) return NULL;
+
+        Spsc_Push(&pipeline->rings[3], item);
+    }
 }
 
-void Destroy_BPlus_Tree(GenericBPlusTreeNode** rootRef, FreeDataFunc freeData, FreeKeyFunc freeKey) 
+void Pipeline_PrintStats(const Pipeline* pipeline, double seconds) 
 {
-    if (rootRef && *rootRef) 
+    fprintf(stderr, "\n--- Pipeline Stage Latency ---\n");
+    fprintf(stderr, "%-8s %10s %14s %14s %14s\n", "Stage", "Items", "Avg svc (ns)", "Max svc (ns)", "Avg wait (ns)");
+
+    for (int i = 0; i < PIPELINE_STAGES; i++) 
     {
-        destroyGenericBPlusTreeNode(*rootRef, freeData, freeKey);
-        *rootRef = NULL;
+        const StageStats* stats = &pipeline->stats[i];
+        uint64_t items = stats->items ? stats->items : 1;
+        fprintf(stderr, "%-8s %10llu %14llu %14llu %14llu\n", stats->name, (unsigned long long)stats->items,
+                (unsigned long long)(stats->service_ns / items), (unsigned long long)stats->service_max_ns, (unsigned long long)(stats->wait_ns / items));
     }
-}
-
 
+    uint64_t events = pipeline->stats[3].items ? pipeline->stats[3].items - 1 : 0; // Minus the terminator
+    fprintf(stderr, "%llu events in %.3f s = %.0f events/s (%ld lines rejected)\n", (unsigned long long)events, seconds, seconds > 0 ? events / seconds : 0.0, pipeline->rejected_lines);
+}
 
-ListNode* createSimpleNode(void* data) 
+int Run_Pipeline(const char* events_file, const char* output_file) 
 {
-    ListNode* newNode = (ListNode*)malloc(sizeof(ListNode));
+    Pipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
 
-    if (!newNode) 
+    pipeline.input = fopen(events_file, "r");
+    pipeline.output = fopen(output_file, "w");
+
+    if (!pipeline.input || !pipeline.output) 
     {
-        perror("Failed to allocate ListNode");
-        return NULL;
+        perror("Unable to open pipeline input/output");
+        if (pipeline.input) fclose(pipeline.input);
+        if (pipeline.output) fclose(pipeline.output);
+        return EXIT_FAILURE;
     }
 
-    newNode->data = data;
-    newNode->next = NULL;
-    return newNode;
-}
+    static char output_buffer[1 << 20];
+    setvbuf(pipeline.output, output_buffer, _IOFBF, sizeof(output_buffer));
 
-void freeSimpleList(ListNode* head) 
-{
-    ListNode* current = head;
-    ListNode* nextNode;
+    pipeline.parkingRoot = Facility_Load(&g_defaultFacility, NULL, PARKING_DB_FILE);
+    Init_Concurrent_BPlus(&pipeline.users, READ_DATABASE_BPlus(USER_DB_FILE));
+    PlateIndex_Build(&g_plateIndex, pipeline.users.root);
+    Parked_Rebuild(pipeline.parkingRoot, pipeline.users.root);
+    Session_Load(&g_sessionStore, SESSION_DB_FILE);
+    Tariff_Load(&g_tariff, TARIFF_CONFIG_FILE);
 
-    while (current != NULL) 
+    const char* names[PIPELINE_STAGES] = { "parse", "lookup", "mutate", "format" };
+    for (int i = 0; i < PIPELINE_STAGES; i++) 
     {
-        nextNode = current->next;
-        free(current);
-        current = nextNode;
+        pipeline.stats[i].name = names[i];
+        if (!Spsc_Init(&pipeline.rings[i], PIPELINE_RING_SIZE)) return EXIT_FAILURE;
     }
-}
 
-// Extracts all data pointers from primary tree leaves into a linked list
-ListNode* extractToList(GenericBPlusTreeNode* primaryRoot) 
-{
-    if (!primaryRoot) return NULL;
+    // Exactly one ring's worth of items circulates, so no push can ever find its ring full for long
+    pipeline.items = (PipelineItem*)trackedCalloc(PIPELINE_RING_SIZE, sizeof(PipelineItem), MEM_PIPELINE);
+    if (!pipeline.items) 
+    {
+        perror("Failed to allocate pipeline items");
+        return EXIT_FAILURE;
+    }
 
-    ListNode* head = NULL;
-    ListNode* tail = NULL;
-    GenericBPlusTreeNode* current_primary_leaf = primaryRoot;
+    for (int i = 0; i < PIPELINE_RING_SIZE; i++) 
+    {
+        Spsc_Push(&pipeline.rings[3], &pipeline.items[i]);
+    }
 
-    // Find the leftmost leaf
-    while (current_primary_leaf && !current_primary_leaf->is_leaf) 
+    // Per-event console chatter from the gate functions is not wanted here
+    fflush(stdout);
+    if (!freopen("/dev/null", "w", stdout)) 
     {
-        current_primary_leaf = current_primary_leaf->children[0];
+        perror("Unable to silence stdout");
     }
 
-    if (!current_primary_leaf) return NULL;
+    void* (*stages[PIPELINE_STAGES])(void*) = { pipelineParseStage, pipelineLookupStage, pipelineMutateStage, pipelineFormatStage };
+    pthread_t threads[PIPELINE_STAGES];
 
-    while (current_primary_leaf != NULL) 
+    uint64_t start = monotonicNanos();
+
+    for (int i = 0; i < PIPELINE_STAGES; i++) 
     {
-        for (int i = 0; i < current_primary_leaf->num_keys; i++) 
-        {
-            void* original_data_ptr = current_primary_leaf->keys[i];
-            if (!original_data_ptr) continue;
+        pthread_create(&threads[i], NULL, stages[i], &pipeline);
+    }
 
-            ListNode* newNode = createSimpleNode(original_data_ptr);
+    for (int i = 0; i < PIPELINE_STAGES; i++) 
+    {
+        pthread_join(threads[i], NULL);
+    }
 
-            if (!newNode) 
-            {
-                fprintf(stderr, "Failed to create list node during extraction. Aborting.\n");
-                return NULL;
-            }
+    double seconds = (monotonicNanos() - start) / 1e9;
+    Pipeline_PrintStats(&pipeline, seconds);
 
-            if (tail == NULL) 
-            {
-                head = tail = newNode;
-            } 
-            else 
-            {
-                tail->next = newNode;
-                tail = newNode;
-            }
-        }
+    fclose(pipeline.input);
+    fclose(pipeline.output);
+
+    WRITE_DATABASE_BPlus(USER_DB_FILE, pipeline.users.root);
+    Facility_Save(&g_defaultFacility, pipeline.parkingRoot, NULL, PARKING_DB_FILE);
+    Session_Save(&g_sessionStore, SESSION_DB_FILE);
+
+    Destroy_BPlus_Tree(&pipeline.users.root, freeUser, freeUserKey);
+    Destroy_BPlus_Tree(&pipeline.parkingRoot, freeParking, freeParkingKey);
+    Session_Destroy(&g_sessionStore);
+    Facility_Unload(&g_defaultFacility);
+    PlateIndex_Destroy(&g_plateIndex);
 
-        current_primary_leaf = current_primary_leaf->next_leaf;
+    for (int i = 0; i < PIPELINE_STAGES; i++) 
+    {
+        trackedFree(pipeline.rings[i].slots);
     }
+    trackedFree(pipeline.items);
 
-    return head;
+    return EXIT_SUCCESS;
 }
 
 
+// Facility Host
+// Runs many lots in one process: --facilities <facilities.csv> <events_in> <results_out>.
+// The facilities file lists "id,directory" rows; each directory holds that lot's parking
+// database and optional lot config, layout, slot attributes and reservations, under the
+// usual file names. Users (USER_DB_FILE), sessions and the tariff stay in the working
+// directory and are shared by every lot. Event lines are "<facility id> ENTER ..." or
+// "<facility id> EXIT ...", with the rest as in the pipeline.
+// Each lot belongs to exactly one worker thread, so lots never contend for their own
+// state; workers only meet in the shared user index, a latch-coupled concurrent tree,
+// and on a striped lock per plate held while a vehicle's record is read and updated.
+// Events are read in chunks, dealt out to the lot queues in input order, and results
+// are written back in input order once every worker has drained the chunk. Lots drain
+// their queues independently, so a chunk never holds events for one plate at two lots:
+// it ends before the first event whose plate (folded, as misreads are corrected across
+// it) already has an event queued at another lot, and that event opens the next chunk.
+// A vehicle moving between lots therefore sees its events applied in input order.
+#define FACILITY_MAX_WORKERS 64
+#define FACILITY_CHUNK_EVENTS 16384
+#define FACILITY_PLATE_TABLE (2 * FACILITY_CHUNK_EVENTS)
+#define FACILITY_PLATE_LOCKS 256
+
+typedef struct HostedFacility 
+{
+    Facility facility;
+    LotConfig lot;
+    SlotIndex slot_index;
+    SlotAttributes slot_attributes;
+    OccupancyTimeline occupancy;
+    ReservationStore reservations;
+    ParkedList parked;
+    GenericBPlusTreeNode* parkingRoot;
+    char directory[256];
+    int* queue;  // This chunk's events for the lot, as indexes in input order
+    int queued;
+
+} HostedFacility;
+
+typedef struct FacilityEvent 
+{
+    GateEvent event;
+    int facility; // Index into the host's facilities, -1 for a line that did not parse
 
-// Comparison function pointer type for list sorting
-typedef int (*ListCompareFunc)(const void* dataA, const void* dataB);
+} FacilityEvent;
 
-int compareUsersByNumParkings_list(const void *a, const void *b) 
+typedef struct FacilityHost 
 {
-    User *userA = (User *)a; 
-    User *userB = (User *)b;
+    HostedFacility* facilities;
+    int num_facilities;
+    ConcurrentBPlusTree users;
+    pthread_mutex_t plate_locks[FACILITY_PLATE_LOCKS];
+
+    FacilityEvent* events;
+    int num_events;
+    int32_t* plate_table; // This chunk's plates by folded hash -> first event index + 1, 0 if free
+
+    int num_workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    uint64_t generation;   // Bumped to hand workers a new chunk
+    int busy;              // Workers still on the current chunk
+    bool stop;
+
+} FacilityHost;
+
+typedef struct FacilityWorker 
+{
+    FacilityHost* host;
+    int index;
 
-    if (userA->number_of_parkings != userB->number_of_parkings)
+} FacilityWorker;
+
+void facilityApplyEvent(FacilityHost* host, HostedFacility* hosted, GateEvent* event) 
+{
+    // Folded, so a misread plate takes the same lock as the vehicle it gets corrected to
+    pthread_mutex_t* plate_lock = &host->plate_locks[hashFoldedPlate(event->vehicle_num) % FACILITY_PLATE_LOCKS];
+    pthread_mutex_lock(plate_lock);
+
+    User* user = (User*)Search_BPlus_OLC(&host->users, event->vehicle_num, compareUserVehicleNum, compareUserVehicleNumInternal);
+
+    event->parking_id = -1;
+    event->amount = 0;
+
+    if (event->type == GATE_ENTRY) 
     {
-        return userA->number_of_parkings - userB->number_of_parkings;
+        event->result = Gate_Enter(&hosted->parkingRoot, NULL, &host->users, NULL, &user, event->vehicle_num, event->owner_name, event->date, event->time, event->entrance, event->required_attrs, &event->parking_id);
     }
-    else
+    else 
     {
-        return strcmp(userA->vehicle_num, userB->vehicle_num);
+        event->result = Gate_Exit(&hosted->parkingRoot, &user, event->vehicle_num, event->date, event->time, &event->parking_id);
+        event->amount = (event->result == GATE_OK) ? user->parking_amt : 0;
     }
+
+    pthread_mutex_unlock(plate_lock);
 }
 
-int compareUsersByParkingAmt_list(const void *a, const void *b) 
+// Worker w serves lots w, w + num_workers, ... for the whole run
+void* facilityWorker(void* arg) 
 {
-    User *userA = (User *)a; 
-    User *userB = (User *)b;
+    FacilityWorker* worker = (FacilityWorker*)arg;
+    FacilityHost* host = worker->host;
+    uint64_t seen = 0;
 
-    if (userA->total_parking_amt != userB->total_parking_amt)
+    pthread_mutex_lock(&host->lock);
+
+    while (true) 
     {
-        return (userA->total_parking_amt > userB->total_parking_amt) ? 1 : -1;
+        while (!host->stop && host->generation == seen) pthread_cond_wait(&host->work, &host->lock);
+        if (host->stop) break;
+
+        seen = host->generation;
+        pthread_mutex_unlock(&host->lock);
+
+        for (int f = worker->index; f < host->num_facilities; f += host->num_workers) 
+        {
+            HostedFacility* hosted = &host->facilities[f];
+            Facility_Enter(&hosted->facility);
+
+            for (int i = 0; i < hosted->queued; i++) 
+            {
+                facilityApplyEvent(host, hosted, &host->events[hosted->queue[i]].event);
+            }
+        }
+
+        pthread_mutex_lock(&host->lock);
+        if (--host->busy == 0) pthread_cond_signal(&host->done);
     }
-    else
-    {
-        return strcmp(userA->vehicle_num, userB->vehicle_num);
-    }    
+
+    pthread_mutex_unlock(&host->lock);
+
+    return NULL;
 }
 
-int compareParkingByOccupancy_list(const void *a, const void *b) 
+// Read the facilities file into host. False if it is missing, malformed or lists an id twice.
+bool readFacilities(FacilityHost* host, const char* filename) 
 {
-    Parking *pA = (Parking *)a;
-    Parking *pB = (Parking *)b;
-
-    if (pA->occupancies != pB->occupancies)
+    FILE* file = fopen(filename, "r");
+    if (!file) 
     {
-        return pB->occupancies - pA->occupancies; // Descending
+        perror("Unable to open facilities file");
+        return false;
     }
-    else
-    {
-        return pA->parking_id - pB->parking_id;
-    }   
-    
-}
 
-int compareParkingByRevenue_list(const void *a, const void *b) 
-{
-    Parking *pA = (Parking *)a; 
-    Parking *pB = (Parking *)b;
+    char line[512];
+    int capacity = 0;
+    int line_num = 1;
+    bool ok = (fgets(line, sizeof(line), file) != NULL); // Header
 
-    if (pA->revenue != pB->revenue)
+    while (ok && fgets(line, sizeof(line), file) != NULL) 
     {
-        return (pB->revenue > pA->revenue) ? 1 : -1; // Descending
+        line_num++;
+
+        int id;
+        char directory[256];
+        int fields = sscanf(line, "%d,%255[^,\r\n]", &id, directory);
+
+        if (fields <= 0) continue;
+
+        ok = (fields == 2 && id >= 0);
+        for (int f = 0; ok && f < host->num_facilities; f++) ok = (host->facilities[f].facility.id != id);
+
+        if (ok && host->num_facilities == capacity) 
+        {
+            capacity = capacity ? capacity * 2 : 16;
+            HostedFacility* grown = (HostedFacility*)trackedRealloc(host->facilities, sizeof(HostedFacility) * capacity, MEM_PIPELINE);
+            ok = (grown != NULL);
+            if (ok) host->facilities = grown;
+        }
+
+        if (!ok) 
+        {
+            fprintf(stderr, "Invalid facility on line %d of %s.\n", line_num, filename);
+            break;
+        }
+
+        HostedFacility* hosted = &host->facilities[host->num_facilities++];
+        memset(hosted, 0, sizeof(*hosted));
+        hosted->facility.id = id;
+        snprintf(hosted->directory, sizeof(hosted->directory), "%s", directory);
     }
-    else
+
+    fclose(file);
+
+    return ok && host->num_facilities > 0;
+}
+
+int hostFacilityIndex(const FacilityHost* host, int id) 
+{
+    for (int f = 0; f < host->num_facilities; f++) 
     {
-        return pA->parking_id - pB->parking_id;
+        if (host->facilities[f].facility.id == id) return f;
     }
-    
+
+    return -1;
 }
 
-ListNode* getMiddle(ListNode* head) 
+// Record that event index of this chunk is for its plate's lot. False if the plate already
+// has an event queued at another lot, in which case the event must wait for the next chunk.
+bool hostClaimPlate(FacilityHost* host, int index) 
 {
-    if (head == NULL) return head;
-    ListNode* slow = head;
-    ListNode* fast = head->next;
+    const FacilityEvent* item = &host->events[index];
+    uint32_t slot = hashFoldedPlate(item->event.vehicle_num) & (FACILITY_PLATE_TABLE - 1);
 
-    while (fast != NULL && fast->next != NULL) 
+    for (; host->plate_table[slot] != 0; slot = (slot + 1) & (FACILITY_PLATE_TABLE - 1)) 
     {
-        slow = slow->next;
-        fast = fast->next->next;
+        const FacilityEvent* first = &host->events[host->plate_table[slot] - 1];
+
+        if (sameFoldedPlate(first->event.vehicle_num, item->event.vehicle_num)) return first->facility == item->facility;
     }
 
-    return slow;
+    host->plate_table[slot] = index + 1;
+
+    return true;
 }
 
-ListNode* mergeSortedLists(ListNode* a, ListNode* b, ListCompareFunc cmp) 
+// Hand the chunk in host->events to the workers and wait until all of it is applied
+void hostRunChunk(FacilityHost* host) 
 {
-    if (a == NULL) return b;
-    if (b == NULL) return a;
+    for (int f = 0; f < host->num_facilities; f++) host->facilities[f].queued = 0;
 
-    ListNode* result = NULL;
-    if (cmp(a->data, b->data) <= 0) 
-    {
-        result = a;
-        result->next = mergeSortedLists(a->next, b, cmp);
-    } 
-    else 
+    for (int i = 0; i < host->num_events; i++) 
     {
-        result = b;
-        result->next = mergeSortedLists(a, b->next, cmp);
+        int f = host->events[i].facility;
+        if (f >= 0) 
+        {
+            HostedFacility* hosted = &host->facilities[f];
+            hosted->queue[hosted->queued++] = i;
+        }
     }
 
-    return result;
+    pthread_mutex_lock(&host->lock);
+    host->busy = host->num_workers;
+    host->generation++;
+    pthread_cond_broadcast(&host->work);
+
+    while (host->busy > 0) pthread_cond_wait(&host->done, &host->lock);
+    pthread_mutex_unlock(&host->lock);
 }
 
-void mergeSortList(ListNode** headRef, ListCompareFunc cmp) 
+void hostWriteResults(const FacilityHost* host, FILE* output) 
 {
-    ListNode* head = *headRef;
-    ListNode* a;
-    ListNode* b;
-
-    // Base case: 0 or 1 element
-    if (head == NULL || head->next == NULL) 
+    for (int i = 0; i < host->num_events; i++) 
     {
-        return;
-    }
+        const FacilityEvent* item = &host->events[i];
+        const GateEvent* event = &item->event;
 
-    // Split list into 'a' and 'b' halves
-    ListNode* middle = getMiddle(head);
-    a = head;
-    b = middle->next;
-    middle->next = NULL; // Terminate the first half
+        if (item->facility < 0) 
+        {
+            fprintf(output, "ERR USAGE\n");
+            continue;
+        }
 
-    // Recursively sort the two halves
-    mergeSortList(&a, cmp);
-    mergeSortList(&b, cmp);
+        fprintf(output, "%d ", host->facilities[item->facility].facility.id);
 
-    // Merge the sorted halves
-    *headRef = mergeSortedLists(a, b, cmp);
+        if (event->result != GATE_OK) 
+        {
+            fprintf(output, "%s ERR %s\n", event->vehicle_num, gateStatusName(event->result));
+        }
+        else if (event->type == GATE_ENTRY) 
+        {
+            fprintf(output, "%s OK %d\n", event->vehicle_num, event->parking_id);
+        }
+        else 
+        {
+            fprintf(output, "%s OK %d %.2f\n", event->vehicle_num, event->parking_id, event->amount);
+        }
+    }
 }
 
-void printSimpleList(ListNode* head, PrintFunc printData, const char* listName) 
+int Run_Facilities(const char* facilities_file, const char* events_file, const char* output_file) 
 {
-    if (!printData) 
+    FacilityHost host;
+    memset(&host, 0, sizeof(host));
+
+    if (!readFacilities(&host, facilities_file)) 
     {
-        printf("Error: Cannot print list '%s'. No data printing function provided.\n", listName);
-        return;
+        trackedFree(host.facilities);
+        return EXIT_FAILURE;
     }
 
-    printf("\n--- Printing Linked List: %s ---\n", listName);
+    FILE* input = fopen(events_file, "r");
+    FILE* output = fopen(output_file, "w");
 
-    if (head == NULL) 
+    if (!input || !output) 
     {
-        printf("List is empty.\n");
-        printf("--- End of List: %s ---\n\n", listName);
-        return;
+        perror("Unable to open facility input/output");
+        if (input) fclose(input);
+        if (output) fclose(output);
+        trackedFree(host.facilities);
+        return EXIT_FAILURE;
     }
 
-    ListNode* current = head;
-    int count = 1;
+    Init_Concurrent_BPlus(&host.users, READ_DATABASE_BPlus(USER_DB_FILE));
+    PlateIndex_Build(&g_plateIndex, host.users.root);
+    Session_Load(&g_sessionStore, SESSION_DB_FILE);
+    Tariff_Load(&g_tariff, TARIFF_CONFIG_FILE);
 
-    while (current != NULL) 
+    for (int f = 0; f < host.num_facilities; f++) 
     {
-        printf("Node %d: \n", count++);
-        if (current->data != NULL) 
-        {
-            printData(current->data);
-        } 
-        else 
-        {
-            printf("Node contains NULL data pointer\n");
-        }
-
-        current = current->next;
+        HostedFacility* hosted = &host.facilities[f];
+        LotConfig defaults = LOT_DEFAULTS;
+
+        hosted->lot = defaults;
+        hosted->occupancy.start = -1;
+        hosted->reservations.next_id = 1;
+        pthread_mutex_init(&hosted->slot_index.lock, NULL);
+        pthread_mutex_init(&hosted->occupancy.lock, NULL);
+        pthread_mutex_init(&hosted->reservations.lock, NULL);
+        hosted->parked.pending.which = 1;
+        hosted->parked.clock = -1;
+        pthread_mutex_init(&hosted->parked.lock, NULL);
+
+        hosted->facility.lot = &hosted->lot;
+        hosted->facility.slot_index = &hosted->slot_index;
+        hosted->facility.slot_attributes = &hosted->slot_attributes;
+        hosted->facility.occupancy = &hosted->occupancy;
+        hosted->facility.reservations = &hosted->reservations;
+        hosted->facility.parked = &hosted->parked;
+
+        printf("Facility %d (%s):\n", hosted->facility.id, hosted->directory);
+        hosted->parkingRoot = Facility_Load(&hosted->facility, hosted->directory, PARKING_DB_FILE);
+        Parked_Rebuild(hosted->parkingRoot, host.users.root);
+        hosted->queue = (int*)trackedMalloc(sizeof(int) * FACILITY_CHUNK_EVENTS, MEM_PIPELINE);
     }
+    Facility_Enter(NULL);
 
-    printf("--- End of List ---\n\n");
-}
+    host.events = (FacilityEvent*)trackedMalloc(sizeof(FacilityEvent) * FACILITY_CHUNK_EVENTS, MEM_PIPELINE);
+    host.plate_table = (int32_t*)trackedMalloc(sizeof(int32_t) * FACILITY_PLATE_TABLE, MEM_PIPELINE);
 
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    host.num_workers = host.num_facilities;
+    if (cpus > 0 && host.num_workers > cpus) host.num_workers = (int)cpus;
+    if (host.num_workers > FACILITY_MAX_WORKERS) host.num_workers = FACILITY_MAX_WORKERS;
 
-int compareUserAmtVsBoundary(const User* userData, const float boundaryVal) 
-{
-    if (!userData || !boundaryVal) 
-    {
-        return -1;
-    }
-    
-    const User* user = userData;
-    const float boundaryAmount = boundaryVal;
+    pthread_mutex_init(&host.lock, NULL);
+    pthread_cond_init(&host.work, NULL);
+    pthread_cond_init(&host.done, NULL);
+    for (int i = 0; i < FACILITY_PLATE_LOCKS; i++) pthread_mutex_init(&host.plate_locks[i], NULL);
 
-    if (user->total_parking_amt < boundaryAmount) 
-    {
-        return -1; // User amount is less than the boundary
-    } 
-    else 
+    static char output_buffer[1 << 20];
+    setvbuf(output, output_buffer, _IOFBF, sizeof(output_buffer));
+
+    // Per-event console chatter from the gate functions is not wanted here
+    fflush(stdout);
+    if (!freopen("/dev/null", "w", stdout)) 
     {
-        return 1; // User amount is greater than the boundary
+        perror("Unable to silence stdout");
     }
-}
 
-void printSimpleListRange(ListNode* head,const float min_val,const float max_val, PrintFunc printData) 
-{
-    printf("\n--- Printing List ---\n");
+    FacilityWorker workers[FACILITY_MAX_WORKERS];
+    pthread_t threads[FACILITY_MAX_WORKERS];
 
-    if (head == NULL) 
+    for (int w = 0; w < host.num_workers; w++) 
     {
-        printf("List is empty. No items to check in range.\n");
-        printf("--- End of List ---\n\n");
-        return;
+        workers[w].host = &host;
+        workers[w].index = w;
+        pthread_create(&threads[w], NULL, facilityWorker, &workers[w]);
     }
 
-    ListNode* current = head;
-    int count = 0; // Count of items printed within the range
-    bool first_printed = true;
+    uint64_t start = monotonicNanos();
+    long total = 0;
+    char line[SERVER_MAX_LINE];
+    bool more = true;
+    FacilityEvent carried;   // Event that ended the last chunk and opens the next one
+    bool have_carried = false;
 
-    while (current != NULL) 
+    while (more || have_carried) 
     {
-        if (current->data != NULL) 
+        host.num_events = 0;
+        memset(host.plate_table, 0, sizeof(int32_t) * FACILITY_PLATE_TABLE);
+
+        if (have_carried) 
         {
-            // Check if data is within the range [min_val, max_val]
-            bool greater_equal_min = (compareUserAmtVsBoundary(current->data, min_val) >= 0);
-            bool less_equal_max    = (compareUserAmtVsBoundary(current->data, max_val) <= 0);
+            host.events[host.num_events] = carried;
+            hostClaimPlate(&host, host.num_events++);
+            have_carried = false;
+        }
 
-            if (greater_equal_min && less_equal_max) 
-            {
-                // Data is in range, print it
-                if (first_printed) 
-                {
-                    printf("Items found within the specified range:\n");
-                    first_printed = false;
-                }
+        while (host.num_events < FACILITY_CHUNK_EVENTS && (more = (fgets(line, sizeof(line), input) != NULL))) 
+        {
+            char* rest;
+            long id = strtol(line, &rest, 10);
+            if (rest == line && (line[0] == '\n' || line[0] == '\0')) continue;
 
-                printData(current->data);
-                count++;
+            FacilityEvent* item = &host.events[host.num_events];
+            item->facility = (rest != line) ? hostFacilityIndex(&host, (int)id) : -1;
+
+            if (item->facility >= 0 && !parseGateEventLine(rest, &item->event)) item->facility = -1;
+
+            if (item->facility >= 0 && !hostClaimPlate(&host, host.num_events)) 
+            {
+                carried = *item;
+                have_carried = true;
+                break;
             }
+
+            host.num_events++;
         }
-        current = current->next;
+
+        if (host.num_events == 0) break;
+
+        hostRunChunk(&host);
+        hostWriteResults(&host, output);
+        total += host.num_events;
     }
 
-    if (count == 0) 
+    double seconds = (monotonicNanos() - start) / 1e9;
+
+    pthread_mutex_lock(&host.lock);
+    host.stop = true;
+    pthread_cond_broadcast(&host.work);
+    pthread_mutex_unlock(&host.lock);
+
+    for (int w = 0; w < host.num_workers; w++) pthread_join(threads[w], NULL);
+
+    fprintf(stderr, "%ld events over %d facilities on %d workers in %.3f s = %.0f events/s\n",
+            total, host.num_facilities, host.num_workers, seconds, seconds > 0 ? total / seconds : 0.0);
+
+    fclose(input);
+    fclose(output);
+
+    WRITE_DATABASE_BPlus(USER_DB_FILE, host.users.root);
+    Session_Save(&g_sessionStore, SESSION_DB_FILE);
+
+    for (int f = 0; f < host.num_facilities; f++) 
     {
-        printf("No items found within the specified range.\n");
+        HostedFacility* hosted = &host.facilities[f];
+
+        Facility_Enter(&hosted->facility);
+        Facility_Save(&hosted->facility, hosted->parkingRoot, hosted->directory, PARKING_DB_FILE);
+        Facility_Unload(&hosted->facility);
+        Destroy_BPlus_Tree(&hosted->parkingRoot, freeParking, freeParkingKey);
+        trackedFree(hosted->queue);
     }
+    Facility_Enter(NULL);
 
-    printf("--- End of List (%d items printed) ---\n\n", count);
-}
+    Destroy_BPlus_Tree(&host.users.root, freeUser, freeUserKey);
+    Session_Destroy(&g_sessionStore);
+    PlateIndex_Destroy(&g_plateIndex);
+    trackedFree(host.events);
+    trackedFree(host.plate_table);
+    trackedFree(host.facilities);
 
+    return EXIT_SUCCESS;
+}
 
-void UsersByNumParkings_ListTree(GenericBPlusTreeNode* userRootPrimary) 
+// Offline export of the current databases: --export csv|jsonl <users_out> <parking_out>
+int Run_Export(const char* format_name, const char* user_file, const char* parking_file) 
 {
-    if (!userRootPrimary) 
-    { 
-        printf("Primary user tree is empty.\n");
-        return; 
+    export_format format;
+
+    if (strcmp(format_name, "csv") == 0) format = EXPORT_CSV;
+    else if (strcmp(format_name, "jsonl") == 0) format = EXPORT_JSONL;
+    else 
+    {
+        fprintf(stderr, "Unknown export format '%s' (use csv or jsonl).\n", format_name);
+        return EXIT_FAILURE;
     }
 
-    ListNode* userList = extractToList(userRootPrimary);
-    if(!userList) 
-    { 
-        printf("Failed to extract user data to list.\n"); 
-        return; 
+    ParkingEngine engine;
+    if (!Engine_Init(&engine, PARKING_DB_FILE, USER_DB_FILE, NULL)) 
+    {
+        return EXIT_FAILURE;
     }
 
-    mergeSortList(&userList, compareUsersByNumParkings_list);
+    uint64_t start = monotonicNanos();
+    bool ok = Engine_Export(&engine, format, user_file, parking_file);
+    uint64_t elapsed = monotonicNanos() - start;
 
-    printf("\n>>> Printing Sorted List <<<\n");
-    printSimpleList(userList, printUser, "Sorted User List (by Num Parkings)");
-    
-    freeSimpleList(userList);
-    userList = NULL;
+    if (ok) 
+    {
+        printf("Exported %ld users and %ld parking slots in %.3f s.\n", Count_BPlus(engine.userTree.root), Count_BPlus(engine.parkingRoot), elapsed / 1e9);
+    }
+    else 
+    {
+        perror("Export failed");
+    }
+
+    Engine_Destroy(&engine);
 
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void UsersByParkingAmountRange_ListTree(GenericBPlusTreeNode* userRootPrimary) 
+// Offline shift close: --settle <DD/MM/YYYY> <HH:MM> [report]. The databases are only read.
+int Run_Settle(const char* date, const char* time, const char* report_file) 
 {
-    if (!userRootPrimary) 
-    { 
-        printf("Primary user tree is empty.\n");
-        return; 
-    }
+    int64_t cutoff = parseTimestamp(date, time);
 
-    ListNode* userList = extractToList(userRootPrimary);
-    if(!userList) 
-    { 
-        printf("Failed to extract user data to list.\n"); 
-        return; 
+    if (cutoff < 0) 
+    {
+        fprintf(stderr, "Invalid cutoff '%s %s' (use DD/MM/YYYY HH:MM).\n", date, time);
+        return EXIT_FAILURE;
     }
 
-    float min_amount, max_amount;
-    printf("Enter minimum parking amount: ");
-    scanf("%f", &min_amount);
-
-    printf("\nEnter maximum parking amount: ");
-    scanf("%f", &max_amount);
-
-    if (min_amount > max_amount)
-    { 
-        printf("Min > Max invalid.\n"); 
-        return; 
+    ParkingEngine engine;
+    if (!Engine_Init(&engine, PARKING_DB_FILE, USER_DB_FILE, NULL)) 
+    {
+        return EXIT_FAILURE;
     }
 
-    mergeSortList(&userList, compareUsersByParkingAmt_list);
+    Settlement settlement;
+    uint64_t start = monotonicNanos();
+    bool ok = Engine_Settle(&engine, cutoff, &settlement);
+    uint64_t elapsed = monotonicNanos() - start;
 
-    printSimpleListRange(userList, min_amount, max_amount, printUser);
+    if (ok) 
+    {
+        ok = Settlement_Write(&settlement, report_file);
+        printf("Priced in %.3f s.\n", elapsed / 1e9);
+        Settlement_Free(&settlement);
+    }
 
-    freeSimpleList(userList);
-    userList = NULL;
+    Engine_Destroy(&engine);
 
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-void ParkingByOccupancy_ListTree(GenericBPlusTreeNode* parkingRootPrimary)
+// Paged user database tool: --paged <db> <frames> <command>, frames being the page pool
+// size (0 for the default). Commands:
+//   import [user_csv]  store every row of a user CSV (the user database by default)
+//   get <plate>...     look plates up
+//   export <user_csv>  write the users out in the user database's CSV layout
+//   stats              size of the database
+int Run_Paged(const char* db_file, int frames, const char* command, int argc, char** argv) 
 {
-    if (!parkingRootPrimary) 
-    { 
-        printf("Primary parking tree is empty.\n");
-        return; 
-    }
+    PagedUserTree tree;
 
-    ListNode* parkingList = extractToList(parkingRootPrimary);
-    if(!parkingList) 
-    { 
-        printf("Failed to extract parking data to list.\n"); 
-        return; 
+    if (!PagedTree_Open(&tree, db_file, frames > 0 ? frames : PAGED_DEFAULT_FRAMES)) 
+    {
+        return EXIT_FAILURE;
     }
 
-    mergeSortList(&parkingList, compareParkingByOccupancy_list);
+    bool ok = true;
+    uint64_t start = monotonicNanos();
 
-    printf("\n>>> Printing Sorted List <<<\n");
-    printSimpleList(parkingList, printParking, "Sorted Parking List (by Occupancy)");
+    if (strcmp(command, "import") == 0) 
+    {
+        long stored = PagedTree_Import(&tree, argc >= 1 ? argv[0] : USER_DB_FILE);
 
-    freeSimpleList(parkingList);
-    parkingList = NULL;
-}
+        ok = stored >= 0;
+        if (ok) printf("Stored %ld user records in %.3f s.\n", stored, (monotonicNanos() - start) / 1e9);
+    }
+    else if (strcmp(command, "get") == 0) 
+    {
+        for (int i = 0; i < argc; i++) 
+        {
+            User user;
 
-void ParkingByRevenue_ListTree(GenericBPlusTreeNode* parkingRootPrimary)
-{    
-    if (!parkingRootPrimary) 
-    { 
-        printf("Primary parking tree is empty.\n");
-        return; 
+            if (PagedTree_Get(&tree, argv[i], &user)) printUser(&user);
+            else printf("  Vehicle %s not found.\n", argv[i]);
+        }
     }
+    else if (strcmp(command, "export") == 0 && argc >= 1) 
+    {
+        FILE* file = fopen(argv[0], "w");
 
-    ListNode* parkingList = extractToList(parkingRootPrimary);
-    if(!parkingList) 
-    { 
-        printf("Failed to extract parking data to list.\n"); 
-        return; 
+        if (!file) 
+        {
+            perror("Unable to open user file for writing");
+            ok = false;
+        }
+        else 
+        {
+            fprintf(file, USER_CSV_HEADER);
+            long written = PagedTree_ForEach(&tree, visitPrintUserInFile, file);
+
+            ok = fclose(file) == 0;
+            if (ok) printf("Exported %ld users in %.3f s.\n", written, (monotonicNanos() - start) / 1e9);
+        }
+    }
+    else if (strcmp(command, "stats") != 0) 
+    {
+        fprintf(stderr, "Unknown paged database command '%s' (use import, get, export or stats).\n", command);
+        ok = false;
     }
 
-    mergeSortList(&parkingList, compareParkingByRevenue_list);
+    // Flushed before the stats so they count the pages written back
+    bool flushed = PagedTree_Flush(&tree);
 
+    PagedTree_PrintStats(&tree);
 
-    printf("\n>>> Printing Sorted List <<<\n");
-    printSimpleList(parkingList, printParking, "Sorted Parking List (by Revenue)");
+    if (!PagedTree_Close(&tree) || !flushed) 
+    {
+        fprintf(stderr, "Failed to write paged user database %s.\n", db_file);
+        ok = false;
+    }
 
-    freeSimpleList(parkingList);
-    parkingList = NULL;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-int main() 
+int main(int argc, char** argv) 
 {
     char vehicle_num[20];
     char owner_name[50];
@@ -1651,18 +12074,77 @@ int main()
 
     bool status = true;
     int temp;
+    int entrance;
+    uint32_t required_attrs;
+    char features[64];
+
+#ifdef PARKING_METRICS
+    Metrics_InstallSignalDump();
+#endif
+
+    if (argc >= 3 && strcmp(argv[1], "--daemon") == 0) 
+    {
+        bool paged = argc >= 5 && strcmp(argv[3], "--paged") == 0;
+        return Run_Server(argv[2], paged ? argv[4] : NULL, paged && argc >= 6 ? atoi(argv[5]) : 0);
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--pipeline") == 0) 
+    {
+        return Run_Pipeline(argv[2], argv[3]);
+    }
+
+    if (argc >= 5 && strcmp(argv[1], "--loadtest") == 0) 
+    {
+        return Run_Load_Test(argv[2], atoi(argv[3]), atoi(argv[4]), argc >= 6 ? atoi(argv[5]) : 16);
+    }
+
+    if (argc >= 5 && strcmp(argv[1], "--facilities") == 0) 
+    {
+        return Run_Facilities(argv[2], argv[3], argv[4]);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--scaletest") == 0) 
+    {
+        return Run_Scale_Test(atoi(argv[2]), argc >= 4 ? atoi(argv[3]) : 1000000);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--olctest") == 0) 
+    {
+        return Run_OLC_Test(atoi(argv[2]), argc >= 4 ? atoi(argv[3]) : 1000000);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--shardtest") == 0) 
+    {
+        return Run_Shard_Test(atoi(argv[2]), argc >= 4 ? atoi(argv[3]) : 1000000, argc >= 5 ? argv[4] : NULL);
+    }
+
+    if (argc >= 5 && strcmp(argv[1], "--export") == 0) 
+    {
+        return Run_Export(argv[2], argv[3], argv[4]);
+    }
 
-    // Initialize Parking B+ Tree
-    GenericBPlusTreeNode* parkingRoot = READ_PARKING_BPlus("sample_parking.csv");
+    if (argc >= 4 && strcmp(argv[1], "--settle") == 0) 
+    {
+        return Run_Settle(argv[2], argv[3], argc >= 5 ? argv[4] : SETTLEMENT_REPORT_FILE);
+    }
+
+    if (argc >= 5 && strcmp(argv[1], "--paged") == 0) 
+    {
+        return Run_Paged(argv[2], atoi(argv[3]), argv[4], argc - 5, argv + 5);
+    }
 
-    // Initialize User B+ Tree
-    GenericBPlusTreeNode* userRoot = READ_DATABASE_BPlus("sample_user.csv");
+    // Initialize Parking and User B+ Trees
+    ParkingEngine engine;
+    if (!Engine_Init(&engine, PARKING_DB_FILE, USER_DB_FILE, NULL)) 
+    {
+        return EXIT_FAILURE;
+    }
 
     printf("\n--- Initial B+ Tree States ---\n");
     printf("User Tree Leaves:\n");
-    traverseLeaves(userRoot, printUser);
+    traverseLeaves(engine.userTree.root, printUser);
     printf("\nParking Tree Leaves:\n");
-    traverseLeaves(parkingRoot, printParking);
+    traverseLeaves(engine.parkingRoot, printParking);
     printf("-----------------------------\n\n");
 
     int choice;
@@ -1674,6 +12156,16 @@ int main()
         printf("[3] View Vehicle Details\n");
         printf("[4] Sort Vehicle Users\n");
         printf("[5] Sort Parking Spaces\n");
+        printf("[6] Tree and Memory Statistics\n");
+        printf("[7] Compact Trees\n");
+#ifdef PARKING_METRICS
+        printf("[8] Dump Metrics\n");
+#endif
+        printf("[9] Session History\n");
+        printf("[10] Occupancy Analytics\n");
+        printf("[11] Reservations\n");
+        printf("[12] Parked Vehicles\n");
+        printf("[13] Plates by Region\n");
         printf("[0] Exit and Save\n");
         printf("-------------------------------\n");
         printf("[*] Enter choice: ");
@@ -1694,7 +12186,27 @@ int main()
                 printf("Arrival time (HH:MM):\n");
                 scanf("%6s", arrival_time);
 
-                status = Insert_Update(&parkingRoot, &userRoot, vehicle_num, owner_name, arrival_date, arrival_time);
+                entrance = 0;
+                if (g_slotIndex.num_entrances > 1) 
+                {
+                    printf("Entrance (0-%d):\n", g_slotIndex.num_entrances - 1);
+                    scanf("%d", &entrance);
+                }
+
+                required_attrs = 0;
+                if (g_slotAttributes.vacant) 
+                {
+                    printf("Required slot features (ev|compact|large|covered|accessible, - for none):\n");
+                    scanf("%63s", features);
+
+                    if (!parseSlotAttributes(features, &required_attrs)) 
+                    {
+                        printf("Unknown slot feature in '%s'.\n", features);
+                        break;
+                    }
+                }
+
+                status = Engine_Enter(&engine, vehicle_num, owner_name, arrival_date, arrival_time, entrance, required_attrs);
 
                 if(status) 
                 {
@@ -1717,7 +12229,7 @@ int main()
                 printf("Departure time (HH:MM):\n");
                 scanf("%6s", departure_time);
 
-                status = Exit_Vehicle_BPlus(&parkingRoot, &userRoot, vehicle_num, departure_date, departure_time);
+                status = Engine_Exit(&engine, vehicle_num, departure_date, departure_time);
 
                 if(status) 
                 {
@@ -1735,7 +12247,7 @@ int main()
                 scanf("%20s", vehicle_num);
                 printf("\n");
 
-                PrintOneEntry_BPlus(userRoot, vehicle_num);
+                Engine_PrintOneEntry(&engine, vehicle_num);
                 break;
 
              case 4:
@@ -1746,11 +12258,11 @@ int main()
 
                 if(!temp)
                 {
-                    UsersByNumParkings_ListTree(userRoot);
+                    Engine_UserReport(&engine, UsersByNumParkings_ListTree);
                 }
                 else
                 {
-                    UsersByParkingAmountRange_ListTree(userRoot);
+                    Engine_UserReport(&engine, UsersByParkingAmountRange_ListTree);
                 }
                 break;
 
@@ -1762,14 +12274,205 @@ int main()
 
                 if(!temp)
                 {
-                    ParkingByOccupancy_ListTree(parkingRoot);
+                    Engine_ParkingReport(&engine, ParkingByOccupancy_ListTree);
                 }
                 else
                 {
-                    ParkingByRevenue_ListTree(parkingRoot);
+                    Engine_ParkingReport(&engine, ParkingByRevenue_ListTree);
+                }
+                break;
+
+            case 6:
+                Engine_PrintStats(&engine);
+                break;
+
+            case 7:
+                if (Engine_Compact(&engine)) 
+                {
+                    printf("Trees compacted.\n");
+                    Engine_PrintStats(&engine);
+                }
+                else 
+                {
+                    printf("Compaction failed.\n");
+                }
+                break;
+
+#ifdef PARKING_METRICS
+            case 8:
+                Metrics_Dump(stdout);
+                break;
+#endif
+
+            case 9:
+                Session_PrintStats(&g_sessionStore);
+                printf("Enter [0] for Revenue between two Dates\n");
+                printf("Enter [1] for Visits of a Vehicle\n");
+                printf("Enter [2] for Sessions per Slot per Day\n");
+                printf("\n[*] Option: ");
+                scanf("%d", &temp);
+
+                if (temp == 1) 
+                {
+                    printf("Enter Vehicle Number\n");
+                    scanf("%20s", vehicle_num);
+                    Session_PrintVisits(&g_sessionStore, vehicle_num);
+                }
+                else 
+                {
+                    printf("Enter From Date (DD/MM/YYYY):\n");
+                    scanf("%11s", arrival_date);
+                    printf("Enter To Date (DD/MM/YYYY):\n");
+                    scanf("%11s", departure_date);
+
+                    if (temp == 0) Session_PrintRevenue(&g_sessionStore, arrival_date, departure_date);
+                    else Session_PrintSlotDays(&g_sessionStore, arrival_date, departure_date, (int)Count_BPlus(engine.parkingRoot));
+                }
+                break;
+
+            case 10:
+                for (int i = 0; i < g_occupancy.num_series; i++) 
+                {
+                    char name[32];
+                    Occupancy_SeriesName(&g_occupancy, i, name, sizeof(name));
+                    printf("Enter [%d] for %s\n", i, name);
+                }
+                printf("\n[*] Series: ");
+                scanf("%d", &temp);
+
+                printf("Enter [0] for Minutes, [1] for Hours, [2] for Days\n");
+                printf("\n[*] Resolution: ");
+                int resolution = 0;
+                scanf("%d", &resolution);
+                if (resolution < 0 || resolution >= OCC_RESOLUTIONS) resolution = OCC_HOUR;
+
+                printf("Enter From Date (DD/MM/YYYY):\n");
+                scanf("%11s", arrival_date);
+                printf("Enter To Date (DD/MM/YYYY):\n");
+                scanf("%11s", departure_date);
+
+                Occupancy_PrintWindow(&g_occupancy, temp, (occupancy_resolution)resolution, arrival_date, departure_date);
+                break;
+
+            case 11:
+                printf("Enter [0] to Reserve a Slot\n");
+                printf("Enter [1] to Cancel a Reservation\n");
+                printf("Enter [2] to List Reservations of a Vehicle\n");
+                printf("\n[*] Option: ");
+                scanf("%d", &temp);
+
+                if (temp == 0) 
+                {
+                    printf("Vehicle number:\n");
+                    scanf("%20s", vehicle_num);
+                    printf("Enter Start Date (DD/MM/YYYY):\n");
+                    scanf("%11s", arrival_date);
+                    printf("Start time (HH:MM):\n");
+                    scanf("%6s", arrival_time);
+                    printf("Enter End Date (DD/MM/YYYY):\n");
+                    scanf("%11s", departure_date);
+                    printf("End time (HH:MM):\n");
+                    scanf("%6s", departure_time);
+
+                    int reserved_id = -1;
+                    int64_t reservation = Engine_Reserve(&engine, vehicle_num, parseTimestamp(arrival_date, arrival_time), parseTimestamp(departure_date, departure_time), &reserved_id);
+
+                    if (reservation >= 0) 
+                    {
+                        printf("Reservation %lld holds Parking Slot %d for %s.\n", (long long)reservation, reserved_id, vehicle_num);
+                    }
+                    else 
+                    {
+                        printf("No slot is free for that window.\n");
+                    }
+                }
+                else if (temp == 1) 
+                {
+                    long long reservation;
+                    printf("Reservation ID:\n");
+                    scanf("%lld", &reservation);
+
+                    printf(Reservation_Cancel(&g_reservations, reservation) ? "Reservation cancelled.\n" : "No such reservation.\n");
+                }
+                else 
+                {
+                    printf("Vehicle number:\n");
+                    scanf("%20s", vehicle_num);
+
+                    if (Reservation_ForPlate(&g_reservations, vehicle_num, printReservation, NULL) == 0) 
+                    {
+                        printf("No reservations for %s.\n", vehicle_num);
+                    }
+                }
+                break;
+
+            case 12:
+                printf("Enter [0] to List Parked Vehicles\n");
+                printf("Enter [1] to Find Overstays\n");
+                printf("Enter [2] to Set an Overstay Alert\n");
+                printf("Enter [3] to Settle All Parked Vehicles\n");
+                printf("\n[*] Option: ");
+                scanf("%d", &temp);
+
+                if (temp == 0) 
+                {
+                    printf("Slot number (0 lists every parked vehicle):\n");
+                    scanf("%d", &temp);
+
+                    Engine_PrintParked(&engine, temp);
+                }
+                else if (temp == 1) 
+                {
+                    printf("Parked for at least (hours):\n");
+                    scanf("%d", &temp);
+                    printf("As of date (DD/MM/YYYY):\n");
+                    scanf("%11s", arrival_date);
+                    printf("As of time (HH:MM):\n");
+                    scanf("%6s", arrival_time);
+
+                    int64_t now = parseTimestamp(arrival_date, arrival_time);
+                    long found = (now >= 0) ? Engine_Overstays(&engine, now, (int64_t)temp * 60, printOverstay, &now) : 0;
+                    printf("%ld vehicle(s) parked %d hour(s) or more.\n", found, temp);
+                }
+                else if (temp == 3) 
+                {
+                    printf("Cutoff date (DD/MM/YYYY):\n");
+                    scanf("%11s", departure_date);
+                    printf("Cutoff time (HH:MM):\n");
+                    scanf("%6s", departure_time);
+
+                    Settlement settlement;
+                    int64_t cutoff = parseTimestamp(departure_date, departure_time);
+
+                    if (cutoff < 0) 
+                    {
+                        printf("Invalid cutoff.\n");
+                    }
+                    else if (Engine_Settle(&engine, cutoff, &settlement)) 
+                    {
+                        Settlement_Write(&settlement, SETTLEMENT_REPORT_FILE);
+                        Settlement_Free(&settlement);
+                    }
+                }
+                else 
+                {
+                    printf("Alert after (hours, 0 turns the alert off):\n");
+                    scanf("%d", &temp);
+
+                    // Alerts fire as later gate events move time past each vehicle's limit
+                    static int64_t alert_minutes;
+                    alert_minutes = (int64_t)temp * 60;
+                    Engine_SetOverstayAlarm(&engine, alert_minutes, temp > 0 ? printOverstayAlarm : NULL, &alert_minutes);
                 }
                 break;
 
+            case 13:
+                printf("Plate prefix (e.g. MH14):\n");
+                scanf("%20s", vehicle_num);
+
+                printf("%ld vehicle(s) registered under %s.\n", Engine_ScanPlates(&engine, vehicle_num, NULL, visitPrintUser, NULL), vehicle_num);
+                break;
+
             case 0:
                 printf("Exiting and saving data...\n");
                 break;
@@ -1781,13 +12484,11 @@ int main()
     } while (choice != 0);
 
     // Save data to files before exiting
-    WRITE_DATABASE_BPlus("sample_user.csv", userRoot);
-    WRITE_PARKING_BPlus("sample_parking.csv", parkingRoot);
+    Engine_Save(&engine, PARKING_DB_FILE, USER_DB_FILE);
 
     // Clean up memory
     printf("Cleaning up resources...\n");
-    Destroy_BPlus_Tree(&userRoot, freeUser, freeUserKey);
-    Destroy_BPlus_Tree(&parkingRoot, freeParking, freeParkingKey);
+    Engine_Destroy(&engine);
 
 
     printf("Thank You!\n");